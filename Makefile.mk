@@ -449,6 +449,9 @@ endif
 ifeq ($(CONFIG_COMPRESS_RAMSTAGE_LZ4),y)
 CBFS_COMPRESS_FLAG:=LZ4
 endif
+ifeq ($(CONFIG_COMPRESS_RAMSTAGE_ZSTD),y)
+CBFS_COMPRESS_FLAG:=ZSTD
+endif
 
 CBFS_PAYLOAD_COMPRESS_FLAG:=none
 ifeq ($(CONFIG_COMPRESSED_PAYLOAD_LZMA),y)
@@ -457,6 +460,9 @@ endif
 ifeq ($(CONFIG_COMPRESSED_PAYLOAD_LZ4),y)
 CBFS_PAYLOAD_COMPRESS_FLAG:=LZ4
 endif
+ifeq ($(CONFIG_COMPRESSED_PAYLOAD_ZSTD),y)
+CBFS_PAYLOAD_COMPRESS_FLAG:=ZSTD
+endif
 
 CBFS_SECONDARY_PAYLOAD_COMPRESS_FLAG:=none
 ifeq ($(CONFIG_COMPRESS_SECONDARY_PAYLOAD),y)
@@ -1088,6 +1094,24 @@ else
 FMAP_SMMSTORE_ENTRY :=
 endif
 
+ifeq ($(CONFIG_ACPI_TABLE_CACHE),y)
+FMAP_ACPI_CACHE_BASE := $(call int-align, $(FMAP_CURRENT_BASE), 0x10000)
+FMAP_ACPI_CACHE_SIZE := $(CONFIG_ACPI_TABLE_CACHE_SIZE)
+FMAP_ACPI_CACHE_ENTRY := RW_ACPI_CACHE@$(FMAP_ACPI_CACHE_BASE) $(FMAP_ACPI_CACHE_SIZE)
+FMAP_CURRENT_BASE := $(call int-add, $(FMAP_ACPI_CACHE_BASE) $(FMAP_ACPI_CACHE_SIZE))
+else
+FMAP_ACPI_CACHE_ENTRY :=
+endif
+
+ifeq ($(CONFIG_PCI_TOPOLOGY_CACHE),y)
+FMAP_PCI_CACHE_BASE := $(call int-align, $(FMAP_CURRENT_BASE), 0x10000)
+FMAP_PCI_CACHE_SIZE := $(CONFIG_PCI_TOPOLOGY_CACHE_SIZE)
+FMAP_PCI_CACHE_ENTRY := RW_PCI_CACHE@$(FMAP_PCI_CACHE_BASE) $(FMAP_PCI_CACHE_SIZE)
+FMAP_CURRENT_BASE := $(call int-add, $(FMAP_PCI_CACHE_BASE) $(FMAP_PCI_CACHE_SIZE))
+else
+FMAP_PCI_CACHE_ENTRY :=
+endif
+
 ifeq ($(CONFIG_SPD_CACHE_IN_FMAP),y)
 FMAP_SPD_CACHE_BASE := $(call int-align, $(FMAP_CURRENT_BASE), 0x4000)
 FMAP_SPD_CACHE_SIZE := $(call int-multiply, $(CONFIG_DIMM_MAX) $(CONFIG_DIMM_SPD_SIZE))
@@ -1192,6 +1216,8 @@ $(obj)/fmap.fmd: $(top)/Makefile.mk $(DEFAULT_FLASHMAP) $(obj)/config.h
 	    -e "s,##CONSOLE_ENTRY##,$(FMAP_CONSOLE_ENTRY)," \
 	    -e "s,##MRC_CACHE_ENTRY##,$(FMAP_MRC_CACHE_ENTRY)," \
 	    -e "s,##SMMSTORE_ENTRY##,$(FMAP_SMMSTORE_ENTRY)," \
+	    -e "s,##ACPI_CACHE_ENTRY##,$(FMAP_ACPI_CACHE_ENTRY)," \
+	    -e "s,##PCI_CACHE_ENTRY##,$(FMAP_PCI_CACHE_ENTRY)," \
 	    -e "s,##SPD_CACHE_ENTRY##,$(FMAP_SPD_CACHE_ENTRY)," \
 	    -e "s,##VPD_ENTRY##,$(FMAP_VPD_ENTRY)," \
 	    -e "s,##HSPHY_FW_ENTRY##,$(FMAP_HSPHY_FW_ENTRY)," \
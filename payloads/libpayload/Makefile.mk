@@ -52,6 +52,7 @@ classes-$(CONFIG_LP_PDCURSES) += libmenu libform libpanel
 classes-$(CONFIG_LP_CBFS) += libcbfs
 classes-$(CONFIG_LP_LZMA) += liblzma
 classes-$(CONFIG_LP_LZ4) += liblz4
+classes-$(CONFIG_LP_ZSTD) += libzstd
 classes-$(CONFIG_LP_REMOTEGDB) += libgdb
 classes-$(CONFIG_LP_VBOOT_LIB) += vboot_fw
 classes-$(CONFIG_LP_VBOOT_LIB) += tlcl
@@ -64,6 +65,7 @@ subdirs-$(CONFIG_LP_CURSES) += curses
 subdirs-$(CONFIG_LP_CBFS) += libcbfs
 subdirs-$(CONFIG_LP_LZMA) += liblzma
 subdirs-$(CONFIG_LP_LZ4) += liblz4
+subdirs-$(CONFIG_LP_ZSTD) += libzstd
 subdirs-$(CONFIG_LP_VBOOT_LIB) += vboot
 
 INCLUDES := -Iinclude -Iinclude/$(ARCHDIR-y) -I$(obj)
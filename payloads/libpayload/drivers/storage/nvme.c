@@ -25,6 +25,13 @@
 #define NVME_SQ_ENTRY_SIZE 64
 #define NVME_CQ_ENTRY_SIZE 16
 
+/* I/O queue entries, one less than this can be in flight. */
+#define NVME_IO_QUEUE_SIZE 32
+
+/* Blocks per read command and the PRP list entries they can take. */
+#define NVME_MAX_BLOCKS 512
+#define NVME_PRP_LIST_ENTRIES (NVME_MAX_BLOCKS * 512 / 0x1000)
+
 struct nvme_dev {
 	storage_dev_t storage_dev;
 
@@ -33,11 +40,17 @@ struct nvme_dev {
 	struct {
 		void *base;
 		uint32_t *bell;
-		uint16_t idx; // bool pos 0 or 1
+		uint16_t idx;
 		uint16_t round; // bool round 0 or 1+0xd
+		uint16_t size;
 	} queue[4];
 
-	uint64_t *prp_list;
+	/* One PRP list per command identifier on the I/O queue. */
+	uint64_t *prp_lists;
+	/* Command identifiers in use and where their data goes in a vectored read. */
+	uint32_t io_busy;
+	uint16_t io_depth;
+	size_t io_pos[NVME_IO_QUEUE_SIZE];
 };
 
 
@@ -63,25 +76,48 @@ static storage_poll_t nvme_poll(struct storage_dev *dev)
 	return POLL_MEDIUM_PRESENT;
 }
 
-static int nvme_cmd(
-		struct nvme_dev *nvme, enum nvme_queue q, const struct nvme_s_queue_entry *cmd)
+/* Put a command into a submission queue, nvme_ring() tells the controller. */
+static void nvme_submit(
+		struct nvme_dev *nvme, enum nvme_queue sq, const struct nvme_s_queue_entry *cmd)
 {
-	int sq = q, cq = q+1;
-
 	void *s_entry = nvme->queue[sq].base + (nvme->queue[sq].idx * NVME_SQ_ENTRY_SIZE);
 	memcpy(s_entry, cmd, NVME_SQ_ENTRY_SIZE);
-	nvme->queue[sq].idx = (nvme->queue[sq].idx + 1) & (NVME_QUEUE_SIZE - 1);
+	if (++nvme->queue[sq].idx == nvme->queue[sq].size)
+		nvme->queue[sq].idx = 0;
+}
+
+static void nvme_ring(struct nvme_dev *nvme, enum nvme_queue sq)
+{
 	write32(nvme->queue[sq].bell, nvme->queue[sq].idx);
+}
 
+/* Wait for the next completion, returns its status and command identifier. */
+static int nvme_complete(struct nvme_dev *nvme, enum nvme_queue cq, uint16_t *cid)
+{
 	struct nvme_c_queue_entry *c_entry = nvme->queue[cq].base +
 		(nvme->queue[cq].idx * NVME_CQ_ENTRY_SIZE);
-	while (((read32(&c_entry->dw[3]) >> 16) & 0x1) == nvme->queue[cq].round)
+	uint32_t dw3;
+
+	while (((dw3 = read32(&c_entry->dw[3])) >> 16 & 0x1) == nvme->queue[cq].round)
 		;
-	nvme->queue[cq].idx = (nvme->queue[cq].idx + 1) & (NVME_QUEUE_SIZE - 1);
-	write32(nvme->queue[cq].bell, nvme->queue[cq].idx);
-	if (nvme->queue[cq].idx == 0)
+	if (++nvme->queue[cq].idx == nvme->queue[cq].size) {
+		nvme->queue[cq].idx = 0;
 		nvme->queue[cq].round = (nvme->queue[cq].round + 1) & 1;
-	return c_entry->dw[3] >> 17;
+	}
+	write32(nvme->queue[cq].bell, nvme->queue[cq].idx);
+
+	*cid = dw3 & 0xffff;
+	return dw3 >> 17;
+}
+
+static int nvme_cmd(
+		struct nvme_dev *nvme, enum nvme_queue q, const struct nvme_s_queue_entry *cmd)
+{
+	uint16_t cid;
+
+	nvme_submit(nvme, q, cmd);
+	nvme_ring(nvme, q);
+	return nvme_complete(nvme, q + 1, &cid);
 }
 
 static int delete_io_submission_queue(struct nvme_dev *nvme)
@@ -167,16 +203,15 @@ static void nvme_detach_device(struct storage_dev *dev)
 	uint16_t command = pci_read_config16(nvme->pci_dev, PCI_COMMAND);
 	pci_write_config16(nvme->pci_dev, PCI_COMMAND, command & ~PCI_COMMAND_MASTER);
 
-	free(nvme->prp_list);
+	free(nvme->prp_lists);
 }
 
-static int nvme_read(struct nvme_dev *nvme, unsigned char *buffer, uint64_t base, uint16_t count)
+/* Queue a read, using the PRP list that belongs to the command identifier. */
+static void nvme_read(struct nvme_dev *nvme, uint16_t cid, unsigned char *buffer,
+		      uint64_t base, uint16_t count)
 {
-	if (count == 0 || count > 512)
-		return -1;
-
 	struct nvme_s_queue_entry e = {
-		.dw[0] = 0x02,
+		.dw[0] = cid << 16 | 0x02,
 		.dw[1] = 0x1,
 		.dw[6] = virt_to_phys(buffer),
 		.dw[10] = base,
@@ -192,45 +227,98 @@ static int nvme_read(struct nvme_dev *nvme, unsigned char *buffer, uint64_t base
 		/* Crossing exactly one page boundary, PRP2 is second page */
 		e.dw[8] = virt_to_phys(buffer + 0x1000) & ~0xfff;
 	} else {
-		/* Use a single page as PRP list, PRP2 points to the list */
+		/* Use the command's PRP list, PRP2 points to the list */
+		uint64_t *prp_list = &nvme->prp_lists[cid * NVME_PRP_LIST_ENTRIES];
 		unsigned int i;
 		for (i = 0; i < end_page - start_page; ++i) {
 			buffer += 0x1000;
-			nvme->prp_list[i] = virt_to_phys(buffer) & ~0xfff;
+			prp_list[i] = virt_to_phys(buffer) & ~0xfff;
 		}
-		e.dw[8] = virt_to_phys(nvme->prp_list);
+		e.dw[8] = virt_to_phys(prp_list);
 	}
 
-	return nvme_cmd(nvme, ios, &e);
+	nvme_submit(nvme, ios, &e);
+}
+
+/*
+ * Keep up to io_depth reads in flight. Completions can come in any order, so
+ * remember where each command's blocks go to report the first failed one.
+ */
+static ssize_t nvme_read_blocks512_vec(
+		struct storage_dev *const dev,
+		const struct storage_read_req *const reqs, const size_t count)
+{
+	struct nvme_dev *nvme = (struct nvme_dev *)dev;
+	size_t req = 0, off = 0, pos = 0, failed = 0;
+	unsigned int inflight = 0;
+	bool error = false;
+	uint16_t cid;
+
+	while (req < count || inflight) {
+		const unsigned int queued = inflight;
+
+		while (req < count && inflight < nvme->io_depth) {
+			if (off == reqs[req].count) {
+				req++;
+				off = 0;
+				continue;
+			}
+
+			const unsigned int blocks = MIN(reqs[req].count - off, NVME_MAX_BLOCKS);
+			cid = __ffs(~nvme->io_busy);
+			nvme->io_busy |= 1 << cid;
+			nvme->io_pos[cid] = pos;
+			nvme_read(nvme, cid, reqs[req].buf + off * 512, reqs[req].start + off,
+				  blocks);
+			inflight++;
+			off += blocks;
+			pos += blocks;
+		}
+		if (inflight != queued)
+			nvme_ring(nvme, ios);
+		if (!inflight)
+			break;
+
+		if (nvme_complete(nvme, ioc, &cid)) {
+			if (!error || nvme->io_pos[cid] < failed)
+				failed = nvme->io_pos[cid];
+			error = true;
+			/* Don't start more reads, but wait for the ones in flight. */
+			req = count;
+		}
+		nvme->io_busy &= ~(1 << cid);
+		inflight--;
+	}
+
+	return error ? failed : pos;
 }
 
 static ssize_t nvme_read_blocks512(
 		struct storage_dev *const dev,
 		const lba_t start, const size_t count, unsigned char *const buf)
 {
-	unsigned int off = 0;
-	while (off < count) {
-		const unsigned int blocks = MIN(count - off, 512);
-		if (nvme_read((struct nvme_dev *)dev, buf + (off * 512), start + off, blocks))
-			return off;
-		off += blocks;
-	}
-	return count;
+	const struct storage_read_req req = {
+		.start = start,
+		.count = count,
+		.buf = buf,
+	};
+
+	return nvme_read_blocks512_vec(dev, &req, 1);
 }
 
-static int create_io_submission_queue(struct nvme_dev *nvme)
+static int create_io_submission_queue(struct nvme_dev *nvme, uint16_t size)
 {
-	void *sq_buffer = memalign(0x1000, NVME_SQ_ENTRY_SIZE * NVME_QUEUE_SIZE);
+	void *sq_buffer = memalign(0x1000, NVME_SQ_ENTRY_SIZE * size);
 	if (!sq_buffer) {
 		printf("NVMe ERROR: Failed to allocate memory for io submission queue.\n");
 		return -1;
 	}
-	memset(sq_buffer, 0, NVME_SQ_ENTRY_SIZE * NVME_QUEUE_SIZE);
+	memset(sq_buffer, 0, NVME_SQ_ENTRY_SIZE * size);
 
 	struct nvme_s_queue_entry e = {
 		.dw[0]  = 0x01,
 		.dw[6]  = virt_to_phys(sq_buffer),
-		.dw[10] = ((NVME_QUEUE_SIZE - 1) << 16) | ios >> 1,
+		.dw[10] = ((size - 1) << 16) | ios >> 1,
 		.dw[11] = (1 << 16) | 1,
 	};
 
@@ -245,22 +333,23 @@ static int create_io_submission_queue(struct nvme_dev *nvme)
 	nvme->queue[ios].base = sq_buffer;
 	nvme->queue[ios].bell = nvme->config + 0x1000 + (ios * (4 << cap_dstrd));
 	nvme->queue[ios].idx = 0;
+	nvme->queue[ios].size = size;
 	return 0;
 }
 
-static int create_io_completion_queue(struct nvme_dev *nvme)
+static int create_io_completion_queue(struct nvme_dev *nvme, uint16_t size)
 {
-	void *const cq_buffer = memalign(0x1000, NVME_CQ_ENTRY_SIZE * NVME_QUEUE_SIZE);
+	void *const cq_buffer = memalign(0x1000, NVME_CQ_ENTRY_SIZE * size);
 	if (!cq_buffer) {
 		printf("NVMe ERROR: Failed to allocate memory for io completion queue.\n");
 		return -1;
 	}
-	memset(cq_buffer, 0, NVME_CQ_ENTRY_SIZE * NVME_QUEUE_SIZE);
+	memset(cq_buffer, 0, NVME_CQ_ENTRY_SIZE * size);
 
 	const struct nvme_s_queue_entry e = {
 		.dw[0]  = 0x05,
 		.dw[6]  = virt_to_phys(cq_buffer),
-		.dw[10] = ((NVME_QUEUE_SIZE - 1) << 16) | ioc >> 1,
+		.dw[10] = ((size - 1) << 16) | ioc >> 1,
 		.dw[11] = 1,
 	};
 
@@ -276,6 +365,7 @@ static int create_io_completion_queue(struct nvme_dev *nvme)
 	nvme->queue[ioc].bell  = nvme->config + 0x1000 + (ioc * (4 << cap_dstrd));
 	nvme->queue[ioc].idx   = 0;
 	nvme->queue[ioc].round = 0;
+	nvme->queue[ioc].size  = size;
 
 	return 0;
 }
@@ -296,6 +386,7 @@ static int create_admin_queues(struct nvme_dev *nvme)
 	nvme->queue[ads].base = sq_buffer;
 	nvme->queue[ads].bell = nvme->config + 0x1000 + (ads * (4 << cap_dstrd));
 	nvme->queue[ads].idx = 0;
+	nvme->queue[ads].size = NVME_QUEUE_SIZE;
 
 	void *cq_buffer = memalign(0x1000, NVME_CQ_ENTRY_SIZE * NVME_QUEUE_SIZE);
 	if (!cq_buffer) {
@@ -310,6 +401,7 @@ static int create_admin_queues(struct nvme_dev *nvme)
 	nvme->queue[adc].bell = nvme->config + 0x1000 + (adc * (4 << cap_dstrd));
 	nvme->queue[adc].idx = 0;
 	nvme->queue[adc].round = 0;
+	nvme->queue[adc].size = NVME_QUEUE_SIZE;
 
 	return 0;
 }
@@ -333,14 +425,21 @@ static void nvme_init(pcidev_t dev)
 	nvme->storage_dev.port_type		= PORT_TYPE_NVME;
 	nvme->storage_dev.poll			= nvme_poll;
 	nvme->storage_dev.read_blocks512	= nvme_read_blocks512;
+	nvme->storage_dev.read_blocks512_vec	= nvme_read_blocks512_vec;
 	nvme->storage_dev.write_blocks512	= NULL;
 	nvme->storage_dev.detach_device		= nvme_detach_device;
 	nvme->pci_dev				= dev;
 	nvme->config				= pci_bar0;
-	nvme->prp_list				= memalign(0x1000, 0x1000);
+	nvme->io_busy				= 0;
+
+	/* CAP.MQES is the largest queue size the controller supports, 0's based. */
+	const uint16_t io_queue_size = MIN(NVME_IO_QUEUE_SIZE, (read64(pci_bar0) & 0xffff) + 1);
+	nvme->io_depth = io_queue_size - 1;
 
-	if (!nvme->prp_list) {
-		printf("NVMe ERROR: Failed to allocate buffer for PRP list\n");
+	/* A PRP list never crosses a page as the lists divide it evenly. */
+	nvme->prp_lists = memalign(0x1000, io_queue_size * NVME_PRP_LIST_ENTRIES * 8);
+	if (!nvme->prp_lists) {
+		printf("NVMe ERROR: Failed to allocate buffer for PRP lists\n");
 		goto _free_abort;
 	}
 
@@ -380,9 +479,9 @@ static void nvme_init(pcidev_t dev)
 
 	uint16_t command = pci_read_config16(dev, PCI_COMMAND);
 	pci_write_config16(dev, PCI_COMMAND, command | PCI_COMMAND_MASTER);
-	if (create_io_completion_queue(nvme))
+	if (create_io_completion_queue(nvme, io_queue_size))
 		goto _delete_admin_abort;
-	if (create_io_submission_queue(nvme))
+	if (create_io_submission_queue(nvme, io_queue_size))
 		goto _delete_completion_abort;
 	storage_attach_device((storage_dev_t *)nvme);
 	printf("NVMe init done.\n");
@@ -393,7 +492,7 @@ _delete_completion_abort:
 _delete_admin_abort:
 	delete_admin_queues(nvme);
 _free_abort:
-	free(nvme->prp_list);
+	free(nvme->prp_lists);
 	free(nvme);
 	printf("NVMe init failed.\n");
 }
@@ -100,6 +100,49 @@ ssize_t storage_read_blocks512(const size_t dev_num,
 		return -1;
 }
 
+/**
+ * Read 512-byte blocks into several buffers
+ *
+ * Reads all of the requests from drive dev_num. Drivers that support it
+ * keep several of them in flight, so this is faster than reading them one
+ * by one for files that are spread over the disk.
+ *
+ * Returns the number of blocks read, counted over the requests in order
+ * up to the first block that couldn't be read, or -1 on error.
+ *
+ * @dev_num device number counted from 0
+ * @reqs requests, each with a first block, a block count and a buffer
+ * @count number of requests
+ */
+ssize_t storage_read_blocks512_vec(const size_t dev_num,
+				   const struct storage_read_req *const reqs,
+				   const size_t count)
+{
+	storage_dev_t *dev;
+	ssize_t total = 0, ret;
+	size_t i;
+
+	if (dev_num >= dev_count)
+		return -1;
+
+	dev = devices[dev_num];
+	if (dev->read_blocks512_vec)
+		return dev->read_blocks512_vec(dev, reqs, count);
+	if (!dev->read_blocks512)
+		return -1;
+
+	for (i = 0; i < count; ++i) {
+		ret = dev->read_blocks512(dev, reqs[i].start, reqs[i].count, reqs[i].buf);
+		if (ret < 0)
+			return total ? total : ret;
+		total += ret;
+		if (ret != reqs[i].count)
+			break;
+	}
+
+	return total;
+}
+
 /**
  * Initializes storage controllers
  *
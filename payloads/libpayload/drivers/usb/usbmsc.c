@@ -96,9 +96,11 @@ usb_msc_destroy(usbdev_t *dev)
 
 const int DEV_RESET = 0xff;
 const int GET_MAX_LUN = 0xfe;
-/* Many USB3 devices do not work with large transfer requests.
- * Limit the request size to 64KB chunks to ensure maximum compatibility. */
+/* Many USB3 devices do not work with large transfer requests. With
+ * USB_MSC_LARGE_TRANSFERS, start out with larger ones, but fall back to
+ * 64KB chunks for maximum compatibility as soon as one fails. */
 const int MAX_CHUNK_BYTES = 1024 * 64;
+const int MAX_LARGE_CHUNK_BYTES = 1024 * 256;
 
 const unsigned int cbw_signature = 0x43425355;
 const unsigned int csw_signature = 0x53425355;
@@ -245,44 +247,20 @@ get_csw(endpoint_t *ep, csw_t *csw)
 	return MSC_COMMAND_OK;
 }
 
+/* Evaluate the CSW of a command, requesting sense data on errors. */
 static int
-execute_command(usbdev_t *dev, cbw_direction dir, const u8 *cb, int cblen,
-		 u8 *buf, int buflen, int residue_ok)
+command_status(usbdev_t *dev, const u8 *cb, const csw_t *csw, int residue_ok)
 {
-	cbw_t cbw;
-	csw_t csw;
+	int ret;
 
-	int always_succeed = 0;
 	if ((cb[0] == 0x1b) && (cb[4] == 1)) {	//start command, always succeed
-		always_succeed = 1;
-	}
-	wrap_cbw(&cbw, buflen, dir, cb, cblen, MSC_INST(dev)->lun);
-	if (dev->controller->
-	    bulk(MSC_INST(dev)->bulk_out, sizeof(cbw), (u8 *) &cbw, 0) < 0) {
-		return reset_transport(dev);
-	}
-	if (buflen > 0) {
-		if (dir == cbw_direction_data_in) {
-			if (dev->controller->
-			    bulk(MSC_INST(dev)->bulk_in, buflen, buf, 0) < 0)
-				clear_stall(MSC_INST(dev)->bulk_in);
-		} else {
-			if (dev->controller->
-			    bulk(MSC_INST(dev)->bulk_out, buflen, buf, 0) < 0)
-				clear_stall(MSC_INST(dev)->bulk_out);
-		}
-	}
-	int ret = get_csw(MSC_INST(dev)->bulk_in, &csw);
-	if (ret) {
-		return ret;
-	} else if (always_succeed == 1) {
 		/* return success, regardless of message */
 		return MSC_COMMAND_OK;
-	} else if (csw.bCSWStatus == 2) {
+	} else if (csw->bCSWStatus == 2) {
 		/* phase error, reset transport */
 		return reset_transport(dev);
-	} else if (csw.bCSWStatus == 0) {
-		if ((csw.dCSWDataResidue == 0) || residue_ok)
+	} else if (csw->bCSWStatus == 0) {
+		if ((csw->dCSWDataResidue == 0) || residue_ok)
 			/* no error, exit */
 			return MSC_COMMAND_OK;
 		else
@@ -304,6 +282,35 @@ execute_command(usbdev_t *dev, cbw_direction dir, const u8 *cb, int cblen,
 	}
 }
 
+static int
+execute_command(usbdev_t *dev, cbw_direction dir, const u8 *cb, int cblen,
+		 u8 *buf, int buflen, int residue_ok)
+{
+	cbw_t cbw;
+	csw_t csw;
+
+	wrap_cbw(&cbw, buflen, dir, cb, cblen, MSC_INST(dev)->lun);
+	if (dev->controller->
+	    bulk(MSC_INST(dev)->bulk_out, sizeof(cbw), (u8 *) &cbw, 0) < 0) {
+		return reset_transport(dev);
+	}
+	if (buflen > 0) {
+		if (dir == cbw_direction_data_in) {
+			if (dev->controller->
+			    bulk(MSC_INST(dev)->bulk_in, buflen, buf, 0) < 0)
+				clear_stall(MSC_INST(dev)->bulk_in);
+		} else {
+			if (dev->controller->
+			    bulk(MSC_INST(dev)->bulk_out, buflen, buf, 0) < 0)
+				clear_stall(MSC_INST(dev)->bulk_out);
+		}
+	}
+	int ret = get_csw(MSC_INST(dev)->bulk_in, &csw);
+	if (ret)
+		return ret;
+	return command_status(dev, cb, &csw, residue_ok);
+}
+
 typedef struct {
 	unsigned char command;	//0
 	unsigned char res1;	//1
@@ -313,6 +320,15 @@ typedef struct {
 	unsigned char control;	//9 - the block is 10 bytes long
 } __packed cmdblock_t;
 
+typedef struct {
+	unsigned char command;	//0
+	unsigned char flags;	//1 - service action for SERVICE ACTION IN
+	unsigned long long block;	//2-9
+	unsigned int length;	//10-13
+	unsigned char res;	//14
+	unsigned char control;	//15 - the block is 16 bytes long
+} __packed cmdblock16_t;
+
 typedef struct {
 	unsigned char command;	//0
 	unsigned char res1;	//1
@@ -342,7 +358,7 @@ typedef struct {
  * @return 0 on success, 1 on failure
  */
 int
-readwrite_blocks_512(usbdev_t *dev, int start, int n,
+readwrite_blocks_512(usbdev_t *dev, u64 start, int n,
 	cbw_direction dir, u8 *buf)
 {
 	int blocksize_divider = MSC_INST(dev)->blocksize / 512;
@@ -350,44 +366,154 @@ readwrite_blocks_512(usbdev_t *dev, int start, int n,
 		n / blocksize_divider, dir, buf);
 }
 
+/* Fill in a READ or WRITE command, (16) if the blocks don't fit (10). */
+static int
+readwrite_cmd(u8 *cmd, u64 start, int n, cbw_direction dir)
+{
+	if (start + n - 1 <= 0xffffffff) {
+		cmdblock_t *const cb = (cmdblock_t *)cmd;
+		memset(cb, 0, sizeof(*cb));
+		cb->command = dir == cbw_direction_data_in ? 0x28 : 0x2a;
+		cb->block = htonl(start);
+		cb->numblocks = htonw(n);
+		return sizeof(*cb);
+	} else {
+		cmdblock16_t *const cb = (cmdblock16_t *)cmd;
+		memset(cb, 0, sizeof(*cb));
+		cb->command = dir == cbw_direction_data_in ? 0x88 : 0x8a;
+		cb->block = htonll(start);
+		cb->length = htonl(n);
+		return sizeof(*cb);
+	}
+}
+
 /**
  * Reads or writes a number of sequential blocks on a USB storage device.
- * As it uses the READ(10) SCSI-2 command, it's limited to storage devices
- * of at most 2TB. It assumes sectors of 512 bytes.
+ * It uses READ(10)/WRITE(10), or the (16) variants for blocks beyond 2^32.
  *
  * @param dev device to access
  * @param start first sector to access
  * @param n number of sectors to access
  * @param dir direction of access: cbw_direction_data_in == read, cbw_direction_data_out == write
  * @param buf buffer to read into or write from. Must be at least n*sectorsize bytes
- * @return 0 on success, 1 on failure
+ * @return MSC_COMMAND_OK on success, otherwise the failure
  */
 static int
-readwrite_chunk(usbdev_t *dev, int start, int n, cbw_direction dir, u8 *buf)
+readwrite_chunk(usbdev_t *dev, u64 start, int n, cbw_direction dir, u8 *buf)
 {
-	cmdblock_t cb;
-	memset(&cb, 0, sizeof(cb));
-	if (dir == cbw_direction_data_in) {
-		// read
-		cb.command = 0x28;
-	} else {
-		// write
-		cb.command = 0x2a;
+	u8 cb[sizeof(cmdblock16_t)];
+	const int cblen = readwrite_cmd(cb, start, n, dir);
+
+	return execute_command(dev, dir, cb, cblen, buf,
+				n * MSC_INST(dev)->blocksize, 0);
+}
+
+/* Largest number of blocks per command for a transfer at buf. */
+static int
+chunk_blocks(usbdev_t *dev, const u8 *buf)
+{
+	/* Larger transfers need a DMA coherent buffer, bounce buffers are 64KB. */
+	const int bytes = dma_coherent(buf) ? MSC_INST(dev)->max_chunk : MAX_CHUNK_BYTES;
+	return MAX(bytes / (int)MSC_INST(dev)->blocksize, 1);
+}
+
+/*
+ * Read with the data and CSW stages of the next command queued on the
+ * controller while the current one completes, so the device doesn't wait
+ * for us between commands. Returns the number of blocks read before the
+ * first failure, which the caller retries without queuing, or -1 if the
+ * device detached.
+ */
+static int
+read_queued(usbdev_t *dev, u64 start, int n, u8 *buf)
+{
+	hci_t *const ctrlr = dev->controller;
+	endpoint_t *const in = MSC_INST(dev)->bulk_in;
+	const int blocksize = MSC_INST(dev)->blocksize;
+	const int chunk = chunk_blocks(dev, buf);
+	csw_t *csw;
+	cbw_t cbw;
+	u8 cb[2][sizeof(cmdblock16_t)];
+	int cblen[2];
+	int done, blocks, next, ret;
+
+	if (!dma_coherent(buf) || n <= chunk)
+		return 0;
+
+	csw = dma_malloc(2 * sizeof(*csw));
+	if (!csw)
+		return 0;
+
+	/* Queue the data and CSW stages, then send the CBW to start them. */
+	blocks = MIN(n, chunk);
+	if (ctrlr->bulk_submit(in, blocks * blocksize, buf) ||
+	    ctrlr->bulk_submit(in, sizeof(csw[0]), (u8 *)&csw[0])) {
+		ctrlr->bulk_cancel(in);
+		free(csw);
+		return 0;
 	}
-	cb.block = htonl(start);
-	cb.numblocks = htonw(n);
 
-	return execute_command(dev, dir, (u8 *) &cb, sizeof(cb), buf,
-				n * MSC_INST(dev)->blocksize, 0)
-		!= MSC_COMMAND_OK ? 1 : 0;
+	for (done = 0; done < n; done += blocks, blocks = next) {
+		const int i = (done / chunk) % 2;
+
+		cblen[i] = readwrite_cmd(cb[i], start + done, blocks, cbw_direction_data_in);
+		wrap_cbw(&cbw, blocks * blocksize, cbw_direction_data_in, cb[i], cblen[i],
+			 MSC_INST(dev)->lun);
+		if (ctrlr->bulk(MSC_INST(dev)->bulk_out, sizeof(cbw), (u8 *)&cbw, 0) < 0) {
+			ctrlr->bulk_cancel(in);
+			ret = reset_transport(dev);
+			break;
+		}
+
+		/* Queue the next command's stages before waiting for these. */
+		next = MIN(n - done - blocks, chunk);
+		if (next && (ctrlr->bulk_submit(in, next * blocksize,
+						buf + (done + blocks) * blocksize) ||
+			     ctrlr->bulk_submit(in, sizeof(csw[0]), (u8 *)&csw[!i])))
+			next = 0;
+
+		ret = ctrlr->bulk_wait(in);
+		if (ret < 0)
+			clear_stall(in);
+		if (ret < 0 || ctrlr->bulk_wait(in) != sizeof(csw[i]) ||
+		    csw[i].dCSWTag != tag || csw[i].dCSWSignature != csw_signature) {
+			/* Start over with the CSW, like execute_command() does. */
+			ctrlr->bulk_cancel(in);
+			ret = get_csw(in, &csw[i]);
+			if (ret == MSC_COMMAND_OK)
+				ret = command_status(dev, cb[i], &csw[i], 0);
+			if (ret == MSC_COMMAND_OK)
+				ret = MSC_COMMAND_FAIL;
+		} else if (ret != blocks * blocksize || csw[i].bCSWStatus ||
+			   csw[i].dCSWDataResidue) {
+			ctrlr->bulk_cancel(in);
+			ret = command_status(dev, cb[i], &csw[i], 0);
+			if (ret == MSC_COMMAND_OK)
+				ret = MSC_COMMAND_FAIL;
+		} else {
+			ret = MSC_COMMAND_OK;
+		}
+
+		if (ret != MSC_COMMAND_OK)
+			break;
+		if (!next) {
+			ctrlr->bulk_cancel(in);
+			done += blocks;
+			break;
+		}
+	}
+
+	free(csw);
+	return ret == MSC_COMMAND_DETACHED ? -1 : done;
 }
 
 /**
  * Reads or writes a number of sequential blocks on a USB storage device
- * that is split into MAX_CHUNK_BYTES size requests.
+ * that is split into chunks of up to max_chunk bytes.
  *
- * As it uses the READ(10) SCSI-2 command, it's limited to storage devices
- * of at most 2TB. It assumes sectors of 512 bytes.
+ * If the device fails a large chunk, it is retried in smaller ones, down
+ * to MAX_CHUNK_BYTES. With USB_MSC_QUEUED_READS on xHCI, reads keep the
+ * next chunk queued on the controller while the current one completes.
  *
  * @param dev device to access
  * @param start first sector to access
@@ -399,27 +525,35 @@ readwrite_chunk(usbdev_t *dev, int start, int n, cbw_direction dir, u8 *buf)
  * @return 0 on success, 1 on failure
  */
 int
-readwrite_blocks(usbdev_t *dev, int start, int n, cbw_direction dir, u8 *buf)
+readwrite_blocks(usbdev_t *dev, u64 start, int n, cbw_direction dir, u8 *buf)
 {
-	int chunk_size = MAX_CHUNK_BYTES / MSC_INST(dev)->blocksize;
-	int chunk;
-
-	/* Read as many full chunks as needed. */
-	for (chunk = 0; chunk < (n / chunk_size); chunk++) {
-		if (readwrite_chunk(dev, start + (chunk * chunk_size),
-				     chunk_size, dir,
-				     buf + (chunk * MAX_CHUNK_BYTES))
-		    != MSC_COMMAND_OK)
+	const int blocksize = MSC_INST(dev)->blocksize;
+	int done = 0, blocks, ret;
+
+	if (CONFIG(LP_USB_MSC_QUEUED_READS) && dir == cbw_direction_data_in &&
+	    dev->controller->bulk_submit) {
+		done = read_queued(dev, start, n, buf);
+		if (done < 0)
 			return 1;
 	}
 
-	/* Read any remaining partial chunk at the end. */
-	if (n % chunk_size) {
-		if (readwrite_chunk(dev, start + (chunk * chunk_size),
-				     n % chunk_size, dir,
-				     buf + (chunk * MAX_CHUNK_BYTES))
-		    != MSC_COMMAND_OK)
+	while (done < n) {
+		blocks = MIN(n - done, chunk_blocks(dev, buf + done * blocksize));
+		ret = readwrite_chunk(dev, start + done, blocks, dir,
+				      buf + done * blocksize);
+		if (ret == MSC_COMMAND_DETACHED)
 			return 1;
+		if (ret != MSC_COMMAND_OK) {
+			/* Some devices can't take large transfers. */
+			if (blocks * blocksize <= MAX_CHUNK_BYTES)
+				return 1;
+			MSC_INST(dev)->max_chunk = MAX(blocks * blocksize / 2,
+						       MAX_CHUNK_BYTES);
+			usb_debug("MSC: transfer failed, using %d byte chunks\n",
+				  MSC_INST(dev)->max_chunk);
+			continue;
+		}
+		done += blocks;
 	}
 
 	return 0;
@@ -491,6 +625,34 @@ spin_up(usbdev_t *dev)
 				sizeof(cb), 0, 0, 0);
 }
 
+static int
+read_capacity16(usbdev_t *dev)
+{
+	cmdblock16_t cb;
+	struct {
+		u64 last_block;
+		u32 blocksize;
+		u8 res[20];
+	} __packed buf;
+	int ret;
+
+	memset(&cb, 0, sizeof(cb));
+	cb.command = 0x9e;	// service action in
+	cb.flags = 0x10;	// read capacity (16)
+	cb.length = htonl(sizeof(buf));
+
+	ret = execute_command(dev, cbw_direction_data_in, (u8 *)&cb,
+			      sizeof(cb), (u8 *)&buf, sizeof(buf), 1);
+	if (ret != MSC_COMMAND_OK) {
+		usb_debug("  READ CAPACITY(16) failed, using the first 2^32 blocks.\n");
+		return ret;
+	}
+
+	MSC_INST(dev)->numblocks = ntohll(buf.last_block) + 1;
+	MSC_INST(dev)->blocksize = ntohl(buf.blocksize);
+	return MSC_COMMAND_OK;
+}
+
 static int
 read_capacity(usbdev_t *dev)
 {
@@ -520,14 +682,17 @@ read_capacity(usbdev_t *dev)
 		MSC_INST(dev)->numblocks = 0xffffffff;
 		MSC_INST(dev)->blocksize = 512;
 	} else {
-		MSC_INST(dev)->numblocks = ntohl(buf[0]) + 1;
+		MSC_INST(dev)->numblocks = ntohl(buf[0]) + 1ULL;
 		MSC_INST(dev)->blocksize = ntohl(buf[1]);
 	}
-	usb_debug("  %d %d-byte sectors (%d MB)\n", MSC_INST(dev)->numblocks,
+	/* The last block doesn't fit 32 bits, ask READ CAPACITY(16). */
+	if (count < 20 && ntohl(buf[0]) == 0xffffffff) {
+		ret = read_capacity16(dev);
+		if (ret == MSC_COMMAND_DETACHED)
+			return ret;
+	}
+	usb_debug("  %llu %d-byte sectors (%llu MB)\n", MSC_INST(dev)->numblocks,
 		MSC_INST(dev)->blocksize,
-		/* round down high block counts to avoid integer overflow */
-		MSC_INST(dev)->numblocks > 1000000
-			? (MSC_INST(dev)->numblocks / 1000) * MSC_INST(dev)->blocksize / 1000 :
 		MSC_INST(dev)->numblocks * MSC_INST(dev)->blocksize / 1000 / 1000);
 	return MSC_COMMAND_OK;
 }
@@ -651,6 +816,8 @@ void usb_msc_force_init(usbdev_t *dev, u32 quirks)
 	MSC_INST(dev)->bulk_out = 0;
 	MSC_INST(dev)->usbdisk_created = 0;
 	MSC_INST(dev)->quirks = quirks;
+	MSC_INST(dev)->max_chunk = CONFIG(LP_USB_MSC_LARGE_TRANSFERS) ?
+				   MAX_LARGE_CHUNK_BYTES : MAX_CHUNK_BYTES;
 
 	for (i = 1; i <= dev->num_endp; i++) {
 		if (dev->endpoints[i].endpoint == 0)
@@ -40,6 +40,9 @@ static void xhci_reset(hci_t *controller);
 static void xhci_reinit(hci_t *controller);
 static void xhci_shutdown(hci_t *controller);
 static int xhci_bulk(endpoint_t *ep, int size, u8 *data, int finalize);
+static int xhci_bulk_submit(endpoint_t *ep, int size, u8 *data);
+static int xhci_bulk_wait(endpoint_t *ep);
+static void xhci_bulk_cancel(endpoint_t *ep);
 static int xhci_control(usbdev_t *dev, direction_t dir, int drlen, void *devreq,
 			 int dalen, u8 *data);
 static void* xhci_create_intr_queue(endpoint_t *ep, int reqsize, int reqcount, int reqtiming);
@@ -84,6 +87,8 @@ xhci_init_cycle_ring(transfer_ring_t *const tr, const size_t ring_size)
 
 	tr->pcs = 1;
 	tr->cur = tr->ring;
+	tr->queued = 0;
+	tr->queued_first = 0;
 }
 
 /* On Panther Point: switch ports shared with EHCI to xHCI */
@@ -168,6 +173,9 @@ xhci_init(unsigned long physical_bar)
 	controller->init		= xhci_reinit;
 	controller->shutdown		= xhci_shutdown;
 	controller->bulk		= xhci_bulk;
+	controller->bulk_submit		= xhci_bulk_submit;
+	controller->bulk_wait		= xhci_bulk_wait;
+	controller->bulk_cancel		= xhci_bulk_cancel;
 	controller->control		= xhci_control;
 	controller->set_address		= xhci_set_address;
 	controller->finish_device_config = xhci_finish_device_config;
@@ -798,6 +806,97 @@ xhci_bulk(endpoint_t *const ep, const int size, u8 *const src,
 	return ret;
 }
 
+/* TRBs xhci_enqueue_td() uses: one per 64KiB segment and the event data TRB. */
+static size_t
+xhci_td_trbs(const void *const data, const size_t size)
+{
+	const size_t off = (size_t)data & 0xffff;
+	return MAX((off + size + 0xffff) >> 16, (size_t)1) + 1;
+}
+
+/*
+ * Queue a bulk transfer without waiting for it, so the controller can move
+ * on to it as soon as the previous one is done. Transfers complete in order,
+ * xhci_bulk_wait() returns the result of the oldest one.
+ */
+static int
+xhci_bulk_submit(endpoint_t *const ep, const int size, u8 *const data)
+{
+	xhci_t *const xhci = XHCI_INST(ep->dev->controller);
+	const int slot_id = ep->dev->address;
+	const int ep_id = xhci_ep_id(ep);
+	epctx_t *const epctx = xhci->dev[slot_id].ctx.ep[ep_id];
+	transfer_ring_t *const tr = xhci->dev[slot_id].transfer_rings[ep_id];
+	const size_t trbs = xhci_td_trbs(data, size);
+	size_t used = 0;
+	int i;
+
+	/* There is no bounce buffer for queued transfers. */
+	if (!dma_coherent(data) || tr->queued == BULK_QUEUE_SIZE)
+		return -1;
+
+	/* Stay clear of the link TRB and of the TRBs still in use. */
+	for (i = 0; i < tr->queued; ++i)
+		used += tr->queued_trbs[(tr->queued_first + i) % BULK_QUEUE_SIZE];
+	if (used + trbs > TRANSFER_RING_SIZE - 2)
+		return -1;
+
+	/* Reset endpoint if it's not running */
+	if (!tr->queued && EC_GET(STATE, epctx) > 1) {
+		if (xhci_reset_endpoint(ep->dev, ep))
+			return -1;
+	}
+
+	const unsigned mps = EC_GET(MPS, epctx);
+	const unsigned dir = (ep->direction == OUT) ? TRB_DIR_OUT : TRB_DIR_IN;
+	xhci_enqueue_td(tr, ep_id, mps, size, data, dir);
+	tr->queued_trbs[(tr->queued_first + tr->queued) % BULK_QUEUE_SIZE] = trbs;
+	++tr->queued;
+	xhci_ring_doorbell(ep);
+
+	return 0;
+}
+
+static int
+xhci_bulk_wait(endpoint_t *const ep)
+{
+	xhci_t *const xhci = XHCI_INST(ep->dev->controller);
+	const int slot_id = ep->dev->address;
+	const int ep_id = xhci_ep_id(ep);
+	transfer_ring_t *const tr = xhci->dev[slot_id].transfer_rings[ep_id];
+
+	if (!tr->queued)
+		return -1;
+
+	const int ret = xhci_wait_for_transfer(xhci, slot_id, ep_id);
+	tr->queued_first = (tr->queued_first + 1) % BULK_QUEUE_SIZE;
+	--tr->queued;
+
+	if (ret < 0) {
+		xhci_debug("Queued bulk transfer failed: %d\n", ret);
+		xhci_bulk_cancel(ep);
+	}
+	return ret;
+}
+
+/* Drop the queued transfers, the next one resets the transfer ring. */
+static void
+xhci_bulk_cancel(endpoint_t *const ep)
+{
+	xhci_t *const xhci = XHCI_INST(ep->dev->controller);
+	const int slot_id = ep->dev->address;
+	const int ep_id = xhci_ep_id(ep);
+	epctx_t *const epctx = xhci->dev[slot_id].ctx.ep[ep_id];
+	transfer_ring_t *const tr = xhci->dev[slot_id].transfer_rings[ep_id];
+
+	if (!tr->queued)
+		return;
+
+	if (EC_GET(STATE, epctx) == 1)
+		xhci_cmd_stop_endpoint(xhci, slot_id, ep_id);
+	tr->queued = 0;
+}
+
 static trb_t *
 xhci_next_trb(trb_t *cur, int *const pcs)
 {
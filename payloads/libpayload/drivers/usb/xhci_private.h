@@ -160,10 +160,16 @@ typedef struct {
 
 /* Never raise this above 256 to prevent transfer event length overflow! */
 #define TRANSFER_RING_SIZE 32
+/* Bulk transfers that can be queued on a ring with xhci_bulk_submit(). */
+#define BULK_QUEUE_SIZE 4
 typedef struct {
 	trb_t *ring;
 	trb_t *cur;
 	u8 pcs;
+	/* Queued bulk transfers and the TRBs each takes, oldest first. */
+	u8 queued;
+	u8 queued_first;
+	u8 queued_trbs[BULK_QUEUE_SIZE];
 } __packed transfer_ring_t;
 
 #define COMMAND_RING_SIZE 4
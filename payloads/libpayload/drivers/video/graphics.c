@@ -43,6 +43,15 @@ static struct rect screen;
 
 static uint8_t *gfx_buffer;
 
+/*
+ * Areas of gfx_buffer in framebuffer coordinates that changed since the last
+ * flush. Areas that touch are merged, and when there are too many the two
+ * that waste the least when combined are merged.
+ */
+static struct rect dirty[8];
+static size_t dirty_count;
+static void (*flush_hook)(size_t bytes);
+
 /*
  * Framebuffer is assumed to assign a higher coordinate (larger x, y) to
  * a higher address
@@ -269,40 +278,203 @@ static inline uint32_t calculate_color(const struct rgb_color *rgb,
 	return color;
 }
 
-/*
- * Plot a pixel in a framebuffer. This is called from tight loops. Keep it slim
- * and do the validation at callers' site.
- */
-static inline void set_pixel(struct vector *coord, uint32_t color)
+/* Map a pixel on the screen to its position in the framebuffer. */
+static inline void screen_to_fb(struct vector *out, int32_t x, int32_t y)
 {
-	const int bpp = fbinfo->bits_per_pixel;
-	const int bpl = fbinfo->bytes_per_line;
-	struct vector rcoord;
-	int i;
-
 	switch (fbinfo->orientation) {
 	case CB_FB_ORIENTATION_NORMAL:
 	default:
-		rcoord.x = coord->x;
-		rcoord.y = coord->y;
+		out->x = x;
+		out->y = y;
 		break;
 	case CB_FB_ORIENTATION_BOTTOM_UP:
-		rcoord.x = screen.size.width - 1 - coord->x;
-		rcoord.y = screen.size.height - 1 - coord->y;
+		out->x = screen.size.width - 1 - x;
+		out->y = screen.size.height - 1 - y;
 		break;
 	case CB_FB_ORIENTATION_LEFT_UP:
-		rcoord.x = coord->y;
-		rcoord.y = screen.size.width - 1 - coord->x;
+		out->x = y;
+		out->y = screen.size.width - 1 - x;
 		break;
 	case CB_FB_ORIENTATION_RIGHT_UP:
-		rcoord.x = screen.size.height - 1 - coord->y;
-		rcoord.y = coord->x;
+		out->x = screen.size.height - 1 - y;
+		out->y = x;
 		break;
 	}
+}
 
-	uint8_t * const pixel = FB + rcoord.y * bpl + rcoord.x * bpp / 8;
-	for (i = 0; i < bpp / 8; i++)
-		pixel[i] = (color >> (i * 8));
+static inline uint8_t *fb_pixel(const struct vector *fb)
+{
+	return FB + fb->y * fbinfo->bytes_per_line +
+		fb->x * fbinfo->bits_per_pixel / 8;
+}
+
+static int64_t area_of(const struct rect *r)
+{
+	return (int64_t)r->size.width * r->size.height;
+}
+
+static void merge_areas(struct rect *out, const struct rect *a,
+			const struct rect *b)
+{
+	const int32_t x = MIN(a->offset.x, b->offset.x);
+	const int32_t y = MIN(a->offset.y, b->offset.y);
+
+	out->size.width = MAX(a->offset.x + a->size.width,
+			      b->offset.x + b->size.width) - x;
+	out->size.height = MAX(a->offset.y + a->size.height,
+			       b->offset.y + b->size.height) - y;
+	out->offset.x = x;
+	out->offset.y = y;
+}
+
+static int areas_touch(const struct rect *a, const struct rect *b)
+{
+	return a->offset.x <= b->offset.x + b->size.width &&
+	       b->offset.x <= a->offset.x + a->size.width &&
+	       a->offset.y <= b->offset.y + b->size.height &&
+	       b->offset.y <= a->offset.y + a->size.height;
+}
+
+/* Remember that an area of the graphics buffer needs to be flushed. */
+static void mark_dirty(int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	struct rect area = {
+		.offset = { .x = x, .y = y },
+		.size = { .width = width, .height = height },
+	};
+	struct rect merged;
+	int64_t waste, least;
+	size_t i, best;
+
+	if (!gfx_buffer)
+		return;
+
+	i = 0;
+	while (i < dirty_count || dirty_count == ARRAY_SIZE(dirty)) {
+		if (i == dirty_count) {
+			/* No room left, merge with the closest area. */
+			least = INT64_MAX;
+			for (i = best = 0; i < dirty_count; i++) {
+				merge_areas(&merged, &area, &dirty[i]);
+				waste = area_of(&merged) - area_of(&dirty[i]);
+				if (waste < least) {
+					least = waste;
+					best = i;
+				}
+			}
+			i = best;
+		} else if (!areas_touch(&area, &dirty[i])) {
+			i++;
+			continue;
+		}
+		/* The merged area may touch ones that were checked already. */
+		merge_areas(&area, &area, &dirty[i]);
+		dirty[i] = dirty[--dirty_count];
+		i = 0;
+	}
+
+	dirty[dirty_count++] = area;
+}
+
+/*
+ * Fill count pixels of a framebuffer line with color. This is called from
+ * tight loops, so the common depths get their own loops.
+ */
+static void fill_pixels(uint8_t *pixel, uint32_t color, int count)
+{
+	const int bytes = fbinfo->bits_per_pixel / 8;
+	int i, j;
+
+	switch (fbinfo->bits_per_pixel) {
+	case 32: {
+		uint32_t *const p = (uint32_t *)pixel;
+		color = htole32(color);
+		for (i = 0; i < count; i++)
+			p[i] = color;
+		break;
+	}
+	case 16: {
+		uint16_t *const p = (uint16_t *)pixel;
+		const uint16_t color16 = htole16(color);
+		for (i = 0; i < count; i++)
+			p[i] = color16;
+		break;
+	}
+	case 8:
+		memset(pixel, color, count);
+		break;
+	default:
+		for (i = 0; i < count; i++, pixel += bytes)
+			for (j = 0; j < bytes; j++)
+				pixel[j] = color >> (j * 8);
+		break;
+	}
+}
+
+/* Write count pixels of colors, starting at pixel and step bytes apart. */
+static void write_pixels(uint8_t *pixel, ptrdiff_t step,
+			 const uint32_t *colors, int count)
+{
+	const int bytes = fbinfo->bits_per_pixel / 8;
+	int i, j;
+
+	switch (fbinfo->bits_per_pixel) {
+	case 32:
+		for (i = 0; i < count; i++, pixel += step)
+			*(uint32_t *)pixel = htole32(colors[i]);
+		break;
+	case 16:
+		for (i = 0; i < count; i++, pixel += step)
+			*(uint16_t *)pixel = htole16(colors[i]);
+		break;
+	default:
+		for (i = 0; i < count; i++, pixel += step)
+			for (j = 0; j < bytes; j++)
+				pixel[j] = colors[i] >> (j * 8);
+		break;
+	}
+}
+
+/*
+ * Fill the area from (x0, y0) up to but excluding (x1, y1) on the screen.
+ * Any orientation turns it into a rectangle in the framebuffer, which is
+ * filled line by line. The validation is done at callers' site.
+ */
+static void fill_rect(int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+		      uint32_t color)
+{
+	struct vector a, b, p;
+	int32_t width, y_start, y_end;
+
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	screen_to_fb(&a, x0, y0);
+	screen_to_fb(&b, x1 - 1, y1 - 1);
+	p.x = MIN(a.x, b.x);
+	width = MAX(a.x, b.x) - p.x + 1;
+	y_start = MIN(a.y, b.y);
+	y_end = MAX(a.y, b.y);
+	mark_dirty(p.x, y_start, width, y_end - y_start + 1);
+	for (p.y = y_start; p.y <= y_end; p.y++)
+		fill_pixels(fb_pixel(&p), color, width);
+}
+
+/* Draw count pixels of colors to the right of (x, y) on the screen. */
+static void draw_row(int32_t x, int32_t y, const uint32_t *colors, int count)
+{
+	const ptrdiff_t bpl = fbinfo->bytes_per_line;
+	const ptrdiff_t bytes = fbinfo->bits_per_pixel / 8;
+	struct vector start, next, end;
+
+	screen_to_fb(&start, x, y);
+	screen_to_fb(&next, x + 1, y);
+	screen_to_fb(&end, x + count - 1, y);
+	mark_dirty(MIN(start.x, end.x), MIN(start.y, end.y),
+		   ABS(end.x - start.x) + 1, ABS(end.y - start.y) + 1);
+	write_pixels(fb_pixel(&start),
+		     (next.y - start.y) * bpl + (next.x - start.x) * bytes,
+		     colors, count);
 }
 
 /*
@@ -357,7 +529,7 @@ static int cbgfx_init(void)
 int draw_box(const struct rect *box, const struct rgb_color *rgb)
 {
 	struct vector top_left;
-	struct vector p, t;
+	struct vector t;
 
 	if (cbgfx_init())
 		return CBGFX_ERROR_INIT;
@@ -379,9 +551,7 @@ int draw_box(const struct rect *box, const struct rgb_color *rgb)
 		return CBGFX_ERROR_BOUNDARY;
 	}
 
-	for (p.y = top_left.y; p.y < t.y; p.y++)
-		for (p.x = top_left.x; p.x < t.x; p.x++)
-			set_pixel(&p, color);
+	fill_rect(top_left.x, top_left.y, t.x, t.y, color);
 
 	return CBGFX_SUCCESS;
 }
@@ -393,7 +563,7 @@ int draw_rounded_box(const struct scale *pos_rel, const struct scale *dim_rel,
 {
 	struct scale pos_end_rel;
 	struct vector top_left;
-	struct vector p, t;
+	struct vector t;
 
 	if (cbgfx_init())
 		return CBGFX_ERROR_INIT;
@@ -446,34 +616,18 @@ int draw_rounded_box(const struct scale *pos_rel, const struct scale *dim_rel,
 	int32_t x_begin, x_end;
 	if (has_thickness) {
 		/* top */
-		for (p.y = top_left.y; p.y < top_left.y + d.y; p.y++)
-			for (p.x = top_left.x + r.x; p.x < t.x - r.x; p.x++)
-				set_pixel(&p, color);
+		fill_rect(top_left.x + r.x, top_left.y, t.x - r.x, top_left.y + d.y, color);
 		/* bottom */
-		for (p.y = t.y - d.y; p.y < t.y; p.y++)
-			for (p.x = top_left.x + r.x; p.x < t.x - r.x; p.x++)
-				set_pixel(&p, color);
-		for (p.y = top_left.y + r.y; p.y < t.y - r.y; p.y++) {
-			/* left */
-			for (p.x = top_left.x; p.x < top_left.x + d.x; p.x++)
-				set_pixel(&p, color);
-			/* right */
-			for (p.x = t.x - d.x; p.x < t.x; p.x++)
-				set_pixel(&p, color);
-		}
+		fill_rect(top_left.x + r.x, t.y - d.y, t.x - r.x, t.y, color);
+		/* left */
+		fill_rect(top_left.x, top_left.y + r.y, top_left.x + d.x, t.y - r.y, color);
+		/* right */
+		fill_rect(t.x - d.x, top_left.y + r.y, t.x, t.y - r.y, color);
 	} else {
 		/* Fill the regions except circular sectors */
-		for (p.y = top_left.y; p.y < t.y; p.y++) {
-			if (p.y >= top_left.y + r.y && p.y < t.y - r.y) {
-				x_begin = top_left.x;
-				x_end = t.x;
-			} else {
-				x_begin = top_left.x + r.x;
-				x_end = t.x - r.x;
-			}
-			for (p.x = x_begin; p.x < x_end; p.x++)
-				set_pixel(&p, color);
-		}
+		fill_rect(top_left.x + r.x, top_left.y, t.x - r.x, top_left.y + r.y, color);
+		fill_rect(top_left.x, top_left.y + r.y, t.x, t.y - r.y, color);
+		fill_rect(top_left.x + r.x, t.y - r.y, t.x - r.x, t.y, color);
 	}
 
 	if (!has_radius)
@@ -520,26 +674,24 @@ int draw_rounded_box(const struct scale *pos_rel, const struct scale *dim_rel,
 			 * If s.x==s.y r.x==r.y, then the sequence will be
 			 * symmetric, and x and y will range from 0 to (r-1).
 			 */
-			/* top left */
-			p.y = top_left.y + r.y - 1 - y;
-			p.x = top_left.x + r.x - 1 - x;
-			set_pixel(&p, color);
-			/* top right */
-			p.y = top_left.y + r.y - 1 - y;
-			p.x = t.x - r.x + x;
-			set_pixel(&p, color);
-			/* bottom left */
-			p.y = t.y - r.y + y;
-			p.x = top_left.x + r.x - 1 - x;
-			set_pixel(&p, color);
-			/* bottom right */
-			p.y = t.y - r.y + y;
-			p.x = t.x - r.x + x;
-			set_pixel(&p, color);
 			x++;
 		}
 		x_end = x;
 		/* (x_begin <= x_end) must hold now */
+
+		/* Pixels x_begin up to x_end from the center on this line. */
+		const int32_t top = top_left.y + r.y - 1 - y;
+		const int32_t bottom = t.y - r.y + y;
+		const int32_t left = top_left.x + r.x - x_end;
+		const int32_t right = t.x - r.x + x_begin;
+		/* top left */
+		fill_rect(left, top, top_left.x + r.x - x_begin, top + 1, color);
+		/* top right */
+		fill_rect(right, top, t.x - r.x + x_end, top + 1, color);
+		/* bottom left */
+		fill_rect(left, bottom, top_left.x + r.x - x_begin, bottom + 1, color);
+		/* bottom right */
+		fill_rect(right, bottom, t.x - r.x + x_end, bottom + 1, color);
 	}
 
 	return CBGFX_SUCCESS;
@@ -551,7 +703,7 @@ int draw_line(const struct scale *pos1, const struct scale *pos2,
 	struct fraction len;
 	struct vector top_left;
 	struct vector size;
-	struct vector p, t;
+	struct vector t;
 
 	if (cbgfx_init())
 		return CBGFX_ERROR_INIT;
@@ -591,9 +743,7 @@ int draw_line(const struct scale *pos1, const struct scale *pos2,
 		return CBGFX_ERROR_BOUNDARY;
 	}
 
-	for (p.y = top_left.y; p.y < t.y; p.y++)
-		for (p.x = top_left.x; p.x < t.x; p.x++)
-			set_pixel(&p, color);
+	fill_rect(top_left.x, top_left.y, t.x, t.y, color);
 
 	return CBGFX_SUCCESS;
 }
@@ -619,26 +769,25 @@ int clear_screen(const struct rgb_color *rgb)
 	if (cbgfx_init())
 		return CBGFX_ERROR_INIT;
 
-	int x, y, i;
-	uint32_t color = calculate_color(rgb, 0);
-	const int bpp = fbinfo->bits_per_pixel;
-	const int bpl = fbinfo->bytes_per_line;
-	uint8_t *line = malloc(bpl);
+	fill_rect(0, 0, screen.size.width, screen.size.height,
+		  calculate_color(rgb, 0));
 
-	if (!line) {
-		LOG("Failed to allocate line buffer (%u bytes)\n", bpl);
-		return CBGFX_ERROR_UNKNOWN;
-	}
+	return CBGFX_SUCCESS;
+}
 
-	/* Set line buffer pixels, then memcpy to framebuffer */
-	for (x = 0; x < fbinfo->x_resolution; x++)
-		for (i = 0; i < bpp / 8; i++)
-			line[x * bpp / 8 + i] = (color >> (i * 8));
-	for (y = 0; y < fbinfo->y_resolution; y++)
-		memcpy(FB + y * bpl, line, bpl);
+/* Convert the palette to framebuffer colors once instead of for every pixel. */
+static void pal_to_colors(const struct bitmap_palette_element_v3 *pal,
+			  size_t palcount, uint8_t invert, uint32_t *out)
+{
+	struct rgb_color rgb;
+	size_t i;
 
-	free(line);
-	return CBGFX_SUCCESS;
+	for (i = 0; i < palcount; i++) {
+		rgb.red = pal[i].red;
+		rgb.green = pal[i].green;
+		rgb.blue = pal[i].blue;
+		out[i] = calculate_color(&rgb, invert);
+	}
 }
 
 static int pal_to_rgb(uint8_t index, const struct bitmap_palette_element_v3 *pal,
@@ -747,7 +896,7 @@ static int draw_bitmap_v3(const struct vector *top_left,
 {
 	const int bpp = header->bits_per_pixel;
 	int32_t dir;
-	struct vector p;
+	int32_t y;		/* screen line of the output pixel line */
 	int32_t ox, oy;		/* output (resampled) pixel coordinates */
 	int32_t ix, iy;		/* input (source image) pixel coordinates */
 	int sx, sy;	/* index into |sample| (not ringbuffer adjusted) */
@@ -775,34 +924,50 @@ static int draw_bitmap_v3(const struct vector *top_left,
 	 * If it's positive, pixel data is stored from bottom to top. We render
 	 * image from the highest row to the lowest row.
 	 */
-	p.y = top_left->y;
+	y = top_left->y;
 	if (header->height < 0) {
 		dir = 1;
 	} else {
-		p.y += dim->height - 1;
+		y += dim->height - 1;
 		dir = -1;
 	}
 
+	/* Output pixel lines are collected here and drawn at once. */
+	uint32_t *colors = malloc(sizeof(*colors) * dim->width);
+	if (!colors)
+		return CBGFX_ERROR_UNKNOWN;
+
 	/* Don't waste time resampling when the scale is 1:1. */
 	if (dim_org->width == dim->width && dim_org->height == dim->height) {
-		for (oy = 0; oy < dim->height; oy++, p.y += dir) {
-			p.x = top_left->x;
-			for (ox = 0; ox < dim->width; ox++, p.x++) {
-				struct rgb_color rgb;
-				if (pal_to_rgb(pixel_array[oy * y_stride + ox],
-					       pal, header->colors_used, &rgb))
+		/* 8 bits per pixel can't index more than 256 colors. */
+		const size_t palcount = MIN(header->colors_used, 256);
+		uint32_t pal_colors[256];
+
+		pal_to_colors(pal, palcount, invert, pal_colors);
+		for (oy = 0; oy < dim->height; oy++, y += dir) {
+			const uint8_t *const row = &pixel_array[oy * y_stride];
+			for (ox = 0; ox < dim->width; ox++) {
+				if (row[ox] >= palcount) {
+					LOG("Color index %d exceeds palette boundary\n",
+					    row[ox]);
+					free(colors);
 					return CBGFX_ERROR_BITMAP_DATA;
-				set_pixel(&p, calculate_color(&rgb, invert));
+				}
+				colors[ox] = pal_colors[row[ox]];
 			}
+			draw_row(top_left->x, y, colors, dim->width);
 		}
+		free(colors);
 		return CBGFX_SUCCESS;
 	}
 
 	/* Precalculate the X-weights for every possible ox so that we only have
 	   to multiply weights together in the end. */
 	fpmath_t (*weight_x)[SSZ] = malloc(sizeof(fpmath_t) * SSZ * dim->width);
-	if (!weight_x)
+	if (!weight_x) {
+		free(colors);
 		return CBGFX_ERROR_UNKNOWN;
+	}
 	for (ox = 0; ox < dim->width; ox++) {
 		for (sx = 0; sx < SSZ; sx++) {
 			fpmath_t ixfp = fpfrac(ox * dim_org->width, dim->width);
@@ -829,7 +994,7 @@ static int draw_bitmap_v3(const struct vector *top_left,
 
 	/* iy and ix track the input pixel corresponding to sample[S0][S0]. */
 	iy = 0;
-	for (oy = 0; oy < dim->height; oy++, p.y += dir) {
+	for (oy = 0; oy < dim->height; oy++, y += dir) {
 		struct rgb_color sample[SSZ][SSZ];
 
 		/* Like with X weights, we also cache all Y weights. */
@@ -892,8 +1057,7 @@ static int draw_bitmap_v3(const struct vector *top_left,
 		}
 
 		ix = 0;
-		p.x = top_left->x;
-		for (ox = 0; ox < dim->width; ox++, p.x++) {
+		for (ox = 0; ox < dim->width; ox++) {
 			/* Adjust ix forward, same as iy above. */
 			fpmath_t ixfp = fpfrac(ox * dim_org->width, dim->width);
 			while (fpfloor(ixfp) > ix) {
@@ -934,8 +1098,8 @@ static int draw_bitmap_v3(const struct vector *top_left,
 
 			/* If all pixels in sample are equal, fast path. */
 			if (equals >= (SSZ * SSZ)) {
-				set_pixel(&p, calculate_color(&sample[0][0],
-							      invert));
+				colors[ox] = calculate_color(&sample[0][0],
+							     invert);
 				continue;
 			}
 
@@ -967,15 +1131,18 @@ static int draw_bitmap_v3(const struct vector *top_left,
 				.blue = MAX(0, MIN(UINT8_MAX, fpround(blue))),
 			};
 
-			set_pixel(&p, calculate_color(&rgb, invert));
+			colors[ox] = calculate_color(&rgb, invert);
 		}
+		draw_row(top_left->x, y, colors, dim->width);
 	}
 
 	free(weight_x);
+	free(colors);
 	return CBGFX_SUCCESS;
 
 bitmap_error:
 	free(weight_x);
+	free(colors);
 	return CBGFX_ERROR_BITMAP_DATA;
 }
 
@@ -1283,15 +1450,45 @@ int enable_graphics_buffer(void)
 
 int flush_graphics_buffer(void)
 {
+	const size_t bytes = fbinfo->bits_per_pixel / 8;
+	const size_t bpl = fbinfo->bytes_per_line;
+	size_t i, offset, width, size, flushed = 0;
+	int32_t y;
+
 	if (!gfx_buffer)
 		return CBGFX_ERROR_GRAPHICS_BUFFER;
 
-	memcpy(REAL_FB, gfx_buffer, fbinfo->y_resolution * fbinfo->bytes_per_line);
+	/* Only copy what was drawn, the framebuffer is slow to write. */
+	for (i = 0; i < dirty_count; i++) {
+		const struct rect *const area = &dirty[i];
+		offset = area->offset.y * bpl + area->offset.x * bytes;
+		width = area->size.width * bytes;
+		if (width == fbinfo->x_resolution * bytes) {
+			/* Whole lines can go in one piece, padding included. */
+			size = (area->size.height - 1) * bpl + width;
+			memcpy(REAL_FB + offset, gfx_buffer + offset, size);
+			flushed += size;
+		} else {
+			for (y = 0; y < area->size.height; y++, offset += bpl)
+				memcpy(REAL_FB + offset, gfx_buffer + offset, width);
+			flushed += area->size.height * width;
+		}
+	}
+	dirty_count = 0;
+
+	if (flush_hook)
+		flush_hook(flushed);
 	return CBGFX_SUCCESS;
 }
 
+void set_graphics_buffer_flush_hook(void (*hook)(size_t bytes))
+{
+	flush_hook = hook;
+}
+
 void disable_graphics_buffer(void)
 {
 	free(gfx_buffer);
 	gfx_buffer = NULL;
+	dirty_count = 0;
 }
@@ -285,12 +285,20 @@ int enable_graphics_buffer(void);
 
 /**
  * Redraw buffered graphics data to real screen if graphics buffer is already
- * enabled.
+ * enabled. Only the areas that were drawn since the last flush are copied.
  *
  * @return CBGFX_* error codes
  */
 int flush_graphics_buffer(void);
 
+/**
+ * Set a function that is called by every flush_graphics_buffer() with the
+ * number of bytes copied to the screen, or NULL to stop calling it.
+ *
+ * @param hook  function to call
+ */
+void set_graphics_buffer_flush_hook(void (*hook)(size_t bytes));
+
 /**
  * Stop using buffered I/O and release allocated memory.
  */
@@ -55,11 +55,21 @@ typedef enum {
 
 struct storage_dev;
 
+/* One part of a vectored read: count blocks starting at start go to buf. */
+struct storage_read_req {
+	lba_t start;
+	size_t count;
+	unsigned char *buf;
+};
+
 typedef struct storage_dev {
 	storage_port_t port_type;
 
 	storage_poll_t (*poll)(struct storage_dev *);
 	ssize_t (*read_blocks512)(struct storage_dev *, lba_t start, size_t count, unsigned char *buf);
+	/* Optional, drivers that can keep several reads in flight implement it. */
+	ssize_t (*read_blocks512_vec)(struct storage_dev *, const struct storage_read_req *reqs,
+				      size_t count);
 	ssize_t (*write_blocks512)(struct storage_dev *, lba_t start, size_t count, const unsigned char *buf);
 
 	void (*detach_device)(struct storage_dev *);
@@ -70,5 +80,7 @@ int storage_attach_device(storage_dev_t *dev);
 
 storage_poll_t storage_probe(size_t dev_num);
 ssize_t storage_read_blocks512(size_t dev_num, lba_t start, size_t count, unsigned char *buf);
+ssize_t storage_read_blocks512_vec(size_t dev_num, const struct storage_read_req *reqs,
+				   size_t count);
 
 #endif
@@ -255,6 +255,16 @@ struct usbdev_hc {
 	void (*shutdown) (hci_t *controller);
 
 	int (*bulk) (endpoint_t *ep, int size, u8 *data, int finalize);
+	/* bulk_submit():	Optional, queue a bulk transfer without waiting
+				for it. Returns 0 if it was queued. Data has
+				to be DMA coherent.
+	   bulk_wait():		Wait for the oldest transfer queued on ep,
+				returns like bulk(). On failure, the other
+				queued transfers are dropped.
+	   bulk_cancel():	Drop all transfers queued on ep. */
+	int (*bulk_submit) (endpoint_t *ep, int size, u8 *data);
+	int (*bulk_wait) (endpoint_t *ep);
+	void (*bulk_cancel) (endpoint_t *ep);
 	int (*control) (usbdev_t *dev, direction_t pid, int dr_length,
 			void *devreq, int data_length, u8 *data);
 	void* (*create_intr_queue) (endpoint_t *ep, int reqsize, int reqcount, int reqtiming);
@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#ifndef __ZSTD_H_
+#define __ZSTD_H_
+
+#include <stddef.h>
+
+/* Decompresses one or more Zstandard frames from src to dst, reading at most srcn bytes and
+ * writing at most dstn bytes. The decoder workspace is taken from the heap.
+ * Returns amount of decompressed bytes, or 0 on error.
+ */
+size_t uzstd(const void *src, size_t srcn, void *dst, size_t dstn);
+
+#endif /* __ZSTD_H_ */
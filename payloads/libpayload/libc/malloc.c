@@ -28,12 +28,18 @@
  */
 
 /*
- * This is a classically weak malloc() implementation. We have a relatively
- * small and static heap, so we take the easy route with an O(N) loop
- * through the tree for every malloc() and free(). Obviously, this doesn't
- * scale past a few hundred KB (if that).
+ * A segregated-fit malloc() implementation. Free blocks are kept in bins by
+ * size: one bin per 8 byte size class below 512 bytes and one per power of
+ * two above. Small requests are served from the head of their own bin or of
+ * the next non-empty one, found with a bitmap, so they don't depend on the
+ * number of blocks in the heap. Large bins are searched first-fit.
  *
- * We're also susceptible to the usual buffer overrun poisoning, though the
+ * Every block starts with a header holding its size and flags. Free blocks
+ * also keep their size in a footer, and the header of the following block
+ * tells whether it is there, so free() can coalesce with both neighbours
+ * right away.
+ *
+ * We're still susceptible to the usual buffer overrun poisoning, though the
  * risk is within acceptable ranges for this implementation (don't overrun
  * your buffers, kids!).
  */
@@ -42,12 +48,35 @@
 #include <libpayload.h>
 #include <stdint.h>
 
+typedef u64 hdrtype_t;
+#define HDRSIZE (sizeof(hdrtype_t))
+
+#define SIZE_BITS      ((HDRSIZE << 3) - 8)
+#define MAGIC          (((hdrtype_t)0x2a) << (SIZE_BITS + 2))
+#define FLAG_FREE      (((hdrtype_t)0x01) << (SIZE_BITS + 0))
+#define FLAG_PREV_FREE (((hdrtype_t)0x01) << (SIZE_BITS + 1))
+#define MAX_SIZE       ((((hdrtype_t)0x01) << SIZE_BITS) - 1)
+
+/* A free block, the list pointers live in the first bytes of its data. */
+struct free_block {
+	hdrtype_t header;
+	struct free_block *next;
+	struct free_block *prev;
+};
+
+/* Blocks below SMALL_LIMIT bytes are binned by size, larger ones by log2. */
+#define SMALL_BINS	64
+#define SMALL_LIMIT	(SMALL_BINS * HDRSIZE)
+#define LARGE_BINS	(SIZE_BITS - 9)
+#define NBINS		(SMALL_BINS + LARGE_BINS)
+
 struct memory_type {
 	void *start;
 	void *end;
-	struct align_region_t* align_regions;
+	int initialized;
+	u64 bitmap[(NBINS + 63) / 64];
+	struct free_block *bins[NBINS];
 #if CONFIG(LP_DEBUG_MALLOC)
-	int magic_initialized;
 	size_t minimal_free;
 	const char *name;
 #endif
@@ -55,24 +84,17 @@ struct memory_type {
 
 extern char _heap, _eheap;	/* Defined in the ldscript. */
 
-static struct memory_type default_type =
-	{ (void *)&_heap, (void *)&_eheap, NULL
+static struct memory_type default_type = {
+	.start = (void *)&_heap,
+	.end = (void *)&_eheap,
 #if CONFIG(LP_DEBUG_MALLOC)
-	, 0, 0, "HEAP"
+	.name = "HEAP",
 #endif
-	};
+};
 static struct memory_type *const heap = &default_type;
 static struct memory_type *dma = &default_type;
 
-typedef u64 hdrtype_t;
-#define HDRSIZE (sizeof(hdrtype_t))
-
-#define SIZE_BITS ((HDRSIZE << 3) - 7)
-#define MAGIC     (((hdrtype_t)0x2a) << (SIZE_BITS + 1))
-#define FLAG_FREE (((hdrtype_t)0x01) << (SIZE_BITS + 0))
-#define MAX_SIZE  ((((hdrtype_t)0x01) << SIZE_BITS) - 1)
-
-#define SIZE(_h) ((_h) & MAX_SIZE)
+#define SIZE(_h) ((size_t)((_h) & MAX_SIZE))
 
 #define _HEADER(_s, _f) ((hdrtype_t) (MAGIC | (_f) | ((_s) & MAX_SIZE)))
 
@@ -82,489 +104,399 @@ typedef u64 hdrtype_t;
 #define IS_FREE(_h) (((_h) & (MAGIC | FLAG_FREE)) == (MAGIC | FLAG_FREE))
 #define HAS_MAGIC(_h) (((_h) & MAGIC) == MAGIC)
 
-static int free_aligned(void* addr, struct memory_type *type);
+/* A free block must hold the list pointers and the footer. */
+#define MIN_SIZE  (ALIGN_UP(sizeof(struct free_block) - HDRSIZE, HDRSIZE) + HDRSIZE)
+#define MIN_BLOCK (HDRSIZE + MIN_SIZE)
+
 void print_malloc_map(void);
 
-void init_dma_memory(void *start, u32 size)
+static inline hdrtype_t *next_block(hdrtype_t *block)
 {
-	if (dma_initialized()) {
-		printf("ERROR: %s called twice!\n", __func__);
-		return;
-	}
-
-	/*
-	 * DMA memory might not be zeroed by coreboot on stage loading, so make
-	 * sure we clear the magic cookie from last boot.
-	 */
-	*(hdrtype_t *)start = 0;
-
-	dma = malloc(sizeof(*dma));
-	dma->start = start;
-	dma->end = start + size;
-	dma->align_regions = NULL;
-
-#if CONFIG(LP_DEBUG_MALLOC)
-	dma->minimal_free = 0;
-	dma->magic_initialized = 0;
-	dma->name = "DMA";
-
-	printf("Initialized cache-coherent DMA memory at [%p:%p]\n", start, start + size);
-#endif
+	return (void *)block + HDRSIZE + SIZE(*block);
 }
 
-int dma_initialized(void)
+/* Only valid if the block has FLAG_PREV_FREE set. */
+static inline hdrtype_t *prev_block(hdrtype_t *block)
 {
-	return dma != heap;
+	return (void *)block - HDRSIZE - SIZE(block[-1]);
 }
 
-/* For boards that don't initialize DMA we assume all locations are coherent */
-int dma_coherent(const void *ptr)
+static unsigned int bin_index(size_t size)
 {
-	return !dma_initialized() || (dma->start <= ptr && dma->end > ptr);
+	if (size < SMALL_LIMIT)
+		return size / HDRSIZE;
+
+	return SMALL_BINS + log2_64(size) - log2(SMALL_LIMIT);
 }
 
-/* Get the range of memory that can be allocated by the dma allocator. */
-void dma_allocator_range(void **start_out, size_t *size_out)
+/* Find the first non-empty bin starting at idx. */
+static int find_bin(const struct memory_type *type, unsigned int idx)
 {
-	if (dma_initialized()) {
-		*start_out = dma->start;
-		*size_out = dma->end - dma->start;
-	} else {
-		*start_out = NULL;
-		*size_out = 0;
+	unsigned int i;
+	u64 bits;
+
+	for (i = idx / 64; i < ARRAY_SIZE(type->bitmap); i++) {
+		bits = type->bitmap[i];
+		if (i == idx / 64)
+			bits &= ~0ULL << (idx % 64);
+		if (bits)
+			return i * 64 + __ffs64(bits);
 	}
+
+	return -1;
 }
 
-/* Find free block of size >= len */
-static hdrtype_t volatile *find_free_block(int len, struct memory_type *type)
+static void bin_insert(struct memory_type *type, hdrtype_t *block)
 {
-	hdrtype_t header;
-	hdrtype_t volatile *ptr = (hdrtype_t volatile *)type->start;
+	struct free_block *b = (struct free_block *)block;
+	unsigned int idx = bin_index(SIZE(*block));
+
+	b->prev = NULL;
+	b->next = type->bins[idx];
+	if (b->next)
+		b->next->prev = b;
+	type->bins[idx] = b;
+	type->bitmap[idx / 64] |= 1ULL << (idx % 64);
+}
 
-	/* Align the size. */
-	len = ALIGN_UP(len, HDRSIZE);
+static void bin_remove(struct memory_type *type, hdrtype_t *block)
+{
+	struct free_block *b = (struct free_block *)block;
+	unsigned int idx = bin_index(SIZE(*block));
+
+	if (b->next)
+		b->next->prev = b->prev;
+	if (b->prev)
+		b->prev->next = b->next;
+	else
+		type->bins[idx] = b->next;
+
+	if (!type->bins[idx])
+		type->bitmap[idx / 64] &= ~(1ULL << (idx % 64));
+}
 
-	if (!len || len > MAX_SIZE)
-		return (void *)NULL;
+/* Turn a block into a free one, merging it with free neighbours. */
+static void release_block(struct memory_type *type, hdrtype_t *block)
+{
+	size_t size = SIZE(*block);
+	hdrtype_t *next = next_block(block);
 
-	/* Make sure the region is setup correctly. */
-	if (!HAS_MAGIC(*ptr)) {
-		size_t size = (type->end - type->start) - HDRSIZE;
-		*ptr = FREE_BLOCK(size);
-#if CONFIG(LP_DEBUG_MALLOC)
-		type->magic_initialized = 1;
-		type->minimal_free = size;
-#endif
+	if (IS_FREE(*next)) {
+		bin_remove(type, next);
+		size += HDRSIZE + SIZE(*next);
 	}
 
-	/* Find some free space. */
-	do {
-		header = *ptr;
-		int size = SIZE(header);
-
-		if (!HAS_MAGIC(header) || size == 0) {
-			printf("memory allocator panic. (%s%s)\n",
-			       !HAS_MAGIC(header) ? " no magic " : "",
-				   size == 0 ? " size=0 " : "");
-			halt();
-		}
-
-		if ((header & FLAG_FREE) && len <= size)
-			return ptr;
-
-		ptr = (hdrtype_t volatile *)((uintptr_t)ptr + HDRSIZE + size);
-
-	} while (ptr < (hdrtype_t *) type->end);
+	if (*block & FLAG_PREV_FREE) {
+		block = prev_block(block);
+		bin_remove(type, block);
+		size += HDRSIZE + SIZE(*block);
+	}
 
-	/* Nothing available. */
-	return NULL;
+	*block = FREE_BLOCK(size);
+	*(hdrtype_t *)((void *)block + size) = size;
+	*next_block(block) |= FLAG_PREV_FREE;
+	bin_insert(type, block);
 }
 
-/* Mark the block with length 'len' as used */
-static void use_block(hdrtype_t volatile *ptr, int len)
+/* Take a block out of its bin and mark it as used. */
+static void use_block(struct memory_type *type, hdrtype_t *block)
 {
-	/* Align the size. */
-	len = ALIGN_UP(len, HDRSIZE);
-
-	hdrtype_t volatile *nptr = (hdrtype_t volatile *)
-		((uintptr_t)ptr + HDRSIZE + len);
-	int size = SIZE(*ptr);
-	int nsize = size - (HDRSIZE + len);
-
-	/*
-	 * If there is still room in this block, then mark it as such otherwise
-	 * account the whole space for that block.
-	 */
-	if (nsize > 0) {
-		/* Mark the block as used. */
-		*ptr = USED_BLOCK(len);
-
-		/* Create a new free block. */
-		*nptr = FREE_BLOCK(nsize);
-	} else {
-		/* Mark the block as used. */
-		*ptr = USED_BLOCK(size);
-	}
+	bin_remove(type, block);
+	*block = USED_BLOCK(SIZE(*block));
+	*next_block(block) &= ~FLAG_PREV_FREE;
 }
 
-static void *alloc(int len, struct memory_type *type)
+/* Shrink a used block to size bytes, releasing the rest if it's worth a block. */
+static void split_block(struct memory_type *type, hdrtype_t *block, size_t size)
 {
-	hdrtype_t volatile *ptr = find_free_block(len, type);
+	size_t rest = SIZE(*block) - size;
+	hdrtype_t *next;
 
-	if (ptr == NULL)
-		return NULL;
+	if (rest < MIN_BLOCK)
+		return;
 
-	use_block(ptr, len);
-	return (void *)((uintptr_t)ptr + HDRSIZE);
+	*block = USED_BLOCK(size) | (*block & FLAG_PREV_FREE);
+	next = next_block(block);
+	*next = USED_BLOCK(rest - HDRSIZE);
+	release_block(type, next);
 }
 
-static void _consolidate(struct memory_type *type)
+static int setup_type(struct memory_type *type)
 {
-	void *ptr = type->start;
-
-	while (ptr < type->end) {
-		void *nptr;
-		hdrtype_t hdr = *((hdrtype_t *) ptr);
-		unsigned int size = 0;
-
-		if (!IS_FREE(hdr)) {
-			ptr += HDRSIZE + SIZE(hdr);
-			continue;
-		}
-
-		size = SIZE(hdr);
-		nptr = ptr + HDRSIZE + SIZE(hdr);
+	void *start, *end;
+	hdrtype_t *block;
 
-		while (nptr < type->end) {
-			hdrtype_t nhdr = *((hdrtype_t *) nptr);
+	if (type->initialized)
+		return 0;
 
-			if (!(IS_FREE(nhdr)))
-				break;
+	start = (void *)ALIGN_UP((uintptr_t)type->start, HDRSIZE);
+	end = (void *)ALIGN_DOWN((uintptr_t)type->end, HDRSIZE);
+	if (end < start + MIN_BLOCK + HDRSIZE)
+		return -1;
 
-			size += SIZE(nhdr) + HDRSIZE;
+	memset(type->bins, 0, sizeof(type->bins));
+	memset(type->bitmap, 0, sizeof(type->bitmap));
 
-			*((hdrtype_t *) nptr) = 0;
+	/* A used block of size 0 at the end stops the coalescing. */
+	block = end - HDRSIZE;
+	*block = USED_BLOCK(0);
 
-			nptr += (HDRSIZE + SIZE(nhdr));
-		}
+	block = start;
+	*block = USED_BLOCK(end - start - 2 * HDRSIZE);
+	release_block(type, block);
 
-		*((hdrtype_t *) ptr) = FREE_BLOCK(size);
-		ptr = nptr;
-	}
+	type->initialized = 1;
+#if CONFIG(LP_DEBUG_MALLOC)
+	type->minimal_free = SIZE(*block);
+#endif
+	return 0;
 }
 
-void free(void *ptr)
+/* Round a request up to a block size, 0 if it can't be satisfied. */
+static size_t block_size(size_t len, struct memory_type *type)
 {
-	hdrtype_t hdr;
-	struct memory_type *type = heap;
+	if (!len || len > type->end - type->start)
+		return 0;
 
-	/* No action occurs on NULL. */
-	if (ptr == NULL)
-		return;
+	return MAX(ALIGN_UP(len, HDRSIZE), MIN_SIZE);
+}
 
-	/* Sanity check. */
-	if (ptr < type->start || ptr >= type->end) {
-		type = dma;
-		if (ptr < type->start || ptr >= type->end)
-			return;
+/* Find a free block of at least size bytes. */
+static hdrtype_t *find_free_block(size_t size, struct memory_type *type)
+{
+	unsigned int idx = bin_index(size);
+	struct free_block *b;
+	int i;
+
+	/* Large bins hold a range of sizes, so look for a fit in our own first. */
+	if (idx >= SMALL_BINS) {
+		for (b = type->bins[idx]; b; b = b->next) {
+			if (SIZE(b->header) >= size)
+				return &b->header;
+		}
+		idx++;
 	}
 
-	if (free_aligned(ptr, type)) return;
-
-	ptr -= HDRSIZE;
-	hdr = *((hdrtype_t *) ptr);
-
-	/* Not our header (we're probably poisoned). */
-	if (!HAS_MAGIC(hdr))
-		return;
+	/* All blocks in the following bins are large enough. */
+	i = find_bin(type, idx);
+	if (i < 0)
+		return NULL;
 
-	/* Double free. */
-	if (hdr & FLAG_FREE)
-		return;
+	b = type->bins[i];
+	if (!IS_FREE(b->header)) {
+		printf("memory allocator panic. (corrupted free block at %p)\n", b);
+		halt();
+	}
 
-	*((hdrtype_t *) ptr) = FREE_BLOCK(SIZE(hdr));
-	_consolidate(type);
+	return &b->header;
 }
 
-void *malloc(size_t size)
+static void *alloc(size_t len, struct memory_type *type)
 {
-	return alloc(size, heap);
-}
+	size_t size;
+	hdrtype_t *block;
 
-void *dma_malloc(size_t size)
-{
-	return alloc(size, dma);
-}
+	if (setup_type(type) < 0)
+		return NULL;
 
-void *calloc(size_t nmemb, size_t size)
-{
-	size_t total = nmemb * size;
-	void *ptr = alloc(total, heap);
+	size = block_size(len, type);
+	if (!size)
+		return NULL;
 
-	if (ptr)
-		memset(ptr, 0, total);
+	block = find_free_block(size, type);
+	if (block == NULL)
+		return NULL;
 
-	return ptr;
+	use_block(type, block);
+	split_block(type, block, size);
+	return (void *)block + HDRSIZE;
 }
 
-void *realloc(void *ptr, size_t size)
+static void *alloc_aligned(size_t align, size_t len, struct memory_type *type)
 {
-	void *ret, *pptr;
-	hdrtype_t volatile *block;
-	unsigned int osize;
-	struct memory_type *type = heap;
+	size_t size;
+	hdrtype_t *block, *aligned;
+	void *ptr, *data;
 
-	if (ptr == NULL)
-		return alloc(size, type);
-
-	pptr = ptr - HDRSIZE;
+	if (align <= HDRSIZE)
+		return alloc(len, type);
 
-	if (!HAS_MAGIC(*((hdrtype_t *) pptr)))
+	if (!IS_POWER_OF_2(align) || setup_type(type) < 0)
 		return NULL;
 
-	if (ptr < type->start || ptr >= type->end)
-		type = dma;
-
-	/* Get the original size of the block. */
-	osize = SIZE(*((hdrtype_t *) pptr));
-
-	/*
-	 * Free the memory to update the tables - this won't touch the actual
-	 * memory, so we can still use it for the copy after we have
-	 * reallocated the new space.
-	 */
-	free(ptr);
+	size = block_size(len, type);
+	if (!size || align > type->end - type->start)
+		return NULL;
 
-	block = find_free_block(size, type);
+	/* Leave room for a free block in front of the aligned data. */
+	block = find_free_block(size + align + MIN_BLOCK, type);
 	if (block == NULL)
 		return NULL;
 
-	ret = (void *)((uintptr_t)block + HDRSIZE);
+	use_block(type, block);
 
-	/*
-	 * If ret == ptr, then no copy is needed. Otherwise, move the memory to
-	 * the new location, which might be before the old one and overlap since
-	 * the free() above includes a _consolidate().
-	 */
-	if (ret != ptr)
-		memmove(ret, ptr, osize > size ? size : osize);
+	ptr = (void *)block + HDRSIZE;
+	data = (void *)ALIGN_UP((uintptr_t)ptr, align);
+	while (data != ptr && data - ptr < MIN_BLOCK)
+		data += align;
 
-	/* Mark the block as used. */
-	use_block(block, size);
+	if (data != ptr) {
+		aligned = data - HDRSIZE;
+		*aligned = USED_BLOCK(SIZE(*block) - (data - ptr));
+		*block = USED_BLOCK(data - ptr - HDRSIZE);
+		release_block(type, block);
+		block = aligned;
+	}
 
-	return ret;
+	split_block(type, block, size);
+	return data;
 }
 
-struct align_region_t
+void init_dma_memory(void *start, u32 size)
 {
-	/* If alignment is 0 then the region represents a large region which
-	 * has no metadata for tracking subelements. */
-	int alignment;
-	/* start in memory, and size in bytes */
-	void* start;
-	int size;
-	/* layout within a region:
-	  - num_elements bytes, 0: free, 1: used, 2: used, combines with next
-	  - padding to alignment
-	  - data section
-	  - waste space
-
-	  start_data points to the start of the data section
-	*/
-	void* start_data;
-	/* number of free blocks sized "alignment" */
-	int free;
-	struct align_region_t *next;
-};
+	if (dma_initialized()) {
+		printf("ERROR: %s called twice!\n", __func__);
+		return;
+	}
 
-static inline int region_is_large(const struct align_region_t *r)
-{
-	return r->alignment == 0;
+	dma = malloc(sizeof(*dma));
+	memset(dma, 0, sizeof(*dma));
+	dma->start = start;
+	dma->end = start + size;
+
+#if CONFIG(LP_DEBUG_MALLOC)
+	dma->name = "DMA";
+
+	printf("Initialized cache-coherent DMA memory at [%p:%p]\n", start, start + size);
+#endif
 }
 
-static inline int addr_in_region(const struct align_region_t *r, void *addr)
+int dma_initialized(void)
 {
-	return ((addr >= r->start_data) && (addr < r->start_data + r->size));
+	return dma != heap;
 }
 
-/* num_elements == 0 indicates a large aligned region instead of a smaller
- * region comprised of alignment-sized chunks. */
-static struct align_region_t *allocate_region(int alignment, int num_elements,
-					size_t size, struct memory_type *type)
+/* For boards that don't initialize DMA we assume all locations are coherent */
+int dma_coherent(const void *ptr)
 {
-	struct align_region_t *r;
-	size_t extra_space;
+	return !dma_initialized() || (dma->start <= ptr && dma->end > ptr);
+}
 
-#if CONFIG(LP_DEBUG_MALLOC)
-	printf("%s(old align_regions=%p, alignment=%u, num_elements=%u, size=%zu)\n",
-		__func__, type->align_regions, alignment, num_elements, size);
-#endif
+/* Get the range of memory that can be allocated by the dma allocator. */
+void dma_allocator_range(void **start_out, size_t *size_out)
+{
+	if (dma_initialized()) {
+		*start_out = dma->start;
+		*size_out = dma->end - dma->start;
+	} else {
+		*start_out = NULL;
+		*size_out = 0;
+	}
+}
 
-	r = malloc(sizeof(*r));
+static struct memory_type *find_type(const void *ptr)
+{
+	if (ptr >= heap->start && ptr < heap->end)
+		return heap;
+	if (ptr >= dma->start && ptr < dma->end)
+		return dma;
+	return NULL;
+}
 
-	if (r == NULL)
-		return NULL;
+void free(void *ptr)
+{
+	hdrtype_t *block;
+	struct memory_type *type;
 
-	memset(r, 0, sizeof(*r));
+	/* No action occurs on NULL. */
+	if (ptr == NULL)
+		return;
 
-	if (num_elements != 0) {
-		r->alignment = alignment;
-		r->size = num_elements * alignment;
-		r->free = num_elements;
-		/* Allocate enough memory for alignment requirements and
-		 * metadata for each chunk. */
-		extra_space = num_elements;
-	} else {
-		/* Large aligned allocation. Set alignment = 0. */
-		r->alignment = 0;
-		r->size = size;
-		extra_space = 0;
-	}
+	/* Sanity check. */
+	type = find_type(ptr);
+	if (type == NULL || !type->initialized)
+		return;
 
-	r->start = alloc(r->size + alignment + extra_space, type);
+	block = ptr - HDRSIZE;
 
-	if (r->start == NULL) {
-		free(r);
-		return NULL;
-	}
+	/* Not our header (we're probably poisoned). */
+	if (!HAS_MAGIC(*block))
+		return;
 
-	r->start_data = (void *)ALIGN_UP((uintptr_t)r->start + extra_space,
-					alignment);
+	/* Double free. */
+	if (*block & FLAG_FREE)
+		return;
 
-	/* Clear any (if requested) metadata. */
-	memset(r->start, 0, extra_space);
+	release_block(type, block);
+}
 
-	/* Link the region with the rest. */
-	r->next = type->align_regions;
-	type->align_regions = r;
+void *malloc(size_t size)
+{
+	return alloc(size, heap);
+}
 
-	return r;
+void *dma_malloc(size_t size)
+{
+	return alloc(size, dma);
 }
 
-static void try_free_region(struct align_region_t **prev_link)
+void *calloc(size_t nmemb, size_t size)
 {
-	struct align_region_t *r = *prev_link;
+	size_t total;
+	void *ptr;
 
-	/* All large regions are immediately free-able. Non-large regions
-	 * need to be checked for the fully freed state. */
-	if (!region_is_large(r)) {
-		if (r->free != r->size / r->alignment)
-			return;
-	}
+	if (__builtin_mul_overflow(nmemb, size, &total))
+		return NULL;
 
-	/* Unlink region from link list. */
-	*prev_link = r->next;
+	ptr = alloc(total, heap);
+	if (ptr)
+		memset(ptr, 0, total);
 
-	/* Free the data and metadata. */
-	free(r->start);
-	free(r);
+	return ptr;
 }
 
-static int free_aligned(void* addr, struct memory_type *type)
+void *realloc(void *ptr, size_t len)
 {
-	struct align_region_t **prev_link = &type->align_regions;
+	void *ret;
+	hdrtype_t *block, *next;
+	size_t size, osize;
+	struct memory_type *type;
 
-	while (*prev_link != NULL)
-	{
-		if (!addr_in_region(*prev_link, addr)) {
-			prev_link = &((*prev_link)->next);
-			continue;
-		}
+	if (ptr == NULL)
+		return alloc(len, heap);
 
-		if (region_is_large(*prev_link)) {
-			try_free_region(prev_link);
-			return 1;
-		}
+	type = find_type(ptr);
+	block = ptr - HDRSIZE;
+	if (type == NULL || !HAS_MAGIC(*block) || (*block & FLAG_FREE))
+		return NULL;
 
-		int i = (addr-(*prev_link)->start_data)/(*prev_link)->alignment;
-		u8 *meta = (*prev_link)->start;
-		while (meta[i] == 2)
-		{
-			meta[i++] = 0;
-			(*prev_link)->free++;
-		}
-		meta[i] = 0;
-		(*prev_link)->free++;
-		try_free_region(prev_link);
-		return 1;
+	size = block_size(len, type);
+	if (!size) {
+		free(ptr);
+		return NULL;
 	}
-	return 0;
-}
 
-static void *alloc_aligned(size_t align, size_t size, struct memory_type *type)
-{
-	/* Define a large request to be 1024 bytes for either alignment or
-	 * size of allocation. */
-	const size_t large_request = 1024;
-
-	if (size == 0) return 0;
-	if (type->align_regions == 0) {
-		type->align_regions = malloc(sizeof(struct align_region_t));
-		if (type->align_regions == NULL)
-			return NULL;
-		memset(type->align_regions, 0, sizeof(struct align_region_t));
+	/* Shrink in place, or grow into the following block if it's free. */
+	osize = SIZE(*block);
+	next = next_block(block);
+	if (size > osize && IS_FREE(*next) && osize + HDRSIZE + SIZE(*next) >= size) {
+		use_block(type, next);
+		*block = USED_BLOCK(osize + HDRSIZE + SIZE(*next)) | (*block & FLAG_PREV_FREE);
 	}
-	struct align_region_t *reg = type->align_regions;
 
-	if (size >= large_request || align >= large_request) {
-		reg = allocate_region(align, 0, size, type);
-		if (reg == NULL)
-			return NULL;
-		return reg->start_data;
+	if (size <= SIZE(*block)) {
+		split_block(type, block, size);
+		return ptr;
 	}
 
-look_further:
-	while (reg != 0)
-	{
-		if ((reg->alignment == align) && (reg->free >= (size + align - 1)/align))
-		{
-#if CONFIG(LP_DEBUG_MALLOC)
-			printf("  found memalign region. %u free, %zu required\n", reg->free, (size + align - 1)/align);
-#endif
-			break;
-		}
-		reg = reg->next;
-	}
-	if (reg == 0)
-	{
-#if CONFIG(LP_DEBUG_MALLOC)
-		printf("  need to allocate a new memalign region\n");
-#endif
-		/* get align regions */
-		reg = allocate_region(align, large_request/align, size, type);
-#if CONFIG(LP_DEBUG_MALLOC)
-		printf("  ... returned %p\n", reg);
-#endif
-	}
-	if (reg == 0) {
-		/* Nothing available. */
-		return (void *)NULL;
-	}
+	ret = alloc(len, type);
+	if (ret == NULL)
+		return NULL;
 
-	int i, count = 0, target = (size+align-1)/align;
-	for (i = 0; i < (reg->size/align); i++)
-	{
-		if (((u8*)reg->start)[i] == 0)
-		{
-			count++;
-			if (count == target) {
-				count = i+1-count;
-				for (i=0; i<target-1; i++)
-				{
-					((u8*)reg->start)[count+i]=2;
-				}
-				((u8*)reg->start)[count+target-1]=1;
-				reg->free -= target;
-				return reg->start_data+(align*count);
-			}
-		} else {
-			count = 0;
-		}
-	}
-	/* The free space in this region is fragmented,
-	   so we will move on and try the next one: */
-	reg = reg->next;
-	goto look_further; // end condition is once a new region is allocated - it always has enough space
+	memcpy(ret, ptr, osize);
+	free(ptr);
+
+	return ret;
 }
 
 void *memalign(size_t align, size_t size)
@@ -582,41 +514,46 @@ void *dma_memalign(size_t align, size_t size)
 void print_malloc_map(void)
 {
 	struct memory_type *type = heap;
-	void *ptr;
-	int free_memory;
+	hdrtype_t *ptr;
+	size_t free_memory;
 
 again:
-	ptr = type->start;
+	ptr = (void *)ALIGN_UP((uintptr_t)type->start, HDRSIZE);
 	free_memory = 0;
 
-	while (ptr < type->end) {
-		hdrtype_t hdr = *((hdrtype_t *) ptr);
+	if (!type->initialized) {
+		printf("%s: Not used yet - going to initialize\n", type->name);
+		goto next;
+	}
+
+	while ((void *)ptr < type->end) {
+		hdrtype_t hdr = *ptr;
 
 		if (!HAS_MAGIC(hdr)) {
-			if (type->magic_initialized)
-				printf("%s: Poisoned magic - we're toast\n", type->name);
-			else
-				printf("%s: No magic yet - going to initialize\n", type->name);
+			printf("%s: Poisoned magic - we're toast\n", type->name);
 			break;
 		}
 
-		/* FIXME: Verify the size of the block. */
+		/* The end marker. */
+		if (SIZE(hdr) == 0)
+			break;
 
-		printf("%s %x: %s (%llx bytes)\n", type->name,
-		       (unsigned int)(ptr - type->start),
+		printf("%s %x: %s (%zx bytes)\n", type->name,
+		       (unsigned int)((void *)ptr - type->start),
 		       hdr & FLAG_FREE ? "FREE" : "USED", SIZE(hdr));
 
 		if (hdr & FLAG_FREE)
 			free_memory += SIZE(hdr);
 
-		ptr += HDRSIZE + SIZE(hdr);
+		ptr = next_block(ptr);
 	}
 
-	if (free_memory && (type->minimal_free > free_memory))
+	if (type->minimal_free > free_memory)
 		type->minimal_free = free_memory;
 	printf("%s: Maximum memory consumption: %zu bytes\n", type->name,
-		(type->end - type->start) - HDRSIZE - type->minimal_free);
+		(type->end - type->start) - 2 * HDRSIZE - type->minimal_free);
 
+next:
 	if (type != dma) {
 		type = dma;
 		goto again;
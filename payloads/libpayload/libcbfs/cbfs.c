@@ -11,6 +11,7 @@
 #include <lp_vboot.h>
 #include <lz4.h>
 #include <lzma.h>
+#include <zstd.h>
 #include <string.h>
 #include <sysinfo.h>
 
@@ -141,6 +142,11 @@ static size_t cbfs_load_and_decompress(size_t offset, size_t in_size, void *buff
 			goto out;
 		out_size = ulzman(load, in_size, buffer, buffer_size);
 		break;
+	case CBFS_COMPRESS_ZSTD:
+		if (!CONFIG(LP_ZSTD))
+			goto out;
+		out_size = uzstd(load, in_size, buffer, buffer_size);
+		break;
 	default:
 		ERROR("'%s' decompression algo %d not supported\n", mdata->h.filename,
 		      compression);
@@ -0,0 +1,7 @@
+# SPDX-License-Identifier: BSD-3-Clause
+
+libzstd-$(CONFIG_LP_ZSTD) += zstd.c
+
+ifeq ($(CONFIG_LP_ZSTD),y)
+libzstd-srcs += $(coreboottop)/src/commonlib/bsd/zstd_decompress.c
+endif
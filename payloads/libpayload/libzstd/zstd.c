@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <commonlib/bsd/compression.h>
+#include <libpayload.h>
+#include <zstd.h>
+
+size_t uzstd(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	void *workspace = malloc(UZSTD_WORKSPACE_SIZE);
+	size_t out_size;
+
+	if (!workspace)
+		return 0;
+
+	out_size = uzstdn(src, srcn, dst, dstn, workspace);
+	free(workspace);
+
+	return out_size;
+}
@@ -0,0 +1,88 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * Measures the read throughput of the first USB mass storage device, first the
+ * way usbmsc always read (synchronous 64 KiB chunks), then with the transfer
+ * options of this build. E.g. in QEMU with a disk image of 64 MiB+:
+ *
+ *   -drive if=none,id=stick,format=raw,file=disk.img
+ *   -device qemu-xhci,id=xhci -device usb-storage,bus=xhci.0,drive=stick
+ */
+
+#include <libpayload-config.h>
+#include <libpayload.h>
+#include <usb/usbdisk.h>
+#include <usb/usbmsc.h>
+
+#define BENCH_MIB	64
+#define BUFFER_SIZE	(1024 * 1024)
+#define OLD_CHUNK_BYTES	(64 * 1024)
+
+static usbdev_t *disk;
+
+void usbdisk_create(usbdev_t *dev)
+{
+	if (!disk)
+		disk = dev;
+}
+
+void usbdisk_remove(usbdev_t *dev)
+{
+	if (disk == dev)
+		disk = NULL;
+}
+
+static void bench(const char *name, u8 *buf)
+{
+	const int sectors = BUFFER_SIZE / 512;
+	u64 sector = 0;
+	uint64_t start, usecs;
+	int i;
+
+	start = timer_us(0);
+	for (i = 0; i < BENCH_MIB; i++, sector += sectors) {
+		if (readwrite_blocks_512(disk, sector, sectors, cbw_direction_data_in, buf)) {
+			printf("Read failed at sector %llu.\n", sector);
+			halt();
+		}
+	}
+	usecs = timer_us(start);
+
+	printf("%s: read %d MiB in %llu ms, %llu KiB/s.\n", name, BENCH_MIB,
+	       usecs / 1000, BENCH_MIB * 1024ULL * 1000000 / MAX(usecs, 1));
+}
+
+int main(void)
+{
+	u8 *buf = dma_memalign(64, BUFFER_SIZE);
+	int i;
+
+	usb_initialize();
+	for (i = 0; i < 100 && !disk; i++) {
+		usb_poll();
+		mdelay(10);
+	}
+	if (!disk || !buf) {
+		printf("No USB mass storage device found.\n");
+		halt();
+	}
+
+	hci_t *const controller = disk->controller;
+	int (*const bulk_submit)(endpoint_t *ep, int size, u8 *data) =
+		controller->bulk_submit;
+	const unsigned int max_chunk = MSC_INST(disk)->max_chunk;
+
+	/* Without bulk_submit(), usbmsc falls back to synchronous transfers. */
+	controller->bulk_submit = NULL;
+	MSC_INST(disk)->max_chunk = OLD_CHUNK_BYTES;
+	bench("synchronous, 64 KiB", buf);
+
+	controller->bulk_submit = bulk_submit;
+	MSC_INST(disk)->max_chunk = max_chunk;
+	printf("Large transfers %s, queued reads %s.\n",
+	       CONFIG(LP_USB_MSC_LARGE_TRANSFERS) ? "on" : "off",
+	       CONFIG(LP_USB_MSC_QUEUED_READS) && bulk_submit ? "on" : "off");
+	bench("configured", buf);
+	halt();
+	return 0;
+}
@@ -6,3 +6,8 @@ speaker-test-srcs += tests/drivers/speaker-test.c
 speaker-test-mocks += inb
 speaker-test-mocks += outb
 speaker-test-mocks += arch_ndelay
+
+tests-y += graphics-test
+
+graphics-test-srcs += tests/drivers/graphics-test.c
+graphics-test-srcs += libc/fpmath.c
@@ -0,0 +1,684 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <libpayload.h>
+#include <sysinfo.h>
+
+/* Include source to gain access to private defines */
+#include "../drivers/video/graphics.c"
+
+#include <tests/test.h>
+
+/* Screen is always 48x32, the framebuffer is rotated by the orientation. */
+#define SCREEN_WIDTH	48
+#define SCREEN_HEIGHT	32
+#define LINE_PADDING	8
+#define FB_SIZE		((SCREEN_WIDTH * 4 + LINE_PADDING) * SCREEN_WIDTH)
+
+unsigned long virtual_offset = 0;
+struct sysinfo_t lib_sysinfo;
+
+static uint8_t fb_mem[FB_SIZE];
+
+/* The scene drawn pixel by pixel like cbgfx used to, in the current format. */
+static uint8_t ref_mem[FB_SIZE];
+
+/* Screen contents of the scene, drawn with 32bpp in the normal orientation. */
+static uint32_t reference[SCREEN_HEIGHT][SCREEN_WIDTH];
+
+/* 6x4 8bpp bitmap stored bottom to top, with a 4 color palette. */
+static const uint8_t bitmap_pixels[4][8] = {
+	{ 0, 1, 2, 3, 0, 1 },
+	{ 1, 1, 1, 1, 1, 1 },
+	{ 3, 2, 1, 0, 3, 2 },
+	{ 2, 0, 2, 0, 2, 0 },
+};
+
+static const struct bitmap_palette_element_v3 bitmap_palette[] = {
+	{ .red = 0xff, .green = 0x00, .blue = 0x00 },
+	{ .red = 0x00, .green = 0xff, .blue = 0x00 },
+	{ .red = 0x00, .green = 0x00, .blue = 0xff },
+	{ .red = 0x12, .green = 0x34, .blue = 0x56 },
+};
+
+static struct {
+	struct bitmap_file_header file_header;
+	struct bitmap_header_v3 header;
+	struct bitmap_palette_element_v3 palette[ARRAY_SIZE(bitmap_palette)];
+	uint8_t pixels[sizeof(bitmap_pixels)];
+} __packed bitmap;
+
+static void setup_bitmap(void)
+{
+	bitmap.file_header.signature[0] = 'B';
+	bitmap.file_header.signature[1] = 'M';
+	bitmap.file_header.file_size = htole32(sizeof(bitmap));
+	bitmap.file_header.bitmap_offset = htole32(offsetof(typeof(bitmap), pixels));
+	bitmap.header.header_size = htole32(sizeof(bitmap.header));
+	bitmap.header.width = htole32(6);
+	bitmap.header.height = htole32(4);
+	bitmap.header.bits_per_pixel = htole16(8);
+	bitmap.header.size = htole32(sizeof(bitmap.pixels));
+	bitmap.header.colors_used = htole32(ARRAY_SIZE(bitmap_palette));
+	memcpy(bitmap.palette, bitmap_palette, sizeof(bitmap.palette));
+	memcpy(bitmap.pixels, bitmap_pixels, sizeof(bitmap.pixels));
+}
+
+static void setup_fb(int bpp, int orientation)
+{
+	struct cb_framebuffer *const fb = &lib_sysinfo.framebuffer;
+	const bool rotated = orientation == CB_FB_ORIENTATION_LEFT_UP ||
+			     orientation == CB_FB_ORIENTATION_RIGHT_UP;
+
+	memset(fb_mem, 0, sizeof(fb_mem));
+	memset(ref_mem, 0, sizeof(ref_mem));
+	memset(fb, 0, sizeof(*fb));
+	fb->physical_address = (uintptr_t)fb_mem;
+	fb->x_resolution = rotated ? SCREEN_HEIGHT : SCREEN_WIDTH;
+	fb->y_resolution = rotated ? SCREEN_WIDTH : SCREEN_HEIGHT;
+	fb->bytes_per_line = fb->x_resolution * bpp / 8 + LINE_PADDING;
+	fb->bits_per_pixel = bpp;
+	fb->orientation = orientation;
+	if (bpp == 8) {
+		fb->red_mask_pos = 5;
+		fb->red_mask_size = 3;
+		fb->green_mask_pos = 2;
+		fb->green_mask_size = 3;
+		fb->blue_mask_pos = 0;
+		fb->blue_mask_size = 2;
+	} else if (bpp == 16) {
+		fb->red_mask_pos = 11;
+		fb->red_mask_size = 5;
+		fb->green_mask_pos = 5;
+		fb->green_mask_size = 6;
+		fb->blue_mask_pos = 0;
+		fb->blue_mask_size = 5;
+	} else {
+		fb->red_mask_pos = 16;
+		fb->red_mask_size = 8;
+		fb->green_mask_pos = 8;
+		fb->green_mask_size = 8;
+		fb->blue_mask_pos = 0;
+		fb->blue_mask_size = 8;
+	}
+
+	initialized = 0;
+	clear_color_map();
+	clear_blend();
+}
+
+/* Pixel lookup the way cbgfx used to plot every single pixel. */
+static uint32_t get_pixel(const uint8_t *mem, int x, int y)
+{
+	const struct cb_framebuffer *const fb = &lib_sysinfo.framebuffer;
+	const int bpp = fb->bits_per_pixel;
+	uint32_t color = 0;
+	int rx, ry, i;
+
+	switch (fb->orientation) {
+	case CB_FB_ORIENTATION_NORMAL:
+	default:
+		rx = x;
+		ry = y;
+		break;
+	case CB_FB_ORIENTATION_BOTTOM_UP:
+		rx = SCREEN_WIDTH - 1 - x;
+		ry = SCREEN_HEIGHT - 1 - y;
+		break;
+	case CB_FB_ORIENTATION_LEFT_UP:
+		rx = y;
+		ry = SCREEN_WIDTH - 1 - x;
+		break;
+	case CB_FB_ORIENTATION_RIGHT_UP:
+		rx = SCREEN_HEIGHT - 1 - y;
+		ry = x;
+		break;
+	}
+
+	const uint8_t *const pixel = mem + ry * fb->bytes_per_line + rx * bpp / 8;
+	for (i = 0; i < bpp / 8; i++)
+		color |= (uint32_t)pixel[i] << (i * 8);
+	return color;
+}
+
+/*
+ * The oracle: set_pixel() and the drawing loops as they were before cbgfx drew
+ * whole lines, writing to ref_mem. Parameters are not validated again.
+ */
+static void ref_set_pixel(struct vector *coord, uint32_t color)
+{
+	const int bpp = fbinfo->bits_per_pixel;
+	const int bpl = fbinfo->bytes_per_line;
+	struct vector rcoord;
+	int i;
+
+	switch (fbinfo->orientation) {
+	case CB_FB_ORIENTATION_NORMAL:
+	default:
+		rcoord.x = coord->x;
+		rcoord.y = coord->y;
+		break;
+	case CB_FB_ORIENTATION_BOTTOM_UP:
+		rcoord.x = screen.size.width - 1 - coord->x;
+		rcoord.y = screen.size.height - 1 - coord->y;
+		break;
+	case CB_FB_ORIENTATION_LEFT_UP:
+		rcoord.x = coord->y;
+		rcoord.y = screen.size.width - 1 - coord->x;
+		break;
+	case CB_FB_ORIENTATION_RIGHT_UP:
+		rcoord.x = screen.size.height - 1 - coord->y;
+		rcoord.y = coord->x;
+		break;
+	}
+
+	uint8_t *const pixel = ref_mem + rcoord.y * bpl + rcoord.x * bpp / 8;
+	for (i = 0; i < bpp / 8; i++)
+		pixel[i] = (color >> (i * 8));
+}
+
+static void ref_fill(const struct vector *top_left, const struct vector *t, uint32_t color)
+{
+	struct vector p;
+
+	for (p.y = top_left->y; p.y < t->y; p.y++)
+		for (p.x = top_left->x; p.x < t->x; p.x++)
+			ref_set_pixel(&p, color);
+}
+
+static void ref_clear_screen(const struct rgb_color *rgb)
+{
+	ref_fill(&vzero, &screen.size, calculate_color(rgb, 0));
+}
+
+static void ref_draw_box(const struct rect *box, const struct rgb_color *rgb)
+{
+	struct vector top_left, t;
+	const struct scale top_left_s = {
+		.x = { .n = box->offset.x, .d = CANVAS_SCALE, },
+		.y = { .n = box->offset.y, .d = CANVAS_SCALE, }
+	};
+	const struct scale bottom_right_s = {
+		.x = { .n = box->offset.x + box->size.x, .d = CANVAS_SCALE, },
+		.y = { .n = box->offset.y + box->size.y, .d = CANVAS_SCALE, }
+	};
+
+	transform_vector(&top_left, &canvas.size, &top_left_s, &canvas.offset);
+	transform_vector(&t, &canvas.size, &bottom_right_s, &canvas.offset);
+	ref_fill(&top_left, &t, calculate_color(rgb, 0));
+}
+
+static void ref_draw_rounded_box(const struct scale *pos_rel, const struct scale *dim_rel,
+				 const struct rgb_color *rgb,
+				 const struct fraction *thickness,
+				 const struct fraction *radius)
+{
+	const uint32_t color = calculate_color(rgb, 0);
+	struct scale pos_end_rel;
+	struct vector top_left, p, t, d, r, s;
+	int32_t x_begin, x_end, x, y;
+
+	add_scales(&pos_end_rel, pos_rel, dim_rel);
+	transform_vector(&top_left, &canvas.size, pos_rel, &canvas.offset);
+	transform_vector(&t, &canvas.size, &pos_end_rel, &canvas.offset);
+
+	const struct scale thickness_scale = {
+		.x = { .n = thickness->n, .d = thickness->d },
+		.y = { .n = thickness->n, .d = thickness->d },
+	};
+	const struct scale radius_scale = {
+		.x = { .n = radius->n, .d = radius->d },
+		.y = { .n = radius->n, .d = radius->d },
+	};
+	transform_vector(&d, &canvas.size, &thickness_scale, &vzero);
+	transform_vector(&r, &canvas.size, &radius_scale, &vzero);
+	const uint8_t has_thickness = d.x > 0 && d.y > 0;
+
+	if (has_thickness) {
+		for (p.y = top_left.y; p.y < top_left.y + d.y; p.y++)
+			for (p.x = top_left.x + r.x; p.x < t.x - r.x; p.x++)
+				ref_set_pixel(&p, color);
+		for (p.y = t.y - d.y; p.y < t.y; p.y++)
+			for (p.x = top_left.x + r.x; p.x < t.x - r.x; p.x++)
+				ref_set_pixel(&p, color);
+		for (p.y = top_left.y + r.y; p.y < t.y - r.y; p.y++) {
+			for (p.x = top_left.x; p.x < top_left.x + d.x; p.x++)
+				ref_set_pixel(&p, color);
+			for (p.x = t.x - d.x; p.x < t.x; p.x++)
+				ref_set_pixel(&p, color);
+		}
+		s.x = r.x - d.x;
+		s.y = r.y - d.y;
+	} else {
+		for (p.y = top_left.y; p.y < t.y; p.y++) {
+			if (p.y >= top_left.y + r.y && p.y < t.y - r.y) {
+				x_begin = top_left.x;
+				x_end = t.x;
+			} else {
+				x_begin = top_left.x + r.x;
+				x_end = t.x - r.x;
+			}
+			for (p.x = x_begin; p.x < x_end; p.x++)
+				ref_set_pixel(&p, color);
+		}
+		s.x = 0;
+		s.y = 0;
+	}
+
+	const uint64_t rrx = (uint64_t)r.x * r.x, rry = (uint64_t)r.y * r.y;
+	const uint64_t ssx = (uint64_t)s.x * s.x, ssy = (uint64_t)s.y * s.y;
+	x_begin = 0;
+	x_end = 0;
+	for (y = r.y - 1; y >= 0; y--) {
+		const uint64_t yy = (uint64_t)y * y;
+
+		while (yy * ssx + x_begin * x_begin * ssy < ssx * ssy)
+			x_begin++;
+		for (x = x_begin; x < x_end || yy * rrx + x * x * rry < rrx * rry; x++) {
+			p.y = top_left.y + r.y - 1 - y;
+			p.x = top_left.x + r.x - 1 - x;
+			ref_set_pixel(&p, color);
+			p.x = t.x - r.x + x;
+			ref_set_pixel(&p, color);
+			p.y = t.y - r.y + y;
+			ref_set_pixel(&p, color);
+			p.x = top_left.x + r.x - 1 - x;
+			ref_set_pixel(&p, color);
+		}
+		x_end = x;
+	}
+}
+
+/* Only vertical lines are part of the scene. */
+static void ref_draw_line(const struct scale *pos1, const struct scale *pos2,
+			  const struct fraction *thickness, const struct rgb_color *rgb)
+{
+	struct fraction len;
+	struct vector top_left, size, t;
+
+	transform_vector(&top_left, &canvas.size, pos1, &canvas.offset);
+	subtract_fractions(&len, &pos2->y, &pos1->y);
+	const struct scale dim = {
+		.x = { .n = thickness->n, .d = thickness->d },
+		.y = { .n = len.n, .d = len.d },
+	};
+	transform_vector(&size, &canvas.size, &dim, &vzero);
+	size.x = MAX(size.x, 1);
+	add_vectors(&t, &top_left, &size);
+	ref_fill(&top_left, &t, calculate_color(rgb, 0));
+}
+
+static void ref_draw_bitmap_v3(const struct vector *top_left, const struct vector *dim,
+			       const struct vector *dim_org,
+			       const struct bitmap_header_v3 *header,
+			       const struct bitmap_palette_element_v3 *pal,
+			       const uint8_t *pixel_array, uint8_t invert)
+{
+	const int32_t y_stride = ROUNDUP(dim_org->width, 4);
+	int32_t dir, ox, oy, ix, iy;
+	int sx, sy;
+	struct vector p;
+
+	p.y = top_left->y;
+	if (header->height < 0) {
+		dir = 1;
+	} else {
+		p.y += dim->height - 1;
+		dir = -1;
+	}
+
+	if (dim_org->width == dim->width && dim_org->height == dim->height) {
+		for (oy = 0; oy < dim->height; oy++, p.y += dir) {
+			p.x = top_left->x;
+			for (ox = 0; ox < dim->width; ox++, p.x++) {
+				struct rgb_color rgb;
+				assert_int_equal(CBGFX_SUCCESS,
+						 pal_to_rgb(pixel_array[oy * y_stride + ox],
+							    pal, header->colors_used, &rgb));
+				ref_set_pixel(&p, calculate_color(&rgb, invert));
+			}
+		}
+		return;
+	}
+
+	fpmath_t weight_x[SCREEN_WIDTH][SSZ];
+	assert_true(dim->width <= SCREEN_WIDTH);
+	for (ox = 0; ox < dim->width; ox++) {
+		for (sx = 0; sx < SSZ; sx++) {
+			fpmath_t ixfp = fpfrac(ox * dim_org->width, dim->width);
+			weight_x[ox][sx] = lanczos_weight(ixfp, sx);
+		}
+	}
+
+	const uint8_t *ypix[SSZ];
+	for (sy = 0; sy < SSZ; sy++) {
+		if (sy <= S0)
+			ypix[sy] = pixel_array;
+		else if (sy - S0 >= dim_org->height)
+			ypix[sy] = ypix[sy - 1];
+		else
+			ypix[sy] = &pixel_array[y_stride * (sy - S0)];
+	}
+
+	iy = 0;
+	for (oy = 0; oy < dim->height; oy++, p.y += dir) {
+		struct rgb_color sample[SSZ][SSZ];
+		fpmath_t iyfp = fpfrac(oy * dim_org->height, dim->height);
+		fpmath_t weight_y[SSZ];
+		for (sy = 0; sy < SSZ; sy++)
+			weight_y[sy] = lanczos_weight(iyfp, sy);
+
+		while (fpfloor(iyfp) > iy) {
+			iy++;
+			for (sy = 0; sy < SSZ - 1; sy++)
+				ypix[sy] = ypix[sy + 1];
+			if (iy + LNCZ_A < dim_org->height)
+				ypix[SSZ - 1] = &pixel_array[y_stride * (iy + LNCZ_A)];
+		}
+
+		int equals = 0;
+		uint8_t last_equal = ypix[0][0];
+		for (sx = 0; sx < SSZ; sx++) {
+			for (sy = 0; sy < SSZ; sy++) {
+				if (sx - S0 >= dim_org->width) {
+					sample[sx][sy] = sample[sx - 1][sy];
+					equals++;
+					continue;
+				}
+				uint8_t i = ypix[sy][MAX(0, sx - S0)];
+				pal_to_rgb(i, pal, header->colors_used, &sample[sx][sy]);
+				if (i == last_equal) {
+					equals++;
+				} else {
+					last_equal = i;
+					equals = 1;
+				}
+			}
+		}
+
+		ix = 0;
+		p.x = top_left->x;
+		for (ox = 0; ox < dim->width; ox++, p.x++) {
+			fpmath_t ixfp = fpfrac(ox * dim_org->width, dim->width);
+			while (fpfloor(ixfp) > ix) {
+				ix++;
+				int rx = (SSZ - 1 + ix) % SSZ;
+				for (sy = 0; sy < SSZ; sy++) {
+					if (ix + LNCZ_A >= dim_org->width) {
+						sample[rx][sy] = sample[(SSZ - 2 + ix) % SSZ][sy];
+						equals++;
+						continue;
+					}
+					uint8_t i = ypix[sy][ix + LNCZ_A];
+					if (i == last_equal) {
+						if (equals++ >= (SSZ * SSZ))
+							continue;
+					} else {
+						last_equal = i;
+						equals = 1;
+					}
+					pal_to_rgb(i, pal, header->colors_used, &sample[rx][sy]);
+				}
+			}
+
+			if (equals >= (SSZ * SSZ)) {
+				ref_set_pixel(&p, calculate_color(&sample[0][0], invert));
+				continue;
+			}
+
+			fpmath_t red = fp(0);
+			fpmath_t green = fp(0);
+			fpmath_t blue = fp(0);
+			for (sy = 0; sy < SSZ; sy++) {
+				for (sx = 0; sx < SSZ; sx++) {
+					int rx = (sx + ix) % SSZ;
+					fpmath_t weight = fpmul(weight_x[ox][sx], weight_y[sy]);
+					red = fpadd(red, fpmuli(weight, sample[rx][sy].red));
+					green = fpadd(green, fpmuli(weight, sample[rx][sy].green));
+					blue = fpadd(blue, fpmuli(weight, sample[rx][sy].blue));
+				}
+			}
+
+			struct rgb_color rgb = {
+				.red = MAX(0, MIN(UINT8_MAX, fpround(red))),
+				.green = MAX(0, MIN(UINT8_MAX, fpround(green))),
+				.blue = MAX(0, MIN(UINT8_MAX, fpround(blue))),
+			};
+			ref_set_pixel(&p, calculate_color(&rgb, invert));
+		}
+	}
+}
+
+static void ref_draw_bitmap(const struct scale *pos_rel, const struct scale *dim_rel,
+			    uint32_t flags)
+{
+	struct bitmap_header_v3 header;
+	const struct bitmap_palette_element_v3 *palette;
+	const uint8_t *pixel_array;
+	struct vector top_left, dim, dim_org;
+
+	assert_int_equal(CBGFX_SUCCESS,
+			 parse_bitmap_header_v3((const uint8_t *)&bitmap, sizeof(bitmap),
+						&header, &palette, &pixel_array, &dim_org));
+	assert_int_equal(CBGFX_SUCCESS, calculate_dimension(&dim_org, dim_rel, &dim));
+	assert_int_equal(CBGFX_SUCCESS,
+			 calculate_position(&dim, pos_rel, flags & PIVOT_MASK, &top_left));
+	ref_draw_bitmap_v3(&top_left, &dim, &dim_org, &header, palette, pixel_array,
+			   (flags & INVERT_COLORS) >> INVERT_SHIFT);
+}
+
+static void ref_draw_bitmap_direct(const struct vector *top_left)
+{
+	struct bitmap_header_v3 header;
+	const struct bitmap_palette_element_v3 *palette;
+	const uint8_t *pixel_array;
+	struct vector dim;
+
+	assert_int_equal(CBGFX_SUCCESS,
+			 parse_bitmap_header_v3((const uint8_t *)&bitmap, sizeof(bitmap),
+						&header, &palette, &pixel_array, &dim));
+	ref_draw_bitmap_v3(top_left, &dim, &dim, &header, palette, pixel_array, 0);
+}
+
+/* The scene exercises every primitive that draws to the framebuffer. */
+static const struct rgb_color white = { 0xff, 0xff, 0xff };
+static const struct rgb_color gray = { 0x80, 0x80, 0x80 };
+static const struct rgb_color orange = { 0xff, 0x80, 0x00 };
+static const struct rect box = {
+	.offset = { .x = CANVAS_SCALE / 8, .y = CANVAS_SCALE / 4 },
+	.size = { .x = CANVAS_SCALE / 2, .y = CANVAS_SCALE / 3 },
+};
+static const struct scale pos = {
+	.x = { .n = 1, .d = 16 }, .y = { .n = 1, .d = 2 },
+};
+static const struct scale dim = {
+	.x = { .n = 7, .d = 8 }, .y = { .n = 7, .d = 16 },
+};
+static const struct scale line_start = {
+	.x = { .n = 1, .d = 8 }, .y = { .n = 1, .d = 32 },
+};
+static const struct scale line_end = {
+	.x = { .n = 1, .d = 8 }, .y = { .n = 7, .d = 8 },
+};
+static const struct scale bitmap_pos = {
+	.x = { .n = 1, .d = 2 }, .y = { .n = 1, .d = 8 },
+};
+static const struct scale bitmap_pos2 = {
+	.x = { .n = 1, .d = 2 }, .y = { .n = 7, .d = 8 },
+};
+static const struct scale bitmap_dim = {
+	.x = { .n = 3, .d = 8 }, .y = { .n = 0, .d = 1 },
+};
+static const struct fraction thickness = { .n = 1, .d = 16 };
+static const struct fraction radius = { .n = 1, .d = 8 };
+static const struct fraction no_thickness = { .n = 0, .d = 1 };
+static const struct vector bitmap_direct = { .x = 1, .y = 2 };
+
+static void draw_scene(void)
+{
+	assert_int_equal(CBGFX_SUCCESS, clear_screen(&gray));
+	assert_int_equal(CBGFX_SUCCESS, draw_box(&box, &white));
+	assert_int_equal(CBGFX_SUCCESS, draw_rounded_box(&pos, &dim, &orange,
+							 &no_thickness, &radius));
+	assert_int_equal(CBGFX_SUCCESS, draw_rounded_box(&pos, &dim, &white,
+							 &thickness, &radius));
+	assert_int_equal(CBGFX_SUCCESS, draw_line(&line_start, &line_end,
+						  &thickness, &orange));
+	assert_int_equal(CBGFX_SUCCESS, draw_bitmap_direct(&bitmap, sizeof(bitmap),
+							   &bitmap_direct));
+	assert_int_equal(CBGFX_SUCCESS, draw_bitmap(&bitmap, sizeof(bitmap), &bitmap_pos,
+						    &bitmap_dim, PIVOT_H_LEFT | PIVOT_V_TOP));
+	assert_int_equal(CBGFX_SUCCESS, draw_bitmap(&bitmap, sizeof(bitmap), &bitmap_pos2,
+						    &bitmap_dim,
+						    PIVOT_H_LEFT | PIVOT_V_BOTTOM |
+						    INVERT_COLORS));
+}
+
+static void draw_reference_scene(void)
+{
+	ref_clear_screen(&gray);
+	ref_draw_box(&box, &white);
+	ref_draw_rounded_box(&pos, &dim, &orange, &no_thickness, &radius);
+	ref_draw_rounded_box(&pos, &dim, &white, &thickness, &radius);
+	ref_draw_line(&line_start, &line_end, &thickness, &orange);
+	ref_draw_bitmap_direct(&bitmap_direct);
+	ref_draw_bitmap(&bitmap_pos, &bitmap_dim, PIVOT_H_LEFT | PIVOT_V_TOP);
+	ref_draw_bitmap(&bitmap_pos2, &bitmap_dim,
+			PIVOT_H_LEFT | PIVOT_V_BOTTOM | INVERT_COLORS);
+}
+
+static int setup_reference(void **state)
+{
+	int x, y;
+
+	setup_bitmap();
+	setup_fb(32, CB_FB_ORIENTATION_NORMAL);
+	draw_scene();
+	draw_reference_scene();
+	for (y = 0; y < SCREEN_HEIGHT; y++)
+		for (x = 0; x < SCREEN_WIDTH; x++)
+			reference[y][x] = get_pixel(ref_mem, x, y);
+	return 0;
+}
+
+static void test_reference(void **state)
+{
+	int x, y;
+
+	/* Outside of the canvas, only clear_screen() draws. */
+	for (y = 0; y < SCREEN_HEIGHT; y++)
+		assert_int_equal(0x808080, reference[y][0]);
+	assert_int_equal(0x808080, reference[SCREEN_HEIGHT - 1][SCREEN_WIDTH - 1]);
+
+	/* The 1:1 bitmap is stored bottom to top. */
+	for (y = 0; y < 4; y++) {
+		for (x = 0; x < 6; x++) {
+			const struct bitmap_palette_element_v3 *const c =
+				&bitmap_palette[bitmap_pixels[3 - y][x]];
+			assert_int_equal(c->red << 16 | c->green << 8 | c->blue,
+					 reference[2 + y][1 + x]);
+		}
+	}
+	assert_int_equal(0x123456, reference[3][1]);
+}
+
+static void test_formats(void **state)
+{
+	const int bpps[] = { 8, 16, 24, 32 };
+	const int orientations[] = {
+		CB_FB_ORIENTATION_NORMAL,
+		CB_FB_ORIENTATION_BOTTOM_UP,
+		CB_FB_ORIENTATION_LEFT_UP,
+		CB_FB_ORIENTATION_RIGHT_UP,
+	};
+	int i, j;
+
+	/* Whole framebuffers are compared, so the line padding is checked too. */
+	for (i = 0; i < ARRAY_SIZE(bpps); i++) {
+		for (j = 0; j < ARRAY_SIZE(orientations); j++) {
+			setup_fb(bpps[i], orientations[j]);
+			draw_scene();
+			draw_reference_scene();
+			assert_memory_equal(ref_mem, fb_mem, FB_SIZE);
+		}
+	}
+}
+
+static size_t flushed;
+
+static void count_flushed(size_t bytes)
+{
+	flushed = bytes;
+}
+
+static void test_graphics_buffer(void **state)
+{
+	const struct rect small_box = {
+		.offset = { .x = CANVAS_SCALE / 4, .y = CANVAS_SCALE / 4 },
+		.size = { .x = CANVAS_SCALE / 2, .y = CANVAS_SCALE / 4 },
+	};
+	const int orientations[] = {
+		CB_FB_ORIENTATION_NORMAL,
+		CB_FB_ORIENTATION_LEFT_UP,
+	};
+	int i, x, y;
+
+	set_graphics_buffer_flush_hook(count_flushed);
+	for (i = 0; i < ARRAY_SIZE(orientations); i++) {
+		setup_fb(32, orientations[i]);
+		assert_int_equal(CBGFX_SUCCESS, enable_graphics_buffer());
+		assert_int_equal(CBGFX_SUCCESS, flush_graphics_buffer());
+		assert_int_equal(0, flushed);
+
+		/* Nothing shows up before the flush. */
+		draw_scene();
+		for (x = 0; x < sizeof(fb_mem); x++)
+			assert_int_equal(0, fb_mem[x]);
+		assert_int_equal(CBGFX_SUCCESS, flush_graphics_buffer());
+		assert_int_equal(SCREEN_WIDTH * SCREEN_HEIGHT * 4, flushed);
+		for (y = 0; y < SCREEN_HEIGHT; y++)
+			for (x = 0; x < SCREEN_WIDTH; x++)
+				assert_int_equal(reference[y][x], get_pixel(fb_mem, x, y));
+
+		/* Only the box is copied to the screen. */
+		memset(fb_mem, 0, sizeof(fb_mem));
+		assert_int_equal(CBGFX_SUCCESS, draw_box(&small_box, &white));
+		assert_int_equal(CBGFX_SUCCESS, flush_graphics_buffer());
+		assert_int_equal(16 * 8 * 4, flushed);
+		for (y = 0; y < SCREEN_HEIGHT; y++) {
+			for (x = 0; x < SCREEN_WIDTH; x++) {
+				if (x >= 16 && x < 32 && y >= 8 && y < 16)
+					assert_int_equal(0xffffff, get_pixel(fb_mem, x, y));
+				else
+					assert_int_equal(0, get_pixel(fb_mem, x, y));
+			}
+		}
+		assert_int_equal(CBGFX_SUCCESS, flush_graphics_buffer());
+		assert_int_equal(0, flushed);
+
+		disable_graphics_buffer();
+	}
+	set_graphics_buffer_flush_hook(NULL);
+}
+
+static void test_out_of_palette(void **state)
+{
+	const struct vector top_left = { .x = 0, .y = 0 };
+
+	setup_fb(32, CB_FB_ORIENTATION_NORMAL);
+	bitmap.pixels[5] = ARRAY_SIZE(bitmap_palette);
+	assert_int_equal(CBGFX_ERROR_BITMAP_DATA,
+			 draw_bitmap_direct(&bitmap, sizeof(bitmap), &top_left));
+	setup_bitmap();
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_reference),
+		cmocka_unit_test(test_formats),
+		cmocka_unit_test(test_graphics_buffer),
+		cmocka_unit_test(test_out_of_palette),
+	};
+
+	return lp_run_group_tests(tests, setup_reference, NULL);
+}
@@ -1,3 +1,7 @@
 tests-y += fmap_locate_area-test
 
 fmap_locate_area-test-srcs += tests/libc/fmap_locate_area-test.c
+
+tests-y += malloc-test
+
+malloc-test-srcs += tests/libc/malloc-test.c
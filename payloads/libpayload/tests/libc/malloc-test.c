@@ -0,0 +1,306 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+/* Keep the host allocator for cmocka and the C library. */
+#define free lp_free
+#define malloc lp_malloc
+#define calloc lp_calloc
+#define realloc lp_realloc
+#define memalign lp_memalign
+#define dma_malloc lp_dma_malloc
+#define dma_memalign lp_dma_memalign
+
+#include "../libc/malloc.c"
+
+#include <libpayload.h>
+#include <tests/test.h>
+#include <time.h>
+
+#define HEAP_SIZE	(1 * MiB)
+#define DMA_SIZE	(64 * KiB)
+#define STRESS_SLOTS	512
+#define STRESS_ROUNDS	200000
+
+/* Point the ldscript heap symbols at a buffer. */
+#define TEST_HEAP(size) uint8_t test_heap[size] __aligned(16);                                 \
+	TEST_SYMBOL(_heap, test_heap);                                                         \
+	TEST_SYMBOL(_eheap, test_heap + size)
+
+TEST_HEAP(HEAP_SIZE);
+
+static uint8_t test_dma[DMA_SIZE] __aligned(16);
+
+/* Mocks */
+void halt(void)
+{
+	fail_msg("The allocator found a corrupted heap");
+
+	/* Should never be reached */
+	while (1)
+		;
+}
+
+static int setup_malloc(void **state)
+{
+	default_type.initialized = 0;
+	dma = heap;
+	return 0;
+}
+
+/* Walk the blocks and check that all of the memory is free in one block. */
+static void assert_all_free(struct memory_type *type)
+{
+	hdrtype_t *block = (void *)ALIGN_UP((uintptr_t)type->start, HDRSIZE);
+	size_t size = ALIGN_DOWN((uintptr_t)type->end, HDRSIZE) - (uintptr_t)block;
+
+	assert_true(IS_FREE(*block));
+	assert_int_equal(size - 2 * HDRSIZE, SIZE(*block));
+	assert_int_equal(USED_BLOCK(0) | FLAG_PREV_FREE, *next_block(block));
+	assert_ptr_equal(block, type->bins[bin_index(SIZE(*block))]);
+}
+
+/* Walk the blocks and check the headers, footers and bins agree. */
+static void assert_consistent(struct memory_type *type)
+{
+	hdrtype_t *block = (void *)ALIGN_UP((uintptr_t)type->start, HDRSIZE);
+	size_t free_blocks = 0, binned = 0;
+	bool prev_free = false;
+	struct free_block *b;
+
+	while (SIZE(*block)) {
+		assert_true(HAS_MAGIC(*block));
+		assert_int_equal(prev_free, !!(*block & FLAG_PREV_FREE));
+		prev_free = *block & FLAG_FREE;
+		if (prev_free) {
+			free_blocks++;
+			assert_int_equal(SIZE(*block), *(hdrtype_t *)((void *)block + SIZE(*block)));
+		}
+		block = next_block(block);
+		assert_true((void *)block < type->end);
+	}
+
+	for (size_t i = 0; i < NBINS; i++) {
+		assert_int_equal(!!type->bins[i], !!(type->bitmap[i / 64] & (1ULL << (i % 64))));
+		for (b = type->bins[i]; b; b = b->next) {
+			assert_true(IS_FREE(b->header));
+			assert_int_equal(i, bin_index(SIZE(b->header)));
+			binned++;
+		}
+	}
+
+	assert_int_equal(free_blocks, binned);
+}
+
+static void test_malloc_small(void **state)
+{
+	void *a, *b, *c;
+
+	assert_null(malloc(0));
+	assert_null(malloc(HEAP_SIZE));
+
+	a = malloc(1);
+	b = malloc(24);
+	c = malloc(100);
+	assert_non_null(a);
+	assert_non_null(b);
+	assert_non_null(c);
+	assert_int_equal(0, (uintptr_t)a % HDRSIZE);
+	assert_true(b >= a + MIN_SIZE);
+
+	/* A freed small block is reused right away. */
+	free(b);
+	assert_ptr_equal(b, malloc(17));
+	assert_consistent(heap);
+
+	free(a);
+	free(c);
+	free(b);
+	assert_all_free(heap);
+}
+
+static void test_malloc_coalesce(void **state)
+{
+	void *p[8];
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(p); i++)
+		p[i] = malloc(1000 * (i + 1));
+
+	/* Free every other block, then the rest to merge with both neighbours. */
+	for (i = 0; i < ARRAY_SIZE(p); i += 2)
+		free(p[i]);
+	assert_consistent(heap);
+	for (i = 1; i < ARRAY_SIZE(p); i += 2)
+		free(p[i]);
+	assert_all_free(heap);
+
+	/* A double free or a foreign pointer is ignored. */
+	p[0] = malloc(64);
+	free(p[0]);
+	free(p[0]);
+	free(test_dma);
+	assert_all_free(heap);
+}
+
+static void test_memalign(void **state)
+{
+	const size_t aligns[] = { 1, 8, 16, 64, 512, 4096, 65536 };
+	void *p[ARRAY_SIZE(aligns)];
+	size_t i;
+
+	assert_null(memalign(24, 64));
+	assert_null(memalign(64, 0));
+
+	for (i = 0; i < ARRAY_SIZE(aligns); i++) {
+		p[i] = memalign(aligns[i], 100 + i);
+		assert_non_null(p[i]);
+		assert_int_equal(0, (uintptr_t)p[i] % aligns[i]);
+		memset(p[i], 0xa5, 100 + i);
+		assert_consistent(heap);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(aligns); i++)
+		free(p[i]);
+	assert_all_free(heap);
+}
+
+static void test_realloc(void **state)
+{
+	uint8_t *p, *q, *blocker;
+	size_t i;
+
+	p = realloc(NULL, 100);
+	for (i = 0; i < 100; i++)
+		p[i] = i;
+
+	/* Growing into the free space that follows keeps the pointer. */
+	q = realloc(p, 1000);
+	assert_ptr_equal(p, q);
+	q = realloc(q, 50);
+	assert_ptr_equal(p, q);
+
+	/* Growing past a used block moves the data. */
+	blocker = malloc(16);
+	q = realloc(p, 2000);
+	assert_ptr_not_equal(p, q);
+	for (i = 0; i < 50; i++)
+		assert_int_equal(i, q[i]);
+	assert_consistent(heap);
+
+	assert_null(realloc(q, 0));
+	free(blocker);
+	assert_all_free(heap);
+}
+
+static void test_dma_arena(void **state)
+{
+	void *start, *p, *q;
+	size_t size;
+
+	assert_false(dma_initialized());
+	dma_allocator_range(&start, &size);
+	assert_null(start);
+	assert_int_equal(0, size);
+
+	init_dma_memory(test_dma, DMA_SIZE);
+	assert_true(dma_initialized());
+	dma_allocator_range(&start, &size);
+	assert_ptr_equal(test_dma, start);
+	assert_int_equal(DMA_SIZE, size);
+
+	p = dma_malloc(100);
+	q = dma_memalign(4096, 4096);
+	assert_true(dma_coherent(p));
+	assert_true(dma_coherent(q));
+	assert_int_equal(0, (uintptr_t)q % 4096);
+	assert_null(dma_malloc(DMA_SIZE));
+
+	/* Regular allocations stay out of the DMA arena. */
+	assert_false(dma_coherent(malloc(100)));
+
+	free(p);
+	free(q);
+	assert_all_free(dma);
+}
+
+static uint32_t lcg(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static size_t random_size(uint32_t *seed)
+{
+	uint32_t r = lcg(seed);
+
+	/* Mostly small objects, like the drivers and the payloads allocate. */
+	if (r % 16)
+		return 1 + r / 16 % 256;
+	return 1 + r / 16 % (16 * KiB);
+}
+
+static void test_malloc_stress(void **state)
+{
+	struct {
+		uint8_t *ptr;
+		size_t size;
+	} slots[STRESS_SLOTS] = { 0 };
+	struct timeval start, end;
+	uint32_t seed = 1, r;
+	size_t i, j, ops = 0;
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < STRESS_ROUNDS; i++) {
+		r = lcg(&seed);
+		j = r % STRESS_SLOTS;
+
+		if (slots[j].ptr) {
+			/* Every block still holds the pattern written when it was allocated. */
+			assert_int_equal((uint8_t)j, slots[j].ptr[0]);
+			assert_int_equal((uint8_t)j, slots[j].ptr[slots[j].size - 1]);
+			if (r / STRESS_SLOTS % 4 == 0) {
+				slots[j].size = random_size(&seed);
+				slots[j].ptr = realloc(slots[j].ptr, slots[j].size);
+			} else {
+				free(slots[j].ptr);
+				slots[j].ptr = NULL;
+				ops++;
+				continue;
+			}
+		} else {
+			slots[j].size = random_size(&seed);
+			if (r / STRESS_SLOTS % 8 == 0)
+				slots[j].ptr = memalign(64 << (r % 4), slots[j].size);
+			else
+				slots[j].ptr = malloc(slots[j].size);
+		}
+
+		assert_non_null(slots[j].ptr);
+		slots[j].ptr[0] = j;
+		slots[j].ptr[slots[j].size - 1] = j;
+		ops++;
+	}
+
+	gettimeofday(&end, NULL);
+	print_message("%zu allocator operations in %ld us\n", ops,
+		      (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec);
+
+	assert_consistent(heap);
+	for (j = 0; j < STRESS_SLOTS; j++)
+		free(slots[j].ptr);
+	assert_all_free(heap);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup(test_malloc_small, setup_malloc),
+		cmocka_unit_test_setup(test_malloc_coalesce, setup_malloc),
+		cmocka_unit_test_setup(test_memalign, setup_malloc),
+		cmocka_unit_test_setup(test_realloc, setup_malloc),
+		cmocka_unit_test_setup(test_dma_arena, setup_malloc),
+		cmocka_unit_test_setup(test_malloc_stress, setup_malloc),
+	};
+
+	return lp_run_group_tests(tests, NULL, NULL);
+}
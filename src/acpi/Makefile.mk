@@ -3,6 +3,7 @@
 ifeq ($(CONFIG_HAVE_ACPI_TABLES),y)
 
 ramstage-y += acpi.c
+ramstage-$(CONFIG_ACPI_TABLE_CACHE) += acpi_cache.c
 ifeq ($(CONFIG_ARCH_RAMSTAGE_X86_32)$(CONFIG_ARCH_RAMSTAGE_X86_64),y)
 ramstage-y += acpi_apic.c
 ramstage-y += acpi_dmar.c
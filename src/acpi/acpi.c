@@ -1545,6 +1545,15 @@ unsigned long write_acpi_tables(const unsigned long start)
 		return fw;
 	}
 
+	if (CONFIG(ACPI_TABLE_CACHE)) {
+		uintptr_t cached_rsdp;
+		unsigned long end = acpi_cache_restore(current, &cached_rsdp);
+		if (end) {
+			coreboot_rsdp = cached_rsdp;
+			return end;
+		}
+	}
+
 	dsdt_file = cbfs_map(CONFIG_CBFS_PREFIX "/dsdt.aml", &dsdt_size);
 	if (!dsdt_file) {
 		printk(BIOS_ERR, "No DSDT file, skipping ACPI tables\n");
@@ -1630,12 +1639,7 @@ unsigned long write_acpi_tables(const unsigned long start)
 		acpi_add_table(rsdp, header);
 	}
 
-	/*
-	 * cbfs_unmap() uses mem_pool_free() which works correctly only
-	 * if freeing is done in reverse order than memory allocation.
-	 * This is why unmapping of dsdt_file must be done after
-	 * unmapping slic file.
-	 */
+	/* Unmap in reverse order of mapping to keep the cbfs_cache compact. */
 	cbfs_unmap(slic_file);
 	cbfs_unmap(dsdt_file);
 
@@ -1651,6 +1655,9 @@ unsigned long write_acpi_tables(const unsigned long start)
 
 	printk(BIOS_INFO, "ACPI: done.\n");
 
+	if (CONFIG(ACPI_TABLE_CACHE))
+		acpi_cache_save(start, current, coreboot_rsdp);
+
 	if (CONFIG(DEBUG_ACPICA_COMPATIBLE)) {
 		printk(BIOS_DEBUG, "Printing ACPI tables in ACPICA compatible format\n");
 		if (facs)
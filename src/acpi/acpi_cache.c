@@ -0,0 +1,252 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <acpi/acpi.h>
+#include <cbmem.h>
+#include <commonlib/region.h>
+#include <console/console.h>
+#include <device/device.h>
+#include <fmap.h>
+#include <fw_config.h>
+#include <region_file.h>
+#include <string.h>
+#include <types.h>
+#include <version.h>
+#include <xxhash.h>
+
+#define ACPI_CACHE_REGION	"RW_ACPI_CACHE"
+#define ACPI_CACHE_SIGNATURE	(('A' << 0) | ('C' << 8) | ('P' << 16) | ('c' << 24))
+
+/*
+ * The tables are only valid at the address they were generated for, so the
+ * cache holds a single copy of them, preceded by this header and followed by
+ * the GNVS and DNVS OpRegions.
+ */
+struct acpi_cache_header {
+	uint32_t signature;
+	uint32_t size;
+	uint32_t nvs_size;
+	uint32_t reserved;
+	uint64_t key;
+	uint64_t addr;
+	uint64_t rsdp;
+	uint64_t data_hash;
+} __packed;
+
+/* The key of the current boot, set by acpi_cache_restore(). */
+static struct {
+	bool valid;
+	uint64_t key;
+	void *cbmem_base;
+	size_t cbmem_size;
+} current;
+
+static void hash_u64(struct xxh64_state *state, uint64_t value)
+{
+	xxh64_update(state, &value, sizeof(value));
+}
+
+static void hash_device(struct xxh64_state *state, const struct device *dev)
+{
+	const struct resource *res;
+
+	xxh64_update(state, &dev->path, sizeof(dev->path));
+	hash_u64(state, dev->enabled | dev->hidden << 1);
+	hash_u64(state, (uint64_t)dev->vendor << 32 | dev->device);
+	hash_u64(state, (uint64_t)dev->subsystem_vendor << 16 | dev->subsystem_device);
+	hash_u64(state, dev->class);
+	hash_u64(state, (uintptr_t)dev->ops);
+	hash_u64(state, (uintptr_t)dev->chip_info);
+
+	if (dev->downstream)
+		hash_u64(state, dev->downstream->secondary | dev->downstream->subordinate << 16);
+
+	for (res = dev->resource_list; res; res = res->next) {
+		hash_u64(state, res->index);
+		hash_u64(state, res->flags);
+		hash_u64(state, res->base);
+		hash_u64(state, res->size);
+	}
+}
+
+/*
+ * Everything the generated tables depend on: the firmware build, where they
+ * are placed, the CBMEM layout that other addresses in them come from and the
+ * hardware configuration. Devices cover CPU topology (one device per APIC ID
+ * and its CPUID signature) and which PCI devices are enabled, with their
+ * resources.
+ */
+static uint64_t acpi_cache_key(unsigned long addr, void *cbmem_base, size_t cbmem_size)
+{
+	struct xxh64_state state;
+	const struct device *dev;
+
+	xxh64_reset(&state, 0);
+
+	hash_u64(&state, coreboot_build_hash());
+	hash_u64(&state, addr);
+	hash_u64(&state, (uintptr_t)cbmem_base);
+	hash_u64(&state, cbmem_size);
+
+	if (CONFIG(FW_CONFIG))
+		hash_u64(&state, fw_config_get());
+
+	for (dev = all_devices; dev; dev = dev->next)
+		hash_device(&state, dev);
+
+	return xxh64_digest(&state);
+}
+
+/*
+ * Generators also store values in GNVS and DNVS, e.g. the location of the NHLT
+ * table, so both OpRegions are cached along with the tables.
+ */
+static void *acpi_cache_nvs(size_t *size)
+{
+	const struct cbmem_entry *entry;
+
+	*size = 0;
+	if (!CONFIG(ACPI_SOC_NVS))
+		return NULL;
+
+	entry = cbmem_entry_find(CBMEM_ID_ACPI_GNVS);
+	if (!entry)
+		return NULL;
+
+	*size = cbmem_entry_size(entry);
+	return cbmem_entry_start(entry);
+}
+
+static int acpi_cache_open(struct region_file *file, struct region_device *rdev)
+{
+	if (fmap_locate_area_as_rdev_rw(ACPI_CACHE_REGION, rdev) < 0) {
+		printk(BIOS_WARNING, "ACPI: Unable to find %s in FMAP\n", ACPI_CACHE_REGION);
+		return -1;
+	}
+
+	if (region_file_init(file, rdev) < 0) {
+		printk(BIOS_ERR, "ACPI: Unable to open table cache\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+unsigned long acpi_cache_restore(unsigned long addr, uintptr_t *rsdp)
+{
+	struct region_device rdev, data;
+	struct region_file file;
+	struct acpi_cache_header header;
+	struct xxh64_state state;
+	void *nvs, *cached_nvs = NULL;
+	size_t nvs_size;
+
+	cbmem_get_region(&current.cbmem_base, &current.cbmem_size);
+	current.key = acpi_cache_key(addr, current.cbmem_base, current.cbmem_size);
+	current.valid = true;
+	nvs = acpi_cache_nvs(&nvs_size);
+
+	if (acpi_cache_open(&file, &rdev) < 0)
+		return 0;
+
+	if (region_file_data(&file, &data) < 0 ||
+	    rdev_readat(&data, &header, 0, sizeof(header)) != sizeof(header))
+		return 0;
+
+	if (header.signature != ACPI_CACHE_SIGNATURE || header.key != current.key ||
+	    header.addr != addr || header.size > CONFIG_MAX_ACPI_TABLE_SIZE_KB * KiB ||
+	    header.nvs_size != nvs_size ||
+	    region_device_sz(&data) < sizeof(header) + header.size + nvs_size) {
+		printk(BIOS_DEBUG, "ACPI: No cached tables for this configuration\n");
+		return 0;
+	}
+
+	if (rdev_readat(&data, (void *)addr, sizeof(header), header.size) != header.size)
+		return 0;
+
+	if (nvs_size) {
+		cached_nvs = rdev_mmap(&data, sizeof(header) + header.size, nvs_size);
+		if (!cached_nvs)
+			return 0;
+	}
+
+	xxh64_reset(&state, 0);
+	xxh64_update(&state, (void *)addr, header.size);
+	if (cached_nvs)
+		xxh64_update(&state, cached_nvs, nvs_size);
+	if (xxh64_digest(&state) != header.data_hash) {
+		printk(BIOS_ERR, "ACPI: Cached tables are corrupted\n");
+		if (cached_nvs)
+			rdev_munmap(&data, cached_nvs);
+		return 0;
+	}
+
+	/*
+	 * GNVS gets the values the generators left in it. Whatever SoC and
+	 * mainboard code fill in is refreshed, as it may change between boots.
+	 */
+	if (cached_nvs) {
+		memcpy(nvs, cached_nvs, nvs_size);
+		rdev_munmap(&data, cached_nvs);
+		acpi_update_gnvs();
+	}
+
+	printk(BIOS_INFO, "ACPI: Restored %u bytes of cached tables at %lx.\n",
+	       header.size, addr);
+
+	*rsdp = header.rsdp;
+	return addr + header.size;
+}
+
+void acpi_cache_save(unsigned long addr, unsigned long end, uintptr_t rsdp)
+{
+	struct region_device rdev;
+	struct region_file file;
+	struct xxh64_state state;
+	void *cbmem_base, *nvs;
+	size_t cbmem_size, nvs_size;
+
+	if (!current.valid)
+		return;
+	current.valid = false;
+
+	/*
+	 * CBMEM entries added by the generators, e.g. a TPM log, would be missing
+	 * when the tables are restored, so such tables can't be cached.
+	 */
+	cbmem_get_region(&cbmem_base, &cbmem_size);
+	if (cbmem_base != current.cbmem_base || cbmem_size != current.cbmem_size) {
+		printk(BIOS_INFO, "ACPI: Tables allocated CBMEM, not caching them\n");
+		return;
+	}
+
+	nvs = acpi_cache_nvs(&nvs_size);
+
+	struct acpi_cache_header header = {
+		.signature = ACPI_CACHE_SIGNATURE,
+		.size = end - addr,
+		.nvs_size = nvs_size,
+		.key = current.key,
+		.addr = addr,
+		.rsdp = rsdp,
+	};
+	xxh64_reset(&state, 0);
+	xxh64_update(&state, (void *)addr, header.size);
+	if (nvs)
+		xxh64_update(&state, nvs, nvs_size);
+	header.data_hash = xxh64_digest(&state);
+
+	const struct update_region_file_entry entries[] = {
+		{ .size = sizeof(header), .data = &header },
+		{ .size = header.size, .data = (void *)addr },
+		{ .size = nvs_size, .data = nvs },
+	};
+
+	if (acpi_cache_open(&file, &rdev) < 0)
+		return;
+
+	/* Without GNVS the last entry is empty. */
+	if (region_file_update_data_arr(&file, entries, ARRAY_SIZE(entries) - !nvs) < 0)
+		printk(BIOS_ERR, "ACPI: Failed to update the table cache\n");
+	else
+		printk(BIOS_DEBUG, "ACPI: Cached %u bytes of tables\n", header.size);
+}
@@ -58,6 +58,16 @@ __weak void soc_fill_gnvs(struct global_nvs *gnvs_) { }
 __weak void mainboard_fill_gnvs(struct global_nvs *gnvs_) { }
 __weak size_t size_of_dnvs(void) { return 0; }
 
+/* Also called on its own when the ACPI tables are restored from the cache. */
+void acpi_update_gnvs(void)
+{
+	if (!gnvs)
+		return;
+
+	soc_fill_gnvs(gnvs);
+	mainboard_fill_gnvs(gnvs);
+}
+
 /* Called from write_acpi_tables() only on normal boot path. */
 void acpi_fill_gnvs(void)
 {
@@ -69,8 +79,7 @@ void acpi_fill_gnvs(void)
 	if (!gnvs)
 		return;
 
-	soc_fill_gnvs(gnvs);
-	mainboard_fill_gnvs(gnvs);
+	acpi_update_gnvs();
 
 	acpigen_write_scope("\\");
 	acpigen_write_opregion(&gnvs_op);
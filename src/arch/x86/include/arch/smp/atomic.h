@@ -67,4 +67,20 @@ static __always_inline void atomic_dec(atomic_t *v)
 		: "m" (v->counter));
 }
 
+/**
+ * atomic_fetch_add - add to atomic variable and return the old value
+ * @param i: value to add
+ * @param v: pointer of type atomic_t
+ *
+ * Atomically adds i to v and returns the value v had before.
+ */
+static __always_inline int atomic_fetch_add(int i, atomic_t *v)
+{
+	__asm__ __volatile__(
+		"lock ; xaddl %0, %1"
+		: "+r" (i), "+m" (v->counter)
+		: : "memory");
+	return i;
+}
+
 #endif /* ARCH_SMP_ATOMIC_H */
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#ifndef ARCH_X86_STRING_OPS_H
+#define ARCH_X86_STRING_OPS_H
+
+#include <stdbool.h>
+
+#define X86_STRING_OPS_ERMS	(1 << 0)	/* Enhanced REP MOVSB/STOSB */
+#define X86_STRING_OPS_FSRM	(1 << 1)	/* Fast Short REP MOVSB */
+#define X86_STRING_OPS_NT	(1 << 2)	/* MOVNTI non-temporal stores (SSE2) */
+
+/* Length from which REP MOVSB/STOSB beats word-sized string instructions with ERMS only. */
+#define X86_STRING_OPS_ERMS_THRESHOLD	256
+
+/*
+ * The string features of the CPU. Detected once on first use. Only the ramstage uses them:
+ * earlier stages run from CAR where non-temporal stores must be avoided, and SMM and rmodules
+ * have to stay self-contained.
+ */
+unsigned int x86_string_ops_features(void);
+
+static inline bool x86_string_ops_dispatch(void)
+{
+	return CONFIG(X86_STRING_OPS_DISPATCH) && ENV_RAMSTAGE;
+}
+
+#endif /* ARCH_X86_STRING_OPS_H */
@@ -1,9 +1,70 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 
+#include <arch/string_ops.h>
+#include <commonlib/helpers.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <asan.h>
 
+static void *memcpy_movsb(void *dest, const void *src, size_t n)
+{
+	unsigned long d0, d1, d2;
+
+	asm volatile(
+		"rep ; movsb\n\t"
+		: "=&c" (d0), "=&D" (d1), "=&S" (d2)
+		: "0" (n), "1" (dest), "2" (src)
+		: "memory"
+	);
+
+	return dest;
+}
+
+/*
+ * Copy with non-temporal stores so that large copies don't evict the whole cache. MOVNTI
+ * works on general purpose registers, coreboot doesn't preserve any SSE register state.
+ */
+static void *memcpy_nt(void *dest, const void *src, size_t n)
+{
+	/* The threshold may be configured lower than the alignment head. */
+	const size_t head = MIN(-(uintptr_t)dest % sizeof(unsigned long), n);
+	const size_t block = 4 * sizeof(unsigned long);
+	unsigned long blocks, tmp;
+	void *d = dest + head;
+	const void *s = src + head;
+
+	memcpy_movsb(dest, src, head);
+	n -= head;
+
+	blocks = n / block;
+	if (blocks) {
+		asm volatile(
+			"1:\n\t"
+			"mov 0*%c[w](%[s]), %[t]\n\t"
+			"movnti %[t], 0*%c[w](%[d])\n\t"
+			"mov 1*%c[w](%[s]), %[t]\n\t"
+			"movnti %[t], 1*%c[w](%[d])\n\t"
+			"mov 2*%c[w](%[s]), %[t]\n\t"
+			"movnti %[t], 2*%c[w](%[d])\n\t"
+			"mov 3*%c[w](%[s]), %[t]\n\t"
+			"movnti %[t], 3*%c[w](%[d])\n\t"
+			"add %[b], %[s]\n\t"
+			"add %[b], %[d]\n\t"
+			"dec %[n]\n\t"
+			"jnz 1b\n\t"
+			"sfence\n\t"
+			: [d] "+r" (d), [s] "+r" (s), [n] "+r" (blocks), [t] "=&r" (tmp)
+			: [w] "i" (sizeof(unsigned long)), [b] "i" (block)
+			: "memory"
+		);
+	}
+
+	memcpy_movsb(d, s, n % block);
+
+	return dest;
+}
+
 void *memcpy(void *dest, const void *src, size_t n)
 {
 	unsigned long d0, d1, d2;
@@ -14,6 +75,17 @@ void *memcpy(void *dest, const void *src, size_t n)
 	check_memory_region((unsigned long)dest, n, true, _RET_IP_);
 #endif
 
+	if (x86_string_ops_dispatch()) {
+		const unsigned int features = x86_string_ops_features();
+
+		if (CONFIG_X86_STRING_OPS_NT_THRESHOLD && n >= CONFIG_X86_STRING_OPS_NT_THRESHOLD
+		    && (features & X86_STRING_OPS_NT))
+			return memcpy_nt(dest, src, n);
+		if ((features & X86_STRING_OPS_FSRM) ||
+		    ((features & X86_STRING_OPS_ERMS) && n >= X86_STRING_OPS_ERMS_THRESHOLD))
+			return memcpy_movsb(dest, src, n);
+	}
+
 #if ENV_X86_64
 	asm volatile(
 		"rep ; movsq\n\t"
@@ -3,6 +3,7 @@
  * This file is derived from memcpy_32.c in the Linux kernel.
  */
 
+#include <arch/string_ops.h>
 #include <string.h>
 #include <stdbool.h>
 #include <asan.h>
@@ -18,6 +19,10 @@ void *memmove(void *dest, const void *src, size_t n)
 	check_memory_region((unsigned long)dest, n, true, _RET_IP_);
 #endif
 
+	/* Buffers that don't overlap can take the CPU specific memcpy() paths. */
+	if (x86_string_ops_dispatch() && (dest + n <= src || src + n <= dest))
+		return memcpy(dest, src, n);
+
 	__asm__ __volatile__(
 		/* Handle more 16bytes in loop */
 		"cmp $0x10, %0\n\t"
@@ -2,6 +2,8 @@
 
 /* From glibc-2.14, sysdeps/i386/memset.c */
 
+#include <arch/string_ops.h>
+#include <commonlib/helpers.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -9,6 +11,53 @@
 
 typedef uint32_t op_t;
 
+static void memset_stosb(void *dst, int c, size_t len)
+{
+	unsigned long d0, d1;
+
+	asm volatile(
+		"rep ; stosb\n\t"
+		: "=&c" (d0), "=&D" (d1)
+		: "0" (len), "1" (dst), "a" (c)
+		: "memory"
+	);
+}
+
+/* Fill with non-temporal stores so that clearing large buffers doesn't evict the cache. */
+static void memset_nt(void *dst, int c, size_t len)
+{
+	/* The threshold may be configured lower than the alignment head. */
+	const size_t head = MIN(-(uintptr_t)dst % sizeof(unsigned long), len);
+	const size_t block = 4 * sizeof(unsigned long);
+	unsigned long blocks, x = (unsigned char)c;
+	void *d = dst + head;
+
+	x *= (unsigned long)0x0101010101010101ULL;
+
+	memset_stosb(dst, c, head);
+	len -= head;
+
+	blocks = len / block;
+	if (blocks) {
+		asm volatile(
+			"1:\n\t"
+			"movnti %[x], 0*%c[w](%[d])\n\t"
+			"movnti %[x], 1*%c[w](%[d])\n\t"
+			"movnti %[x], 2*%c[w](%[d])\n\t"
+			"movnti %[x], 3*%c[w](%[d])\n\t"
+			"add %[b], %[d]\n\t"
+			"dec %[n]\n\t"
+			"jnz 1b\n\t"
+			"sfence\n\t"
+			: [d] "+r" (d), [n] "+r" (blocks)
+			: [x] "r" (x), [w] "i" (sizeof(unsigned long)), [b] "i" (block)
+			: "memory"
+		);
+	}
+
+	memset_stosb(d, c, len % block);
+}
+
 void *memset(void *dstpp, int c, size_t len)
 {
 	int d0;
@@ -19,6 +68,20 @@ void *memset(void *dstpp, int c, size_t len)
 	check_memory_region((unsigned long)dstpp, len, true, _RET_IP_);
 #endif
 
+	if (x86_string_ops_dispatch()) {
+		const unsigned int features = x86_string_ops_features();
+
+		if (CONFIG_X86_STRING_OPS_NT_THRESHOLD &&
+		    len >= CONFIG_X86_STRING_OPS_NT_THRESHOLD && (features & X86_STRING_OPS_NT)) {
+			memset_nt(dstpp, c, len);
+			return dstpp;
+		}
+		if ((features & X86_STRING_OPS_ERMS) && len >= X86_STRING_OPS_ERMS_THRESHOLD) {
+			memset_stosb(dstpp, c, len);
+			return dstpp;
+		}
+	}
+
 	/* This explicit register allocation improves code very much indeed. */
 	register op_t x asm("ax");
 
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <arch/cpu.h>
+#include <arch/string_ops.h>
+#include <cpu/x86/cr.h>
+
+#define CPUID_FEATURE_SSE2	(1 << 26)	/* leaf 1, EDX */
+#define CPUID_FEATURE_ERMS	(1 << 9)	/* leaf 7, EBX */
+#define CPUID_FEATURE_FSRM	(1 << 4)	/* leaf 7, EDX */
+
+/* Can't use memset() or printk() here, they may end up calling back into this function. */
+static unsigned int detect_features(void)
+{
+	unsigned int features = 0;
+	struct cpuid_result res;
+
+	if (cpuid_get_max_func() < 1)
+		return 0;
+
+	/* MOVNTI only needs SSE2, but don't rely on it unless the OS bits are set up. */
+	if ((cpuid_edx(1) & CPUID_FEATURE_SSE2) && (read_cr4() & CR4_OSFXSR))
+		features |= X86_STRING_OPS_NT;
+
+	if (cpuid_get_max_func() < CPUID_STRUCT_EXTENDED_FEATURE_FLAGS)
+		return features;
+
+	res = cpuid_ext(CPUID_STRUCT_EXTENDED_FEATURE_FLAGS, 0);
+	if (res.ebx & CPUID_FEATURE_ERMS)
+		features |= X86_STRING_OPS_ERMS;
+	if (res.edx & CPUID_FEATURE_FSRM)
+		features |= X86_STRING_OPS_FSRM;
+
+	return features;
+}
+
+unsigned int x86_string_ops_features(void)
+{
+	/* Racing APs will all store the same value, no locking needed. */
+	static unsigned int features;
+	static bool detected;
+
+	if (!detected) {
+		features = detect_features();
+		detected = true;
+	}
+
+	return features;
+}
@@ -53,6 +53,10 @@ romstage-y += bsd/lz4_wrapper.c
 ramstage-y += bsd/lz4_wrapper.c
 postcar-y += bsd/lz4_wrapper.c
 
+romstage-$(CONFIG_COMPRESS_RAMSTAGE_ZSTD) += bsd/zstd_decompress.c
+ramstage-$(CONFIG_ZSTD) += bsd/zstd_decompress.c
+postcar-$(CONFIG_COMPRESS_RAMSTAGE_ZSTD) += bsd/zstd_decompress.c
+
 ramstage-y += sort.c
 
 romstage-y += bsd/elog.c
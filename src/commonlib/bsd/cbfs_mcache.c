@@ -2,7 +2,9 @@
 
 #include <assert.h>
 #include <commonlib/bsd/cbfs_private.h>
+#include <commonlib/bsd/fnv.h>
 #include <commonlib/bsd/helpers.h>
+#include <string.h>
 
 /*
  * A CBFS metadata cache is an in memory data structure storing CBFS file headers (= metadata).
@@ -21,11 +23,27 @@
  * metadata (entry->file.h.offset). The next mcache_entry begins at the next
  * CBFS_MCACHE_ALIGNMENT boundary after that. The cache is terminated by a special 4-byte
  * mcache_entry that consists only of a magic number (MCACHE_MAGIC_END or MCACHE_MAGIC_FULL).
+ *
+ * If there is enough space left after a complete (MCACHE_MAGIC_END terminated) cache, it is
+ * followed by a hash index that lets cbfs_mcache_lookup() find files without walking all
+ * entries. The index is an open-addressing hash table (struct mcache_index) with one 32-bit
+ * slot per bucket: the upper 16 bits hold the upper 16 bits of the filename hash, the lower 16
+ * bits the entry offset in units of CBFS_MCACHE_ALIGNMENT. It is followed by a trailer (struct
+ * mcache_index_trailer) pointing back at it. The same trailer is also written to the very end
+ * of the mcache area, so the index can be found in O(1) both in the original mcache and in a
+ * copy truncated to cbfs_mcache_real_size(). Readers that don't know about the index just stop
+ * at MCACHE_MAGIC_END, and mcaches without a valid trailer are searched linearly.
  */
 
 #define MCACHE_MAGIC_FILE	0x454c4946	/* 'FILE' */
 #define MCACHE_MAGIC_FULL	0x4c4c5546	/* 'FULL' */
 #define MCACHE_MAGIC_END	0x444e4524	/* '$END' */
+#define MCACHE_MAGIC_INDEX	0x58444e49	/* 'INDX' */
+#define MCACHE_MAGIC_TRAILER	0x24584449	/* 'IDX$' */
+
+#define MCACHE_INDEX_EMPTY	0xffffffff
+#define MCACHE_INDEX_POS_MASK	0xffff
+#define MCACHE_INDEX_TAG_MASK	0xffff0000
 
 union mcache_entry {
 	union cbfs_mdata file;
@@ -35,6 +53,111 @@ union mcache_entry {
 	};
 };
 
+struct mcache_index {
+	uint32_t magic;
+	uint32_t num_slots;	/* always a power of two */
+	uint32_t slots[];
+};
+
+struct mcache_index_trailer {
+	uint32_t index_offset;
+	uint32_t magic;
+};
+
+static size_t mcache_filename_len(const union mcache_entry *entry)
+{
+	const size_t max = be32toh(entry->file.h.offset) - offsetof(union cbfs_mdata, h.filename);
+
+	return strnlen(entry->file.h.filename, max);
+}
+
+static size_t mcache_index_size(uint32_t num_slots)
+{
+	return sizeof(struct mcache_index) + num_slots * sizeof(uint32_t);
+}
+
+/* Find the index through the trailer at the end of the mcache. Returns NULL if there is none. */
+static const struct mcache_index *mcache_find_index(const void *mcache, size_t mcache_size)
+{
+	const struct mcache_index_trailer *trailer;
+	const struct mcache_index *index;
+	size_t trailer_offset;
+
+	mcache_size = ALIGN_DOWN(mcache_size, CBFS_MCACHE_ALIGNMENT);
+	if (mcache_size < sizeof(*trailer) + sizeof(*index))
+		return NULL;
+
+	trailer_offset = mcache_size - sizeof(*trailer);
+	trailer = mcache + trailer_offset;
+	if (trailer->magic != MCACHE_MAGIC_TRAILER ||
+	    trailer->index_offset > trailer_offset - sizeof(*index) ||
+	    !IS_ALIGNED(trailer->index_offset, CBFS_MCACHE_ALIGNMENT))
+		return NULL;
+
+	index = mcache + trailer->index_offset;
+	if (index->magic != MCACHE_MAGIC_INDEX || !index->num_slots ||
+	    (index->num_slots & (index->num_slots - 1)) ||
+	    index->num_slots > (trailer_offset - trailer->index_offset) / sizeof(uint32_t))
+		return NULL;
+
+	return index;
+}
+
+/* Append the hash index after the MCACHE_MAGIC_END at |end|, if it fits. */
+static void mcache_build_index(void *mcache, size_t mcache_size, void *end, int count)
+{
+	const size_t index_offset = end - mcache;
+	struct mcache_index *index = end;
+	struct mcache_index_trailer *trailer;
+	uint32_t num_slots = 4;
+	void *current;
+
+	mcache_size = ALIGN_DOWN(mcache_size, CBFS_MCACHE_ALIGNMENT);
+
+	/* Slots can only address entries within the first 64K alignment units. */
+	if (index_offset / CBFS_MCACHE_ALIGNMENT >= MCACHE_INDEX_POS_MASK)
+		return;
+
+	/* Keep the load factor at or below 75% so probe sequences stay short. */
+	while (num_slots * 3 < count * 4)
+		num_slots *= 2;
+
+	/* Leave room for the second trailer at the end, see cbfs_mcache_build(). */
+	if (index_offset + mcache_index_size(num_slots) + 2 * sizeof(*trailer) > mcache_size) {
+		LOG("No space for mcache index (%d files)\n", count);
+		return;
+	}
+
+	index->magic = MCACHE_MAGIC_INDEX;
+	index->num_slots = num_slots;
+	memset(index->slots, 0xff, num_slots * sizeof(uint32_t));
+
+	for (current = mcache; current < end;) {
+		const union mcache_entry *entry = current;
+		const size_t pos = (current - mcache) / CBFS_MCACHE_ALIGNMENT;
+		const uint32_t hash = fnv1a_32(entry->file.h.filename,
+						       mcache_filename_len(entry));
+		uint32_t slot = hash & (num_slots - 1);
+
+		/* Linear probing. Entries are inserted in CBFS order so duplicate names resolve
+		   to the first one, like in the linear lookup. */
+		while (index->slots[slot] != MCACHE_INDEX_EMPTY)
+			slot = (slot + 1) & (num_slots - 1);
+		index->slots[slot] = (hash & MCACHE_INDEX_TAG_MASK) | pos;
+
+		current += ALIGN_UP(be32toh(entry->file.h.offset), CBFS_MCACHE_ALIGNMENT);
+	}
+
+	trailer = end + mcache_index_size(num_slots);
+	trailer->index_offset = index_offset;
+	trailer->magic = MCACHE_MAGIC_TRAILER;
+
+	/* Second copy at the very end so lookups on the full-size mcache can find it. */
+	trailer = mcache + mcache_size - sizeof(*trailer);
+	trailer->index_offset = index_offset;
+	trailer->magic = MCACHE_MAGIC_TRAILER;
+}
+
 struct cbfs_mcache_build_args {
 	void *mcache;
 	void *end;
@@ -66,19 +189,26 @@ static enum cb_err build_walker(cbfs_dev_t dev, size_t offset, const union cbfs_
 enum cb_err cbfs_mcache_build(cbfs_dev_t dev, void *mcache, size_t size,
 			      struct vb2_hash *metadata_hash)
 {
+	struct mcache_index_trailer *trailer = mcache + ALIGN_DOWN(size, CBFS_MCACHE_ALIGNMENT)
+					       - sizeof(*trailer);
 	struct cbfs_mcache_build_args args = {
 		.mcache = mcache,
-		.end = mcache + ALIGN_DOWN(size, CBFS_MCACHE_ALIGNMENT)
-		       - sizeof(uint32_t), /* leave space for terminating magic */
+		/* leave space for terminating magic and index trailer */
+		.end = (void *)trailer - sizeof(uint32_t),
 		.count = 0,
 	};
 
-	assert(size > sizeof(uint32_t) && IS_ALIGNED((uintptr_t)mcache, CBFS_MCACHE_ALIGNMENT));
+	assert(size > sizeof(uint32_t) + sizeof(*trailer) &&
+	       IS_ALIGNED((uintptr_t)mcache, CBFS_MCACHE_ALIGNMENT));
+
+	/* Invalidate any stale index, mcache_build_index() will write a valid trailer. */
+	trailer->magic = 0;
 	enum cb_err ret = cbfs_walk(dev, build_walker, &args, metadata_hash, 0);
 	union mcache_entry *entry = args.mcache;
 	if (ret == CB_CBFS_NOT_FOUND) {
 		ret = CB_SUCCESS;
 		entry->magic = MCACHE_MAGIC_END;
+		mcache_build_index(mcache, size, args.mcache + sizeof(entry->magic), args.count);
 	} else if (ret == CB_CBFS_CACHE_FULL) {
 		ERROR("mcache overflow, should increase CBFS_MCACHE size!\n");
 		entry->magic = MCACHE_MAGIC_FULL;
@@ -89,12 +219,65 @@ enum cb_err cbfs_mcache_build(cbfs_dev_t dev, void *mcache, size_t size,
 	return ret;
 }
 
+/* Returns true and fills out the output parameters if |entry| is the file called |name|. */
+static bool mcache_entry_match(const union mcache_entry *entry, const char *name,
+			       size_t namesize, union cbfs_mdata *mdata_out,
+			       size_t *data_offset_out)
+{
+	const uint32_t data_offset = be32toh(entry->file.h.offset);
+
+	if (namesize > data_offset - offsetof(union cbfs_mdata, h.filename) ||
+	    memcmp(name, entry->file.h.filename, namesize) != 0)
+		return false;
+
+	LOG("Found '%s' @%#x size %#x in mcache @%p\n",
+	    name, entry->offset, be32toh(entry->file.h.len), entry);
+	*data_offset_out = entry->offset + data_offset;
+	memcpy(mdata_out, &entry->file, data_offset);
+	return true;
+}
+
+static enum cb_err mcache_lookup_index(const void *mcache, const struct mcache_index *index,
+				       const char *name, union cbfs_mdata *mdata_out,
+				       size_t *data_offset_out)
+{
+	const size_t namesize = strlen(name) + 1; /* Count trailing \0 so we can memcmp() it. */
+	const uint32_t hash = fnv1a_32(name, namesize - 1);
+	const uint32_t mask = index->num_slots - 1;
+	uint32_t slot = hash & mask;
+	uint32_t i;
+
+	for (i = 0; i < index->num_slots; i++, slot = (slot + 1) & mask) {
+		const uint32_t value = index->slots[slot];
+
+		if (value == MCACHE_INDEX_EMPTY)
+			return CB_CBFS_NOT_FOUND;
+		if ((value & MCACHE_INDEX_TAG_MASK) != (hash & MCACHE_INDEX_TAG_MASK))
+			continue;
+
+		const size_t offset = (value & MCACHE_INDEX_POS_MASK) * CBFS_MCACHE_ALIGNMENT;
+		if (offset >= (const void *)index - mcache)
+			return CB_ERR;	/* should never happen */
+
+		const union mcache_entry *entry = mcache + offset;
+		assert(entry->magic == MCACHE_MAGIC_FILE);
+		if (mcache_entry_match(entry, name, namesize, mdata_out, data_offset_out))
+			return CB_SUCCESS;
+	}
+
+	return CB_CBFS_NOT_FOUND;
+}
+
 enum cb_err cbfs_mcache_lookup(const void *mcache, size_t mcache_size, const char *name,
 			       union cbfs_mdata *mdata_out, size_t *data_offset_out)
 {
 	const size_t namesize = strlen(name) + 1; /* Count trailing \0 so we can memcmp() it. */
 	const void *end = mcache + mcache_size;
 	const void *current = mcache;
+	const struct mcache_index *index = mcache_find_index(mcache, mcache_size);
+
+	if (index)
+		return mcache_lookup_index(mcache, index, name, mdata_out, data_offset_out);
 
 	while (current + sizeof(uint32_t) <= end) {
 		const union mcache_entry *entry = current;
@@ -105,18 +288,10 @@ enum cb_err cbfs_mcache_lookup(const void *mcache, size_t mcache_size, const cha
 			return CB_CBFS_CACHE_FULL;
 
 		assert(entry->magic == MCACHE_MAGIC_FILE);
-		const uint32_t data_offset = be32toh(entry->file.h.offset);
-		const uint32_t data_length = be32toh(entry->file.h.len);
-		if (namesize <= data_offset - offsetof(union cbfs_mdata, h.filename) &&
-		    memcmp(name, entry->file.h.filename, namesize) == 0) {
-			LOG("Found '%s' @%#x size %#x in mcache @%p\n",
-			    name, entry->offset, data_length, current);
-			*data_offset_out = entry->offset + data_offset;
-			memcpy(mdata_out, &entry->file, data_offset);
+		if (mcache_entry_match(entry, name, namesize, mdata_out, data_offset_out))
 			return CB_SUCCESS;
-		}
 
-		current += ALIGN_UP(data_offset, CBFS_MCACHE_ALIGNMENT);
+		current += ALIGN_UP(be32toh(entry->file.h.offset), CBFS_MCACHE_ALIGNMENT);
 	}
 
 	ERROR("CBFS mcache is not terminated!\n");	/* should never happen */
@@ -140,5 +315,11 @@ size_t cbfs_mcache_real_size(const void *mcache, size_t mcache_size)
 		current += ALIGN_UP(be32toh(entry->file.h.offset), CBFS_MCACHE_ALIGNMENT);
 	}
 
+	/* Include the index and its trailer, if they directly follow the terminator. */
+	const struct mcache_index *index = mcache_find_index(mcache, mcache_size);
+	if (index && (const void *)index == current)
+		current += mcache_index_size(index->num_slots) +
+			   sizeof(struct mcache_index_trailer);
+
 	return current - mcache;
 }
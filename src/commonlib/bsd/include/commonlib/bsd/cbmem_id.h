@@ -23,6 +23,7 @@
 #define CBMEM_ID_CSE_UPDATE	0x43534555
 #define CBMEM_ID_EHCI_DEBUG	0xe4c1deb9
 #define CBMEM_ID_ELOG		0x454c4f47
+#define CBMEM_ID_ELOG_HINT	0x454c4854
 #define CBMEM_ID_FREESPACE	0x46524545
 #define CBMEM_ID_FSP_RESERVED_MEMORY 0x46535052
 #define CBMEM_ID_FSP_RUNTIME	0x52505346
@@ -65,6 +66,7 @@
 #define CBMEM_ID_TPM_CB_LOG	0x54435041 /* TPM log in coreboot-specific format */
 #define CBMEM_ID_TCPA_TCG_LOG	0x54445041 /* TPM log per TPM 1.2 specification */
 #define CBMEM_ID_TIMESTAMP	0x54494d45
+#define CBMEM_ID_TIMESTAMP_SPANS 0x5453504e
 #define CBMEM_ID_TPM2_TCG_LOG	0x54504d32 /* TPM log per TPM 2.0 specification */
 #define CBMEM_ID_TPM_PPI	0x54505049
 #define CBMEM_ID_VBOOT_HANDOFF	0x780074f0  /* deprecated */
@@ -112,6 +114,7 @@
 	{ CBMEM_ID_CPU_CRASHLOG,	"CPU CRASHLOG (deprecated)"}, \
 	{ CBMEM_ID_EHCI_DEBUG,		"USBDEBUG   " }, \
 	{ CBMEM_ID_ELOG,		"ELOG       " }, \
+	{ CBMEM_ID_ELOG_HINT,		"ELOG HINT  " }, \
 	{ CBMEM_ID_FREESPACE,		"FREE SPACE " }, \
 	{ CBMEM_ID_FSP_RESERVED_MEMORY, "FSP MEMORY " }, \
 	{ CBMEM_ID_FSP_RUNTIME,		"FSP RUNTIME" }, \
@@ -149,6 +152,7 @@
 	{ CBMEM_ID_TPM_CB_LOG,		"TPM CB LOG " }, \
 	{ CBMEM_ID_TCPA_TCG_LOG,	"TCPA TCGLOG" }, \
 	{ CBMEM_ID_TIMESTAMP,		"TIME STAMP " }, \
+	{ CBMEM_ID_TIMESTAMP_SPANS,	"TIME SPANS " }, \
 	{ CBMEM_ID_TPM2_TCG_LOG,	"TPM2 TCGLOG" }, \
 	{ CBMEM_ID_TPM_PPI,		"TPM PPI    " }, \
 	{ CBMEM_ID_VBOOT_HANDOFF,	"VBOOT      " }, \
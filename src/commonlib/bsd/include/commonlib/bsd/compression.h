@@ -18,4 +18,29 @@ size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn);
 /* Same as ulz4fn() but does not perform any bounds checks. */
 size_t ulz4f(const void *src, void *dst);
 
+/* Input callback for the streaming decompressors. Reads `size` bytes of compressed data at
+ * `offset` into `buf` and returns the amount of bytes read (anything short of `size` is
+ * treated as an error). Reads are always issued in ascending, non-overlapping order.
+ */
+typedef size_t (*decompress_read_fn)(void *arg, size_t offset, void *buf, size_t size);
+
+/* Same as ulz4fn(), but pulls the srcn bytes of compressed input through read() in
+ * chunks of up to scratch_size bytes instead of requiring the whole input to be
+ * mapped. Blocks are decoded as their data arrives, so scratch can be much smaller
+ * than the LZ4 block size. In-place decompression is not supported.
+ */
+size_t ulz4fn_stream(decompress_read_fn read, void *arg, size_t srcn, void *dst, size_t dstn,
+		     void *scratch, size_t scratch_size);
+
+/* Size of the workspace that uzstdn() needs for its decoding tables. */
+#define UZSTD_WORKSPACE_SIZE	(10 * 1024)
+
+/* Decompresses one or more zstd frames from src to dst, ensuring that it doesn't read more
+ * than srcn bytes and doesn't write more than dstn. Frames using a dictionary aren't
+ * supported. workspace has to be UZSTD_WORKSPACE_SIZE bytes, suitably aligned for any type.
+ * In-place decompression is not supported.
+ * Returns amount of decompressed bytes, or 0 on error.
+ */
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn, void *workspace);
+
 #endif	/* _COMMONLIB_COMPRESSION_H_ */
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#ifndef _COMMONLIB_BSD_FNV_H_
+#define _COMMONLIB_BSD_FNV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 32-bit FNV-1a. It is small and fast enough for hashing short keys like file names in
+ * every stage, but not meant for anything that needs to resist collisions on purpose.
+ * Hashes of data read in chunks are computed by passing the previous result back in.
+ */
+#define FNV1A_32_INIT	0x811c9dc5
+
+static inline uint32_t fnv1a_32_update(uint32_t hash, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+
+	while (size--) {
+		hash ^= *p++;
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+static inline uint32_t fnv1a_32(const void *data, size_t size)
+{
+	return fnv1a_32_update(FNV1A_32_INIT, data, size);
+}
+
+#endif /* _COMMONLIB_BSD_FNV_H_ */
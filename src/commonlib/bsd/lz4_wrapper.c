@@ -93,6 +93,19 @@ struct lz4_block_header {
 	/* + uint32_t block_checksum iff has_block_checksum is set */
 } __packed;
 
+static int lz4_frame_header_valid(const struct lz4_frame_header *h)
+{
+	/* We assume there's always only a single, standard frame. */
+	if (le32toh(h->magic) != LZ4F_MAGICNUMBER
+	    || (h->flags & VERSION) != (1 << VERSION_SHIFT))
+		return 0;	/* unknown format */
+	if ((h->flags & RESERVED0) || (h->block_descriptor & RESERVED1_2))
+		return 0;	/* reserved must be zero */
+	if (!(h->flags & INDEPENDENT_BLOCKS))
+		return 0;	/* we don't support block dependency */
+	return 1;
+}
+
 size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn)
 {
 	const void *in = src;
@@ -106,14 +119,8 @@ size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn)
 		if (srcn < sizeof(*h) + sizeof(uint64_t) + sizeof(uint8_t))
 			return 0;	/* input overrun */
 
-		/* We assume there's always only a single, standard frame. */
-		if (le32toh(h->magic) != LZ4F_MAGICNUMBER
-		    || (h->flags & VERSION) != (1 << VERSION_SHIFT))
-			return 0;	/* unknown format */
-		if ((h->flags & RESERVED0) || (h->block_descriptor & RESERVED1_2))
-			return 0;	/* reserved must be zero */
-		if (!(h->flags & INDEPENDENT_BLOCKS))
-			return 0;	/* we don't support block dependency */
+		if (!lz4_frame_header_valid(h))
+			return 0;
 		has_block_checksum = h->flags & HAS_BLOCK_CHECKSUM;
 
 		in += sizeof(*h);
@@ -169,3 +176,206 @@ size_t ulz4f(const void *src, void *dst)
 	/* LZ4 uses signed size parameters, so can't just use ((u32)-1) here. */
 	return ulz4fn(src, 1*GiB, dst, 1*GiB);
 }
+
+/*
+ * Streaming decompression. Unlike ulz4fn() this can't hand whole blocks to
+ * LZ4_decompress_generic() since they may be larger than the scratch buffer, so
+ * it decodes the LZ4 sequences itself, pulling input bytes from the scratch
+ * buffer and refilling it through the read callback as needed. Matches only
+ * ever reference already decompressed output, which is all still in dst.
+ */
+struct lz4_stream {
+	decompress_read_fn read;
+	void *arg;
+	size_t srcn;
+	size_t offset;		/* input offset of the next refill */
+	uint8_t *buf;
+	size_t buf_size;
+	size_t pos;		/* read position in buf */
+	size_t end;		/* amount of valid data in buf */
+};
+
+static size_t lz4s_consumed(const struct lz4_stream *s)
+{
+	return s->offset - (s->end - s->pos);
+}
+
+/* Copy the next n input bytes to out, or skip them if out is NULL. */
+static int lz4s_copy(struct lz4_stream *s, void *out, size_t n)
+{
+	while (n) {
+		size_t chunk;
+
+		if (s->pos == s->end) {
+			/* Bypass the scratch buffer for large copies. */
+			if (out && n >= s->buf_size) {
+				if (n > s->srcn - s->offset
+				    || s->read(s->arg, s->offset, out, n) != n)
+					return -1;
+				s->offset += n;
+				return 0;
+			}
+
+			chunk = MIN(s->buf_size, s->srcn - s->offset);
+			if (!chunk || s->read(s->arg, s->offset, s->buf, chunk) != chunk)
+				return -1;
+			s->offset += chunk;
+			s->pos = 0;
+			s->end = chunk;
+		}
+
+		chunk = MIN(n, s->end - s->pos);
+		if (out) {
+			memcpy(out, s->buf + s->pos, chunk);
+			out += chunk;
+		}
+		s->pos += chunk;
+		n -= chunk;
+	}
+
+	return 0;
+}
+
+static int lz4s_byte(struct lz4_stream *s, uint8_t *b)
+{
+	if (likely(s->pos < s->end)) {
+		*b = s->buf[s->pos++];
+		return 0;
+	}
+	return lz4s_copy(s, b, 1);
+}
+
+/* Add the optional extra length bytes following a saturated token nibble. */
+static int lz4s_extra_len(struct lz4_stream *s, size_t *len)
+{
+	uint8_t b;
+
+	do {
+		if (lz4s_byte(s, &b))
+			return -1;
+		*len += b;
+	} while (b == 255);
+
+	return 0;
+}
+
+static int lz4s_block(struct lz4_stream *s, size_t block_size, void *dst, void **out,
+		      void *out_end)
+{
+	const size_t block_end = lz4s_consumed(s) + block_size;
+	uint8_t *op = *out;
+
+	while (lz4s_consumed(s) < block_end) {
+		uint8_t token, le_offset[2];
+		size_t len, offset;
+
+		if (lz4s_byte(s, &token))
+			return -1;
+
+		len = token >> ML_BITS;
+		if (len == RUN_MASK && lz4s_extra_len(s, &len))
+			return -1;
+		if (len > (size_t)((uint8_t *)out_end - op))
+			return -1;	/* output overrun */
+		if (lz4s_copy(s, op, len))
+			return -1;
+		op += len;
+
+		/* The last sequence of a block only has literals. */
+		if (lz4s_consumed(s) >= block_end)
+			break;
+
+		if (lz4s_copy(s, le_offset, sizeof(le_offset)))
+			return -1;
+		offset = le_offset[0] | le_offset[1] << 8;
+		if (!offset || offset > (size_t)(op - (uint8_t *)dst))
+			return -1;	/* match before start of output */
+
+		len = token & ML_MASK;
+		if (len == ML_MASK && lz4s_extra_len(s, &len))
+			return -1;
+		len += MINMATCH;
+		if (len > (size_t)((uint8_t *)out_end - op))
+			return -1;	/* output overrun */
+
+		if (offset >= len) {
+			memcpy(op, op - offset, len);
+			op += len;
+		} else {
+			/* Overlapping match, repeats the last offset bytes. */
+			while (len--) {
+				*op = *(op - offset);
+				op++;
+			}
+		}
+	}
+
+	if (lz4s_consumed(s) != block_end)
+		return -1;	/* sequence ran past the end of the block */
+
+	*out = op;
+	return 0;
+}
+
+size_t ulz4fn_stream(decompress_read_fn read, void *arg, size_t srcn, void *dst, size_t dstn,
+		     void *scratch, size_t scratch_size)
+{
+	struct lz4_stream s = {
+		.read = read,
+		.arg = arg,
+		.srcn = srcn,
+		.buf = scratch,
+		.buf_size = scratch_size,
+	};
+	struct lz4_frame_header h;
+	void *out = dst;
+	size_t out_size = 0;
+	int has_block_checksum;
+
+	if (!scratch_size)
+		return 0;
+
+	if (srcn < sizeof(h) + sizeof(uint64_t) + sizeof(uint8_t))
+		return 0;	/* input overrun */
+
+	if (lz4s_copy(&s, &h, sizeof(h)) || !lz4_frame_header_valid(&h))
+		return 0;
+	has_block_checksum = h.flags & HAS_BLOCK_CHECKSUM;
+
+	if (lz4s_copy(&s, NULL, ((h.flags & HAS_CONTENT_SIZE) ? sizeof(uint64_t) : 0)
+			       + sizeof(uint8_t)))
+		return 0;
+
+	while (1) {
+		struct lz4_block_header b;
+		size_t size;
+
+		if (lz4s_copy(&s, &b, sizeof(b)))
+			break;		/* input overrun */
+		b.raw = le32toh(b.raw);
+		size = b.raw & BH_SIZE;
+
+		if (lz4s_consumed(&s) + size > srcn)
+			break;		/* input overrun */
+
+		if (!size) {
+			out_size = out - dst;
+			break;		/* decompression successful */
+		}
+
+		if (b.raw & NOT_COMPRESSED) {
+			if (size > (size_t)(dst + dstn - out))
+				break;	/* output overrun */
+			if (lz4s_copy(&s, out, size))
+				break;
+			out += size;
+		} else if (lz4s_block(&s, size, dst, &out, dst + dstn)) {
+			break;		/* decompression error */
+		}
+
+		if (has_block_checksum && lz4s_copy(&s, NULL, sizeof(uint32_t)))
+			break;
+	}
+
+	return out_size;
+}
@@ -0,0 +1,867 @@
+/* SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-only */
+
+/*
+ * Zstandard decoder following RFC 8878. Input and output are both completely in memory, so
+ * matches are copied straight from the output and there is no window buffer. The decoding
+ * tables in the caller's workspace are all of the state. Dictionaries aren't supported and
+ * content checksums are skipped, CBFS has its own hashes.
+ */
+
+#include <commonlib/bsd/compression.h>
+#include <commonlib/bsd/helpers.h>
+#include <commonlib/bsd/sysincludes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ZSTD_MAGIC		0xfd2fb528
+#define ZSTD_SKIPPABLE_MAGIC	0x184d2a50
+#define ZSTD_SKIPPABLE_MASK	0xfffffff0
+#define ZSTD_BLOCK_SIZE_MAX	(128 * KiB)
+
+/* Frame_Header_Descriptor */
+#define FHD_DICT_ID_SIZE	0x03
+#define FHD_CHECKSUM		0x04
+#define FHD_RESERVED		0x08
+#define FHD_SINGLE_SEGMENT	0x20
+#define FHD_FCS_SIZE_SHIFT	6
+
+enum {
+	BLOCK_RAW,
+	BLOCK_RLE,
+	BLOCK_COMPRESSED,
+};
+
+enum {
+	LITERALS_RAW,
+	LITERALS_RLE,
+	LITERALS_COMPRESSED,
+	LITERALS_TREELESS,
+};
+
+enum {
+	MODE_PREDEFINED,
+	MODE_RLE,
+	MODE_FSE,
+	MODE_REPEAT,
+};
+
+#define HUF_MAX_BITS		11
+#define HUF_MAX_SYMBOLS		256
+#define WEIGHT_MAX_LOG		6
+#define LL_MAX_LOG		9
+#define ML_MAX_LOG		9
+#define OF_MAX_LOG		8
+#define LL_MAX_SYMBOL		35
+#define ML_MAX_SYMBOL		52
+#define OF_MAX_SYMBOL		31
+
+struct huf_entry {
+	uint8_t symbol;
+	uint8_t bits;
+};
+
+struct fse_entry {
+	uint16_t base;
+	uint8_t symbol;
+	uint8_t bits;
+};
+
+struct fse_table {
+	unsigned int log;
+	bool valid;
+};
+
+struct zstd_workspace {
+	struct huf_entry huf[1 << HUF_MAX_BITS];
+	struct fse_entry ll[1 << LL_MAX_LOG];
+	struct fse_entry ml[1 << ML_MAX_LOG];
+	struct fse_entry of[1 << OF_MAX_LOG];
+	struct fse_table ll_table, ml_table, of_table;
+	unsigned int huf_log;
+	bool huf_valid;
+	uint32_t rep[3];
+};
+
+_Static_assert(sizeof(struct zstd_workspace) <= UZSTD_WORKSPACE_SIZE,
+	       "UZSTD_WORKSPACE_SIZE too small");
+
+/* Where a block writes its output. The literals are staged in dst right below lit_end. */
+struct zstd_out {
+	uint8_t *frame;
+	uint8_t *pos;
+	uint8_t *end;
+};
+
+/* Predefined distributions and code tables of RFC 8878 3.1.1.3.2. */
+static const int16_t ll_predefined[LL_MAX_SYMBOL + 1] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2,
+	2, 3, 2, 1, 1, 1, 1, 1, -1, -1, -1, -1,
+};
+
+static const int16_t ml_predefined[ML_MAX_SYMBOL + 1] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1,
+};
+
+static const int16_t of_predefined[] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1, -1,
+};
+
+static const uint32_t ll_base[LL_MAX_SYMBOL + 1] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+	8192, 16384, 32768, 65536,
+};
+
+static const uint8_t ll_bits[LL_MAX_SYMBOL + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+	13, 14, 15, 16,
+};
+
+static const uint32_t ml_base[ML_MAX_SYMBOL + 1] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+	4099, 8195, 16387, 32771, 65539,
+};
+
+static const uint8_t ml_bits[ML_MAX_SYMBOL + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+	12, 13, 14, 15, 16,
+};
+
+static unsigned int highbit(uint32_t x)
+{
+	return 31 - __builtin_clz(x);
+}
+
+static uint32_t read_le(const uint8_t *p, size_t n)
+{
+	uint32_t v = 0;
+
+	while (n--)
+		v = v << 8 | p[n];
+
+	return v;
+}
+
+/* Reads 8 bytes at index, which may reach outside of the buffer, where everything is 0. */
+static uint64_t load_le64(const uint8_t *p, size_t size, int64_t index)
+{
+	uint64_t v = 0;
+	int i;
+
+	if (index >= 0 && index + 8 <= (int64_t)size) {
+		memcpy(&v, &p[index], sizeof(v));
+		return le64toh(v);
+	}
+
+	for (i = 0; i < 8; i++) {
+		if (index + i >= 0 && index + i < (int64_t)size)
+			v |= (uint64_t)p[index + i] << (i * 8);
+	}
+
+	return v;
+}
+
+/*
+ * Huffman and FSE coded data is read backwards, starting at the highest bit below the marker
+ * bit in the last byte. pos is the amount of bits left, reading past the start returns zeros.
+ */
+struct bits {
+	const uint8_t *src;
+	size_t size;
+	int64_t pos;
+};
+
+static int bits_init(struct bits *b, const uint8_t *src, size_t size)
+{
+	if (!size || !src[size - 1])
+		return -1;
+
+	b->src = src;
+	b->size = size;
+	b->pos = (size - 1) * 8 + highbit(src[size - 1]);
+
+	return 0;
+}
+
+/* Returns the next n <= 32 bits, without consuming them. */
+static uint32_t bits_peek(const struct bits *b, unsigned int n)
+{
+	const int64_t start = b->pos - n;
+
+	if (!n)
+		return 0;
+
+	return (load_le64(b->src, b->size, start >> 3) >> (start & 7)) & ((1ULL << n) - 1);
+}
+
+static uint32_t bits_read(struct bits *b, unsigned int n)
+{
+	const uint32_t v = bits_peek(b, n);
+
+	b->pos -= n;
+	return v;
+}
+
+/* Reads the normalized distribution of an FSE table. Returns the bytes used or -1. */
+static int fse_read_counts(int16_t *counts, unsigned int *max_symbol, unsigned int *log,
+			   const uint8_t *src, size_t size, unsigned int max_log)
+{
+	size_t pos = 4;
+	unsigned int symbol = 0;
+	unsigned int nbits;
+	int remaining, threshold;
+	bool previous0 = false;
+
+	if (!size)
+		return -1;
+
+	*log = (src[0] & 0xf) + 5;
+	if (*log > max_log)
+		return -1;
+
+	threshold = 1 << *log;
+	remaining = threshold + 1;
+	nbits = *log + 1;
+
+	while (remaining > 1 && symbol <= *max_symbol) {
+		uint32_t v;
+		int count, max;
+
+		if (previous0) {
+			unsigned int repeat, i;
+
+			/* Each 2 bit flag adds up to 3 more zeros, 3 means another flag follows. */
+			do {
+				repeat = load_le64(src, size, pos / 8) >> (pos % 8) & 3;
+				pos += 2;
+				for (i = 0; i < repeat; i++) {
+					if (symbol > *max_symbol)
+						return -1;
+					counts[symbol++] = 0;
+				}
+			} while (repeat == 3);
+
+			if (symbol > *max_symbol)
+				return -1;
+		}
+
+		v = load_le64(src, size, pos / 8) >> (pos % 8);
+		max = 2 * threshold - 1 - remaining;
+		if ((int)(v & (threshold - 1)) < max) {
+			count = v & (threshold - 1);
+			pos += nbits - 1;
+		} else {
+			count = v & (2 * threshold - 1);
+			if (count >= threshold)
+				count -= max;
+			pos += nbits;
+		}
+
+		count--;
+		remaining -= count < 0 ? -count : count;
+		if (remaining < 1)
+			return -1;
+		counts[symbol++] = count;
+		previous0 = !count;
+
+		while (remaining < threshold) {
+			nbits--;
+			threshold >>= 1;
+		}
+	}
+
+	if (remaining != 1 || (pos + 7) / 8 > size)
+		return -1;
+
+	*max_symbol = symbol - 1;
+	return (pos + 7) / 8;
+}
+
+static int fse_build(struct fse_entry *table, const int16_t *counts, unsigned int max_symbol,
+		     unsigned int log)
+{
+	const uint32_t size = 1 << log;
+	const uint32_t step = (size >> 1) + (size >> 3) + 3;
+	uint32_t high = size - 1;
+	uint32_t pos = 0;
+	uint16_t next[ML_MAX_SYMBOL + 1];
+	unsigned int s;
+	uint32_t i;
+
+	for (s = 0; s <= max_symbol; s++) {
+		if (counts[s] == -1) {
+			table[high--].symbol = s;
+			next[s] = 1;
+		} else {
+			next[s] = counts[s];
+		}
+	}
+
+	for (s = 0; s <= max_symbol; s++) {
+		for (i = 0; (int)i < counts[s]; i++) {
+			table[pos].symbol = s;
+			do {
+				pos = (pos + step) & (size - 1);
+			} while (pos > high);
+		}
+	}
+
+	if (pos)
+		return -1;
+
+	for (i = 0; i < size; i++) {
+		const uint32_t n = next[table[i].symbol]++;
+
+		table[i].bits = log - highbit(n);
+		table[i].base = (n << table[i].bits) - size;
+	}
+
+	return 0;
+}
+
+static uint8_t fse_decode(const struct fse_entry *table, uint32_t *state, struct bits *b)
+{
+	const struct fse_entry *e = &table[*state];
+
+	*state = e->base + bits_read(b, e->bits);
+	return e->symbol;
+}
+
+/* Reads the Huffman tree description. Returns the bytes used or -1. */
+static int huf_read_table(struct zstd_workspace *ws, const uint8_t *src, size_t size)
+{
+	uint8_t weights[HUF_MAX_SYMBOLS];
+	uint32_t rank[HUF_MAX_BITS + 1] = { 0 };
+	size_t count = 0, used, i;
+	uint32_t total = 0, rest;
+	unsigned int log, w;
+
+	if (!size)
+		return -1;
+
+	if (src[0] >= 128) {
+		/* Direct representation, 4 bits per weight. */
+		count = src[0] - 127;
+		used = 1 + (count + 1) / 2;
+		if (used > size)
+			return -1;
+		for (i = 0; i < count; i++)
+			weights[i] = i & 1 ? src[1 + i / 2] & 0xf : src[1 + i / 2] >> 4;
+	} else {
+		/* FSE compressed weights, decoded with two interleaved states. */
+		struct fse_entry table[1 << WEIGHT_MAX_LOG];
+		int16_t counts[HUF_MAX_BITS + 2];
+		unsigned int max_symbol = HUF_MAX_BITS + 1;
+		uint32_t state1, state2;
+		struct bits b;
+		int header;
+
+		used = 1 + src[0];
+		if (used > size)
+			return -1;
+
+		header = fse_read_counts(counts, &max_symbol, &log, &src[1], src[0],
+					 WEIGHT_MAX_LOG);
+		if (header < 0 || fse_build(table, counts, max_symbol, log))
+			return -1;
+		if (bits_init(&b, &src[1 + header], src[0] - header))
+			return -1;
+
+		state1 = bits_read(&b, log);
+		state2 = bits_read(&b, log);
+		for (;;) {
+			if (count + 2 >= HUF_MAX_SYMBOLS)
+				return -1;
+			weights[count++] = fse_decode(table, &state1, &b);
+			if (b.pos < 0) {
+				weights[count++] = table[state2].symbol;
+				break;
+			}
+			weights[count++] = fse_decode(table, &state2, &b);
+			if (b.pos < 0) {
+				weights[count++] = table[state1].symbol;
+				break;
+			}
+		}
+	}
+
+	/* The weight of the last symbol is implied by the others. */
+	for (i = 0; i < count; i++) {
+		if (weights[i] > HUF_MAX_BITS)
+			return -1;
+		if (weights[i])
+			total += 1 << (weights[i] - 1);
+	}
+	if (!total || count >= HUF_MAX_SYMBOLS)
+		return -1;
+
+	log = highbit(total) + 1;
+	rest = (1 << log) - total;
+	if (log > HUF_MAX_BITS || rest & (rest - 1))
+		return -1;
+	weights[count++] = highbit(rest) + 1;
+
+	/* Symbols with the longest codes go first, each taking 2^(weight - 1) entries. */
+	for (i = 0; i < count; i++)
+		rank[weights[i]]++;
+	for (w = 1, total = 0; w <= log; w++) {
+		const uint32_t start = total;
+
+		total += rank[w] << (w - 1);
+		rank[w] = start;
+	}
+
+	for (i = 0; i < count; i++) {
+		const struct huf_entry e = { .symbol = i, .bits = log + 1 - weights[i] };
+		uint32_t n;
+
+		if (!weights[i])
+			continue;
+
+		for (n = 0; n < 1U << (weights[i] - 1); n++)
+			ws->huf[rank[weights[i]]++] = e;
+	}
+
+	ws->huf_log = log;
+	ws->huf_valid = true;
+
+	return used;
+}
+
+static int huf_decode_stream(const struct zstd_workspace *ws, uint8_t *out, size_t n,
+			     const uint8_t *src, size_t size)
+{
+	struct bits b;
+	size_t i;
+
+	if (bits_init(&b, src, size))
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		const struct huf_entry e = ws->huf[bits_peek(&b, ws->huf_log)];
+
+		out[i] = e.symbol;
+		b.pos -= e.bits;
+	}
+
+	return b.pos == 0 ? 0 : -1;
+}
+
+/* Decodes the literals section to lit, which is in dst right below the end of the block. */
+static int decode_literals(struct zstd_workspace *ws, const uint8_t *src, size_t size,
+			   uint8_t *lit_end, const struct zstd_out *out, uint8_t **lit)
+{
+	const unsigned int type = src[0] & 3;
+	const unsigned int format = src[0] >> 2 & 3;
+	size_t header, regen, csize = 0;
+	uint32_t v;
+
+	if (type == LITERALS_RAW || type == LITERALS_RLE) {
+		header = format == 1 ? 2 : format == 3 ? 3 : 1;
+		if (header > size)
+			return -1;
+		v = read_le(src, header);
+		regen = format & 1 ? v >> 4 : v >> 3;
+		csize = type == LITERALS_RLE ? 1 : regen;
+	} else {
+		const unsigned int bits = format < 2 ? 10 : format == 2 ? 14 : 18;
+		uint64_t h;
+
+		header = format < 2 ? 3 : format == 2 ? 4 : 5;
+		if (header > size)
+			return -1;
+		h = read_le(src, MIN(header, 4));
+		if (header == 5)
+			h |= (uint64_t)src[4] << 32;
+		regen = h >> 4 & ((1 << bits) - 1);
+		csize = h >> (4 + bits) & ((1 << bits) - 1);
+	}
+
+	if (header + csize > size || regen > ZSTD_BLOCK_SIZE_MAX ||
+	    regen > (size_t)(lit_end - out->pos))
+		return -1;
+
+	*lit = lit_end - regen;
+	src += header;
+
+	switch (type) {
+	case LITERALS_RAW:
+		memmove(*lit, src, regen);
+		break;
+	case LITERALS_RLE:
+		memset(*lit, src[0], regen);
+		break;
+	case LITERALS_COMPRESSED:
+	case LITERALS_TREELESS: {
+		const size_t segment = (regen + 3) / 4;
+		size_t streams[4];
+		int table = 0;
+		int i;
+
+		if (type == LITERALS_COMPRESSED) {
+			table = huf_read_table(ws, src, csize);
+			if (table < 0)
+				return -1;
+		} else if (!ws->huf_valid) {
+			return -1;
+		}
+
+		src += table;
+		csize -= table;
+
+		if (format == 0) {
+			if (huf_decode_stream(ws, *lit, regen, src, csize))
+				return -1;
+			return header + table + csize;
+		}
+
+		/* Four streams with a jump table, the last stream gets what is left. */
+		if (csize < 6 || regen < 4)
+			return -1;
+		streams[0] = read_le(&src[0], 2);
+		streams[1] = read_le(&src[2], 2);
+		streams[2] = read_le(&src[4], 2);
+		if (streams[0] + streams[1] + streams[2] > csize - 6)
+			return -1;
+		streams[3] = csize - 6 - streams[0] - streams[1] - streams[2];
+
+		const uint8_t *stream = &src[6];
+		for (i = 0; i < 4; i++) {
+			const size_t n = i < 3 ? segment : regen - 3 * segment;
+
+			if (huf_decode_stream(ws, *lit + i * segment, n, stream, streams[i]))
+				return -1;
+			stream += streams[i];
+		}
+		return header + table + csize;
+	}
+	}
+
+	return header + csize;
+}
+
+static int read_seq_table(struct fse_entry *table, struct fse_table *t, unsigned int mode,
+			  const uint8_t *src, size_t size, const int16_t *predefined,
+			  unsigned int predefined_max, unsigned int predefined_log,
+			  unsigned int max_symbol, unsigned int max_log)
+{
+	int16_t counts[ML_MAX_SYMBOL + 1];
+	int used;
+
+	switch (mode) {
+	case MODE_PREDEFINED:
+		if (fse_build(table, predefined, predefined_max, predefined_log))
+			return -1;
+		t->log = predefined_log;
+		used = 0;
+		break;
+	case MODE_RLE:
+		if (!size || src[0] > max_symbol)
+			return -1;
+		table[0].symbol = src[0];
+		table[0].bits = 0;
+		table[0].base = 0;
+		t->log = 0;
+		used = 1;
+		break;
+	case MODE_FSE:
+		used = fse_read_counts(counts, &max_symbol, &t->log, src, size, max_log);
+		if (used < 0 || fse_build(table, counts, max_symbol, t->log))
+			return -1;
+		break;
+	default:
+		return t->valid ? 0 : -1;
+	}
+
+	t->valid = true;
+	return used;
+}
+
+static int copy_match(struct zstd_out *out, uint32_t offset, uint32_t length, const uint8_t *limit)
+{
+	const uint8_t *match;
+
+	if (!offset || offset > (size_t)(out->pos - out->frame) ||
+	    length > (size_t)(limit - out->pos))
+		return -1;
+
+	match = out->pos - offset;
+	if (offset >= length) {
+		memcpy(out->pos, match, length);
+		out->pos += length;
+	} else {
+		while (length--)
+			*out->pos++ = *match++;
+	}
+
+	return 0;
+}
+
+static int decode_sequences(struct zstd_workspace *ws, const uint8_t *src, size_t size,
+			    struct zstd_out *out, const uint8_t *lit, size_t lit_size)
+{
+	const uint8_t *const end = src + size;
+	const uint8_t *lit_end = lit + lit_size;
+	uint32_t ll_state = 0, ml_state = 0, of_state = 0;
+	uint32_t count, count_total;
+	unsigned int modes;
+	struct bits b;
+	int used;
+
+	if (!size)
+		return -1;
+
+	count = src[0];
+	if (count >= 128) {
+		if (count < 255) {
+			if (size < 2)
+				return -1;
+			count = ((count - 128) << 8) + src[1];
+			src += 2;
+		} else {
+			if (size < 3)
+				return -1;
+			count = read_le(&src[1], 2) + 0x7f00;
+			src += 3;
+		}
+	} else {
+		src++;
+	}
+
+	count_total = count;
+	if (count) {
+		if (src >= end)
+			return -1;
+		modes = *src++;
+		if (modes & 3)
+			return -1;
+
+		used = read_seq_table(ws->ll, &ws->ll_table, modes >> 6, src, end - src,
+				      ll_predefined, LL_MAX_SYMBOL, 6, LL_MAX_SYMBOL, LL_MAX_LOG);
+		if (used < 0)
+			return -1;
+		src += used;
+		used = read_seq_table(ws->of, &ws->of_table, modes >> 4 & 3, src, end - src,
+				      of_predefined, ARRAY_SIZE(of_predefined) - 1, 5,
+				      OF_MAX_SYMBOL, OF_MAX_LOG);
+		if (used < 0)
+			return -1;
+		src += used;
+		used = read_seq_table(ws->ml, &ws->ml_table, modes >> 2 & 3, src, end - src,
+				      ml_predefined, ML_MAX_SYMBOL, 6, ML_MAX_SYMBOL, ML_MAX_LOG);
+		if (used < 0)
+			return -1;
+		src += used;
+
+		if (bits_init(&b, src, end - src))
+			return -1;
+
+		ll_state = bits_read(&b, ws->ll_table.log);
+		of_state = bits_read(&b, ws->of_table.log);
+		ml_state = bits_read(&b, ws->ml_table.log);
+	}
+
+	while (count--) {
+		const uint8_t ll_code = ws->ll[ll_state].symbol;
+		const uint8_t ml_code = ws->ml[ml_state].symbol;
+		const uint8_t of_code = ws->of[of_state].symbol;
+		uint32_t offset, ll, ml;
+
+		if (of_code > OF_MAX_SYMBOL)
+			return -1;
+
+		/* Extra bits come in the order offset, match length, literals length. */
+		offset = (1U << of_code) + bits_read(&b, of_code);
+		ml = ml_base[ml_code] + bits_read(&b, ml_bits[ml_code]);
+		ll = ll_base[ll_code] + bits_read(&b, ll_bits[ll_code]);
+
+		if (offset > 3) {
+			ws->rep[2] = ws->rep[1];
+			ws->rep[1] = ws->rep[0];
+			ws->rep[0] = offset - 3;
+		} else {
+			/* Repeat offsets, shifted by one without literals. */
+			const unsigned int idx = offset - 1 + !ll;
+
+			if (idx) {
+				offset = idx == 3 ? ws->rep[0] - 1 : ws->rep[idx];
+				if (idx > 1)
+					ws->rep[2] = ws->rep[1];
+				ws->rep[1] = ws->rep[0];
+				ws->rep[0] = offset;
+			}
+		}
+
+		if (count) {
+			ll_state = ws->ll[ll_state].base + bits_read(&b, ws->ll[ll_state].bits);
+			ml_state = ws->ml[ml_state].base + bits_read(&b, ws->ml[ml_state].bits);
+			of_state = ws->of[of_state].base + bits_read(&b, ws->of[of_state].bits);
+		}
+
+		if (ll > (size_t)(lit_end - lit))
+			return -1;
+		memmove(out->pos, lit, ll);
+		out->pos += ll;
+		lit += ll;
+
+		/* The match must not overwrite literals that are still needed. */
+		if (copy_match(out, ws->rep[0], ml, lit))
+			return -1;
+	}
+
+	if (count_total ? b.pos != 0 : src != end)
+		return -1;
+
+	memmove(out->pos, lit, lit_end - lit);
+	out->pos += lit_end - lit;
+
+	return 0;
+}
+
+static int decode_block(struct zstd_workspace *ws, const uint8_t *src, size_t size,
+			struct zstd_out *out)
+{
+	uint8_t *lit_end = out->pos + MIN((size_t)(out->end - out->pos), ZSTD_BLOCK_SIZE_MAX);
+	uint8_t *lit;
+	int used;
+
+	if (!size)
+		return -1;
+
+	used = decode_literals(ws, src, size, lit_end, out, &lit);
+	if (used < 0)
+		return -1;
+
+	return decode_sequences(ws, src + used, size - used, out, lit, lit_end - lit);
+}
+
+/* Decodes a single frame. Returns the bytes used or 0. */
+static size_t decode_frame(struct zstd_workspace *ws, const uint8_t *src, size_t srcn,
+			   struct zstd_out *out)
+{
+	static const uint8_t dict_id_size[] = { 0, 1, 2, 4 };
+	const uint8_t *const start = src;
+	const uint8_t *const end = src + srcn;
+	unsigned int fhd, fcs_size, dict_size, window_size;
+	bool last;
+
+	if (srcn < 5)
+		return 0;
+
+	fhd = src[4];
+	if (fhd & FHD_RESERVED)
+		return 0;
+
+	/* Matches can reach back to the start of the frame, the window size doesn't matter. */
+	window_size = fhd & FHD_SINGLE_SEGMENT ? 0 : 1;
+	dict_size = dict_id_size[fhd & FHD_DICT_ID_SIZE];
+	fcs_size = fhd >> FHD_FCS_SIZE_SHIFT ? 1 << (fhd >> FHD_FCS_SIZE_SHIFT) : 0;
+	if (!fcs_size && (fhd & FHD_SINGLE_SEGMENT))
+		fcs_size = 1;
+
+	if (srcn < 5 + window_size + dict_size + fcs_size)
+		return 0;
+	src += 5 + window_size;
+
+	/* Dictionaries aren't supported, the ID has to be 0 if it is present. */
+	if (dict_size && read_le(src, dict_size))
+		return 0;
+	src += dict_size + fcs_size;
+
+	memset(ws, 0, sizeof(*ws));
+	ws->rep[0] = 1;
+	ws->rep[1] = 4;
+	ws->rep[2] = 8;
+	out->frame = out->pos;
+
+	do {
+		uint32_t header, type, size;
+
+		if (end - src < 3)
+			return 0;
+		header = read_le(src, 3);
+		src += 3;
+		last = header & 1;
+		type = header >> 1 & 3;
+		size = header >> 3;
+
+		if (size > ZSTD_BLOCK_SIZE_MAX)
+			return 0;
+
+		switch (type) {
+		case BLOCK_RAW:
+			if ((size_t)(end - src) < size || (size_t)(out->end - out->pos) < size)
+				return 0;
+			memcpy(out->pos, src, size);
+			out->pos += size;
+			src += size;
+			break;
+		case BLOCK_RLE:
+			if (src >= end || (size_t)(out->end - out->pos) < size)
+				return 0;
+			memset(out->pos, *src++, size);
+			out->pos += size;
+			break;
+		case BLOCK_COMPRESSED:
+			if ((size_t)(end - src) < size || decode_block(ws, src, size, out))
+				return 0;
+			src += size;
+			break;
+		default:
+			return 0;
+		}
+	} while (!last);
+
+	if (fhd & FHD_CHECKSUM) {
+		if (end - src < 4)
+			return 0;
+		src += 4;
+	}
+
+	return src - start;
+}
+
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn, void *workspace)
+{
+	const uint8_t *in = src;
+	struct zstd_out out = {
+		.pos = dst,
+		.end = (uint8_t *)dst + dstn,
+	};
+
+	/* Concatenated frames are decoded one after the other, skippable frames are skipped. */
+	while (srcn) {
+		uint32_t magic;
+		size_t used;
+
+		if (srcn < 8)
+			return 0;
+
+		magic = read_le(in, 4);
+		if ((magic & ZSTD_SKIPPABLE_MASK) == ZSTD_SKIPPABLE_MAGIC) {
+			used = 8 + (size_t)read_le(&in[4], 4);
+			if (used > srcn)
+				return 0;
+		} else if (magic == ZSTD_MAGIC) {
+			used = decode_frame(workspace, in, srcn, &out);
+			if (!used)
+				return 0;
+		} else {
+			return 0;
+		}
+
+		in += used;
+		srcn -= used;
+	}
+
+	return out.pos - (uint8_t *)dst;
+}
@@ -89,6 +89,7 @@ enum {
 	LB_TAG_PCIE			= 0x0044,
 	LB_TAG_EFI_FW_INFO		= 0x0045,
 	LB_TAG_CAPSULE			= 0x0046,
+	LB_TAG_TIMESTAMP_SPANS		= 0x0047,
 	LB_TAG_LOGO			= 0x00a0,
 	/* The following options are CMOS-related */
 	LB_TAG_CMOS_OPTION_TABLE	= 0x00c8,
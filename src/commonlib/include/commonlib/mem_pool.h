@@ -9,24 +9,37 @@
 
 /*
  * The memory pool allows one to allocate memory from a fixed size buffer that
- * also allows freeing semantics for reuse. However, the current limitation is
- * that only the two most recent allocations  can be freed (in exact reverse
- * order). If one tries to free any allocation that isn't at the top of the
- * allocation stack, or one allocates more than two buffers in a row without
- * freeing, it will result in a leak within the memory pool. (Two allocations
- * were chosen to optimize for the CBFS cache case which may need two buffers
- * to map a single compressed file, and will free them in reverse order.)
+ * also allows freeing semantics for reuse. The pool tracks up to
+ * MEM_POOL_MAX_ALLOCS live allocations, which may be freed in any order. The
+ * space between live allocations acts as an implicit free list: new
+ * allocations are placed into the first gap that is large enough before the
+ * pool is grown at the top, and freeing the topmost allocation releases all
+ * adjacent free space below it.
+ *
+ * When more than MEM_POOL_MAX_ALLOCS allocations are live at the same time,
+ * the lowest one stops being tracked and, together with all space below it,
+ * is leaked for the lifetime of the pool (until mem_pool_reset()). Freeing an
+ * allocation that is no longer tracked is silently ignored.
  *
  * You must ensure the backing buffer is 'alignment' aligned.
  */
 
+#define MEM_POOL_MAX_ALLOCS 16
+
+struct mem_pool_block {
+	size_t offset;
+	size_t size;
+};
+
 struct mem_pool {
 	uint8_t *buf;
 	size_t size;
 	size_t alignment;
-	uint8_t *last_alloc;
-	uint8_t *second_to_last_alloc;
-	size_t free_offset;
+	/* Everything below this offset has been leaked and can no longer be reused. */
+	size_t floor;
+	/* Live allocations, sorted by offset. */
+	size_t num_allocs;
+	struct mem_pool_block allocs[MEM_POOL_MAX_ALLOCS];
 };
 
 #define MEM_POOL_INIT(buf_, size_, alignment_)	\
@@ -34,16 +47,14 @@ struct mem_pool {
 		.buf = (buf_),			\
 		.size = (size_),		\
 		.alignment = (alignment_),	\
-		.last_alloc = NULL,		\
-		.second_to_last_alloc = NULL,	\
-		.free_offset = 0,		\
+		.floor = 0,			\
+		.num_allocs = 0,		\
 	}
 
 static inline void mem_pool_reset(struct mem_pool *mp)
 {
-	mp->last_alloc = NULL;
-	mp->second_to_last_alloc = NULL;
-	mp->free_offset = 0;
+	mp->floor = 0;
+	mp->num_allocs = 0;
 }
 
 /* Initialize a memory pool. */
@@ -65,4 +76,7 @@ void *mem_pool_alloc(struct mem_pool *mp, size_t sz);
 /* Free allocation from memory pool. */
 void mem_pool_free(struct mem_pool *mp, void *alloc);
 
+/* Return the size of the largest allocation that would currently succeed. */
+size_t mem_pool_largest_free(const struct mem_pool *mp);
+
 #endif /* _MEM_POOL_H_ */
@@ -6,6 +6,7 @@
 #include <sys/types.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <commonlib/bsd/helpers.h>
 #include <commonlib/mem_pool.h>
 
@@ -307,4 +308,40 @@ const struct region_device *incoherent_rdev_init(struct incoherent_rdev *irdev,
 				const struct region_device *read,
 				const struct region_device *write);
 
+/*
+ * A cache_rdev keeps recently used blocks of a backing device that is slow to access, like SPI
+ * flash that isn't memory mapped, in a buffer provided by the caller. Small reads like the ones
+ * of CBFS headers are then served from memory. When a read misses the cache right behind the
+ * previous read, the following blocks are read ahead within the same transaction. Reads that
+ * would replace much of the cache go straight to the backing device. Writes and erases are
+ * passed through and drop the blocks they touch, so all writes to the backing device have to
+ * go through the cache_rdev to keep it coherent. mmap() is passed through as well.
+ */
+struct cache_rdev_block {
+	size_t offset;
+	uint32_t last_use;
+};
+
+struct cache_rdev {
+	struct region_device rdev;
+	const struct region_device *backing;
+	uint8_t *data;
+	struct cache_rdev_block *blocks;
+	size_t block_size;
+	size_t block_count;
+	size_t readahead;
+	size_t next_offset;
+	uint32_t clock;
+};
+
+/* Initialize a cache_rdev covering all of the backing rdev. The buffer holds both the blocks
+ * and their bookkeeping. block_size has to be a power of 2 and readahead is the number of
+ * blocks that are read ahead on sequential misses. Returns NULL if the buffer can't hold more
+ * than twice readahead + 1 blocks. Otherwise the function returns a pointer to the containing
+ * region_device, whose lifetime matches the one of the cache_rdev object. */
+const struct region_device *cache_rdev_init(struct cache_rdev *crdev,
+				const struct region_device *backing,
+				void *buffer, size_t buffer_size,
+				size_t block_size, size_t readahead);
+
 #endif /* _REGION_H_ */
@@ -19,6 +19,39 @@ struct timestamp_table {
 	struct timestamp_entry entries[]; /* Variable number of entries */
 } __packed;
 
+/*
+ * Spans record begin/end pairs with their nesting, so tools don't have to guess which
+ * timestamps belong together. They live in their own CBMEM table (CBMEM_ID_TIMESTAMP_SPANS)
+ * and use the base_time and tick_freq_mhz of the timestamp table.
+ */
+#define TIMESTAMP_SPAN_NAME_LEN 32
+
+enum timestamp_span_kind {
+	TS_SPAN_GENERIC = 0,
+	TS_SPAN_BOOT_STATE = 1,		/* name is the boot state */
+	TS_SPAN_DEVICE_INIT = 2,	/* name is the device path */
+	TS_SPAN_CBFS_LOAD = 3,		/* name is the CBFS filename */
+	TS_SPAN_DEVICE_READ_RESOURCES = 4,	/* name is the device path */
+	TS_SPAN_DEVICE_ENABLE = 5,	/* name is the device path */
+	TS_SPAN_DEVICE_FINAL = 6,	/* name is the device path */
+};
+
+struct timestamp_span {
+	int64_t		start;
+	int64_t		end;		/* smaller than start while the span is open */
+	uint32_t	id;		/* timestamp_id for TS_SPAN_GENERIC, else 0 */
+	uint16_t	parent;		/* index + 1 of the enclosing span, 0 if none */
+	uint8_t		kind;		/* enum timestamp_span_kind */
+	uint8_t		thread;		/* ID of the coop thread that recorded the span */
+	char		name[TIMESTAMP_SPAN_NAME_LEN];	/* not necessarily terminated */
+} __packed;
+
+struct timestamp_span_table {
+	uint32_t	max_spans;
+	uint32_t	num_spans;
+	struct timestamp_span spans[];	/* in order of span start */
+} __packed;
+
 enum timestamp_id {
 	TS_ROMSTAGE_START = 1,
 	TS_INITRAM_START = 2,
@@ -37,6 +70,8 @@ enum timestamp_id {
 	TS_ULZMA_END = 16,
 	TS_ULZ4F_START = 17,
 	TS_ULZ4F_END = 18,
+	TS_UZSTD_START = 19,
+	TS_UZSTD_END = 20,
 	TS_DEVICE_ENUMERATE = 30,
 	TS_DEVICE_CONFIGURE = 40,
 	TS_DEVICE_ENABLE = 50,
@@ -212,6 +247,8 @@ static const struct timestamp_id_to_name {
 	TS_NAME_DEF(TS_ULZMA_END, 0, "finished LZMA decompress (ignore for x86)"),
 	TS_NAME_DEF(TS_ULZ4F_START, TS_ULZ4F_END, "starting LZ4 decompress (ignore for x86)"),
 	TS_NAME_DEF(TS_ULZ4F_END, 0, "finished LZ4 decompress (ignore for x86)"),
+	TS_NAME_DEF(TS_UZSTD_START, TS_UZSTD_END, "starting zstd decompress (ignore for x86)"),
+	TS_NAME_DEF(TS_UZSTD_END, 0, "finished zstd decompress (ignore for x86)"),
 	TS_NAME_DEF(TS_DEVICE_ENUMERATE, TS_DEVICE_CONFIGURE, "device enumeration"),
 	TS_NAME_DEF(TS_DEVICE_CONFIGURE, TS_DEVICE_ENABLE,  "device configuration"),
 	TS_NAME_DEF(TS_DEVICE_ENABLE, TS_DEVICE_INITIALIZE, "device enable"),
@@ -2,10 +2,40 @@
 
 #include <commonlib/helpers.h>
 #include <commonlib/mem_pool.h>
+#include <string.h>
+
+static size_t block_end(const struct mem_pool_block *b)
+{
+	return b->offset + b->size;
+}
+
+/* Return the start of the free gap that precedes allocation index i. */
+static size_t gap_start(const struct mem_pool *mp, size_t i)
+{
+	if (i == 0)
+		return mp->floor;
+	return block_end(&mp->allocs[i - 1]);
+}
+
+/* Return the end of the free gap that precedes allocation index i. */
+static size_t gap_end(const struct mem_pool *mp, size_t i)
+{
+	if (i == mp->num_allocs)
+		return mp->size;
+	return mp->allocs[i].offset;
+}
+
+/* Stop tracking the lowest allocation, leaking it and everything below it. */
+static void leak_lowest(struct mem_pool *mp)
+{
+	mp->floor = block_end(&mp->allocs[0]);
+	mp->num_allocs--;
+	memmove(&mp->allocs[0], &mp->allocs[1], mp->num_allocs * sizeof(mp->allocs[0]));
+}
 
 void *mem_pool_alloc(struct mem_pool *mp, size_t sz)
 {
-	void *p;
+	size_t i;
 
 	if (mp->alignment == 0)
 		return NULL;
@@ -13,27 +43,52 @@ void *mem_pool_alloc(struct mem_pool *mp, size_t sz)
 	/* We assume that mp->buf started mp->alignment aligned */
 	sz = ALIGN_UP(sz, mp->alignment);
 
+	if (mp->num_allocs == ARRAY_SIZE(mp->allocs))
+		leak_lowest(mp);
+
+	/* First fit over the gaps between live allocations, including the top. */
+	for (i = 0; i <= mp->num_allocs; i++) {
+		if (gap_end(mp, i) - gap_start(mp, i) >= sz)
+			break;
+	}
+
 	/* Determine if any space available. */
-	if ((mp->size - mp->free_offset) < sz)
+	if (i > mp->num_allocs)
 		return NULL;
 
-	p = &mp->buf[mp->free_offset];
+	memmove(&mp->allocs[i + 1], &mp->allocs[i],
+		(mp->num_allocs - i) * sizeof(mp->allocs[0]));
+	mp->allocs[i].offset = gap_start(mp, i);
+	mp->allocs[i].size = sz;
+	mp->num_allocs++;
 
-	mp->free_offset += sz;
-	mp->second_to_last_alloc = mp->last_alloc;
-	mp->last_alloc = p;
-
-	return p;
+	return &mp->buf[mp->allocs[i].offset];
 }
 
 void mem_pool_free(struct mem_pool *mp, void *p)
 {
-	/* Determine if p was the most recent allocation. */
-	if (p == NULL || mp->last_alloc != p)
+	size_t i;
+
+	if (p == NULL)
 		return;
 
-	mp->free_offset = mp->last_alloc - mp->buf;
-	mp->last_alloc = mp->second_to_last_alloc;
-	/* No way to track allocation before this one. */
-	mp->second_to_last_alloc = NULL;
+	/* Freeing simply drops the entry; the gap it leaves is reused by later allocations. */
+	for (i = 0; i < mp->num_allocs; i++) {
+		if (&mp->buf[mp->allocs[i].offset] != p)
+			continue;
+		mp->num_allocs--;
+		memmove(&mp->allocs[i], &mp->allocs[i + 1],
+			(mp->num_allocs - i) * sizeof(mp->allocs[0]));
+		return;
+	}
+}
+
+size_t mem_pool_largest_free(const struct mem_pool *mp)
+{
+	size_t i, largest = 0;
+
+	for (i = 0; i <= mp->num_allocs; i++)
+		largest = MAX(largest, gap_end(mp, i) - gap_start(mp, i));
+
+	return largest;
 }
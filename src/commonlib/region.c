@@ -536,3 +536,211 @@ const struct region_device *incoherent_rdev_init(struct incoherent_rdev *irdev,
 
 	return &irdev->rdev;
 }
+
+#define CACHE_RDEV_NO_BLOCK	(~(size_t)0)
+
+static struct cache_rdev *to_cache_rdev(const struct region_device *rd)
+{
+	return container_of((void *)rd, struct cache_rdev, rdev);
+}
+
+static int cache_rdev_find(const struct cache_rdev *crdev, size_t offset)
+{
+	size_t i;
+
+	for (i = 0; i < crdev->block_count; i++) {
+		if (crdev->blocks[i].offset == offset)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Find the run of count slots that was used least recently as a whole. */
+static size_t cache_rdev_victims(const struct cache_rdev *crdev, size_t count)
+{
+	uint32_t best_use = UINT32_MAX;
+	size_t best = 0;
+	size_t i, j;
+
+	for (i = 0; i + count <= crdev->block_count; i++) {
+		uint32_t use = 0;
+
+		for (j = i; j < i + count; j++)
+			use = MAX(use, crdev->blocks[j].last_use);
+
+		if (use < best_use) {
+			best_use = use;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+static uint8_t *cache_rdev_get(struct cache_rdev *crdev, size_t offset, bool sequential)
+{
+	const size_t dev_size = region_device_sz(&crdev->rdev);
+	size_t count = 1;
+	size_t first, size, i;
+	int slot;
+
+	slot = cache_rdev_find(crdev, offset);
+	if (slot >= 0) {
+		crdev->blocks[slot].last_use = ++crdev->clock;
+		return &crdev->data[slot * crdev->block_size];
+	}
+
+	/* Read ahead until the end of the device or the next block that is still cached. */
+	if (sequential) {
+		while (count <= crdev->readahead) {
+			const size_t next = offset + count * crdev->block_size;
+
+			if (next >= dev_size || cache_rdev_find(crdev, next) >= 0)
+				break;
+			count++;
+		}
+	}
+
+	first = cache_rdev_victims(crdev, count);
+	size = MIN(count * crdev->block_size, dev_size - offset);
+
+	for (i = first; i < first + count; i++)
+		crdev->blocks[i].offset = CACHE_RDEV_NO_BLOCK;
+
+	if (rdev_readat(crdev->backing, &crdev->data[first * crdev->block_size], offset,
+			size) != size)
+		return NULL;
+
+	crdev->clock++;
+	for (i = 0; i < count; i++) {
+		crdev->blocks[first + i].offset = offset + i * crdev->block_size;
+		crdev->blocks[first + i].last_use = crdev->clock;
+	}
+
+	return &crdev->data[first * crdev->block_size];
+}
+
+static void cache_rdev_drop(struct cache_rdev *crdev, size_t offset, size_t size)
+{
+	const struct region r = {
+		.offset = offset,
+		.size = size,
+	};
+	size_t i;
+
+	for (i = 0; i < crdev->block_count; i++) {
+		const struct region block = {
+			.offset = crdev->blocks[i].offset,
+			.size = crdev->block_size,
+		};
+
+		if (block.offset != CACHE_RDEV_NO_BLOCK && region_overlap(&block, &r)) {
+			crdev->blocks[i].offset = CACHE_RDEV_NO_BLOCK;
+			crdev->blocks[i].last_use = 0;
+		}
+	}
+}
+
+static void *cache_mmap(const struct region_device *rd, size_t offset, size_t size)
+{
+	return rdev_mmap(to_cache_rdev(rd)->backing, offset, size);
+}
+
+static int cache_munmap(const struct region_device *rd, void *mapping)
+{
+	return rdev_munmap(to_cache_rdev(rd)->backing, mapping);
+}
+
+static ssize_t cache_readat(const struct region_device *rd, void *b, size_t offset,
+				size_t size)
+{
+	struct cache_rdev *crdev = to_cache_rdev(rd);
+	uint8_t *dst = b;
+	size_t done = 0;
+
+	if (size > crdev->block_count * crdev->block_size / 2)
+		return rdev_readat(crdev->backing, b, offset, size);
+
+	while (done < size) {
+		const size_t pos = offset + done;
+		const size_t block = ALIGN_DOWN(pos, crdev->block_size);
+		const size_t skip = pos - block;
+		const size_t len = MIN(crdev->block_size - skip, size - done);
+		const bool sequential = done ||
+				block == ALIGN_UP(crdev->next_offset, crdev->block_size);
+		const uint8_t *data;
+
+		data = cache_rdev_get(crdev, block, sequential);
+		if (!data)
+			return -1;
+
+		memcpy(&dst[done], &data[skip], len);
+		done += len;
+	}
+
+	crdev->next_offset = offset + size;
+
+	return size;
+}
+
+static ssize_t cache_writeat(const struct region_device *rd, const void *b,
+				size_t offset, size_t size)
+{
+	struct cache_rdev *crdev = to_cache_rdev(rd);
+
+	cache_rdev_drop(crdev, offset, size);
+
+	return rdev_writeat(crdev->backing, b, offset, size);
+}
+
+static ssize_t cache_eraseat(const struct region_device *rd, size_t offset,
+				size_t size)
+{
+	struct cache_rdev *crdev = to_cache_rdev(rd);
+
+	cache_rdev_drop(crdev, offset, size);
+
+	return rdev_eraseat(crdev->backing, offset, size);
+}
+
+static const struct region_device_ops cache_rdev_ops = {
+	.mmap = cache_mmap,
+	.munmap = cache_munmap,
+	.readat = cache_readat,
+	.writeat = cache_writeat,
+	.eraseat = cache_eraseat,
+};
+
+const struct region_device *cache_rdev_init(struct cache_rdev *crdev,
+				const struct region_device *backing,
+				void *buffer, size_t buffer_size,
+				size_t block_size, size_t readahead)
+{
+	const size_t slot_size = block_size + sizeof(*crdev->blocks);
+	size_t i;
+
+	if (!block_size || !IS_POWER_OF_2(block_size) || (uintptr_t)buffer % sizeof(size_t))
+		return NULL;
+
+	memset(crdev, 0, sizeof(*crdev));
+	crdev->block_count = buffer_size / slot_size;
+	if (crdev->block_count <= 2 * (readahead + 1))
+		return NULL;
+
+	/* The bookkeeping goes first to keep it aligned. */
+	crdev->blocks = buffer;
+	crdev->data = (uint8_t *)&crdev->blocks[crdev->block_count];
+	crdev->block_size = block_size;
+	crdev->readahead = readahead;
+	crdev->backing = backing;
+
+	for (i = 0; i < crdev->block_count; i++) {
+		crdev->blocks[i].offset = CACHE_RDEV_NO_BLOCK;
+		crdev->blocks[i].last_use = 0;
+	}
+
+	region_device_init(&crdev->rdev, &cache_rdev_ops, 0, region_device_sz(backing));
+
+	return &crdev->rdev;
+}
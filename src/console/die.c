@@ -1,8 +1,11 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 
 #include <console/console.h>
+#include <console/uart.h>
+#include <elog.h>
 #include <halt.h>
 #include <stdarg.h>
+#include <stdbool.h>
 
 /*
  * The method should be overwritten in mainboard directory to signal that a
@@ -17,12 +20,22 @@ __weak void die_notify(void)
 /* Report a fatal error */
 void __noreturn die(const char *fmt, ...)
 {
+	static bool dying;
 	va_list args;
 
 	va_start(args, fmt);
 	vprintk(BIOS_EMERG, fmt, args);
 	va_end(args);
 
+	/* Don't leave the message in the serial console queue. */
+	__uart_tx_drain();
+
+	/* Don't lose the events ramstage hasn't written yet, unless writing them died. */
+	if (ENV_RAMSTAGE && !dying) {
+		dying = true;
+		elog_flush();
+	}
+
 	die_notify();
 	halt();
 }
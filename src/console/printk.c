@@ -7,6 +7,7 @@
 #include <console/cbmem_console.h>
 #include <console/console.h>
 #include <console/streams.h>
+#include <console/uart.h>
 #include <console/vtxprintf.h>
 #include <smp/spinlock.h>
 #include <smp/node.h>
@@ -41,6 +42,10 @@ void console_time_report(void)
 
 	printk(BIOS_DEBUG, "BS: " ENV_STRING " times (exec / console): total (unknown) / %ld ms\n",
 		DIV_ROUND_CLOSEST(console_usecs, USECS_PER_MSEC));
+
+	if (__CONSOLE_SERIAL_ASYNC__ && __CONSOLE_SERIAL_ENABLE__)
+		printk(BIOS_DEBUG, "BS: " ENV_STRING " serial console queue saved %ld ms\n",
+			DIV_ROUND_CLOSEST(uart_async_usecs_saved(), USECS_PER_MSEC));
 }
 
 long console_time_get_and_reset(void)
@@ -19,6 +19,7 @@
 #include <device/device.h>
 #include <device/path.h>
 #include <smp/atomic.h>
+#include <smp/parallel_for.h>
 #include <smp/spinlock.h>
 #include <symbols.h>
 #include <timer.h>
@@ -1044,6 +1045,125 @@ enum cb_err mp_run_on_all_cpus_synchronously(void (*func)(void *), void *arg)
 						   1000 * USECS_PER_MSEC * global_num_aps);
 }
 
+#if CONFIG(PARALLEL_MP_AP_WORK)
+/* Keep the number of chunks well within the useful range of an atomic_t. */
+#define PARALLEL_FOR_MAX_CHUNKS		(1 << 20)
+/* Upper bound for an AP to finish its last chunk once the BSP found none left. */
+#define PARALLEL_FOR_IDLE_TIMEOUT_MS	10000
+
+struct parallel_for_work {
+	void (*func)(void *arg, size_t start, size_t end);
+	void *arg;
+	size_t count;
+	size_t chunk_size;
+	atomic_t next_chunk;
+};
+
+static struct parallel_for_work parallel_for_work;
+
+static void parallel_for_worker(void *unused)
+{
+	struct parallel_for_work *work = &parallel_for_work;
+	size_t start;
+
+	while (1) {
+		start = atomic_fetch_add(1, &work->next_chunk) * work->chunk_size;
+		if (start >= work->count)
+			break;
+
+		work->func(work->arg, start, MIN(start + work->chunk_size, work->count));
+	}
+}
+
+/*
+ * mp_run_on_aps() hands out a callback on its own stack, which an AP that accepts it
+ * after the timeout would copy when it is gone. This one stays valid.
+ */
+static struct mp_callback parallel_for_cb = {
+	.func = parallel_for_worker,
+	.logical_cpu_number = MP_RUN_ON_ALL_CPUS,
+};
+
+/* Take back the callback from the APs that didn't accept it yet. */
+static void withdraw_callback(struct mp_callback *val)
+{
+	const int cur_cpu = cpu_index();
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ap_callbacks); i++) {
+		struct mp_callback *expected = val;
+
+		if (i == cur_cpu)
+			continue;
+
+		asm volatile ("lock; cmpxchg %2, %1"
+			: "+a" (expected), "+m" (ap_callbacks[i])
+			: "r" ((struct mp_callback *)NULL)
+			: "memory"
+		);
+	}
+}
+
+static enum cb_err wait_for_aps_idle(void)
+{
+	const int cur_cpu = cpu_index();
+	struct stopwatch sw;
+	int i;
+
+	stopwatch_init_msecs_expire(&sw, PARALLEL_FOR_IDLE_TIMEOUT_MS);
+	for (i = 0; i <= global_num_aps; i++) {
+		if (i == cur_cpu)
+			continue;
+
+		while (atomic_read(&ap_status[i]) == AP_BUSY) {
+			if (stopwatch_expired(&sw)) {
+				printk(BIOS_ERR, "CPU %d didn't finish its parallel work.\n", i);
+				return CB_ERR;
+			}
+			asm ("pause");
+		}
+	}
+
+	return CB_SUCCESS;
+}
+
+enum cb_err parallel_for(void (*func)(void *arg, size_t start, size_t end), void *arg,
+			 size_t count, size_t chunk_size)
+{
+	struct parallel_for_work *work = &parallel_for_work;
+
+	if (count == 0)
+		return CB_SUCCESS;
+
+	work->func = func;
+	work->arg = arg;
+	work->count = count;
+	work->chunk_size = MAX(MAX(chunk_size, 1),
+			       DIV_ROUND_UP(count, PARALLEL_FOR_MAX_CHUNKS));
+	atomic_set(&work->next_chunk, 0);
+
+	/*
+	 * Every AP that accepted the work is busy until it finds no chunks left. The BSP
+	 * takes chunks as well, so the work completes even if the APs can't take it. An
+	 * AP that reads the callback just before it is withdrawn still runs the worker,
+	 * which takes chunks like any other CPU or finds none left.
+	 */
+	if (global_num_aps > 0 &&
+	    run_ap_work(&parallel_for_cb, 1000 * USECS_PER_MSEC, false) != CB_SUCCESS) {
+		printk(BIOS_WARNING, "Not all APs accepted parallel work.\n");
+		withdraw_callback(&parallel_for_cb);
+	}
+
+	parallel_for_worker(NULL);
+
+	/*
+	 * Once the BSP finds no chunks left, each AP finishes at most one more. A wedged
+	 * AP must not hang the boot, but its chunk may not be done then.
+	 */
+	return wait_for_aps_idle();
+}
+#endif
+
 enum cb_err mp_park_aps(void)
 {
 	struct stopwatch sw;
@@ -40,6 +40,7 @@ smm-y += pci_ops.c
 ramstage-$(CONFIG_PCIX_PLUGIN_SUPPORT) += pcix_device.c
 ramstage-$(CONFIG_PCIEXP_PLUGIN_SUPPORT) += pciexp_device.c
 ramstage-$(CONFIG_CARDBUS_PLUGIN_SUPPORT) += cardbus_device.c
+ramstage-$(CONFIG_PCI_TOPOLOGY_CACHE) += pci_topology_cache.c
 endif
 
 subdirs-y += oprom dram
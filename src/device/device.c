@@ -6,13 +6,16 @@
 
 #include <console/console.h>
 #include <device/device.h>
+#include <device/pci.h>
 #include <device/pci_def.h>
 #include <device/pci_ids.h>
 #include <post.h>
 #include <stdlib.h>
 #include <string.h>
 #include <smp/spinlock.h>
+#include <thread.h>
 #include <timer.h>
+#include <timestamp.h>
 
 /** Pointer to the last device */
 extern struct device *last_dev;
@@ -186,6 +189,7 @@ struct device *alloc_find_dev(struct bus *parent, struct device_path *path)
 static void read_resources(struct bus *bus)
 {
 	struct device *curdev;
+	int span;
 
 	printk(BIOS_SPEW, "%s %s segment group %d bus %d\n", dev_path(bus->dev),
 	       __func__, bus->segment_group, bus->secondary);
@@ -202,7 +206,9 @@ static void read_resources(struct bus *bus)
 			continue;
 		}
 		post_log_path(curdev);
+		span = timestamp_span_begin(TS_SPAN_DEVICE_READ_RESOURCES, 0, dev_path(curdev));
 		curdev->ops->read_resources(curdev);
+		timestamp_span_end(span);
 
 		/* Read in the resources behind the current device's links. */
 		if (curdev->downstream)
@@ -334,11 +340,14 @@ void assign_resources(struct bus *bus)
 static void enable_resources(struct bus *link)
 {
 	struct device *dev;
+	int span;
 
 	for (dev = link->children; dev; dev = dev->sibling) {
 		if (dev->enabled && dev->ops && dev->ops->enable_resources) {
 			post_log_path(dev);
+			span = timestamp_span_begin(TS_SPAN_DEVICE_ENABLE, 0, dev_path(dev));
 			dev->ops->enable_resources(dev);
+			timestamp_span_end(span);
 		}
 	}
 
@@ -527,12 +536,100 @@ void dev_enable(void)
 	printk(BIOS_INFO, "done.\n");
 }
 
+static void run_dev_init(struct device *dev)
+{
+	struct stopwatch sw;
+	long init_time;
+	int span;
+
+	stopwatch_init(&sw);
+	span = timestamp_span_begin(TS_SPAN_DEVICE_INIT, 0, dev_path(dev));
+	dev->ops->init(dev);
+	timestamp_span_end(span);
+
+	init_time = stopwatch_duration_msecs(&sw);
+	printk(BIOS_DEBUG, "%s init finished in %ld msecs\n", dev_path(dev),
+	       init_time);
+}
+
+#if CONFIG(PARALLEL_DEVICE_INIT)
+/* Devices flagged async_init in the devicetree whose init() runs on a thread. */
+static struct async_init {
+	struct device *dev;
+	struct thread_handle handle;
+} async_inits[CONFIG_NUM_THREADS];
+
+static enum cb_err async_init_thread(void *arg)
+{
+	run_dev_init(arg);
+	return CB_SUCCESS;
+}
+
+/*
+ * Threads only have CONFIG_STACK_SIZE of stack. Option ROMs and the graphics init around
+ * them need more than that and also must not be interleaved with other devices' init().
+ */
+static bool init_dev_runs_oprom(const struct device *dev)
+{
+#if CONFIG(PCI)
+	if (dev->path.type == DEVICE_PATH_PCI)
+		return dev->ops->init == pci_dev_init ||
+		       (dev->class >> 16) == PCI_BASE_CLASS_DISPLAY;
+#endif
+	return false;
+}
+
+/* Returns false if the init() could not be started on a thread. */
+static bool init_dev_async(struct device *dev)
+{
+	struct async_init *slot = NULL;
+
+	if (init_dev_runs_oprom(dev)) {
+		printk(BIOS_WARNING, "%s may run an option ROM, ignoring async_init\n",
+		       dev_path(dev));
+		return false;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(async_inits); i++) {
+		if (async_inits[i].dev && async_inits[i].handle.state != THREAD_DONE)
+			continue;
+		slot = &async_inits[i];
+		break;
+	}
+
+	if (!slot || thread_run(&slot->handle, async_init_thread, dev) < 0)
+		return false;
+
+	slot->dev = dev;
+	return true;
+}
+
+/* Wait for the init() of dev to finish, or for all of them if dev is NULL. */
+static void init_dev_join(const struct device *dev)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(async_inits); i++) {
+		if (!async_inits[i].dev || (dev && async_inits[i].dev != dev))
+			continue;
+		thread_join(&async_inits[i].handle);
+		async_inits[i].dev = NULL;
+	}
+}
+#else
+static bool init_dev_async(struct device *dev)
+{
+	return false;
+}
+
+static void init_dev_join(const struct device *dev) {}
+#endif
+
 /**
  * Initialize a specific device.
  *
  * The parent should be initialized first to avoid having an ordering problem.
  * This is done by calling the parent's init() method before its children's
- * init() methods.
+ * init() methods. With PARALLEL_DEVICE_INIT, the init() of devices flagged
+ * async_init runs on a thread and overlaps with the following siblings.
  *
  * @param dev The device to be initialized.
  */
@@ -542,22 +639,18 @@ static void init_dev(struct device *dev)
 		return;
 
 	if (!dev->initialized && dev->ops && dev->ops->init) {
-		struct stopwatch sw;
-		long init_time;
-
 		if (dev->path.type == DEVICE_PATH_I2C) {
 			printk(BIOS_DEBUG, "smbus: %s->", dev_path(dev->upstream->dev));
 		}
 
-		printk(BIOS_DEBUG, "%s init\n", dev_path(dev));
+		printk(BIOS_DEBUG, "%s init%s\n", dev_path(dev),
+		       dev->init_async ? " (async)" : "");
 
-		stopwatch_init(&sw);
 		dev->initialized = 1;
-		dev->ops->init(dev);
+		if (dev->init_async && init_dev_async(dev))
+			return;
 
-		init_time = stopwatch_duration_msecs(&sw);
-		printk(BIOS_DEBUG, "%s init finished in %ld msecs\n", dev_path(dev),
-		       init_time);
+		run_dev_init(dev);
 	}
 }
 
@@ -571,9 +664,13 @@ static void init_link(struct bus *link)
 		init_dev(dev);
 	}
 
-	for (dev = link->children; dev; dev = dev->sibling)
-		if (dev->downstream)
+	for (dev = link->children; dev; dev = dev->sibling) {
+		if (dev->downstream) {
+			/* Children may depend on their parent being initialized. */
+			init_dev_join(dev);
 			init_link(dev->downstream);
+		}
+	}
 }
 
 /**
@@ -592,6 +689,7 @@ void dev_initialize(void)
 	/* Now initialize everything. */
 	if (dev_root.downstream)
 		init_link(dev_root.downstream);
+	init_dev_join(NULL);
 	post_log_clear();
 
 	printk(BIOS_INFO, "Devices initialized\n");
@@ -613,8 +711,12 @@ static void final_dev(struct device *dev)
 		return;
 
 	if (dev->ops && dev->ops->final) {
+		int span;
+
 		printk(BIOS_DEBUG, "%s final\n", dev_path(dev));
+		span = timestamp_span_begin(TS_SPAN_DEVICE_FINAL, 0, dev_path(dev));
 		dev->ops->final(dev);
+		timestamp_span_end(span);
 	}
 }
 
@@ -12,6 +12,115 @@
 /** Linked list of ALL devices */
 DEVTREE_CONST struct device *DEVTREE_CONST all_devices = &dev_root;
 
+/* Return the device with the given number in devtree_index. */
+static DEVTREE_CONST struct device *static_dev(unsigned int i)
+{
+	return i ? &devtree_index.devices[i - 1] : &dev_root;
+}
+
+/* Return the number of a device in devtree_index, -1 if it was allocated at runtime. */
+static int static_dev_number(const struct device *dev)
+{
+	if (dev == &dev_root)
+		return 0;
+	if (dev >= devtree_index.devices &&
+	    dev < devtree_index.devices + devtree_index.device_count)
+		return dev - devtree_index.devices + 1;
+	return -1;
+}
+
+static void path_index(enum device_path_type type, const uint16_t **list, size_t *count)
+{
+	for (size_t i = 0; i < devtree_index.path_count; i++) {
+		if (devtree_index.paths[i].key == type) {
+			*list = &devtree_index.by_path[devtree_index.paths[i].first];
+			*count = devtree_index.paths[i].count;
+			return;
+		}
+	}
+	*list = NULL;
+	*count = 0;
+}
+
+/**
+ * Find the next device on all_devices that matches.
+ *
+ * Only the static devices in the given index list are tried, the devices
+ * allocated at runtime all follow the static ones on all_devices.
+ *
+ * @param prev_match The previously matched device, NULL to start at the beginning.
+ * @param list Device numbers of the static devices that may match, in ascending order.
+ * @param count Number of entries in list.
+ * @param match Returns whether a device matches.
+ * @param arg Argument passed to match().
+ * @return Pointer to the device structure (if found), NULL otherwise.
+ */
+static DEVTREE_CONST struct device *find_next_indexed(
+		DEVTREE_CONST struct device *prev_match,
+		const uint16_t *list, size_t count,
+		bool (*match)(const struct device *dev, const void *arg),
+		const void *arg)
+{
+	DEVTREE_CONST struct device *dev;
+	int prev = prev_match ? static_dev_number(prev_match) : -1;
+
+	if (prev_match && prev < 0) {
+		dev = prev_match->next;
+	} else {
+		size_t lo = 0, hi = count;
+
+		/* Skip the devices up to and including prev_match. */
+		while (lo < hi) {
+			size_t mid = (lo + hi) / 2;
+			if (list[mid] <= prev)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for (; lo < count; lo++) {
+			dev = static_dev(list[lo]);
+			if (match(dev, arg))
+				return dev;
+		}
+
+		dev = static_dev(devtree_index.device_count)->next;
+	}
+
+	for (; dev; dev = dev->next) {
+		if (match(dev, arg))
+			return dev;
+	}
+	return NULL;
+}
+
+static DEVTREE_CONST struct device *find_next_path(
+		DEVTREE_CONST struct device *prev_match, enum device_path_type type,
+		bool (*match)(const struct device *dev, const void *arg),
+		const void *arg)
+{
+	const uint16_t *list;
+	size_t count;
+
+	path_index(type, &list, &count);
+	return find_next_indexed(prev_match, list, count, match, arg);
+}
+
+struct slot_match {
+	unsigned int bus;
+	unsigned int devfn;
+};
+
+static bool match_pci_slot(const struct device *dev, const void *arg)
+{
+	const struct slot_match *slot = arg;
+
+	return dev->path.type == DEVICE_PATH_PCI &&
+	       dev->upstream->secondary == slot->bus &&
+	       dev->upstream->segment_group == 0 &&
+	       dev->path.pci.devfn == slot->devfn;
+}
+
 /**
  * Given a PCI bus and a devfn number, find the device structure.
  *
@@ -29,19 +138,14 @@ DEVTREE_CONST struct device *DEVTREE_CONST all_devices = &dev_root;
 static DEVTREE_CONST struct device *dev_find_slot(unsigned int bus,
 						unsigned int devfn)
 {
-	DEVTREE_CONST struct device *dev, *result;
+	const struct slot_match slot = { .bus = bus, .devfn = devfn };
 
-	result = 0;
-	for (dev = all_devices; dev; dev = dev->next) {
-		if ((dev->path.type == DEVICE_PATH_PCI) &&
-		    (dev->upstream->secondary == bus) &&
-		    (dev->upstream->segment_group == 0) &&
-		    (dev->path.pci.devfn == devfn)) {
-			result = dev;
-			break;
-		}
-	}
-	return result;
+	return find_next_path(NULL, DEVICE_PATH_PCI, match_pci_slot, &slot);
+}
+
+static bool match_path_type(const struct device *dev, const void *arg)
+{
+	return dev->path.type == *(const enum device_path_type *)arg;
 }
 
 /**
@@ -55,21 +159,43 @@ DEVTREE_CONST struct device *dev_find_path(
 		DEVTREE_CONST struct device *prev_match,
 		enum device_path_type path_type)
 {
-	DEVTREE_CONST struct device *dev, *result = NULL;
+	return find_next_path(prev_match, path_type, match_path_type, &path_type);
+}
 
-	if (prev_match == NULL)
-		prev_match = all_devices;
-	else
-		prev_match = prev_match->next;
+#if !DEVTREE_EARLY
+static bool match_chip_ops(const struct device *dev, const void *arg)
+{
+	return dev->chip_ops == arg;
+}
 
-	for (dev = prev_match; dev; dev = dev->next) {
-		if (dev->path.type == path_type) {
-			result = dev;
+/**
+ * Given a chip driver, find the devices it was set for in the devicetree.
+ *
+ * @param prev_match The previously matched device instance.
+ * @param ops The chip operations of the driver.
+ * @return Pointer to the device structure (if found), 0 otherwise.
+ */
+DEVTREE_CONST struct device *dev_find_chip_ops(
+		DEVTREE_CONST struct device *prev_match,
+		const struct chip_operations *ops)
+{
+	const uint16_t *list = NULL;
+	size_t count = 0;
+
+	/* All devices of a chip driver are in the same range. */
+	for (size_t i = 0; i < devtree_index.chip_count; i++) {
+		const struct devtree_index_range *range = &devtree_index.chips[i];
+
+		if (static_dev(devtree_index.by_chip[range->first])->chip_ops == ops) {
+			list = &devtree_index.by_chip[range->first];
+			count = range->count;
 			break;
 		}
 	}
-	return result;
+
+	return find_next_indexed(prev_match, list, count, match_chip_ops, ops);
 }
+#endif
 
 /**
  * Given a device pointer, find the next PCI device.
@@ -257,8 +383,34 @@ DEVTREE_CONST struct bus *pci_root_bus(void)
 	return pci_root;
 }
 
+/* Look up a device on the PCI root bus in the index, which is sorted by devfn. */
+static DEVTREE_CONST struct device *pcidev_path_on_root_indexed(pci_devfn_t devfn)
+{
+	size_t lo = 0, hi = devtree_index.pci_root_count;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		DEVTREE_CONST struct device *dev = static_dev(devtree_index.pci_root[mid]);
+
+		if (dev->path.pci.devfn == devfn)
+			return dev;
+		if (dev->path.pci.devfn < devfn)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
 DEVTREE_CONST struct device *pcidev_path_on_root(pci_devfn_t devfn)
 {
+	/*
+	 * Until ramstage the device tree can't change, so the index is complete.
+	 * PCI enumeration in ramstage adds and removes devices on the bus.
+	 */
+	if (DEVTREE_EARLY && devtree_index.pci_root_count)
+		return pcidev_path_on_root_indexed(devfn);
+
 	return pcidev_path_behind(pci_root_bus(), devfn);
 }
 
@@ -309,21 +461,21 @@ void __noreturn devtree_die(void)
  * @param addr A device number.
  * @return Pointer to the device structure (if found), 0 otherwise.
  */
+static bool match_smbus_slot(const struct device *dev, const void *arg)
+{
+	const struct slot_match *slot = arg;
+
+	return dev->path.type == DEVICE_PATH_I2C &&
+	       dev->upstream->secondary == slot->bus &&
+	       dev->path.i2c.device == slot->devfn;
+}
+
 DEVTREE_CONST struct device *dev_find_slot_on_smbus(unsigned int bus,
 							unsigned int addr)
 {
-	DEVTREE_CONST struct device *dev, *result;
+	const struct slot_match slot = { .bus = bus, .devfn = addr };
 
-	result = 0;
-	for (dev = all_devices; dev; dev = dev->next) {
-		if ((dev->path.type == DEVICE_PATH_I2C) &&
-		    (dev->upstream->secondary == bus) &&
-		    (dev->path.i2c.device == addr)) {
-			result = dev;
-			break;
-		}
-	}
-	return result;
+	return find_next_path(NULL, DEVICE_PATH_I2C, match_smbus_slot, &slot);
 }
 
 /**
@@ -333,18 +485,20 @@ DEVTREE_CONST struct device *dev_find_slot_on_smbus(unsigned int bus,
  * @param device Logical device number.
  * @return Pointer to the device structure (if found), 0 otherwise.
  */
+static bool match_pnp_slot(const struct device *dev, const void *arg)
+{
+	const struct pnp_path *pnp = arg;
+
+	return dev->path.type == DEVICE_PATH_PNP &&
+	       dev->path.pnp.port == pnp->port &&
+	       dev->path.pnp.device == pnp->device;
+}
+
 DEVTREE_CONST struct device *dev_find_slot_pnp(u16 port, u16 device)
 {
-	DEVTREE_CONST struct device *dev;
+	const struct pnp_path pnp = { .port = port, .device = device };
 
-	for (dev = all_devices; dev; dev = dev->next) {
-		if ((dev->path.type == DEVICE_PATH_PNP) &&
-		    (dev->path.pnp.port == port) &&
-		    (dev->path.pnp.device == device)) {
-			return dev;
-		}
-	}
-	return 0;
+	return find_next_path(NULL, DEVICE_PATH_PNP, match_pnp_slot, &pnp);
 }
 
 /**
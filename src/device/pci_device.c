@@ -1418,6 +1418,55 @@ static bool pci_bus_only_one_child(struct bus *bus)
 	return pciexp_is_downstream_port(pcie_type);
 }
 
+/**
+ * Look up the functions found on a bus the last time.
+ *
+ * @param bus Pointer to the bus structure.
+ * @param present Bitmap of the devfns that were found, filled in on success.
+ * @param entries Cached functions of the bus, filled in on success.
+ * @param count Number of cached functions, filled in on success.
+ * @return True if the bus is in the cache.
+ */
+static bool pci_scan_cached(struct bus *bus, u32 present[256 / 32],
+			    const struct pci_topology_entry **entries, size_t *count)
+{
+	size_t i;
+
+	if (!pci_topology_cache_lookup(bus, entries, count))
+		return false;
+
+	memset(present, 0, 256 / 8);
+	for (i = 0; i < *count; i++)
+		present[(*entries)[i].devfn / 32] |= 1U << ((*entries)[i].devfn % 32);
+
+	return true;
+}
+
+/**
+ * Check a function that is not in the devicetree against the cache, after
+ * pci_probe_dev() read its vendor and device ID.
+ *
+ * @return True if the function is gone or has a different ID.
+ */
+static bool pci_cached_function_changed(const struct bus *bus, const struct device *dev,
+					unsigned int devfn,
+					const struct pci_topology_entry *entries, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (entries[i].devfn == devfn)
+			break;
+	}
+
+	if (i < count && dev && entries[i].id == (dev->device << 16 | dev->vendor))
+		return false;
+
+	printk(BIOS_INFO, "PCI: %02x:%02x.%01x changed, scanning all buses\n",
+	       bus->secondary, PCI_SLOT(devfn), PCI_FUNC(devfn));
+	return true;
+}
+
 /**
  * Scan a PCI bus.
  *
@@ -1434,6 +1483,10 @@ void pci_scan_bus(struct bus *bus, unsigned int min_devfn,
 	unsigned int devfn;
 	struct device *dev, **prev;
 	int once = 0;
+	u32 present[256 / 32], probed[256 / 32] = { 0 };
+	const struct pci_topology_entry *entries;
+	size_t count;
+	bool cached = false, rescan;
 
 	printk(BIOS_DEBUG, "PCI: %s for segment group %02x bus %02x\n", __func__,
 	       bus->segment_group, bus->secondary);
@@ -1450,42 +1503,76 @@ void pci_scan_bus(struct bus *bus, unsigned int min_devfn,
 
 	if (pci_bus_only_one_child(bus))
 		max_devfn = MIN(max_devfn, 0x07);
+	else if (CONFIG(PCI_TOPOLOGY_CACHE))
+		cached = pci_scan_cached(bus, present, &entries, &count);
 
 	/*
 	 * Probe all devices/functions on this bus with some optimization for
 	 * non-existence and single function devices.
+	 *
+	 * With a cached topology, only the functions found the last time are
+	 * probed. If one of them changed, the bus is scanned again without the
+	 * cache. Functions that were already probed are then only put back in
+	 * order, pci_scan_get_dev() finds them on the bus.
 	 */
-	for (devfn = min_devfn; devfn <= max_devfn; devfn++) {
-		if (CONFIG(MINIMAL_PCI_SCANNING)) {
-			dev = pcidev_path_behind(bus, devfn);
-			if (!dev || !dev->mandatory)
+	do {
+		rescan = false;
+		for (devfn = min_devfn; devfn <= max_devfn; devfn++) {
+			const u32 bit = 1U << (devfn % 32);
+			bool dynamic;
+
+			if (CONFIG(MINIMAL_PCI_SCANNING)) {
+				dev = pcidev_path_behind(bus, devfn);
+				if (!dev || !dev->mandatory)
+					continue;
+			}
+
+			/* Skip functions that weren't there the last time. */
+			if (cached && !(present[devfn / 32] & bit) &&
+			    !pcidev_path_behind(bus, devfn))
 				continue;
-		}
 
-		/* First thing setup the device structure. */
-		dev = pci_scan_get_dev(bus, devfn);
+			/* First thing setup the device structure. */
+			dev = pci_scan_get_dev(bus, devfn);
+			dynamic = !dev;
 
-		/* Devices marked 'hidden' do not get probed */
-		if (dev && dev->hidden) {
-			pci_scan_hidden_device(dev);
+			if (probed[devfn / 32] & bit) {
+				if (dev && dev->hidden)
+					continue;
+			} else {
+				probed[devfn / 32] |= bit;
 
-			/* Skip pci_probe_dev, go to next devfn */
-			continue;
-		}
+				/* Devices marked 'hidden' do not get probed */
+				if (dev && dev->hidden) {
+					pci_scan_hidden_device(dev);
 
-		/* See if a device is present and setup the device structure. */
-		dev = pci_probe_dev(dev, bus, devfn);
+					/* Skip pci_probe_dev, go to next devfn */
+					continue;
+				}
 
-		/*
-		 * If this is not a multi function device, or the device is
-		 * not present don't waste time probing another function.
-		 * Skip to next device.
-		 */
-		if ((PCI_FUNC(devfn) == 0x00) && (!dev
-		     || (dev->enabled && ((dev->hdr_type & 0x80) != 0x80)))) {
-			devfn += 0x07;
+				/* See if a device is present and setup the device structure. */
+				dev = pci_probe_dev(dev, bus, devfn);
+
+				if (cached && dynamic &&
+				    pci_cached_function_changed(bus, dev, devfn, entries, count)) {
+					pci_topology_cache_invalidate();
+					cached = false;
+					rescan = true;
+					break;
+				}
+			}
+
+			/*
+			 * If this is not a multi function device, or the device is
+			 * not present don't waste time probing another function.
+			 * Skip to next device.
+			 */
+			if ((PCI_FUNC(devfn) == 0x00) && (!dev
+			     || (dev->enabled && ((dev->hdr_type & 0x80) != 0x80)))) {
+				devfn += 0x07;
+			}
 		}
-	}
+	} while (rescan);
 
 	/*
 	 * Warn if any leftover static devices are found.
@@ -1525,6 +1612,9 @@ void pci_scan_bus(struct bus *bus, unsigned int min_devfn,
 	if (once)
 		printk(BIOS_WARNING, "PCI: Check your devicetree.cb.\n");
 
+	if (CONFIG(PCI_TOPOLOGY_CACHE))
+		pci_topology_cache_record(bus);
+
 	/*
 	 * For all children that implement scan_bus() (i.e. bridges)
 	 * scan the bus behind that child.
@@ -0,0 +1,234 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <acpi/acpi.h>
+#include <bootstate.h>
+#include <commonlib/region.h>
+#include <console/console.h>
+#include <device/device.h>
+#include <device/pci.h>
+#include <fmap.h>
+#include <region_file.h>
+#include <string.h>
+#include <types.h>
+#include <version.h>
+#include <xxhash.h>
+
+#define PCI_CACHE_REGION	"RW_PCI_CACHE"
+#define PCI_CACHE_SIGNATURE	(('P' << 0) | ('C' << 8) | ('I' << 16) | ('c' << 24))
+#define PCI_CACHE_MAX_ENTRIES	512
+
+struct pci_cache_header {
+	uint32_t signature;
+	uint32_t count;
+	uint64_t key;
+	uint64_t data_hash;
+} __packed;
+
+struct pci_topology {
+	size_t count;
+	struct pci_topology_entry entries[PCI_CACHE_MAX_ENTRIES];
+};
+
+/* The topology read from flash and the one found during this boot. */
+static struct pci_topology cached, found;
+static bool cache_loaded, cache_valid, found_overflow;
+
+/* Drivers may make functions appear or disappear, so a new build starts over. */
+static uint64_t pci_cache_key(void)
+{
+	return coreboot_build_hash();
+}
+
+static uint64_t pci_cache_data_hash(const struct pci_topology *topology)
+{
+	return xxh64(topology->entries, topology->count * sizeof(topology->entries[0]), 0);
+}
+
+static int pci_cache_open(struct region_file *file, struct region_device *rdev)
+{
+	if (fmap_locate_area_as_rdev_rw(PCI_CACHE_REGION, rdev) < 0) {
+		printk(BIOS_WARNING, "PCI: Unable to find %s in FMAP\n", PCI_CACHE_REGION);
+		return -1;
+	}
+
+	if (region_file_init(file, rdev) < 0) {
+		printk(BIOS_ERR, "PCI: Unable to open topology cache\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+void pci_topology_cache_load(void)
+{
+	struct region_device rdev, data;
+	struct region_file file;
+	struct pci_cache_header header;
+	size_t size;
+
+	cached.count = 0;
+	found.count = 0;
+	cache_loaded = false;
+	cache_valid = false;
+	found_overflow = false;
+
+	if (pci_cache_open(&file, &rdev) < 0)
+		return;
+
+	if (region_file_data(&file, &data) < 0 ||
+	    rdev_readat(&data, &header, 0, sizeof(header)) != sizeof(header))
+		return;
+
+	size = header.count * sizeof(cached.entries[0]);
+	if (header.signature != PCI_CACHE_SIGNATURE || header.key != pci_cache_key() ||
+	    header.count > ARRAY_SIZE(cached.entries) ||
+	    region_device_sz(&data) < sizeof(header) + size) {
+		printk(BIOS_DEBUG, "PCI: No cached topology for this firmware\n");
+		return;
+	}
+
+	if (rdev_readat(&data, cached.entries, sizeof(header), size) != size)
+		return;
+
+	cached.count = header.count;
+	if (pci_cache_data_hash(&cached) != header.data_hash) {
+		printk(BIOS_ERR, "PCI: Cached topology is corrupted\n");
+		cached.count = 0;
+		return;
+	}
+
+	printk(BIOS_DEBUG, "PCI: Using cached topology of %u entries\n", header.count);
+	cache_loaded = true;
+	cache_valid = true;
+}
+
+static bool is_bus_entry(const struct pci_topology_entry *entry, const struct bus *bus)
+{
+	return entry->id == 0 && entry->segment_group == bus->segment_group &&
+		entry->bus == bus->secondary;
+}
+
+bool pci_topology_cache_lookup(const struct bus *bus, const struct pci_topology_entry **entries,
+			       size_t *count)
+{
+	size_t i, n;
+
+	if (!cache_valid)
+		return false;
+
+	for (i = 0; i < cached.count; i++) {
+		if (is_bus_entry(&cached.entries[i], bus))
+			break;
+	}
+
+	/* The bus wasn't scanned before. */
+	if (i == cached.count)
+		return false;
+
+	i++;
+	for (n = 0; i + n < cached.count && cached.entries[i + n].id != 0; n++)
+		;
+
+	*entries = &cached.entries[i];
+	*count = n;
+	return true;
+}
+
+static void record_entry(const struct bus *bus, unsigned int devfn, uint32_t id, uint32_t class)
+{
+	if (found.count == ARRAY_SIZE(found.entries)) {
+		found_overflow = true;
+		return;
+	}
+
+	found.entries[found.count++] = (struct pci_topology_entry) {
+		.segment_group = bus->segment_group,
+		.bus = bus->secondary,
+		.devfn = devfn,
+		.id = id,
+		.class = class,
+	};
+}
+
+void pci_topology_cache_record(const struct bus *bus)
+{
+	const struct device *dev;
+
+	record_entry(bus, 0, 0, 0);
+
+	/* Devices that weren't found or are hidden keep a vendor ID of 0. */
+	for (dev = bus->children; dev; dev = dev->sibling) {
+		if (dev->path.type != DEVICE_PATH_PCI || dev->hidden || !dev->vendor)
+			continue;
+		record_entry(bus, dev->path.pci.devfn, dev->device << 16 | dev->vendor,
+			     dev->class);
+	}
+}
+
+void pci_topology_cache_invalidate(void)
+{
+	cache_valid = false;
+}
+
+void pci_topology_cache_save(void)
+{
+	struct region_device rdev;
+	struct region_file file;
+	/*
+	 * Buses scanned before an invalidation were still filtered by the stale cache
+	 * and may lack functions. Only drop the cache then, the next boot does a full
+	 * scan and saves what it finds. A topology that doesn't fit replaces the
+	 * cache the same way.
+	 */
+	const bool stale = cache_loaded && (!cache_valid || found_overflow);
+
+	if (found_overflow) {
+		printk(BIOS_WARNING, "PCI: Too many functions to cache the topology\n");
+		if (!stale)
+			return;
+	}
+
+	/* Only write the flash when the topology changed. */
+	if (!stale && cache_loaded && cached.count == found.count &&
+	    !memcmp(cached.entries, found.entries, found.count * sizeof(found.entries[0])))
+		return;
+
+	/* Leave the flash alone while resuming. */
+	if (acpi_is_wakeup_s3())
+		return;
+
+	struct pci_cache_header header = {
+		.signature = stale ? 0 : PCI_CACHE_SIGNATURE,
+		.count = stale ? 0 : found.count,
+		.key = pci_cache_key(),
+		.data_hash = pci_cache_data_hash(&found),
+	};
+
+	const struct update_region_file_entry entries[] = {
+		{ .size = sizeof(header), .data = &header },
+		{ .size = header.count * sizeof(found.entries[0]), .data = found.entries },
+	};
+
+	if (pci_cache_open(&file, &rdev) < 0)
+		return;
+
+	if (region_file_update_data_arr(&file, entries, ARRAY_SIZE(entries)) < 0)
+		printk(BIOS_ERR, "PCI: Failed to update the topology cache\n");
+	else if (stale)
+		printk(BIOS_DEBUG, "PCI: Dropped the stale topology cache\n");
+	else
+		printk(BIOS_DEBUG, "PCI: Cached topology of %u entries\n", header.count);
+}
+
+static void load_cache(void *unused)
+{
+	pci_topology_cache_load();
+}
+
+static void save_cache(void *unused)
+{
+	pci_topology_cache_save();
+}
+
+BOOT_STATE_INIT_ENTRY(BS_DEV_ENUMERATE, BS_ON_ENTRY, load_cache, NULL);
+BOOT_STATE_INIT_ENTRY(BS_DEV_ENUMERATE, BS_ON_EXIT, save_cache, NULL);
@@ -46,14 +46,33 @@ struct elog_state {
 	size_t mirror_last_write;
 	size_t nv_last_write;
 
+	/* Offset of the newest event in the mirror, 0 if there is none. */
+	size_t last_event;
+
 	struct region_device nv_dev;
 	/* Device that mirrors the eventlog in memory. */
 	struct region_device mirror_dev;
 
+	/* Events are only added to the mirror until elog_flush() is called. */
+	bool defer_nv_writes;
+
 	enum elog_init_state elog_initialized;
 };
 
-static struct elog_state elog_state;
+static struct elog_state elog_state = {
+	.defer_nv_writes = ENV_RAMSTAGE && CONFIG(ELOG_DEFER_NV_WRITES),
+};
+
+/*
+ * Tail of the log as last seen in NV storage by an earlier stage of this boot. The events
+ * before the tail don't need to be validated again as long as the newest event still ends
+ * at the tail and nothing was written behind it.
+ */
+struct elog_tail_hint {
+	u32 nv_offset;
+	u32 last_event;
+	u32 tail;
+};
 
 #define ELOG_SIZE (4 * KiB)
 static uint8_t elog_mirror_buf[ELOG_SIZE];
@@ -150,6 +169,7 @@ static size_t elog_nv_region_to_update(size_t *offset)
  */
 static void elog_tandem_reset_last_write(void)
 {
+	elog_state.last_event = 0;
 	elog_mirror_reset_last_write();
 	elog_nv_reset_last_write();
 }
@@ -307,15 +327,80 @@ static void elog_nv_erase(void)
 		printk(BIOS_ERR, "ELOG: erase failure.\n");
 }
 
+static struct elog_tail_hint *elog_get_tail_hint(bool create)
+{
+	if (!cbmem_online())
+		return NULL;
+
+	if (create)
+		return cbmem_add(CBMEM_ID_ELOG_HINT, sizeof(struct elog_tail_hint));
+
+	return cbmem_find(CBMEM_ID_ELOG_HINT);
+}
+
+/* Record the tail once the NV storage holds everything in the mirror. */
+static void elog_save_tail_hint(void)
+{
+	struct elog_tail_hint *hint;
+
+	if (elog_nv_needs_update() || elog_state.last_event == 0)
+		return;
+
+	hint = elog_get_tail_hint(true);
+	if (hint == NULL)
+		return;
+
+	hint->nv_offset = region_device_offset(&elog_state.nv_dev);
+	hint->last_event = elog_state.last_event;
+	hint->tail = elog_state.mirror_last_write;
+}
+
+/*
+ * Return the offset from which the events still need to be validated. Only the newest
+ * event and the byte behind it are checked; the scan still makes sure the rest is erased.
+ */
+static size_t elog_validate_from(void)
+{
+	const struct elog_tail_hint *hint = elog_get_tail_hint(false);
+	uint8_t type;
+
+	if (hint == NULL)
+		return elog_events_start();
+
+	if (hint->nv_offset != region_device_offset(&elog_state.nv_dev) ||
+	    hint->last_event < elog_events_start() ||
+	    hint->last_event >= hint->tail ||
+	    hint->tail >= region_device_sz(mirror_dev_get()))
+		return elog_events_start();
+
+	if (elog_is_event_valid(hint->last_event) != hint->tail - hint->last_event ||
+	    rdev_readat(mirror_dev_get(), &type, hint->tail, sizeof(type)) < 0 ||
+	    type != ELOG_TYPE_EOL) {
+		elog_debug("ELOG: tail hint doesn't match the log\n");
+		return elog_events_start();
+	}
+
+	elog_state.last_event = hint->last_event;
+	return hint->tail;
+}
+
 /*
  * Scan the event area and validate each entry and update the ELOG state.
  */
 static int elog_update_event_buffer_state(void)
 {
 	size_t offset = elog_events_start();
+	const size_t validated = elog_validate_from();
 
 	elog_debug("%s()\n", __func__);
 
+	/* Skip the events an earlier stage already validated. */
+	if (validated > offset) {
+		elog_debug("ELOG: events validated up to 0x%zx\n", validated);
+		elog_tandem_increment_last_write(validated - offset);
+		offset = validated;
+	}
+
 	/* Go through each event and validate it */
 	while (1) {
 		uint8_t type;
@@ -342,6 +427,7 @@ static int elog_update_event_buffer_state(void)
 		}
 
 		/* Move to the next event */
+		elog_state.last_event = offset;
 		elog_tandem_increment_last_write(len);
 		offset += len;
 	}
@@ -675,8 +761,10 @@ static int elog_sync_to_nv(void)
 	 * If erase wasn't performed then don't rescan. Assume the appended
 	 * write was successful.
 	 */
-	if (!erase_needed)
+	if (!erase_needed) {
+		elog_save_tail_hint();
 		return 0;
+	}
 
 	elog_debug_dump_buffer("ELOG: in-memory mirror:\n");
 
@@ -688,9 +776,21 @@ static int elog_sync_to_nv(void)
 		return -1;
 	}
 
+	elog_save_tail_hint();
 	return 0;
 }
 
+/*
+ * Write the events added since the last flush to NV storage.
+ */
+int elog_flush(void)
+{
+	if (elog_state.elog_initialized != ELOG_INITIALIZED)
+		return 0;
+
+	return elog_sync_to_nv();
+}
+
 /*
  * Do not log boot count events in S3 resume or SMM.
  */
@@ -770,9 +870,13 @@ int elog_init(void)
 	elog_state.elog_initialized = ELOG_INITIALIZED;
 
 	/* Load the log from flash and prepare the flash if necessary. */
-	if (elog_scan_flash() < 0 && elog_prepare_empty() < 0) {
-		printk(BIOS_ERR, "ELOG: Unable to prepare flash\n");
-		return -1;
+	if (elog_scan_flash() < 0) {
+		if (elog_prepare_empty() < 0) {
+			printk(BIOS_ERR, "ELOG: Unable to prepare flash\n");
+			return -1;
+		}
+	} else {
+		elog_save_tail_hint();
 	}
 
 	printk(BIOS_INFO, "ELOG: area is %zu bytes, full threshold %d,"
@@ -836,6 +940,7 @@ int elog_add_event_raw(u8 event_type, void *data, u8 data_size)
 	elog_update_checksum(event, -(elog_checksum_event(event)));
 	elog_put_event_buffer(event);
 
+	elog_state.last_event = elog_state.mirror_last_write;
 	elog_mirror_increment_last_write(event_size);
 
 	printk(BIOS_INFO, "ELOG: Event(%X) added with size %d ",
@@ -852,6 +957,10 @@ int elog_add_event_raw(u8 event_type, void *data, u8 data_size)
 	if (elog_shrink() < 0)
 		return -1;
 
+	/* Ramstage collects its events and writes them out in elog_flush(). */
+	if (elog_state.defer_nv_writes)
+		return 0;
+
 	/* Ensure the updates hit the non-volatile storage. */
 	return elog_sync_to_nv();
 }
@@ -899,3 +1008,14 @@ int elog_add_extended_event(u8 type, u32 complement)
 /* Make sure elog_init() runs at least once to log System Boot event. */
 static void elog_bs_init(void *unused) { elog_init(); }
 BOOT_STATE_INIT_ENTRY(BS_POST_DEVICE, BS_ON_ENTRY, elog_bs_init, NULL);
+
+/*
+ * Write the deferred events before the flash may get locked down, like the MRC cache does.
+ * Events logged after this point are written right away.
+ */
+static void elog_bs_flush(void *unused)
+{
+	elog_state.defer_nv_writes = false;
+	elog_flush();
+}
+BOOT_STATE_INIT_ENTRY(BS_OS_RESUME_CHECK, BS_ON_ENTRY, elog_bs_flush, NULL);
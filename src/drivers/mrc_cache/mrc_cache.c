@@ -4,6 +4,7 @@
 #include <boot_device.h>
 #include <bootstate.h>
 #include <bootmode.h>
+#include <cbfs.h>
 #include <console/console.h>
 #include <cbmem.h>
 #include <elog.h>
@@ -22,19 +23,46 @@
 #define RECOVERY_MRC_CACHE	"RECOVERY_MRC_CACHE"
 #define UNIFIED_MRC_CACHE	"UNIFIED_MRC_CACHE"
 
-/* Signature "MRCD" was used for older header format before CB:67670. */
-#define MRC_DATA_SIGNATURE       (('M'<<0)|('R'<<8)|('C'<<16)|('d'<<24))
+/*
+ * Signature "MRCD" was used for older header format before CB:67670. Signature "MRCd" was
+ * used for the header format with an xxh32 data hash and without delta updates.
+ */
+#define MRC_DATA_SIGNATURE       (('M'<<0)|('R'<<8)|('C'<<16)|('h'<<24))
 
 static const uint32_t mrc_invalid_sig = ~MRC_DATA_SIGNATURE;
 
+/* The slot holds a delta against the full copy at base_offset instead of the data. */
+#define MRC_FLAG_DELTA		(1 << 0)
+/* The data could not be reconstructed from a delta, only full copies may be written. */
+#define MRC_FLAG_NO_DELTA	(1 << 1)
+
 struct mrc_metadata {
 	uint32_t signature;
 	uint32_t data_size;
-	uint32_t data_hash;
+	uint64_t data_hash;
 	uint32_t header_hash;
 	uint32_t version;
+	uint32_t flags;
+	/* The following fields are only valid with MRC_FLAG_DELTA. */
+	uint32_t delta_size;
+	uint32_t base_offset;
+	uint64_t base_hash;
 } __packed;
 
+/*
+ * A delta consists of runs, each one a header followed by the new bytes at that offset.
+ * Everything outside of the runs is taken from the full copy the delta was taken against.
+ */
+struct mrc_delta_run {
+	uint32_t offset;
+	uint32_t size;
+} __packed;
+
+#define MRC_DELTA_MAX_RUNS	16
+
+/* Set when a delta couldn't be applied, so that the retrained data is written in full. */
+static bool delta_unusable;
+
 enum result {
 	UPDATE_FAILURE		= -1,
 	UPDATE_SUCCESS		= 0,
@@ -168,6 +196,14 @@ static const struct cache_region *lookup_region(struct region *r, int type)
 	return cr;
 }
 
+/* Size of what is stored after the metadata, which is either the data or a delta. */
+static size_t mrc_payload_size(const struct mrc_metadata *md)
+{
+	if (md->flags & MRC_FLAG_DELTA)
+		return md->delta_size;
+	return md->data_size;
+}
+
 static int mrc_header_valid(struct region_device *rdev, struct mrc_metadata *md)
 {
 	uint32_t hash;
@@ -208,7 +244,7 @@ static int mrc_header_valid(struct region_device *rdev, struct mrc_metadata *md)
 
 	/* Re-size the region device according to the metadata as a region_file
 	 * does block allocation. */
-	size = sizeof(*md) + md->data_size;
+	size = sizeof(*md) + mrc_payload_size(md);
 	if (rdev_chain(rdev, rdev, 0, size) < 0) {
 		printk(BIOS_ERR, "MRC: size exceeds rdev size: %zx vs %zx\n",
 			size, region_device_sz(rdev));
@@ -221,7 +257,7 @@ static int mrc_header_valid(struct region_device *rdev, struct mrc_metadata *md)
 static int mrc_data_valid(int type, const struct mrc_metadata *md,
 			  void *data, size_t data_size)
 {
-	uint32_t hash;
+	uint64_t hash;
 	const struct cache_region *cr = lookup_region_type(type);
 	uint32_t hash_idx;
 
@@ -236,11 +272,11 @@ static int mrc_data_valid(int type, const struct mrc_metadata *md,
 		if (!mrc_cache_verify_hash(hash_idx, data, data_size))
 			return -1;
 	} else {
-		hash = xxh32(data, data_size, 0);
+		hash = xxh64(data, data_size, 0);
 
 		if (md->data_hash != hash) {
-			printk(BIOS_ERR, "MRC: data hash mismatch: %x vs %x\n",
-			       md->data_hash, hash);
+			printk(BIOS_ERR, "MRC: data hash mismatch: %llx vs %llx\n",
+			       (unsigned long long)md->data_hash, (unsigned long long)hash);
 			return -1;
 		}
 	}
@@ -255,6 +291,9 @@ static int mrc_cache_get_latest_slot_info(const char *name,
 				struct region_device *rdev,
 				bool fail_bad_data)
 {
+	/* Leave no stale metadata behind for callers that don't fail on bad data. */
+	memset(md, 0, sizeof(*md));
+
 	/* Init and obtain a handle to the file data. */
 	if (region_file_init(cache_file, backing_rdev) < 0) {
 		printk(BIOS_ERR, "MRC: region file invalid in '%s'\n", name);
@@ -273,21 +312,72 @@ static int mrc_cache_get_latest_slot_info(const char *name,
 
 	/* Validate header and resize region to reflect actual usage on the
 	 * saved medium (including metadata and data). */
-	if (mrc_header_valid(rdev, md) < 0)
+	if (mrc_header_valid(rdev, md) < 0) {
+		memset(md, 0, sizeof(*md));
 		return fail_bad_data ? -1 : 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Reconstruct the data of a delta slot into buffer. The full copy it was taken against is
+ * still in the region file, as the region file only gets emptied for full copies.
+ */
+static int mrc_delta_apply(const struct region_device *region_rdev,
+			   const struct region_device *delta_rdev,
+			   const struct mrc_metadata *md, void *buffer)
+{
+	struct region_device base_rdev;
+	struct mrc_metadata base_md;
+	struct mrc_delta_run run;
+	size_t offset = 0;
+
+	if (md->base_offset >= region_device_sz(region_rdev) ||
+	    rdev_chain(&base_rdev, region_rdev, md->base_offset,
+		       region_device_sz(region_rdev) - md->base_offset) < 0)
+		return -1;
+
+	if (mrc_header_valid(&base_rdev, &base_md) < 0)
+		return -1;
+
+	if ((base_md.flags & MRC_FLAG_DELTA) || base_md.data_hash != md->base_hash ||
+	    base_md.data_size != md->data_size) {
+		printk(BIOS_ERR, "MRC: delta base mismatch\n");
+		return -1;
+	}
+
+	if (rdev_readat(&base_rdev, buffer, sizeof(base_md), base_md.data_size) !=
+	    base_md.data_size)
+		return -1;
+
+	while (offset < region_device_sz(delta_rdev)) {
+		if (rdev_readat(delta_rdev, &run, offset, sizeof(run)) != sizeof(run))
+			return -1;
+		offset += sizeof(run);
+
+		if (run.offset > md->data_size || run.size > md->data_size - run.offset) {
+			printk(BIOS_ERR, "MRC: delta run out of bounds: %x+%x\n",
+			       run.offset, run.size);
+			return -1;
+		}
+
+		if (rdev_readat(delta_rdev, buffer + run.offset, offset, run.size) != run.size)
+			return -1;
+		offset += run.size;
+	}
 
 	return 0;
 }
 
 static int mrc_cache_find_current(int type, uint32_t version,
+				  struct region_device *read_rdev,
 				  struct region_device *rdev,
 				  struct mrc_metadata *md)
 {
 	const struct cache_region *cr;
 	struct region region;
-	struct region_device read_rdev;
 	struct region_file cache_file;
-	size_t data_size;
 	const size_t md_size = sizeof(*md);
 	const bool fail_bad_data = true;
 
@@ -304,11 +394,11 @@ static int mrc_cache_find_current(int type, uint32_t version,
 	if (cr == NULL)
 		return -1;
 
-	if (boot_device_ro_subregion(&region, &read_rdev) < 0)
+	if (boot_device_ro_subregion(&region, read_rdev) < 0)
 		return -1;
 
 	if (mrc_cache_get_latest_slot_info(cr->name,
-					   &read_rdev,
+					   read_rdev,
 					   md,
 					   &cache_file,
 					   rdev,
@@ -321,27 +411,34 @@ static int mrc_cache_find_current(int type, uint32_t version,
 		return -1;
 	}
 
-	/* Re-size rdev to only contain the data. i.e. remove metadata. */
-	data_size = md->data_size;
-	return rdev_chain(rdev, rdev, md_size, data_size);
+	/* Re-size rdev to only contain the data or delta. i.e. remove metadata. */
+	return rdev_chain(rdev, rdev, md_size, mrc_payload_size(md));
 }
 
 ssize_t mrc_cache_load_current(int type, uint32_t version, void *buffer,
 			      size_t buffer_size)
 {
+	struct region_device read_rdev;
 	struct region_device rdev;
 	struct mrc_metadata md;
 	ssize_t data_size;
 
-	if (mrc_cache_find_current(type, version, &rdev, &md) < 0)
+	if (mrc_cache_find_current(type, version, &read_rdev, &rdev, &md) < 0)
 		return -1;
 
-	data_size = region_device_sz(&rdev);
+	data_size = md.data_size;
 	if (buffer_size < data_size)
 		return -1;
 
-	if (rdev_readat(&rdev, buffer, 0, data_size) != data_size)
+	if (md.flags & MRC_FLAG_DELTA) {
+		if (mrc_delta_apply(&read_rdev, &rdev, &md, buffer) < 0) {
+			printk(BIOS_ERR, "MRC: failed to apply delta update.\n");
+			delta_unusable = true;
+			return -1;
+		}
+	} else if (rdev_readat(&rdev, buffer, 0, data_size) != data_size) {
 		return -1;
+	}
 
 	if (mrc_data_valid(type, &md, buffer, data_size) < 0)
 		return -1;
@@ -352,18 +449,32 @@ ssize_t mrc_cache_load_current(int type, uint32_t version, void *buffer,
 void *mrc_cache_current_mmap_leak(int type, uint32_t version,
 				  size_t *data_size)
 {
+	struct region_device read_rdev;
 	struct region_device rdev;
 	void *data;
 	size_t region_device_size;
 	struct mrc_metadata md;
 
-	if (mrc_cache_find_current(type, version, &rdev, &md) < 0)
+	if (mrc_cache_find_current(type, version, &read_rdev, &rdev, &md) < 0)
 		return NULL;
 
-	region_device_size = region_device_sz(&rdev);
+	region_device_size = md.data_size;
 	if (data_size)
 		*data_size = region_device_size;
-	data = rdev_mmap_full(&rdev);
+
+	/* A delta has to be applied to a copy, like cbfs_map() does for compressed files. */
+	if (md.flags & MRC_FLAG_DELTA) {
+		data = mem_pool_alloc(&cbfs_cache, region_device_size);
+		if (data == NULL || mrc_delta_apply(&read_rdev, &rdev, &md, data) < 0) {
+			printk(BIOS_ERR, "MRC: failed to apply delta update.\n");
+			if (data)
+				mem_pool_free(&cbfs_cache, data);
+			delta_unusable = true;
+			return NULL;
+		}
+	} else {
+		data = rdev_mmap_full(&rdev);
+	}
 
 	if (data == NULL) {
 		printk(BIOS_INFO, "MRC: mmap failure.\n");
@@ -376,33 +487,145 @@ void *mrc_cache_current_mmap_leak(int type, uint32_t version,
 	return data;
 }
 
-static bool mrc_cache_needs_update(const struct region_device *rdev,
-				   const struct mrc_metadata *new_md,
-				   size_t new_data_size)
+static bool mrc_cache_needs_update(const struct mrc_metadata *md,
+				   const struct mrc_metadata *new_md)
 {
-	void *mapping;
-	size_t old_data_size = region_device_sz(rdev) - sizeof(struct mrc_metadata);
-	bool need_update = false;
-
-	if (new_data_size != old_data_size)
+	/*
+	 * The data hash covers all of the data, so comparing the metadata is enough and the
+	 * old data doesn't have to be read back. A delta slot carries the hash of the data
+	 * it reconstructs, not the hash of the delta itself.
+	 */
+	if (md->signature != new_md->signature || md->data_size != new_md->data_size ||
+	    md->version != new_md->version || md->data_hash != new_md->data_hash)
 		return true;
 
-	mapping = rdev_mmap_full(rdev);
-	if (mapping == NULL) {
-		printk(BIOS_ERR, "MRC: cannot mmap existing cache.\n");
+	/* The delta couldn't be applied on this boot, replace it with a full copy. */
+	if ((new_md->flags & MRC_FLAG_NO_DELTA) && (md->flags & MRC_FLAG_DELTA))
 		return true;
+
+	return false;
+}
+
+/*
+ * Find the ranges where new differs from old. Differing ranges separated by no more than
+ * a run header are merged, as a separate run would not make the delta any smaller.
+ * Returns the number of runs or -1 if more than max_runs are needed.
+ */
+static int mrc_delta_runs(const uint8_t *old, const uint8_t *new, size_t size,
+			  struct mrc_delta_run *runs, int max_runs)
+{
+	struct mrc_delta_run *last = NULL;
+	int num_runs = 0;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (old[i] == new[i])
+			continue;
+
+		if (last && i - (last->offset + last->size) <= sizeof(*last)) {
+			last->size = i + 1 - last->offset;
+			continue;
+		}
+
+		if (num_runs == max_runs)
+			return -1;
+
+		last = &runs[num_runs++];
+		last->offset = i;
+		last->size = 1;
 	}
 
-	/*
-	 * Compare the old and new metadata only. If the data hashes don't
-	 * match, the comparison will fail.
-	 */
-	if (memcmp(new_md, mapping, sizeof(struct mrc_metadata)))
-		need_update = true;
+	return num_runs;
+}
 
-	rdev_munmap(rdev, mapping);
+/*
+ * Try to write the new data as a delta against the last full copy in the region file.
+ * Returns 0 when the delta was written, 1 when a full copy has to be written instead and
+ * -1 when writing the delta failed.
+ */
+static int mrc_cache_update_delta(struct region_file *cache_file,
+				  const struct region_device *backing_rdev,
+				  const struct region_device *latest_rdev,
+				  const struct mrc_metadata *md,
+				  const struct mrc_metadata *new_md,
+				  const void *new_data)
+{
+	struct mrc_delta_run runs[MRC_DELTA_MAX_RUNS];
+	struct update_region_file_entry entries[1 + 2 * ARRAY_SIZE(runs)];
+	struct mrc_metadata dmd = *new_md;
+	struct mrc_metadata base_md;
+	struct region_device base_rdev;
+	ssize_t base_offset;
+	size_t delta_size = 0;
+	void *base_data;
+	int num_runs;
+	int i;
+
+	if (!CONFIG(MRC_CACHE_DELTA_UPDATES))
+		return 1;
+
+	if (md->signature != MRC_DATA_SIGNATURE || md->version != new_md->version ||
+	    md->data_size != new_md->data_size || (new_md->flags & MRC_FLAG_NO_DELTA))
+		return 1;
 
-	return need_update;
+	/* Deltas are always taken against a full copy, never against another delta. */
+	if (md->flags & MRC_FLAG_DELTA)
+		base_offset = md->base_offset;
+	else
+		base_offset = rdev_relative_offset(backing_rdev, latest_rdev);
+
+	if (base_offset < 0 || base_offset >= region_device_sz(backing_rdev) ||
+	    rdev_chain(&base_rdev, backing_rdev, base_offset,
+		       region_device_sz(backing_rdev) - base_offset) < 0)
+		return 1;
+
+	if (mrc_header_valid(&base_rdev, &base_md) < 0 || (base_md.flags & MRC_FLAG_DELTA) ||
+	    base_md.data_size != new_md->data_size || base_md.version != new_md->version)
+		return 1;
+
+	if ((md->flags & MRC_FLAG_DELTA) && base_md.data_hash != md->base_hash)
+		return 1;
+
+	base_data = rdev_mmap(&base_rdev, sizeof(base_md), base_md.data_size);
+	if (base_data == NULL)
+		return 1;
+
+	num_runs = mrc_delta_runs(base_data, new_data, new_md->data_size, runs,
+				  ARRAY_SIZE(runs));
+	rdev_munmap(&base_rdev, base_data);
+
+	if (num_runs < 0)
+		return 1;
+
+	entries[0].size = sizeof(dmd);
+	entries[0].data = &dmd;
+	for (i = 0; i < num_runs; i++) {
+		entries[1 + 2 * i].size = sizeof(runs[i]);
+		entries[1 + 2 * i].data = &runs[i];
+		entries[2 + 2 * i].size = runs[i].size;
+		entries[2 + 2 * i].data = (const uint8_t *)new_data + runs[i].offset;
+		delta_size += sizeof(runs[i]) + runs[i].size;
+	}
+
+	/* Only worth it for small changes that don't cause the region file to be emptied. */
+	if (delta_size > new_md->data_size / 4 ||
+	    !region_file_update_fits(cache_file, sizeof(dmd) + delta_size))
+		return 1;
+
+	dmd.flags |= MRC_FLAG_DELTA;
+	dmd.delta_size = delta_size;
+	dmd.base_offset = base_offset;
+	dmd.base_hash = base_md.data_hash;
+	dmd.header_hash = 0;
+	dmd.header_hash = xxh32(&dmd, sizeof(dmd), 0);
+
+	if (region_file_update_data_arr(cache_file, entries, 1 + 2 * num_runs) < 0)
+		return -1;
+
+	printk(BIOS_DEBUG, "MRC: wrote %zu byte delta in %d runs against offset 0x%zx.\n",
+	       delta_size, num_runs, (size_t)base_offset);
+
+	return 0;
 }
 
 static void log_event_cache_update(uint8_t slot, enum result res)
@@ -448,6 +671,7 @@ static void update_mrc_cache_by_type(int type,
 	struct region_device latest_rdev;
 	const bool fail_bad_data = false;
 	uint32_t hash_idx;
+	int ret;
 
 	cr = lookup_region(&region, type);
 
@@ -482,7 +706,7 @@ static void update_mrc_cache_by_type(int type,
 
 		return;
 
-	if (!mrc_cache_needs_update(&latest_rdev, new_md, new_data_size)) {
+	if (!mrc_cache_needs_update(&md, new_md)) {
 		printk(BIOS_DEBUG, "MRC: '%s' does not need update.\n", cr->name);
 		log_event_cache_update(cr->elog_slot, ALREADY_UPTODATE);
 		return;
@@ -490,17 +714,23 @@ static void update_mrc_cache_by_type(int type,
 
 	printk(BIOS_DEBUG, "MRC: cache data '%s' needs update.\n", cr->name);
 
-	struct update_region_file_entry entries[] = {
-		[0] = {
-			.size = sizeof(*new_md),
-			.data = new_md,
-		},
-		[1] = {
-			.size = new_data_size,
-			.data = new_data,
-		},
-	};
-	if (region_file_update_data_arr(&cache_file, entries, ARRAY_SIZE(entries)) < 0) {
+	ret = mrc_cache_update_delta(&cache_file, backing_rdev, &latest_rdev, &md, new_md,
+				     new_data);
+	if (ret > 0) {
+		struct update_region_file_entry entries[] = {
+			[0] = {
+				.size = sizeof(*new_md),
+				.data = new_md,
+			},
+			[1] = {
+				.size = new_data_size,
+				.data = new_data,
+			},
+		};
+		ret = region_file_update_data_arr(&cache_file, entries, ARRAY_SIZE(entries));
+	}
+
+	if (ret < 0) {
 		printk(BIOS_ERR, "MRC: failed to update '%s'.\n", cr->name);
 		log_event_cache_update(cr->elog_slot, UPDATE_FAILURE);
 	} else {
@@ -699,7 +929,8 @@ int mrc_cache_stash_data(int type, uint32_t version, const void *data,
 		.signature = MRC_DATA_SIGNATURE,
 		.data_size = size,
 		.version = version,
-		.data_hash = xxh32(data, size, 0),
+		.data_hash = xxh64(data, size, 0),
+		.flags = delta_unusable ? MRC_FLAG_NO_DELTA : 0,
 	};
 	md.header_hash = xxh32(&md, sizeof(md), 0);
 
@@ -60,6 +60,26 @@ static uint32_t smmstorev1_exec(uint8_t command, void *param)
 		break;
 	}
 
+	case SMMSTORE_CMD_LOOKUP: {
+		printk(BIOS_DEBUG, "Looking up key in SMM store\n");
+		struct smmstore_params_lookup *params = param;
+		uint32_t valsize;
+
+		if (range_check(params, sizeof(*params)) != 0)
+			break;
+		if (range_check(params->key, params->keysize) != 0)
+			break;
+		if (range_check(params->val, params->valsize) != 0)
+			break;
+
+		valsize = MIN(params->valsize, UINT32_MAX);
+		if (smmstore_lookup_data(params->key, params->keysize,
+					 params->val, &valsize) == 0)
+			ret = SMMSTORE_RET_SUCCESS;
+		params->valsize = valsize;
+		break;
+	}
+
 	case SMMSTORE_CMD_CLEAR: {
 		if (smmstore_clear_region() == 0)
 			ret = SMMSTORE_RET_SUCCESS;
@@ -3,10 +3,12 @@
 #include <boot_device.h>
 #include <fmap.h>
 #include <fmap_config.h>
+#include <commonlib/bsd/fnv.h>
 #include <commonlib/helpers.h>
 #include <commonlib/region.h>
 #include <console/console.h>
 #include <smmstore.h>
+#include <string.h>
 #include <types.h>
 
 #define SMMSTORE_REGION "SMMSTORE"
@@ -41,12 +43,45 @@ _Static_assert(SMM_BLOCK_SIZE <= FMAP_SECTION_SMMSTORE_SIZE,
  * the constraint that entries are either complete or will be ignored, as long
  * as flash is written sequentially and into a fully erased block.
  *
- * Future additions to the format will split the region in half with an active
- * block marker to allow safe compaction (ie. write the new data in the unused
- * region, mark it active after the write completed). Otherwise a well-timed
- * crash/reboot could clear out all variables.
+ * If the region is a multiple of two blocks, the log is kept in one half of
+ * it, starting at either the first block or the middle of the region. The
+ * first half is used if it isn't erased. When the log fills up, the latest
+ * entry of every key is copied into the other half, and the first word of
+ * the copy is written last to mark it complete. Only then is the old half
+ * erased, starting with its first block. A well-timed crash/reboot thus
+ * leaves either the old or the compacted log in place.
+ *
+ * Logs written before compaction was supported may extend beyond the first
+ * half. These keep using the whole region and still need to be cleared when
+ * full. One that happens to have an entry end right at the middle can't be
+ * told apart from a full first half, and only that half of it is used.
  */
 
+#define SMMSTORE_END_MARKER	0xffffffff
+#define SMMSTORE_INDEX_ENTRIES	512
+#define SMMSTORE_COPY_CHUNK	64
+
+struct smmstore_index_entry {
+	uint32_t hash;
+	uint32_t offset;	/* relative to the start of the log */
+};
+
+/*
+ * The latest entry of every key in the log, kept in SMRAM so that neither
+ * appends nor lookups need to walk the log.
+ */
+static struct {
+	bool valid;
+	/* Every key of the log has an entry. Otherwise lookups and compaction fail. */
+	bool complete;
+	struct region region;
+	size_t base;
+	size_t limit;
+	size_t end;
+	size_t count;
+	struct smmstore_index_entry entries[SMMSTORE_INDEX_ENTRIES];
+} store_index;
+
 static int use_full_flash;
 static int has_capsules = -1;
 
@@ -154,50 +189,131 @@ int smmstore_lookup_region(struct region_device *rstore)
 	*rstore = rdev;
 	return ret;
 }
+
+static size_t entry_size(uint32_t key_sz, uint32_t value_sz)
+{
+	return sizeof(key_sz) + sizeof(value_sz) + key_sz + value_sz + sizeof(uint8_t);
+}
+
+static enum cb_err read_key_hash(const struct region_device *log, size_t offset,
+				 uint32_t key_sz, uint32_t *hash)
+{
+	uint8_t buf[SMMSTORE_COPY_CHUNK];
+	size_t pos = offset + 2 * sizeof(uint32_t);
+
+	*hash = FNV1A_32_INIT;
+	while (key_sz) {
+		const size_t len = MIN(key_sz, sizeof(buf));
+
+		if (rdev_readat(log, buf, pos, len) != len)
+			return CB_ERR;
+
+		*hash = fnv1a_32_update(*hash, buf, len);
+		pos += len;
+		key_sz -= len;
+	}
+
+	return CB_SUCCESS;
+}
+
 /*
- * Read entire store into user provided buffer
- *
- * returns 0 on success, -1 on failure
- * writes up to `*bufsize` bytes into `buf` and updates `*bufsize`
+ * Compare the key of the entry at offset with key, or with the key of the
+ * entry at key_offset if key is NULL.
  */
-int smmstore_read_region(void *buf, ssize_t *bufsize)
+static bool key_equal(const struct region_device *log, size_t offset, const void *key,
+		      size_t key_offset, uint32_t key_sz)
 {
-	struct region_device store;
+	uint8_t buf[SMMSTORE_COPY_CHUNK], other[SMMSTORE_COPY_CHUNK];
+	uint32_t sz;
+	size_t pos = 0;
+
+	if (rdev_readat(log, &sz, offset, sizeof(sz)) != sizeof(sz) || sz != key_sz)
+		return false;
+
+	offset += 2 * sizeof(uint32_t);
+	key_offset += 2 * sizeof(uint32_t);
+	while (pos < key_sz) {
+		const size_t len = MIN(key_sz - pos, sizeof(buf));
+
+		if (rdev_readat(log, buf, offset + pos, len) != len)
+			return false;
+
+		if (key) {
+			if (memcmp(buf, (const uint8_t *)key + pos, len))
+				return false;
+		} else if (rdev_readat(log, other, key_offset + pos, len) != len ||
+			   memcmp(buf, other, len)) {
+			return false;
+		}
 
-	if (bufsize == NULL)
-		return -1;
+		pos += len;
+	}
 
-	if (lookup_store(&store) < 0) {
-		printk(BIOS_WARNING, "reading region failed\n");
-		return -1;
+	return true;
+}
+
+static struct smmstore_index_entry *index_find(const struct region_device *log, uint32_t hash,
+					       const void *key, size_t key_offset,
+					       uint32_t key_sz)
+{
+	for (size_t i = 0; i < store_index.count; i++) {
+		struct smmstore_index_entry *e = &store_index.entries[i];
+
+		if (e->hash == hash && key_equal(log, e->offset, key, key_offset, key_sz))
+			return e;
 	}
 
-	ssize_t tx = MIN(*bufsize, region_device_sz(&store));
-	*bufsize = rdev_readat(&store, buf, 0, tx);
+	return NULL;
+}
 
-	if (*bufsize < 0)
-		return -1;
+/* Make the entry at offset the latest one for its key. */
+static void index_update(const struct region_device *log, uint32_t hash, const void *key,
+			 size_t offset, uint32_t key_sz)
+{
+	struct smmstore_index_entry *e = index_find(log, hash, key, offset, key_sz);
+
+	if (e == NULL) {
+		if (store_index.count == ARRAY_SIZE(store_index.entries)) {
+			if (store_index.complete)
+				printk(BIOS_WARNING, "smm store: index full\n");
+			store_index.complete = false;
+			return;
+		}
+		e = &store_index.entries[store_index.count++];
+		e->hash = hash;
+	}
 
-	return 0;
+	e->offset = offset;
+}
+
+static bool can_compact(const struct region_device *store)
+{
+	return IS_ALIGNED(region_device_sz(store), 2 * SMM_BLOCK_SIZE);
 }
 
-static enum cb_err scan_end(struct region_device *store)
+static enum cb_err scan_log(const struct region_device *store, size_t max_size)
 {
 	/* scan for end */
+	struct region_device log;
 	ssize_t end = 0;
-	uint32_t k_sz, v_sz;
-	const ssize_t data_sz = region_device_sz(store);
+	uint32_t k_sz = SMMSTORE_END_MARKER, v_sz, hash;
+	uint8_t active;
+	const ssize_t data_sz = max_size;
+
+	if (rdev_chain(&log, store, store_index.base, max_size))
+		return CB_ERR;
+
 	while (end < data_sz) {
 		/* make odd corner cases identifiable, eg. invalid v_sz */
 		k_sz = 0;
 
-		if (rdev_readat(store, &k_sz, end, sizeof(k_sz)) < 0) {
+		if (rdev_readat(&log, &k_sz, end, sizeof(k_sz)) < 0) {
 			printk(BIOS_WARNING, "failed reading key size\n");
 			return CB_ERR;
 		}
 
 		/* found the end */
-		if (k_sz == 0xffffffff)
+		if (k_sz == SMMSTORE_END_MARKER)
 			break;
 
 		/* something is fishy here:
@@ -209,7 +325,7 @@ static enum cb_err scan_end(struct region_device *store)
 			return CB_ERR;
 		}
 
-		if (rdev_readat(store, &v_sz, end + sizeof(k_sz), sizeof(v_sz)) < 0) {
+		if (rdev_readat(&log, &v_sz, end + sizeof(k_sz), sizeof(v_sz)) < 0) {
 			printk(BIOS_WARNING, "failed reading value size\n");
 			return CB_ERR;
 		}
@@ -219,23 +335,249 @@ static enum cb_err scan_end(struct region_device *store)
 			return CB_ERR;
 		}
 
-		end += sizeof(k_sz) + sizeof(v_sz) + k_sz + v_sz + 1;
+		/* Incomplete entries are skipped, like readers of the log do. */
+		if (rdev_readat(&log, &active, end + entry_size(k_sz, v_sz) - sizeof(active),
+				sizeof(active)) == sizeof(active) && active == 0) {
+			if (read_key_hash(&log, end, k_sz, &hash) != CB_SUCCESS)
+				return CB_ERR;
+			index_update(&log, hash, NULL, end, k_sz);
+		}
+
+		end += entry_size(k_sz, v_sz);
 		end = ALIGN_UP(end, sizeof(uint32_t));
 	}
 
 	printk(BIOS_DEBUG, "used smm store size might be 0x%zx bytes\n", end);
 
-	if (k_sz != 0xffffffff) {
+	/* A log that fills the region completely has no end marker. */
+	if (end < data_sz && k_sz != SMMSTORE_END_MARKER) {
 		printk(BIOS_WARNING,
 			"EOF of data marker looks invalid: 0x%x\n", k_sz);
 		return CB_ERR;
 	}
 
-	if (rdev_chain(store, store, end, data_sz - end))
+	if (end > data_sz) {
+		printk(BIOS_WARNING, "last entry exceeds the store\n");
 		return CB_ERR;
+	}
+
+	store_index.end = end;
 
 	return CB_SUCCESS;
 }
+
+static bool log_is_empty(const struct region_device *store, size_t offset)
+{
+	uint32_t k_sz;
+
+	return rdev_readat(store, &k_sz, offset, sizeof(k_sz)) == sizeof(k_sz) &&
+		k_sz == SMMSTORE_END_MARKER;
+}
+
+static void index_reset(size_t base)
+{
+	memset(&store_index, 0, sizeof(store_index));
+	store_index.complete = true;
+	store_index.base = base;
+}
+
+static enum cb_err build_index(const struct region_device *store)
+{
+	const size_t size = region_device_sz(store);
+	const size_t half = size / 2;
+	enum cb_err ret;
+
+	if (can_compact(store) && log_is_empty(store, 0) && !log_is_empty(store, half))
+		index_reset(half);
+	else
+		index_reset(0);
+
+	if (can_compact(store)) {
+		/*
+		 * A log filling the first half has no end marker, and its compacted
+		 * copy may follow if the old log wasn't erased yet. Stop at the middle
+		 * so the copy isn't taken for more entries.
+		 */
+		ret = scan_log(store, half);
+		store_index.limit = half;
+
+		/* Logs written before compaction was supported cross the middle. */
+		if (ret != CB_SUCCESS && store_index.base == 0) {
+			index_reset(0);
+			ret = scan_log(store, size);
+			store_index.limit = size;
+		}
+	} else {
+		ret = scan_log(store, size);
+		store_index.limit = size;
+	}
+
+	if (ret != CB_SUCCESS)
+		return CB_ERR;
+
+	store_index.region = *region_device_region(store);
+	store_index.valid = true;
+
+	printk(BIOS_DEBUG, "smm store: indexed %zu keys, log at 0x%zx, 0x%zx/0x%zx bytes used\n",
+	       store_index.count, store_index.base, store_index.end, store_index.limit);
+
+	return CB_SUCCESS;
+}
+
+/*
+ * Build the index on first use, or when the flash changed underneath, which is
+ * detected by the end of the log not being erased anymore.
+ */
+static enum cb_err get_index(const struct region_device *store)
+{
+	const struct region *r = region_device_region(store);
+
+	if (store_index.valid && region_offset(r) == region_offset(&store_index.region) &&
+	    region_sz(r) == region_sz(&store_index.region) &&
+	    (store_index.end == store_index.limit ||
+	     log_is_empty(store, store_index.base + store_index.end)))
+		return CB_SUCCESS;
+
+	return build_index(store);
+}
+
+static enum cb_err copy_data(const struct region_device *src, size_t src_offset,
+			     const struct region_device *dst, size_t dst_offset, size_t size)
+{
+	uint8_t buf[SMMSTORE_COPY_CHUNK];
+
+	while (size) {
+		const size_t len = MIN(size, sizeof(buf));
+
+		if (rdev_readat(src, buf, src_offset, len) != len ||
+		    rdev_writeat(dst, buf, dst_offset, len) != len)
+			return CB_ERR;
+
+		src_offset += len;
+		dst_offset += len;
+		size -= len;
+	}
+
+	return CB_SUCCESS;
+}
+
+static struct smmstore_index_entry *index_find_offset(size_t offset)
+{
+	for (size_t i = 0; i < store_index.count; i++)
+		if (store_index.entries[i].offset == offset)
+			return &store_index.entries[i];
+
+	return NULL;
+}
+
+/* Copy the latest entry of every key into the other half and switch over to it. */
+static enum cb_err compact_store(const struct region_device *store)
+{
+	const size_t half = region_device_sz(store) / 2;
+	const size_t dst_base = store_index.base ? 0 : half;
+	struct region_device src, dst;
+	uint32_t k_sz, v_sz, first_k_sz = SMMSTORE_END_MARKER;
+	size_t offset, out = 0;
+
+	if (!can_compact(store) || store_index.limit != half || !store_index.complete)
+		return CB_ERR;
+
+	if (rdev_chain(&src, store, store_index.base, half) ||
+	    rdev_chain(&dst, store, dst_base, half))
+		return CB_ERR;
+
+	/* Any failure from here on leaves flash in a state that needs a rescan. */
+	store_index.valid = false;
+
+	if (rdev_eraseat(&dst, 0, half) != half) {
+		printk(BIOS_WARNING, "smm store: erasing compaction target failed\n");
+		return CB_ERR;
+	}
+
+	for (offset = 0; offset < store_index.end;
+	     offset = ALIGN_UP(offset + entry_size(k_sz, v_sz), sizeof(uint32_t))) {
+		struct smmstore_index_entry *e;
+
+		if (rdev_readat(&src, &k_sz, offset, sizeof(k_sz)) != sizeof(k_sz) ||
+		    rdev_readat(&src, &v_sz, offset + sizeof(k_sz), sizeof(v_sz)) !=
+		    sizeof(v_sz))
+			return CB_ERR;
+
+		e = index_find_offset(offset);
+		if (e == NULL)
+			continue;
+
+		/* The first word marks the copy as complete, it's written last. */
+		if (out == 0) {
+			first_k_sz = k_sz;
+			if (copy_data(&src, offset + sizeof(k_sz), &dst, sizeof(k_sz),
+				      entry_size(k_sz, v_sz) - sizeof(k_sz)) != CB_SUCCESS)
+				return CB_ERR;
+		} else if (copy_data(&src, offset, &dst, out, entry_size(k_sz, v_sz)) !=
+			   CB_SUCCESS) {
+			return CB_ERR;
+		}
+
+		/* New offsets never exceed the old ones, so later lookups by offset still work. */
+		e->offset = out;
+		out = ALIGN_UP(out + entry_size(k_sz, v_sz), sizeof(uint32_t));
+	}
+
+	if (out && rdev_writeat(&dst, &first_k_sz, 0, sizeof(first_k_sz)) != sizeof(first_k_sz))
+		return CB_ERR;
+
+	/* Erasing the first block invalidates the old log, the rest is cleanup. */
+	if (rdev_eraseat(&src, 0, SMM_BLOCK_SIZE) != SMM_BLOCK_SIZE ||
+	    rdev_eraseat(&src, SMM_BLOCK_SIZE, half - SMM_BLOCK_SIZE) !=
+	    half - SMM_BLOCK_SIZE) {
+		printk(BIOS_WARNING, "smm store: erasing old log failed\n");
+		return CB_ERR;
+	}
+
+	printk(BIOS_INFO, "smm store: compacted log from 0x%zx to 0x%zx bytes\n",
+	       store_index.end, out);
+
+	store_index.base = dst_base;
+	store_index.end = out;
+	store_index.valid = true;
+
+	return CB_SUCCESS;
+}
+
+/*
+ * Read entire store into user provided buffer
+ *
+ * returns 0 on success, -1 on failure
+ * writes up to `*bufsize` bytes into `buf` and updates `*bufsize`
+ */
+int smmstore_read_region(void *buf, ssize_t *bufsize)
+{
+	struct region_device store;
+
+	if (bufsize == NULL)
+		return -1;
+
+	if (lookup_store(&store) < 0) {
+		printk(BIOS_WARNING, "reading region failed\n");
+		return -1;
+	}
+
+	/* Only the active half of the store holds the log. */
+	if (get_index(&store) == CB_SUCCESS &&
+	    rdev_chain(&store, &store, store_index.base, store_index.limit)) {
+		printk(BIOS_WARNING, "reading region failed\n");
+		return -1;
+	}
+
+	ssize_t tx = MIN(*bufsize, region_device_sz(&store));
+	*bufsize = rdev_readat(&store, buf, 0, tx);
+
+	if (*bufsize < 0)
+		return -1;
+
+	return 0;
+}
+
 /*
  * Append data to region
  *
@@ -245,6 +587,7 @@ int smmstore_append_data(void *key, uint32_t key_sz, void *value,
 			 uint32_t value_sz)
 {
 	struct region_device store;
+	struct region_device log;
 
 	if (lookup_store(&store) < 0) {
 		printk(BIOS_WARNING, "reading region failed\n");
@@ -254,21 +597,30 @@ int smmstore_append_data(void *key, uint32_t key_sz, void *value,
 	ssize_t offset = 0;
 	ssize_t size;
 	uint8_t nul = 0;
-	if (scan_end(&store) != CB_SUCCESS)
+	if (get_index(&store) != CB_SUCCESS)
 		return -1;
 
 	printk(BIOS_DEBUG, "used size looks legit\n");
 
-	printk(BIOS_DEBUG, "open (%zx, %zx) for writing\n",
-		region_device_offset(&store), region_device_sz(&store));
+	size = entry_size(key_sz, value_sz);
+	if (store_index.end + size > store_index.limit &&
+	    compact_store(&store) != CB_SUCCESS) {
+		printk(BIOS_WARNING, "not enough space for new data\n");
+		return -1;
+	}
 
-	size = sizeof(key_sz) + sizeof(value_sz) + key_sz + value_sz
-		+ sizeof(nul);
-	if (rdev_chain(&store, &store, 0, size)) {
+	if (rdev_chain(&log, &store, store_index.base, store_index.limit) ||
+	    rdev_chain(&store, &log, store_index.end, size)) {
 		printk(BIOS_WARNING, "not enough space for new data\n");
 		return -1;
 	}
 
+	printk(BIOS_DEBUG, "open (%zx, %zx) for writing\n",
+		region_device_offset(&store), region_device_sz(&store));
+
+	/* A partially written entry needs a rescan. */
+	store_index.valid = false;
+
 	if (rdev_writeat(&store, &key_sz, offset, sizeof(key_sz))
 	    != sizeof(key_sz)) {
 		printk(BIOS_WARNING, "failed writing key size\n");
@@ -296,6 +648,54 @@ int smmstore_append_data(void *key, uint32_t key_sz, void *value,
 		return -1;
 	}
 
+	index_update(&log, fnv1a_32(key, key_sz), key, store_index.end, key_sz);
+	store_index.end = ALIGN_UP(store_index.end + size, sizeof(uint32_t));
+	store_index.valid = true;
+
+	return 0;
+}
+
+/*
+ * Look up the latest value of a key
+ *
+ * Returns 0 on success, -1 on failure
+ * writes the value into `value` and its size into `*value_sz`. If the buffer is
+ * too small, only `*value_sz` is updated.
+ */
+int smmstore_lookup_data(void *key, uint32_t key_sz, void *value, uint32_t *value_sz)
+{
+	struct region_device store;
+	struct region_device log;
+	struct smmstore_index_entry *e;
+	uint32_t v_sz;
+
+	if (lookup_store(&store) < 0) {
+		printk(BIOS_WARNING, "reading region failed\n");
+		return -1;
+	}
+
+	if (get_index(&store) != CB_SUCCESS || !store_index.complete)
+		return -1;
+
+	if (rdev_chain(&log, &store, store_index.base, store_index.end))
+		return -1;
+
+	e = index_find(&log, fnv1a_32(key, key_sz), key, 0, key_sz);
+	if (e == NULL)
+		return -1;
+
+	if (rdev_readat(&log, &v_sz, e->offset + sizeof(key_sz), sizeof(v_sz)) != sizeof(v_sz))
+		return -1;
+
+	if (*value_sz < v_sz) {
+		*value_sz = v_sz;
+		return -1;
+	}
+
+	*value_sz = v_sz;
+	if (rdev_readat(&log, value, e->offset + 2 * sizeof(uint32_t) + key_sz, v_sz) != v_sz)
+		return -1;
+
 	return 0;
 }
 
@@ -313,6 +713,8 @@ int smmstore_clear_region(void)
 		return -1;
 	}
 
+	store_index.valid = false;
+
 	ssize_t res = rdev_eraseat(&store, 0, region_device_sz(&store));
 	if (res != region_device_sz(&store)) {
 		printk(BIOS_WARNING, "smm store: erasing region failed\n");
@@ -79,6 +79,25 @@ static const struct region_device_ops spi_ops = {
 static struct mmap_helper_region_device mdev =
 	MMAP_HELPER_DEV_INIT(&spi_ops, 0, CONFIG_ROM_SIZE, &cbfs_cache);
 
+#if ENV_RAMSTAGE
+#define SPI_CACHE_SIZE	CONFIG_COMMON_CBFS_SPI_CACHE_RAMSTAGE_SIZE
+#elif ENV_ROMSTAGE_OR_BEFORE
+#define SPI_CACHE_SIZE	CONFIG_COMMON_CBFS_SPI_CACHE_PRERAM_SIZE
+#else
+/* SMM can't cache anything, the OS may write the flash between SMIs. */
+#define SPI_CACHE_SIZE	0
+#endif
+
+/* CBFS is aligned to 64 bytes, so most file headers and their attributes fit in one block. */
+#define SPI_CACHE_BLOCK_SIZE	256
+#define SPI_CACHE_READAHEAD	3
+
+#if SPI_CACHE_SIZE
+static struct cache_rdev spi_cache;
+static uint8_t spi_cache_buffer[SPI_CACHE_SIZE] __aligned(sizeof(size_t));
+#endif
+static const struct region_device *spi_rdev;
+
 void boot_device_init(void)
 {
 	int bus = CONFIG_BOOT_DEVICE_SPI_FLASH_BUS;
@@ -90,6 +109,17 @@ void boot_device_init(void)
 	if (spi_flash_probe(bus, cs, &spi_flash_info))
 		return;
 
+	spi_rdev = &mdev.rdev;
+#if SPI_CACHE_SIZE
+	spi_rdev = cache_rdev_init(&spi_cache, &mdev.rdev, spi_cache_buffer,
+				   sizeof(spi_cache_buffer), SPI_CACHE_BLOCK_SIZE,
+				   SPI_CACHE_READAHEAD);
+	if (!spi_rdev) {
+		printk(BIOS_ERR, "SPI boot device cache too small, not using it\n");
+		spi_rdev = &mdev.rdev;
+	}
+#endif
+
 	spi_flash_init_done = true;
 }
 
@@ -99,7 +129,7 @@ const struct region_device *boot_device_ro(void)
 	if (spi_flash_init_done != true)
 		return NULL;
 
-	return &mdev.rdev;
+	return spi_rdev;
 }
 
 /* The read-only and read-write implementations are symmetric. */
@@ -10,6 +10,7 @@
 #define CMD_GD25_WREN		0x06	/* Write Enable */
 #define CMD_GD25_WRDI		0x04	/* Write Disable */
 #define CMD_GD25_RDSR		0x05	/* Read Status Register */
+#define CMD_GD25_RDSR2		0x35	/* Read Status Register 2 */
 #define CMD_GD25_WRSR		0x01	/* Write Status Register */
 #define CMD_GD25_READ		0x03	/* Read Data Bytes */
 #define CMD_GD25_FAST_READ	0x0b	/* Read Data Bytes at Higher Speed */
@@ -19,6 +20,9 @@
 #define CMD_GD25_CE		0xc7	/* Chip Erase */
 #define CMD_GD25_DP		0xb9	/* Deep Power-down */
 #define CMD_GD25_RES		0xab	/* Release from DP, and Read Signature */
+#define CMD_GD25_VSR_WREN	0x50	/* Write Enable for Volatile Status Register */
+
+#define GD25_SR2_QE		(1 << 1)	/* Quad Enable */
 
 static const struct spi_flash_part_id flash_table[] = {
 	{
@@ -32,6 +36,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 8,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},					/* also GD25Q80B */
 	{
 		/* GD25Q16 */
@@ -39,6 +45,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 9,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},					/* also GD25Q16B */
 	{
 		/* GD25Q32B */
@@ -46,6 +54,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 10,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},					/* also GD25Q32B */
 	{
 		/* GD25Q64 */
@@ -53,6 +63,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 11,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},					/* also GD25Q64B, GD25B64C */
 	{
 		/* GD25Q128 */
@@ -60,6 +72,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 12,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},					/* also GD25Q128B */
 	{
 		/* GD25VQ80C */
@@ -67,6 +81,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 8,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},
 	{
 		/* GD25VQ16C */
@@ -74,6 +90,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 9,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},
 	{
 		/* GD25LQ80 */
@@ -81,6 +99,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 8,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},
 	{
 		/* GD25LQ16 */
@@ -88,6 +108,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 9,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},
 	{
 		/* GD25LQ32 */
@@ -95,6 +117,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 10,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},
 	{
 		/* GD25LQ64C */
@@ -102,6 +126,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 11,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},					/* also GD25LB64C */
 	{
 		/* GD25LQ128 */
@@ -109,6 +135,8 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 12,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},
 	{
 		/* GD25LQ255E */
@@ -116,9 +144,43 @@ static const struct spi_flash_part_id flash_table[] = {
 		.nr_sectors_shift		= 13,
 		.fast_read_dual_output_support	= 1,
 		.fast_read_dual_io_support	= 1,
+		.fast_read_quad_output_support	= 1,
+		.fast_read_quad_io_support	= 1,
 	},
 };
 
+/* Set QE with a volatile write, so it doesn't wear the status register. */
+static int gigadevice_quad_enable(const struct spi_flash *flash)
+{
+	u8 cmd[3];
+	u8 sr2;
+
+	if (spi_flash_cmd(&flash->spi, CMD_GD25_RDSR2, &sr2, sizeof(sr2)))
+		return -1;
+
+	if (sr2 & GD25_SR2_QE)
+		return 0;
+
+	cmd[0] = CMD_GD25_WRSR;
+	if (spi_flash_cmd(&flash->spi, CMD_GD25_RDSR, &cmd[1], sizeof(cmd[1])))
+		return -1;
+	cmd[2] = sr2 | GD25_SR2_QE;
+
+	if (spi_flash_cmd(&flash->spi, CMD_GD25_VSR_WREN, NULL, 0))
+		return -1;
+
+	if (spi_flash_cmd_write(&flash->spi, cmd, sizeof(cmd), NULL, 0))
+		return -1;
+
+	if (spi_flash_cmd_wait_ready(flash, SPI_FLASH_PROG_TIMEOUT_MS))
+		return -1;
+
+	if (spi_flash_cmd(&flash->spi, CMD_GD25_RDSR2, &sr2, sizeof(sr2)))
+		return -1;
+
+	return (sr2 & GD25_SR2_QE) ? 0 : -1;
+}
+
 const struct spi_flash_vendor_info spi_flash_gigadevice_vi = {
 	.id = VENDOR_ID_GIGADEVICE,
 	.page_size_shift = 8,
@@ -127,4 +189,5 @@ const struct spi_flash_vendor_info spi_flash_gigadevice_vi = {
 	.ids = flash_table,
 	.nr_part_ids = ARRAY_SIZE(flash_table),
 	.desc = &spi_flash_pp_0x20_sector_desc,
+	.quad_enable = gigadevice_quad_enable,
 };
@@ -21,6 +21,7 @@
 #define CMD_MX25XX_RES		0xab	/* Release from DP, and Read Signature */
 
 #define MACRONIX_SR_WIP		(1 << 0)	/* Write-in-Progress */
+#define MACRONIX_SR_QE		(1 << 6)	/* Quad Enable */
 
 static const struct spi_flash_part_id flash_table[] = {
 	{
@@ -71,67 +72,78 @@ static const struct spi_flash_part_id flash_table[] = {
 	 * of compatibility. Since Macronix makes it impossible to search all
 	 * different parts that it recklessly assigned the same IDs to, it's
 	 * hard to know if there may be parts that don't even support Dual I/O
-	 * with these IDs, though (or what we should do if there are).
+	 * with these IDs, though (or what we should do if there are). For
+	 * the same reason only Quad I/O is set and not Quad Output.
 	 */
 	{
 		/* MX25L1635E */
 		.id[0] = 0x2515,
 		.nr_sectors_shift = 9,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25U8032E */
 		.id[0] = 0x2534,
 		.nr_sectors_shift = 8,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25U1635E/MX25U1635F */
 		.id[0] = 0x2535,
 		.nr_sectors_shift = 9,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25U3235E/MX25U3235F */
 		.id[0] = 0x2536,
 		.nr_sectors_shift = 10,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25U6435E/MX25U6435F */
 		.id[0] = 0x2537,
 		.nr_sectors_shift = 11,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25U12835F */
 		.id[0] = 0x2538,
 		.nr_sectors_shift = 12,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25U25635F */
 		.id[0] = 0x2539,
 		.nr_sectors_shift = 13,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25U51235F */
 		.id[0] = 0x253a,
 		.nr_sectors_shift = 14,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25L12855E */
 		.id[0] = 0x2618,
 		.nr_sectors_shift = 12,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25L3235D/MX25L3225D/MX25L3236D/MX25L3237D */
 		.id[0] = 0x5e16,
 		.nr_sectors_shift = 10,
 		.fast_read_dual_io_support = 1,
+		.fast_read_quad_io_support = 1,
 	},
 	{
 		/* MX25L6495F */
@@ -145,6 +157,39 @@ static const struct spi_flash_part_id flash_table[] = {
 	},
 };
 
+/*
+ * Macronix parts only have a non-volatile QE bit. It is written once and stays set from then
+ * on, so this doesn't wear the status register.
+ */
+static int macronix_quad_enable(const struct spi_flash *flash)
+{
+	u8 cmd[2];
+	u8 sr;
+
+	if (spi_flash_cmd_status(flash, &sr))
+		return -1;
+
+	if (sr & MACRONIX_SR_QE)
+		return 0;
+
+	cmd[0] = CMD_MX25XX_WRSR;
+	cmd[1] = sr | MACRONIX_SR_QE;
+
+	if (spi_flash_cmd(&flash->spi, CMD_MX25XX_WREN, NULL, 0))
+		return -1;
+
+	if (spi_flash_cmd_write(&flash->spi, cmd, sizeof(cmd), NULL, 0))
+		return -1;
+
+	if (spi_flash_cmd_wait_ready(flash, SPI_FLASH_PROG_TIMEOUT_MS))
+		return -1;
+
+	if (spi_flash_cmd_status(flash, &sr))
+		return -1;
+
+	return (sr & MACRONIX_SR_QE) ? 0 : -1;
+}
+
 const struct spi_flash_vendor_info spi_flash_macronix_vi = {
 	.id = VENDOR_ID_MACRONIX,
 	.page_size_shift = 8,
@@ -153,4 +198,5 @@ const struct spi_flash_vendor_info spi_flash_macronix_vi = {
 	.ids = flash_table,
 	.nr_part_ids = ARRAY_SIZE(flash_table),
 	.desc = &spi_flash_pp_0x20_sector_desc,
+	.quad_enable = macronix_quad_enable,
 };
@@ -67,8 +67,11 @@ static int do_spi_flash_cmd(const struct spi_slave *spi, const u8 *dout,
 	return ret;
 }
 
-static int do_dual_output_cmd(const struct spi_slave *spi, const u8 *dout,
-			      size_t bytes_out, void *din, size_t bytes_in)
+/* Send the command in single mode and receive the data with xfer_multi. */
+static int do_multi_output_cmd(const struct spi_slave *spi, const u8 *dout,
+			       size_t bytes_out, void *din, size_t bytes_in,
+			       int (*xfer_multi)(const struct spi_slave *slave, const void *dout,
+						 size_t bytesout, void *din, size_t bytesin))
 {
 	int ret;
 
@@ -76,8 +79,8 @@ static int do_dual_output_cmd(const struct spi_slave *spi, const u8 *dout,
 	 * spi_xfer_vector() will automatically fall back to .xfer() if
 	 * .xfer_vector() is unimplemented. So using vector API here is more
 	 * flexible, even though a controller that implements .xfer_vector()
-	 * and (the non-vector based) .xfer_dual() but not .xfer() would be
-	 * pretty odd.
+	 * and (the non-vector based) .xfer_dual() or .xfer_quad() but not
+	 * .xfer() would be pretty odd.
 	 */
 	struct spi_op vector = { .dout = dout, .bytesout = bytes_out,
 				 .din = NULL, .bytesin = 0 };
@@ -89,14 +92,17 @@ static int do_dual_output_cmd(const struct spi_slave *spi, const u8 *dout,
 	ret = spi_xfer_vector(spi, &vector, 1);
 
 	if (!ret)
-		ret = spi->ctrlr->xfer_dual(spi, NULL, 0, din, bytes_in);
+		ret = xfer_multi(spi, NULL, 0, din, bytes_in);
 
 	spi_release_bus(spi);
 	return ret;
 }
 
-static int do_dual_io_cmd(const struct spi_slave *spi, const u8 *dout,
-			  size_t bytes_out, void *din, size_t bytes_in)
+/* Send the opcode in single mode, everything else goes through xfer_multi. */
+static int do_multi_io_cmd(const struct spi_slave *spi, const u8 *dout,
+			   size_t bytes_out, void *din, size_t bytes_in,
+			   int (*xfer_multi)(const struct spi_slave *slave, const void *dout,
+					     size_t bytesout, void *din, size_t bytesin))
 {
 	int ret;
 
@@ -111,15 +117,41 @@ static int do_dual_io_cmd(const struct spi_slave *spi, const u8 *dout,
 	ret = spi_xfer_vector(spi, &vector, 1);
 
 	if (!ret)
-		ret = spi->ctrlr->xfer_dual(spi, &dout[1], bytes_out - 1, NULL, 0);
+		ret = xfer_multi(spi, &dout[1], bytes_out - 1, NULL, 0);
 
 	if (!ret)
-		ret = spi->ctrlr->xfer_dual(spi, NULL, 0, din, bytes_in);
+		ret = xfer_multi(spi, NULL, 0, din, bytes_in);
 
 	spi_release_bus(spi);
 	return ret;
 }
 
+static int do_dual_output_cmd(const struct spi_slave *spi, const u8 *dout,
+			      size_t bytes_out, void *din, size_t bytes_in)
+{
+	return do_multi_output_cmd(spi, dout, bytes_out, din, bytes_in,
+				   spi->ctrlr->xfer_dual);
+}
+
+static int do_dual_io_cmd(const struct spi_slave *spi, const u8 *dout,
+			  size_t bytes_out, void *din, size_t bytes_in)
+{
+	return do_multi_io_cmd(spi, dout, bytes_out, din, bytes_in, spi->ctrlr->xfer_dual);
+}
+
+static int do_quad_output_cmd(const struct spi_slave *spi, const u8 *dout,
+			      size_t bytes_out, void *din, size_t bytes_in)
+{
+	return do_multi_output_cmd(spi, dout, bytes_out, din, bytes_in,
+				   spi->ctrlr->xfer_quad);
+}
+
+static int do_quad_io_cmd(const struct spi_slave *spi, const u8 *dout,
+			  size_t bytes_out, void *din, size_t bytes_in)
+{
+	return do_multi_io_cmd(spi, dout, bytes_out, din, bytes_in, spi->ctrlr->xfer_quad);
+}
+
 int spi_flash_cmd(const struct spi_slave *spi, u8 cmd, void *response, size_t len)
 {
 	int ret = do_spi_flash_cmd(spi, &cmd, sizeof(cmd), response, len);
@@ -158,7 +190,7 @@ int spi_flash_cmd_write(const struct spi_slave *spi, const u8 *cmd,
 int spi_flash_cmd_read(const struct spi_flash *flash, u32 offset,
 				  size_t len, void *buf)
 {
-	u8 cmd[5 + ADDR_MOD];
+	u8 cmd[7 + ADDR_MOD];
 	int ret, cmd_len;
 	int (*do_cmd)(const struct spi_slave *spi, const u8 *din,
 		      size_t in_bytes, void *out, size_t out_bytes);
@@ -167,6 +199,19 @@ int spi_flash_cmd_read(const struct spi_flash *flash, u32 offset,
 		cmd_len = 4 + ADDR_MOD;
 		cmd[0] = CMD_READ_ARRAY_SLOW;
 		do_cmd = do_spi_flash_cmd;
+	} else if (flash->flags.quad_io && flash->spi.ctrlr->xfer_quad) {
+		/* Address, a mode byte that doesn't enter continuous read and 4 dummy clocks */
+		cmd_len = 7 + ADDR_MOD;
+		cmd[0] = CMD_READ_FAST_QUAD_IO;
+		cmd[4 + ADDR_MOD] = 0;
+		cmd[5 + ADDR_MOD] = 0;
+		cmd[6 + ADDR_MOD] = 0;
+		do_cmd = do_quad_io_cmd;
+	} else if (flash->flags.quad_output && flash->spi.ctrlr->xfer_quad) {
+		cmd_len = 5 + ADDR_MOD;
+		cmd[0] = CMD_READ_FAST_QUAD_OUTPUT;
+		cmd[4 + ADDR_MOD] = 0;
+		do_cmd = do_quad_output_cmd;
 	} else if (flash->flags.dual_io && flash->spi.ctrlr->xfer_dual) {
 		cmd_len = 5 + ADDR_MOD;
 		cmd[0] = CMD_READ_FAST_DUAL_IO;
@@ -403,10 +448,30 @@ static const struct spi_flash_vendor_info *spi_flash_vendors[] = {
 };
 #define IDCODE_LEN 5
 
+/*
+ * The quad reads use the WP# and HOLD# pins as IO2 and IO3, which requires the Quad Enable
+ * bit to be set. Fall back to the other reads if that isn't possible.
+ */
+static void spi_flash_setup_quad(struct spi_flash *flash,
+				 const struct spi_flash_vendor_info *vi)
+{
+	if (!flash->flags.quad_output && !flash->flags.quad_io)
+		return;
+
+	if (CONFIG(SPI_FLASH_QUAD_IO) && flash->spi.ctrlr && flash->spi.ctrlr->xfer_quad &&
+	    vi->quad_enable && !vi->quad_enable(flash))
+		return;
+
+	flash->flags.quad_output = 0;
+	flash->flags.quad_io = 0;
+}
+
 static int fill_spi_flash(const struct spi_slave *spi, struct spi_flash *flash,
 	const struct spi_flash_vendor_info *vi,
 	const struct spi_flash_part_id *part)
 {
+	int ret;
+
 	memcpy(&flash->spi, spi, sizeof(*spi));
 	flash->vendor = vi->id;
 	flash->model = part->id[0];
@@ -421,13 +486,20 @@ static int fill_spi_flash(const struct spi_slave *spi, struct spi_flash *flash,
 
 	flash->flags.dual_output = part->fast_read_dual_output_support;
 	flash->flags.dual_io = part->fast_read_dual_io_support;
+	flash->flags.quad_output = part->fast_read_quad_output_support;
+	flash->flags.quad_io = part->fast_read_quad_io_support;
 
 	flash->ops = &vi->desc->ops;
 	flash->prot_ops = vi->prot_ops;
 	flash->part = part;
 
-	if (vi->after_probe)
-		return vi->after_probe(flash);
+	if (vi->after_probe) {
+		ret = vi->after_probe(flash);
+		if (ret)
+			return ret;
+	}
+
+	spi_flash_setup_quad(flash, vi);
 
 	return 0;
 }
@@ -540,7 +612,11 @@ int spi_flash_probe(unsigned int bus, unsigned int cs, struct spi_flash *flash)
 	}
 
 	const char *mode_string = "";
-	if (flash->flags.dual_io && spi.ctrlr->xfer_dual)
+	if (flash->flags.quad_io && spi.ctrlr->xfer_quad)
+		mode_string = " (Quad I/O mode)";
+	else if (flash->flags.quad_output && spi.ctrlr->xfer_quad)
+		mode_string = " (Quad Output mode)";
+	else if (flash->flags.dual_io && spi.ctrlr->xfer_dual)
 		mode_string = " (Dual I/O mode)";
 	else if (flash->flags.dual_output && spi.ctrlr->xfer_dual)
 		mode_string = " (Dual Output mode)";
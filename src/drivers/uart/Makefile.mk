@@ -5,6 +5,7 @@ ifeq ($(CONFIG_DRIVERS_UART),y)
 romstage-y += util.c
 postcar-y += util.c
 ramstage-y += util.c
+ramstage-$(CONFIG_CONSOLE_SERIAL_ASYNC) += async.c
 bootblock-y += util.c
 verstage-y += util.c
 smm-$(CONFIG_DEBUG_SMI) += util.c
@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <bootstate.h>
+#include <commonlib/bsd/helpers.h>
+#include <console/console.h>
+#include <console/uart.h>
+#include <smp/node.h>
+#include <smp/spinlock.h>
+#include <timer.h>
+#include <types.h>
+
+#include "uart8250reg.h"
+
+#define QUEUE_SIZE	CONFIG_CONSOLE_SERIAL_ASYNC_BUFFER_SIZE
+
+_Static_assert(QUEUE_SIZE && !(QUEUE_SIZE & (QUEUE_SIZE - 1)),
+	       "The serial console queue size must be a power of 2");
+
+/* 8N1: a start bit, 8 data bits and a stop bit per character. */
+#define BITS_PER_CHAR	10
+
+DECLARE_SPIN_LOCK(queue_lock)
+
+static struct {
+	unsigned char data[QUEUE_SIZE];
+	/* Free running, head is where the next byte goes, tail the next to send. */
+	size_t head;
+	size_t tail;
+	/* Set after the final drain, to write the UART directly from then on. */
+	bool direct;
+	bool timer_pending;
+	struct timeout_callback timer;
+	/* Bytes that went through the queue and the time spent waiting for it. */
+	size_t sent;
+	long wait_usecs;
+} queue;
+
+/* Time the UART needs to send a full FIFO. */
+static uint64_t fifo_usecs(void)
+{
+	return DIV_ROUND_UP(UART8250_TX_FIFO_SIZE * BITS_PER_CHAR * USECS_PER_SEC,
+			    get_uart_baudrate());
+}
+
+/* Push what the UART takes without waiting. Called with the lock held. */
+static void queue_push(void)
+{
+	const unsigned int idx = get_uart_for_console();
+	size_t count, written;
+
+	while (queue.head != queue.tail) {
+		/* Up to the end of the queued bytes or of the buffer. */
+		count = MIN(queue.head - queue.tail, QUEUE_SIZE - queue.tail % QUEUE_SIZE);
+		written = uart_tx_nonblocking(idx, &queue.data[queue.tail % QUEUE_SIZE], count);
+		if (!written)
+			break;
+		queue.tail += written;
+		queue.sent += written;
+	}
+}
+
+/* Push until the queue has room for another count bytes. Called with the lock held. */
+static void queue_wait(size_t count)
+{
+	struct mono_time start, end;
+
+	if (QUEUE_SIZE - (queue.head - queue.tail) >= count)
+		return;
+
+	timer_monotonic_get(&start);
+	do {
+		queue_push();
+	} while (QUEUE_SIZE - (queue.head - queue.tail) < count);
+	timer_monotonic_get(&end);
+
+	queue.wait_usecs += mono_time_diff_microseconds(&start, &end);
+}
+
+static void queue_timer_callback(struct timeout_callback *tocb);
+
+/* Called with the lock held. The timer queue belongs to the BSP. */
+static void queue_timer_schedule(void)
+{
+	if (queue.timer_pending || queue.head == queue.tail || !boot_cpu())
+		return;
+
+	queue.timer.callback = queue_timer_callback;
+	if (!timer_sched_callback(&queue.timer, fifo_usecs()))
+		queue.timer_pending = true;
+}
+
+static void queue_timer_callback(struct timeout_callback *tocb)
+{
+	spin_lock(&queue_lock);
+	queue.timer_pending = false;
+	queue_push();
+	queue_timer_schedule();
+	spin_unlock(&queue_lock);
+}
+
+void uart_async_tx_byte(unsigned char data)
+{
+	if (queue.direct) {
+		uart_tx_byte(get_uart_for_console(), data);
+		return;
+	}
+
+	spin_lock(&queue_lock);
+
+	queue_wait(1);
+	queue.data[queue.head++ % QUEUE_SIZE] = data;
+
+	/* Checking the UART once per line keeps the number of slow register reads low. */
+	if (data == '\n') {
+		queue_push();
+		queue_timer_schedule();
+	}
+
+	spin_unlock(&queue_lock);
+}
+
+void uart_async_tx_flush(void)
+{
+	if (queue.direct) {
+		uart_tx_flush(get_uart_for_console());
+		return;
+	}
+
+	spin_lock(&queue_lock);
+	queue_push();
+	queue_timer_schedule();
+	spin_unlock(&queue_lock);
+}
+
+void uart_async_tx_drain(void)
+{
+	spin_lock(&queue_lock);
+	queue_wait(QUEUE_SIZE);
+	spin_unlock(&queue_lock);
+
+	uart_tx_flush(get_uart_for_console());
+}
+
+long uart_async_usecs_saved(void)
+{
+	uint64_t wire_usecs = (uint64_t)queue.sent * BITS_PER_CHAR * USECS_PER_SEC /
+			      get_uart_baudrate();
+
+	return (long)wire_usecs - queue.wait_usecs;
+}
+
+/* The payload and the OS don't know about the queue, so send everything now. */
+static void uart_async_finish(void *unused)
+{
+	uart_async_tx_drain();
+	queue.direct = true;
+	console_time_report();
+}
+
+BOOT_STATE_INIT_ENTRY(BS_PAYLOAD_BOOT, BS_ON_ENTRY, uart_async_finish, NULL);
+BOOT_STATE_INIT_ENTRY(BS_OS_RESUME, BS_ON_ENTRY, uart_async_finish, NULL);
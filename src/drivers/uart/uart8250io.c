@@ -31,6 +31,26 @@ static void uart8250_tx_byte(unsigned int base_port, unsigned char data)
 	outb(data, base_port + UART8250_TBR);
 }
 
+static size_t uart8250_tx_nonblocking(unsigned int base_port, const unsigned char *data,
+				      size_t len)
+{
+	size_t i;
+
+	if (!uart8250_can_tx_byte(base_port))
+		return 0;
+
+	/* The holding register being empty means the whole FIFO is. */
+	if ((inb(base_port + UART8250_IIR) & UART8250_IIR_FIFO_EN) == UART8250_IIR_FIFO_EN)
+		len = MIN(len, UART8250_TX_FIFO_SIZE);
+	else
+		len = MIN(len, 1);
+
+	for (i = 0; i < len; i++)
+		outb(data[i], base_port + UART8250_TBR);
+
+	return len;
+}
+
 static void uart8250_tx_flush(unsigned int base_port)
 {
 	unsigned long int i = FIFO_TIMEOUT;
@@ -99,6 +119,11 @@ void uart_tx_byte(unsigned int idx, unsigned char data)
 	uart8250_tx_byte(uart_platform_base(idx), data);
 }
 
+size_t uart_tx_nonblocking(unsigned int idx, const unsigned char *data, size_t len)
+{
+	return uart8250_tx_nonblocking(uart_platform_base(idx), data, len);
+}
+
 unsigned char uart_rx_byte(unsigned int idx)
 {
 	return uart8250_rx_byte(uart_platform_base(idx));
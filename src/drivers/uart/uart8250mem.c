@@ -52,6 +52,25 @@ static void uart8250_mem_tx_byte(void *base, unsigned char data)
 	uart8250_write(base, UART8250_TBR, data);
 }
 
+static size_t uart8250_mem_tx_nonblocking(void *base, const unsigned char *data, size_t len)
+{
+	size_t i;
+
+	if (!uart8250_mem_can_tx_byte(base))
+		return 0;
+
+	/* The holding register being empty means the whole FIFO is. */
+	if ((uart8250_read(base, UART8250_IIR) & UART8250_IIR_FIFO_EN) == UART8250_IIR_FIFO_EN)
+		len = MIN(len, UART8250_TX_FIFO_SIZE);
+	else
+		len = MIN(len, 1);
+
+	for (i = 0; i < len; i++)
+		uart8250_write(base, UART8250_TBR, data[i]);
+
+	return len;
+}
+
 static void uart8250_mem_tx_flush(void *base)
 {
 	unsigned long int i = FIFO_TIMEOUT;
@@ -117,6 +136,14 @@ void uart_tx_byte(unsigned int idx, unsigned char data)
 	uart8250_mem_tx_byte(base, data);
 }
 
+size_t uart_tx_nonblocking(unsigned int idx, const unsigned char *data, size_t len)
+{
+	void *base = uart_platform_baseptr(idx);
+	if (!base)
+		return len;
+	return uart8250_mem_tx_nonblocking(base, data, len);
+}
+
 unsigned char uart_rx_byte(unsigned int idx)
 {
 	void *base = uart_platform_baseptr(idx);
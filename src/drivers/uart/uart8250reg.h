@@ -37,6 +37,9 @@
 #define   UART8250_FCR_TRIGGER_8	(2 << 6) /* Mask for trigger set at 8 */
 #define   UART8250_FCR_TRIGGER_14	(3 << 6) /* Mask for trigger set at 14 */
 
+/* Transmit FIFO depth of a 16550A, when the FIFOs are enabled. */
+#define UART8250_TX_FIFO_SIZE	16
+
 #define UART8250_LCR 0x03
 #define   UART8250_LCR_WLS_MSK	0x03 /* character length select mask */
 #define   UART8250_LCR_WLS_5	0x00 /* 5 bit character length */
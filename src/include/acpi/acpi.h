@@ -1730,6 +1730,16 @@ unsigned long fw_cfg_acpi_tables(unsigned long start);
 /* These are implemented by the target port or north/southbridge. */
 void preload_acpi_dsdt(void);
 unsigned long write_acpi_tables(const unsigned long addr);
+
+/*
+ * ACPI table cache (ACPI_TABLE_CACHE). acpi_cache_restore() copies the tables
+ * cached for the current configuration to addr and returns their end, or 0
+ * if they need to be generated. acpi_cache_save() caches the tables generated
+ * between addr and end for the configuration seen by acpi_cache_restore().
+ */
+unsigned long acpi_cache_restore(unsigned long addr, uintptr_t *rsdp);
+void acpi_cache_save(unsigned long addr, unsigned long end, uintptr_t rsdp);
+
 unsigned long acpi_fill_madt(unsigned long current);
 unsigned long acpi_arch_fill_madt(acpi_madt_t *madt, unsigned long current);
 
@@ -1741,6 +1751,7 @@ void mainboard_fill_fadt(acpi_fadt_t *fadt);
 void fill_fadt_extended_pm_io(acpi_fadt_t *fadt);
 
 void acpi_fill_gnvs(void);
+void acpi_update_gnvs(void);
 void acpi_fill_cnvs(void);
 
 unsigned long acpi_fill_lpit(unsigned long current);
@@ -118,17 +118,22 @@ static inline void *cbfs_unverified_area_cbmem_alloc(const char *area, const cha
  * This method depends on COOP_MULTITASKING to parallelize the loading. This method is only
  * effective when the underlying rdev supports DMA operations.
  *
+ * Preloads are queued and streamed into the cbfs_cache by a single background thread in
+ * CONFIG_CBFS_PRELOAD_CHUNK_SIZE chunks, in the order they were requested.
+ *
  * When `cbfs_load`, `cbfs_alloc`, or `cbfs_map` are called after a preload has been started,
- * they will wait for the preload to complete (if it hasn't already) and then perform
- * verification and/or decompression.
+ * they will consume the file from the preload buffer, only waiting for the parts that haven't
+ * been read yet, and then perform verification and/or decompression. If the preload of the
+ * file hasn't started yet, it is cancelled and the file is read directly instead.
  *
  * This method does not have a return value because the system should boot regardless if this
  * method succeeds or fails.
  */
 void cbfs_preload(const char *name);
 
-/* Removes a previously allocated CBFS mapping. Should try to unmap mappings in strict LIFO
-   order where possible, since mapping backends often don't support more complicated cases. */
+/* Removes a previously allocated CBFS mapping. Mappings may be released in any order, but
+   the cbfs_cache can only track a limited number of live allocations (MEM_POOL_MAX_ALLOCS), so
+   long-lived mappings should be kept to a minimum. */
 void cbfs_unmap(void *mapping);
 
 /* Load stage into memory filling in prog. Return 0 on success. < 0 on error. */
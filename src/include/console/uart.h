@@ -3,6 +3,7 @@
 #ifndef CONSOLE_UART_H
 #define CONSOLE_UART_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 /* Return the clock frequency UART uses as reference clock for
@@ -52,6 +53,10 @@ void uart_tx_byte(unsigned int idx, unsigned char data);
 void uart_tx_flush(unsigned int idx);
 unsigned char uart_rx_byte(unsigned int idx);
 
+/* Write as many of the len bytes at data as the UART takes without waiting and
+   return how many that were. */
+size_t uart_tx_nonblocking(unsigned int idx, const unsigned char *data, size_t len);
+
 uintptr_t uart_platform_base(unsigned int idx);
 
 static inline void *uart_platform_baseptr(unsigned int idx)
@@ -65,6 +70,19 @@ void oxford_remap(unsigned int new_base);
 	(ENV_BOOTBLOCK || ENV_SEPARATE_ROMSTAGE || ENV_RAMSTAGE || ENV_SEPARATE_VERSTAGE \
 	 || ENV_POSTCAR || (ENV_SMM && CONFIG(DEBUG_SMI))))
 
+/*
+ * Serial console queue (CONSOLE_SERIAL_ASYNC). uart_async_tx_flush() pushes
+ * what the UART takes without waiting, uart_async_tx_drain() waits until the
+ * queue is empty.
+ */
+#define __CONSOLE_SERIAL_ASYNC__	(CONFIG(CONSOLE_SERIAL_ASYNC) && ENV_RAMSTAGE)
+
+void uart_async_tx_byte(unsigned char data);
+void uart_async_tx_flush(void);
+void uart_async_tx_drain(void);
+/* Microseconds of waiting for the UART that the queue saved so far. */
+long uart_async_usecs_saved(void);
+
 #if __CONSOLE_SERIAL_ENABLE__
 static inline void __uart_init(void)
 {
@@ -72,16 +90,28 @@ static inline void __uart_init(void)
 }
 static inline void __uart_tx_byte(u8 data)
 {
-	uart_tx_byte(get_uart_for_console(), data);
+	if (__CONSOLE_SERIAL_ASYNC__)
+		uart_async_tx_byte(data);
+	else
+		uart_tx_byte(get_uart_for_console(), data);
 }
 static inline void __uart_tx_flush(void)
 {
-	uart_tx_flush(get_uart_for_console());
+	if (__CONSOLE_SERIAL_ASYNC__)
+		uart_async_tx_flush();
+	else
+		uart_tx_flush(get_uart_for_console());
+}
+static inline void __uart_tx_drain(void)
+{
+	if (__CONSOLE_SERIAL_ASYNC__)
+		uart_async_tx_drain();
 }
 #else
 static inline void __uart_init(void)		{}
 static inline void __uart_tx_byte(u8 data)	{}
 static inline void __uart_tx_flush(void)	{}
+static inline void __uart_tx_drain(void)	{}
 #endif
 
 #if CONFIG(GDB_STUB) && (ENV_ROMSTAGE_OR_BEFORE || ENV_RAMSTAGE)
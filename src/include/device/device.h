@@ -118,6 +118,8 @@ struct device {
 	/* set if this device is used even in minimum PCI cases */
 	unsigned int    mandatory : 1;
 	unsigned int	hotplug_port : 1;
+	/* set if init() may run on a thread, in parallel with other devices */
+	unsigned int	init_async : 1;
 	u8 command;
 	uint16_t hotplug_buses; /* Number of hotplug buses to allocate */
 
@@ -159,6 +161,36 @@ struct device {
 extern DEVTREE_CONST struct device	dev_root;
 /* list of all devices */
 extern DEVTREE_CONST struct device * DEVTREE_CONST all_devices;
+
+/*
+ * Index of the devices in the static device tree, generated by sconfig. They
+ * are numbered in the order of all_devices: 0 is dev_root and i is
+ * devices[i - 1]. The index lists hold device numbers in ascending order,
+ * split into one range for every path type and every chip driver.
+ */
+struct devtree_index_range {
+	uint16_t key;		/* enum device_path_type for paths */
+	uint16_t first;
+	uint16_t count;
+};
+
+struct devtree_index {
+	DEVTREE_CONST struct device *devices;
+	uint16_t device_count;	/* dev_root not included */
+	uint16_t path_count;
+	uint16_t pci_root_count;
+	const struct devtree_index_range *paths;
+	const uint16_t *by_path;
+	/* PCI devices on pci_root_bus(), sorted by devfn */
+	const uint16_t *pci_root;
+#if !DEVTREE_EARLY
+	uint16_t chip_count;
+	const struct devtree_index_range *chips;
+	const uint16_t *by_chip;
+#endif
+};
+
+extern const struct devtree_index devtree_index;
 extern struct resource	*free_resources;
 extern struct bus	*free_links;
 
@@ -214,6 +246,9 @@ struct device *dev_find_class(unsigned int class, struct device *from);
 DEVTREE_CONST struct device *dev_find_path(
 		DEVTREE_CONST struct device *prev_match,
 		enum device_path_type path_type);
+DEVTREE_CONST struct device *dev_find_chip_ops(
+		DEVTREE_CONST struct device *prev_match,
+		const struct chip_operations *ops);
 struct device *dev_find_lapic(unsigned int apic_id);
 int dev_count_cpu(void);
 struct device *add_cpu_device(struct bus *cpu_bus, unsigned int apic_id,
@@ -90,6 +90,28 @@ void pci_scan_bridge(struct device *bus);
 void pci_scan_bus(struct bus *bus, unsigned int min_devfn,
 	unsigned int max_devfn);
 
+/*
+ * PCI topology cache (PCI_TOPOLOGY_CACHE). The functions found on each bus
+ * are recorded in scan order, every bus starting with an entry with an id of
+ * 0. pci_topology_cache_lookup() returns the functions that were found on
+ * the bus the last time, unless there is no valid cache or it was
+ * invalidated during this boot.
+ */
+struct pci_topology_entry {
+	uint16_t segment_group;
+	uint8_t bus;
+	uint8_t devfn;
+	uint32_t id;
+	uint32_t class;
+} __packed;
+
+void pci_topology_cache_load(void);
+bool pci_topology_cache_lookup(const struct bus *bus, const struct pci_topology_entry **entries,
+			       size_t *count);
+void pci_topology_cache_record(const struct bus *bus);
+void pci_topology_cache_invalidate(void);
+void pci_topology_cache_save(void);
+
 uint8_t pci_moving_config8(struct device *dev, unsigned int reg);
 uint16_t pci_moving_config16(struct device *dev, unsigned int reg);
 uint32_t pci_moving_config32(struct device *dev, unsigned int reg);
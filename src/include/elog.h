@@ -10,6 +10,8 @@
 /* Eventlog backing storage must be initialized before calling elog_init(). */
 int elog_init(void);
 int elog_clear(void);
+/* Write events that were only added to the in-memory copy of the log so far. */
+int elog_flush(void);
 /* Event addition functions return < 0 on failure and 0 on success. */
 int elog_add_event_raw(u8 event_type, void *data, u8 data_size);
 int elog_add_event(u8 event_type);
@@ -23,6 +25,7 @@ int elog_add_extended_event(u8 type, u32 complement);
 /* Stubs to help avoid littering sources with #if CONFIG_ELOG */
 static inline int elog_init(void) { return -1; }
 static inline int elog_clear(void) { return -1; }
+static inline int elog_flush(void) { return 0; }
 static inline int elog_add_event_raw(u8 event_type, void *data,
 					u8 data_size) { return 0; }
 static inline int elog_add_event(u8 event_type) { return 0; }
@@ -5,11 +5,20 @@
 #ifndef __LIB_H__
 #define __LIB_H__
 
+#include <commonlib/bsd/compression.h>
 #include <types.h>
 
 /* Defined in src/lib/lzma.c. Returns decompressed size or 0 on error. */
 size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn);
 
+/* Defined in src/lib/lzma.c. Same as ulzman(), but pulls the compressed input through read()
+   in chunks of up to scratch_size bytes instead of requiring it to be mapped in memory. */
+size_t ulzman_stream(decompress_read_fn read, void *arg, size_t srcn, void *dst,
+		     size_t dstn, void *scratch, size_t scratch_size);
+
+/* Defined in src/lib/zstd.c. Returns decompressed size or 0 on error. */
+size_t uzstd(const void *src, size_t srcn, void *dst, size_t dstn);
+
 /* Defined in src/lib/ramtest.c */
 /* Assumption is 32-bit addressable UC memory. */
 void ram_check(uintptr_t start);
@@ -48,6 +48,12 @@ int region_file_update_data_arr(struct region_file *f,
 				  size_t num_entries);
 int region_file_update_data(struct region_file *f, const void *buf, size_t size);
 
+/*
+ * Returns 1 if an update of size bytes can be appended to the data written so far, 0 if
+ * the region would have to be emptied for it, which erases all previous updates.
+ */
+int region_file_update_fits(const struct region_file *f, size_t size);
+
 /* Declared here for easy object allocation. */
 struct region_file {
 	/* Region device covering file */
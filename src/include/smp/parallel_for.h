@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#ifndef SMP_PARALLEL_FOR_H
+#define SMP_PARALLEL_FOR_H
+
+#include <types.h>
+
+/*
+ * Split [0, count) into chunks of chunk_size and call func(arg, start, end) for every chunk,
+ * on the BSP and all APs that are waiting for work. Returns once all chunks are done. func
+ * must not use the console heavily, as all CPUs share it.
+ *
+ * The chunks are handed out in order, but may complete in any order. Only the BSP may call
+ * this, and not while other work is running on the APs. Without PARALLEL_MP_AP_WORK, or
+ * outside of ramstage, func is called once for the whole range on the calling CPU.
+ *
+ * Returns CB_ERR if an AP didn't finish its chunk in time. That chunk may not be done, and
+ * the AP may still be working on it.
+ */
+#if ENV_RAMSTAGE && CONFIG(PARALLEL_MP_AP_WORK)
+enum cb_err parallel_for(void (*func)(void *arg, size_t start, size_t end), void *arg,
+			 size_t count, size_t chunk_size);
+#else
+static inline enum cb_err parallel_for(void (*func)(void *arg, size_t start, size_t end),
+				       void *arg, size_t count, size_t chunk_size)
+{
+	if (count)
+		func(arg, 0, count);
+	return CB_SUCCESS;
+}
+#endif
+
+#endif /* SMP_PARALLEL_FOR_H */
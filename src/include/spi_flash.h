@@ -99,7 +99,9 @@ struct spi_flash {
 		struct {
 			u8 dual_output	: 1;
 			u8 dual_io	: 1;
-			u8 _reserved	: 6;
+			u8 quad_output	: 1;
+			u8 quad_io	: 1;
+			u8 _reserved	: 4;
 		};
 	} flags;
 	u16 model;
@@ -69,6 +69,10 @@ int thread_yield_microseconds(unsigned int microsecs);
 void thread_coop_enable(void);
 void thread_coop_disable(void);
 
+/* Return the ID of the running thread. The main thread (and code running before threads are
+ * initialized) has ID 0. */
+int thread_self_id(void);
+
 void thread_mutex_lock(struct thread_mutex *mutex);
 void thread_mutex_unlock(struct thread_mutex *mutex);
 
@@ -90,6 +94,10 @@ static inline int thread_yield_microseconds(unsigned int microsecs)
 }
 static inline void thread_coop_enable(void) {}
 static inline void thread_coop_disable(void) {}
+static inline int thread_self_id(void)
+{
+	return 0;
+}
 
 static inline void thread_mutex_lock(struct thread_mutex *mutex) {}
 
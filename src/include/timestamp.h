@@ -52,6 +52,24 @@ uint64_t timestamp_get(void);
 #define timestamp_get() 0
 #endif
 
+#if CONFIG(TIMESTAMP_SPANS) && ENV_HAS_CBMEM
+/*
+ * Open a span nested in the span the running thread has currently open. Spans are only
+ * recorded in stages with CBMEM, once it is online. Returns a handle for
+ * timestamp_span_end(), which is 0 if the span wasn't recorded (it's fine to pass that to
+ * timestamp_span_end()).
+ */
+int timestamp_span_begin(enum timestamp_span_kind kind, uint32_t id, const char *name);
+void timestamp_span_end(int handle);
+#else
+static inline int timestamp_span_begin(enum timestamp_span_kind kind, uint32_t id,
+				       const char *name)
+{
+	return 0;
+}
+static inline void timestamp_span_end(int handle) {}
+#endif
+
 uint64_t get_initial_timestamp(void);
 /* Returns timestamp tick frequency in MHz. */
 int timestamp_tick_freq_mhz(void);
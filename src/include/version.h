@@ -3,6 +3,8 @@
 #ifndef VERSION_H
 #define VERSION_H
 
+#include <stdint.h>
+
 /* Dasharo version */
 extern const char dasharo_version[];
 extern const unsigned int dasharo_major_revision;
@@ -21,6 +23,9 @@ extern const unsigned int coreboot_minor_revision;
 extern const char coreboot_compile_time[];
 extern const char coreboot_dmi_date[];
 
+/* Identifies the firmware build, e.g. to invalidate caches kept in flash. */
+uint64_t coreboot_build_hash(void);
+
 struct bcd_date {
 	unsigned char century;
 	unsigned char year;
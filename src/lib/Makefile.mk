@@ -98,6 +98,7 @@ romstage-y += cbfs.c
 ifneq ($(CONFIG_COMPRESS_RAMSTAGE_LZMA)$(CONFIG_FSP_COMPRESS_FSP_M_LZMA),)
 romstage-y += lzma.c lzmadecode.c
 endif
+romstage-$(CONFIG_COMPRESS_RAMSTAGE_ZSTD) += zstd.c
 romstage-y += libgcc.c
 romstage-y += memrange.c
 romstage-$(CONFIG_PRIMITIVE_MEMTEST) += primitive_memtest.c
@@ -145,6 +146,7 @@ ramstage-y += delay.c
 ramstage-y += fallback_boot.c
 ramstage-y += cbfs.c
 ramstage-y += lzma.c lzmadecode.c
+ramstage-$(CONFIG_ZSTD) += zstd.c
 ramstage-y += stack.c
 ramstage-y += hexstrtobin.c
 ramstage-y += wrdd.c
@@ -277,6 +279,9 @@ smm-y += crc_byte.c
 romstage-y += xxhash.c
 ramstage-y += xxhash.c
 
+romstage-y += build_hash.c
+ramstage-y += build_hash.c
+
 postcar-y += bootmode.c
 postcar-y += boot_device.c
 postcar-y += cbfs.c
@@ -286,6 +291,7 @@ postcar-y += gcc.c
 postcar-y += halt.c
 postcar-y += libgcc.c
 postcar-$(CONFIG_COMPRESS_RAMSTAGE_LZMA) += lzma.c lzmadecode.c
+postcar-$(CONFIG_COMPRESS_RAMSTAGE_ZSTD) += zstd.c
 postcar-y += memchr.c
 postcar-y += memcmp.c
 postcar-y += prog_loaders.c
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <string.h>
+#include <types.h>
+#include <version.h>
+#include <xxhash.h>
+
+/* Code and read-only data of the current stage, see program.ld. */
+extern u8 _text[];
+extern u8 _etext[];
+
+static void hash_string(struct xxh64_state *state, const char *s)
+{
+	xxh64_update(state, s, strlen(s) + 1);
+}
+
+/*
+ * The version strings alone don't tell builds apart: the compile time is taken
+ * from the last commit, so builds of the same tree with another .config or
+ * local changes share them. The code and constant data of the running stage
+ * do change with those.
+ */
+uint64_t coreboot_build_hash(void)
+{
+	static uint64_t hash;
+	struct xxh64_state state;
+
+	if (hash)
+		return hash;
+
+	xxh64_reset(&state, 0);
+	hash_string(&state, coreboot_version);
+	hash_string(&state, coreboot_extra_version);
+	hash_string(&state, coreboot_build);
+	hash_string(&state, coreboot_compile_time);
+	xxh64_update(&state, _text, _etext - _text);
+	hash = xxh64_digest(&state);
+
+	return hash;
+}
@@ -158,6 +158,23 @@ static inline bool cbfs_lzma_enabled(void)
 	return ENV_BOOTBLOCK;
 }
 
+static inline bool cbfs_zstd_enabled(void)
+{
+	if (!CONFIG(ZSTD))
+		return false;
+	/* Payload loader (ramstage) may load zstd compressed files. */
+	if (ENV_PAYLOAD_LOADER)
+		return true;
+	/* Only other use of zstd is ramstage compression. */
+	if (!CONFIG(COMPRESS_RAMSTAGE_ZSTD))
+		return false;
+	if (CONFIG(POSTCAR_STAGE))
+		return ENV_POSTCAR;
+	if (CONFIG(SEPARATE_ROMSTAGE))
+		return ENV_SEPARATE_ROMSTAGE;
+	return ENV_BOOTBLOCK;
+}
+
 static bool cbfs_file_hash_mismatch(const void *buffer, size_t size,
 				    const union cbfs_mdata *mdata, bool skip_verification)
 {
@@ -206,6 +223,53 @@ static bool cbfs_file_hash_mismatch(const void *buffer, size_t size,
 	return false;
 }
 
+static bool cbfs_decompress_streaming(bool skip_verification)
+{
+	if (!CONFIG(CBFS_STREAMING_DECOMPRESSION))
+		return false;
+
+	/* Hashing needs the whole compressed file before decompression may start. */
+	if (CONFIG(CBFS_VERIFICATION) && !skip_verification)
+		return false;
+	if (CONFIG(TPM_MEASURED_BOOT) && !ENV_SMM)
+		return false;
+
+	return true;
+}
+
+static size_t cbfs_stream_read(void *arg, size_t offset, void *buf, size_t size)
+{
+	const struct region_device *rdev = arg;
+
+	if (rdev_readat(rdev, buf, offset, size) != size)
+		return 0;
+
+	return size;
+}
+
+typedef size_t (*cbfs_stream_decompressor_t)(decompress_read_fn read, void *arg, size_t srcn,
+					     void *dst, size_t dstn, void *scratch,
+					     size_t scratch_size);
+
+/* Returns decompressed size, 0 on error or SIZE_MAX if no scratch buffer was available. */
+static size_t cbfs_stream_decompress(const struct region_device *rdev, void *buffer,
+				     size_t buffer_size, cbfs_stream_decompressor_t decompress)
+{
+	const size_t scratch_size = CONFIG_CBFS_STREAMING_DECOMPRESSION_BUFFER_SIZE;
+	void *scratch = mem_pool_alloc(&cbfs_cache, scratch_size);
+	size_t out_size;
+
+	if (!scratch)
+		return SIZE_MAX;
+
+	out_size = decompress(cbfs_stream_read, (void *)rdev, region_device_sz(rdev), buffer,
+			      buffer_size, scratch, scratch_size);
+
+	mem_pool_free(&cbfs_cache, scratch);
+
+	return out_size;
+}
+
 static size_t cbfs_load_and_decompress(const struct region_device *rdev, void *buffer,
 				       size_t buffer_size, uint32_t compression,
 				       const union cbfs_mdata *mdata, bool skip_verification)
@@ -238,6 +302,15 @@ static size_t cbfs_load_and_decompress(const struct region_device *rdev, void *b
 		if (!cbfs_lz4_enabled())
 			return 0;
 
+		if (cbfs_decompress_streaming(skip_verification)) {
+			timestamp_add_now(TS_ULZ4F_START);
+			out_size = cbfs_stream_decompress(rdev, buffer, buffer_size,
+							  ulz4fn_stream);
+			timestamp_add_now(TS_ULZ4F_END);
+			if (out_size != SIZE_MAX)
+				return out_size;
+		}
+
 		/* cbfs_prog_stage_load() takes care of in-place LZ4 decompression by
 		   setting up the rdev to be in memory. */
 		map = rdev_mmap_full(rdev);
@@ -257,6 +330,16 @@ static size_t cbfs_load_and_decompress(const struct region_device *rdev, void *b
 	case CBFS_COMPRESS_LZMA:
 		if (!cbfs_lzma_enabled())
 			return 0;
+
+		if (cbfs_decompress_streaming(skip_verification)) {
+			timestamp_add_now(TS_ULZMA_START);
+			out_size = cbfs_stream_decompress(rdev, buffer, buffer_size,
+							  ulzman_stream);
+			timestamp_add_now(TS_ULZMA_END);
+			if (out_size != SIZE_MAX)
+				return out_size;
+		}
+
 		map = rdev_mmap_full(rdev);
 		if (map == NULL)
 			return 0;
@@ -272,20 +355,57 @@ static size_t cbfs_load_and_decompress(const struct region_device *rdev, void *b
 
 		return out_size;
 
+	case CBFS_COMPRESS_ZSTD:
+		if (!cbfs_zstd_enabled())
+			return 0;
+
+		map = rdev_mmap_full(rdev);
+		if (map == NULL)
+			return 0;
+
+		if (!cbfs_file_hash_mismatch(map, in_size, mdata, skip_verification)) {
+			timestamp_add_now(TS_UZSTD_START);
+			out_size = uzstd(map, in_size, buffer, buffer_size);
+			timestamp_add_now(TS_UZSTD_END);
+		}
+
+		rdev_munmap(rdev, map);
+
+		return out_size;
+
 	default:
 		return 0;
 	}
 }
 
+/*
+ * CBFS preloading is implemented as a queue of files that a single worker thread streams into
+ * the cbfs_cache in CONFIG_CBFS_PRELOAD_CHUNK_SIZE pieces, yielding after each one. Consumers
+ * don't have to wait for the whole file: they get a region_device backed by the preload buffer
+ * that only blocks until the bytes they actually access have landed.
+ */
+enum cbfs_preload_state {
+	CBFS_PRELOAD_QUEUED,
+	CBFS_PRELOAD_LOADING,
+	CBFS_PRELOAD_DONE,
+	CBFS_PRELOAD_FAILED,
+};
+
 struct cbfs_preload_context {
+	/* Source file on the boot device. */
 	struct region_device rdev;
-	struct thread_handle handle;
+	/* Consumer view of the preload buffer, see preload_rdev_ops. */
+	struct region_device buffer_rdev;
 	struct list_node list_node;
+	enum cbfs_preload_state state;
+	size_t loaded;
 	void *buffer;
 	char name[];
 };
 
 static struct list_node cbfs_preload_context_list;
+static struct thread_handle cbfs_preload_worker_handle;
+static bool cbfs_preload_worker_running;
 
 static struct cbfs_preload_context *alloc_cbfs_preload_context(size_t additional)
 {
@@ -314,18 +434,104 @@ static void free_cbfs_preload_context(struct cbfs_preload_context *context)
 	mem_pool_free(&cbfs_cache, context);
 }
 
-static enum cb_err cbfs_preload_thread_entry(void *arg)
+static struct cbfs_preload_context *next_queued_cbfs_preload_context(void)
 {
-	struct cbfs_preload_context *context = arg;
+	struct cbfs_preload_context *context;
 
-	if (rdev_read_full(&context->rdev, context->buffer) < 0) {
-		ERROR("%s(name='%s') readat failed\n", __func__, context->name);
-		return CB_ERR;
+	list_for_each(context, cbfs_preload_context_list, list_node) {
+		if (context->state == CBFS_PRELOAD_QUEUED)
+			return context;
 	}
 
+	return NULL;
+}
+
+static enum cb_err cbfs_preload_worker_entry(void *unused)
+{
+	struct cbfs_preload_context *context;
+
+	while ((context = next_queued_cbfs_preload_context())) {
+		const size_t size = region_device_sz(&context->rdev);
+
+		context->state = CBFS_PRELOAD_LOADING;
+
+		while (context->loaded < size) {
+			size_t chunk = MIN(size - context->loaded,
+					   (size_t)CONFIG_CBFS_PRELOAD_CHUNK_SIZE);
+
+			if (rdev_readat(&context->rdev, context->buffer + context->loaded,
+					context->loaded, chunk) != chunk) {
+				ERROR("%s(name='%s') readat failed\n", __func__, context->name);
+				context->state = CBFS_PRELOAD_FAILED;
+				break;
+			}
+
+			context->loaded += chunk;
+			/* Give consumers waiting on this chunk a chance to run. */
+			thread_yield();
+		}
+
+		if (context->state == CBFS_PRELOAD_LOADING)
+			context->state = CBFS_PRELOAD_DONE;
+	}
+
+	cbfs_preload_worker_running = false;
+
 	return CB_SUCCESS;
 }
 
+/* Wait until the worker has filled the preload buffer up to `end`. */
+static int wait_for_preload(struct cbfs_preload_context *context, size_t end)
+{
+	while (context->loaded < end) {
+		if (context->state == CBFS_PRELOAD_FAILED)
+			return -1;
+		if (thread_yield() < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static struct cbfs_preload_context *preload_rdev_context(const struct region_device *rd)
+{
+	return container_of(rd, struct cbfs_preload_context, buffer_rdev);
+}
+
+static void *preload_rdev_mmap(const struct region_device *rd, size_t offset, size_t size)
+{
+	struct cbfs_preload_context *context = preload_rdev_context(rd);
+
+	if (wait_for_preload(context, offset + size))
+		return NULL;
+
+	return context->buffer + offset;
+}
+
+static int preload_rdev_munmap(const struct region_device *rd, void *mapping)
+{
+	return 0;
+}
+
+static ssize_t preload_rdev_readat(const struct region_device *rd, void *b, size_t offset,
+				   size_t size)
+{
+	struct cbfs_preload_context *context = preload_rdev_context(rd);
+
+	if (wait_for_preload(context, offset + size))
+		return -1;
+
+	memcpy(b, context->buffer + offset, size);
+
+	return size;
+}
+
+static const struct region_device_ops preload_rdev_ops = {
+	.mmap = preload_rdev_mmap,
+	.munmap = preload_rdev_munmap,
+	.readat = preload_rdev_readat,
+};
+
 void cbfs_preload(const char *name)
 {
 	struct region_device rdev;
@@ -358,21 +564,27 @@ void cbfs_preload(const char *name)
 	if (context->buffer == NULL) {
 		ERROR("%s(name='%s') failed to allocate %zu bytes for preload buffer\n",
 		      __func__, name, size);
-		goto out;
+		mem_pool_free(&cbfs_cache, context);
+		return;
 	}
 
 	context->rdev = rdev;
+	context->state = CBFS_PRELOAD_QUEUED;
+	region_device_init(&context->buffer_rdev, &preload_rdev_ops, 0, size);
 	strcpy(context->name, name);
 
 	append_cbfs_preload_context(context);
 
-	if (thread_run(&context->handle, cbfs_preload_thread_entry, context) == 0)
+	if (cbfs_preload_worker_running)
+		return;
+
+	cbfs_preload_worker_running = true;
+	if (thread_run(&cbfs_preload_worker_handle, cbfs_preload_worker_entry, NULL) == 0)
 		return;
 
 	ERROR("%s(name='%s') failed to start preload thread\n", __func__, name);
+	cbfs_preload_worker_running = false;
 	mem_pool_free(&cbfs_cache, context->buffer);
-
-out:
 	free_cbfs_preload_context(context);
 }
 
@@ -388,40 +600,55 @@ static struct cbfs_preload_context *find_cbfs_preload_context(const char *name)
 	return NULL;
 }
 
-static enum cb_err get_preload_rdev(struct region_device *rdev, const char *name)
+static void release_cbfs_preload_context(struct cbfs_preload_context *context,
+					 const void *mapping)
+{
+	/* The worker must be done writing into the buffer before it can be reused. */
+	while (context->state == CBFS_PRELOAD_LOADING)
+		assert(thread_yield() == 0);
+
+	/* cbfs_map() of an uncompressed file hands out the preload buffer itself, which the
+	   caller will later release through cbfs_unmap(). */
+	if (context->buffer != mapping)
+		mem_pool_free(&cbfs_cache, context->buffer);
+	free_cbfs_preload_context(context);
+}
+
+/*
+ * Point rdev at the preload buffer for `name`. Returns the preload context that must be
+ * released once the caller is done with rdev, or NULL if the file should be read directly
+ * from the boot device.
+ */
+static struct cbfs_preload_context *get_preload_rdev(struct region_device *rdev,
+						     const char *name)
 {
-	enum cb_err err;
 	struct cbfs_preload_context *context;
 
 	if (!CONFIG(CBFS_PRELOAD) || !ENV_SUPPORTS_COOP)
-		return CB_ERR_ARG;
+		return NULL;
 
 	context = find_cbfs_preload_context(name);
 	if (!context)
-		return CB_ERR_ARG;
-
-	err = thread_join(&context->handle);
-	if (err != CB_SUCCESS) {
-		ERROR("%s(name='%s') Preload thread failed: %u\n", __func__, name, err);
+		return NULL;
 
-		goto out;
+	/* Nothing gained by waiting on the worker if it hasn't even started on this file. */
+	if (context->state == CBFS_PRELOAD_QUEUED || context->state == CBFS_PRELOAD_FAILED) {
+		DEBUG("%s(name='%s') preload %s, reading directly\n", __func__, name,
+		      context->state == CBFS_PRELOAD_QUEUED ? "not started" : "failed");
+		release_cbfs_preload_context(context, NULL);
+		return NULL;
 	}
 
-	if (rdev_chain_mem(rdev, context->buffer, region_device_sz(&context->rdev)) != 0) {
+	if (rdev_chain_full(rdev, &context->buffer_rdev) != 0) {
 		ERROR("%s(name='%s') chaining failed\n", __func__, name);
-
-		err = CB_ERR;
-		goto out;
+		release_cbfs_preload_context(context, NULL);
+		return NULL;
 	}
 
-	err = CB_SUCCESS;
+	DEBUG("%s(name='%s') using preload, %zu/%zu bytes loaded\n", __func__, name,
+	      context->loaded, region_device_sz(rdev));
 
-	DEBUG("%s(name='%s') preload successful\n", __func__, name);
-
-out:
-	free_cbfs_preload_context(context);
-
-	return err;
+	return context;
 }
 
 static void *do_alloc(union cbfs_mdata *mdata, struct region_device *rdev,
@@ -479,7 +706,7 @@ void *_cbfs_alloc(const char *name, cbfs_allocator_t allocator, void *arg,
 		  size_t *size_out, bool force_ro, enum cbfs_type *type)
 {
 	struct region_device rdev;
-	bool preload_successful = false;
+	struct cbfs_preload_context *preload = NULL;
 	union cbfs_mdata mdata;
 	bool skip_verification = false;
 
@@ -501,8 +728,8 @@ void *_cbfs_alloc(const char *name, cbfs_allocator_t allocator, void *arg,
 	}
 
 	/* Update the rdev with the preload content */
-	if (!force_ro && get_preload_rdev(&rdev, name) == CB_SUCCESS)
-		preload_successful = true;
+	if (!force_ro)
+		preload = get_preload_rdev(&rdev, name);
 
 	/*
 	 * Bootblock will never have its hash due to how CBFS_VERIFICATION works.
@@ -511,12 +738,16 @@ void *_cbfs_alloc(const char *name, cbfs_allocator_t allocator, void *arg,
 	if (type && *type == CBFS_TYPE_BOOTBLOCK)
 		skip_verification = true;
 
+	const int span = timestamp_span_begin(TS_SPAN_CBFS_LOAD, 0, name);
+
 	void *ret = do_alloc(&mdata, &rdev, allocator, arg, size_out, skip_verification);
 
 	/* When using cbfs_preload we need to free the preload buffer after populating the
-	 * destination buffer. We know we must have a mem_rdev here, so extra mmap is fine. */
-	if (preload_successful)
-		cbfs_unmap(rdev_mmap_full(&rdev));
+	 * destination buffer. */
+	if (preload)
+		release_cbfs_preload_context(preload, ret);
+
+	timestamp_span_end(span);
 
 	return ret;
 }
@@ -599,8 +830,10 @@ enum cb_err cbfs_prog_stage_load(struct prog *pstage)
 	}
 
 	/* LZ4 stages can be decompressed in-place to save mapping scratch space. Load the
-	   compressed data to the end of the buffer and point &rdev to that memory location. */
-	if (cbfs_lz4_enabled() && compression == CBFS_COMPRESS_LZ4) {
+	   compressed data to the end of the buffer and point &rdev to that memory location.
+	   Not needed when streaming, which decompresses straight from the boot device. */
+	if (cbfs_lz4_enabled() && compression == CBFS_COMPRESS_LZ4 &&
+	    !cbfs_decompress_streaming(false)) {
 		size_t in_size = region_device_sz(&rdev);
 		void *compr_start = prog_start(pstage) + prog_size(pstage) - in_size;
 		if (rdev_readat(&rdev, compr_start, 0, in_size) != in_size)
@@ -608,8 +841,10 @@ enum cb_err cbfs_prog_stage_load(struct prog *pstage)
 		rdev_chain_mem(&rdev, compr_start, in_size);
 	}
 
+	const int span = timestamp_span_begin(TS_SPAN_CBFS_LOAD, 0, prog_name(pstage));
 	size_t fsize = cbfs_load_and_decompress(&rdev, prog_start(pstage), prog_size(pstage),
 						compression, &mdata, false);
+	timestamp_span_end(span);
 	if (!fsize)
 		return CB_ERR;
 
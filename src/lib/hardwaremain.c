@@ -320,6 +320,7 @@ static void bs_walk_state_machine(void)
 	while (1) {
 		struct boot_state *state;
 		boot_state_t next_id;
+		int span;
 
 		state = &boot_states[current_phase.state_id];
 
@@ -337,6 +338,8 @@ static void bs_walk_state_machine(void)
 
 		bs_sample_time(state);
 
+		span = timestamp_span_begin(TS_SPAN_BOOT_STATE, 0, state->name);
+
 		bs_call_callbacks(state, current_phase.seq);
 		/* Update the current sequence so that any calls to block the
 		 * current state from the run_state() function will place a
@@ -359,6 +362,8 @@ static void bs_walk_state_machine(void)
 
 		bs_call_callbacks(state, current_phase.seq);
 
+		timestamp_span_end(span);
+
 		if (CONFIG(DEBUG_BOOT_STATE))
 			printk(BIOS_DEBUG,
 				"----------------------------------------\n");
@@ -11,16 +11,45 @@
  *
  */
 
+#include <commonlib/helpers.h>
 #include <console/console.h>
 #include <string.h>
 #include <lib.h>
 
 #include "lzmadecode.h"
 
-size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
+struct lzma_stream_in {
+	ILzmaInCallback cb;
+	decompress_read_fn read;
+	void *arg;
+	size_t offset;
+	size_t srcn;
+	unsigned char *buf;
+	size_t buf_size;
+};
+
+static int lzma_stream_read(ILzmaInCallback *cb, const unsigned char **buffer,
+			    SizeT *size)
+{
+	struct lzma_stream_in *in = container_of(cb, struct lzma_stream_in, cb);
+	size_t chunk = MIN(in->buf_size, in->srcn - in->offset);
+
+	if (chunk && in->read(in->arg, in->offset, in->buf, chunk) != chunk) {
+		printk(BIOS_WARNING, "lzma: Input read error.\n");
+		return 1;
+	}
+
+	in->offset += chunk;
+	*buffer = in->buf;
+	*size = chunk;
+	return 0;
+}
+
+/* Parses the stream header in src and decodes the rest. in_cb is optional. */
+static size_t lzma_decode(const unsigned char *header, const void *src, size_t srcn,
+			  ILzmaInCallback *in_cb, void *dst, size_t dstn)
 {
 	unsigned char properties[LZMA_PROPERTIES_SIZE];
-	const int data_offset = LZMA_PROPERTIES_SIZE + 8;
 	UInt32 outSize;
 	SizeT inProcessed;
 	SizeT outProcessed;
@@ -30,17 +59,12 @@ size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
 	static unsigned char scratchpad[15980];
 	const unsigned char *cp;
 
-	if (srcn < data_offset) {
-		printk(BIOS_WARNING, "lzma: Input too small.\n");
-		return 0;
-	}
-
-	memcpy(properties, src, LZMA_PROPERTIES_SIZE);
+	memcpy(properties, header, LZMA_PROPERTIES_SIZE);
 	/* The outSize in LZMA stream is a 64bit integer stored in little-endian
 	 * (ref: lzma.cc@LZMACompress: put_64). To prevent accessing by
 	 * unaligned memory address and to load in correct endianness, read each
 	 * byte and re-construct. */
-	cp = src + LZMA_PROPERTIES_SIZE;
+	cp = header + LZMA_PROPERTIES_SIZE;
 	outSize = cp[3] << 24 | cp[2] << 16 | cp[1] << 8 | cp[0];
 	if (outSize > dstn)
 		outSize = dstn;
@@ -55,11 +79,51 @@ size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
 		return 0;
 	}
 	state.Probs = (CProb *)scratchpad;
-	res = LzmaDecode(&state, src + data_offset, srcn - data_offset,
-			 &inProcessed, dst, outSize, &outProcessed);
+	state.InCallback = in_cb;
+	res = LzmaDecode(&state, src, srcn, &inProcessed, dst, outSize, &outProcessed);
 	if (res != 0) {
 		printk(BIOS_WARNING, "lzma: Decoding error = %d\n", res);
 		return 0;
 	}
 	return outProcessed;
 }
+
+size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	const int data_offset = LZMA_PROPERTIES_SIZE + 8;
+
+	if (srcn < data_offset) {
+		printk(BIOS_WARNING, "lzma: Input too small.\n");
+		return 0;
+	}
+
+	return lzma_decode(src, src + data_offset, srcn - data_offset, NULL, dst, dstn);
+}
+
+size_t ulzman_stream(decompress_read_fn read, void *arg, size_t srcn, void *dst,
+		     size_t dstn, void *scratch, size_t scratch_size)
+{
+	unsigned char header[LZMA_PROPERTIES_SIZE + 8];
+	struct lzma_stream_in in = {
+		.cb.Read = lzma_stream_read,
+		.read = read,
+		.arg = arg,
+		.offset = sizeof(header),
+		.srcn = srcn,
+		.buf = scratch,
+		.buf_size = scratch_size,
+	};
+
+	if (srcn < sizeof(header)) {
+		printk(BIOS_WARNING, "lzma: Input too small.\n");
+		return 0;
+	}
+
+	if (!scratch_size || read(arg, 0, header, sizeof(header)) != sizeof(header)) {
+		printk(BIOS_WARNING, "lzma: Input read error.\n");
+		return 0;
+	}
+
+	/* Start with an empty chunk, the decoder pulls the first one on its own. */
+	return lzma_decode(header, scratch, 0, &in.cb, dst, dstn);
+}
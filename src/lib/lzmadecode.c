@@ -57,9 +57,15 @@
 }
 
 
-#define RC_TEST { if (Buffer == BufferLim) return LZMA_RESULT_DATA_ERROR; }
+/* Byte reads are used for the last 4 bytes of each chunk, so look_ahead is
+ * always drained when Buffer reaches BufferLim and it is safe to refill. */
+#define RC_TEST {							\
+	if (Buffer == BufferLim && LzmaRefill(vs, &Buffer, &BufferLim,	\
+					     &ChunkStart, &InPrev))	\
+		return LZMA_RESULT_DATA_ERROR;				\
+}
 
-#define RC_INIT(buffer, bufferSize) Buffer = buffer; \
+#define RC_INIT(buffer, bufferSize) Buffer = buffer; ChunkStart = buffer; \
 	BufferLim = buffer + bufferSize; RC_INIT2
 
 
@@ -189,6 +195,24 @@ int LzmaDecodeProperties(CLzmaProperties *propsRes,
 
 #define kLzmaStreamWasFinishedId (-1)
 
+/* Fetch the next input chunk. Returns non-zero if there is no more input. */
+static int LzmaRefill(CLzmaDecoderState *vs, const Byte **buffer,
+	const Byte **bufferLim, const Byte **chunkStart, SizeT *inPrev)
+{
+	SizeT size;
+
+	if (!vs->InCallback)
+		return 1;
+
+	*inPrev += (SizeT)(*bufferLim - *chunkStart);
+	if (vs->InCallback->Read(vs->InCallback, buffer, &size) || size == 0)
+		return 1;
+
+	*chunkStart = *buffer;
+	*bufferLim = *buffer + size;
+	return 0;
+}
+
 __lzma_attribute_Ofast__
 int LzmaDecode(CLzmaDecoderState *vs,
 	const unsigned char *inStream, SizeT inSize, SizeT *inSizeProcessed,
@@ -207,6 +231,8 @@ int LzmaDecode(CLzmaDecoderState *vs,
 	int len = 0;
 	const Byte *Buffer;
 	const Byte *BufferLim;
+	const Byte *ChunkStart;
+	SizeT InPrev = 0;
 	int look_ahead_ptr = 4;
 	union {
 		Byte raw[4];
@@ -435,7 +461,7 @@ int LzmaDecode(CLzmaDecoderState *vs,
 	 (void)len;
 
 
-	*inSizeProcessed = (SizeT)(Buffer - inStream);
+	*inSizeProcessed = InPrev + (SizeT)(Buffer - ChunkStart);
 	*outSizeProcessed = nowPos;
 	return LZMA_RESULT_OK;
 }
@@ -52,9 +52,21 @@ int LzmaDecodeProperties(CLzmaProperties *propsRes,
 
 #define kLzmaNeedInitId (-2)
 
+/*
+ * Optional input callback. When set, LzmaDecode() calls Read() for the next
+ * chunk of compressed data whenever it has consumed the current one, instead
+ * of failing at the end of inStream. Read() returns 0 on success and may only
+ * return an empty chunk at the end of the input.
+ */
+typedef struct _ILzmaInCallback {
+	int (*Read)(struct _ILzmaInCallback *object, const unsigned char **buffer,
+		SizeT *bufferSize);
+} ILzmaInCallback;
+
 typedef struct _CLzmaDecoderState {
 	CLzmaProperties Properties;
 	CProb *Probs;
+	ILzmaInCallback *InCallback;
 } CLzmaDecoderState;
 
 
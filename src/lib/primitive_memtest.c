@@ -3,46 +3,63 @@
 #include <stdint.h>
 #include <lib.h>
 #include <console/console.h>
+#include <smp/atomic.h>
+#include <smp/parallel_for.h>
+
+/* Each CPU takes 16 MiB of the range at a time. */
+#define MEMTEST_CHUNK_WORDS	(16 * MiB / sizeof(uintptr_t))
+
+struct memtest {
+	uintptr_t base;
+	atomic_t bad;
+};
+
+static void memtest_write(void *arg, size_t start, size_t end)
+{
+	const struct memtest *t = arg;
+	uintptr_t *p = (uintptr_t *)t->base;
+	size_t i;
+
+	for (i = start; i < end; i++)
+		p[i] = (uintptr_t)&p[i];
+}
+
+static void memtest_check(void *arg, size_t start, size_t end)
+{
+	struct memtest *t = arg;
+	uintptr_t *p = (uintptr_t *)t->base;
+	size_t i;
+
+	for (i = start; i < end; i++) {
+		if (p[i] != (uintptr_t)&p[i]) {
+			printk(BIOS_SPEW, "0x%08lx: got 0x%lx\n", (uintptr_t)&p[i], p[i]);
+			atomic_inc(&t->bad);
+		}
+	}
+}
 
 int primitive_memtest(uintptr_t base, uintptr_t size)
 {
-	uintptr_t *p;
-	uintptr_t i;
-	int bad = 0;
+	struct memtest t = { .base = base, .bad = ATOMIC_INIT(0) };
+	/* Leaves out the last word, like the test always did. */
+	const size_t words = size / sizeof(uintptr_t) - 1;
 
 	printk(BIOS_SPEW, "Performing primitive memory test.\n");
-	printk(BIOS_SPEW, "DRAM start: 0x%08x, DRAM size: 0x%08x", base, size);
-	for (i = base; i < base + (size - 1) - sizeof(p); i += sizeof(p)) {
-		if (i % 0x100000 == 0) {
-			if ((i % 0x800000) == 0)
-				printk(BIOS_SPEW, "\n");
-			else if (i != 0)
-				printk(BIOS_SPEW, " ");
-			printk(BIOS_SPEW, "0x%08x", i);
-		}
-		p = (uintptr_t *)i;
-		*p = i;
+	printk(BIOS_SPEW, "DRAM start: 0x%08lx, DRAM size: 0x%08lx\n", base, size);
+
+	if (parallel_for(memtest_write, &t, words, MEMTEST_CHUNK_WORDS) != CB_SUCCESS) {
+		printk(BIOS_ERR, "Memory test didn't finish writing\n");
+		return -1;
 	}
 
-	printk(BIOS_SPEW, "\n\nReading back DRAM content");
-	for (i = base; i < base + (size - 1) - sizeof(p); i += sizeof(p)) {
-		if (i % 0x100000 == 0) {
-			if ((i % 0x800000) == 0)
-				printk(BIOS_SPEW, "\n");
-			else if (i != 0)
-				printk(BIOS_SPEW, " ");
-			printk(BIOS_SPEW, "0x%08x", i);
-		}
+	printk(BIOS_SPEW, "Reading back DRAM content\n");
 
-		p = (uintptr_t *)i;
-		if (*p != i) {
-			printk(BIOS_SPEW, "\n0x%08zx: got 0x%zx\n", i, *p);
-			bad++;
-		}
+	if (parallel_for(memtest_check, &t, words, MEMTEST_CHUNK_WORDS) != CB_SUCCESS) {
+		printk(BIOS_ERR, "Memory test didn't finish reading back\n");
+		return -1;
 	}
 
-	printk(BIOS_SPEW, "\n");
-	printk(BIOS_SPEW, "%d errors\n", bad);
+	printk(BIOS_SPEW, "%d errors\n", atomic_read(&t.bad));
 
-	return bad;
+	return atomic_read(&t.bad);
 }
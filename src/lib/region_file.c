@@ -478,3 +478,12 @@ int region_file_update_data(struct region_file *f, const void *buf, size_t size)
 	};
 	return region_file_update_data_arr(f, &entry, 1);
 }
+
+int region_file_update_fits(const struct region_file *f, size_t size)
+{
+	/* Without metadata the region gets emptied before the first update. */
+	if (f->slot < RF_ONLY_METADATA)
+		return 0;
+
+	return update_can_fit(f, bytes_to_block(ALIGN_UP(size, REGF_BLOCK_GRANULARITY)));
+}
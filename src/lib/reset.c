@@ -2,12 +2,18 @@
 
 #include <arch/cache.h>
 #include <console/console.h>
+#include <console/uart.h>
+#include <elog.h>
 #include <halt.h>
 #include <reset.h>
 
 __noreturn void board_reset(void)
 {
 	printk(BIOS_INFO, "%s() called!\n", __func__);
+	/* Don't lose the events ramstage hasn't written to flash yet. */
+	if (ENV_RAMSTAGE)
+		elog_flush();
+	__uart_tx_drain();
 	dcache_clean_all();
 	do_board_reset();
 	halt();
@@ -87,6 +87,19 @@ static int load_one_segment(uint8_t *dest,
 			return 0;
 		break;
 	}
+	case CBFS_COMPRESS_ZSTD: {
+		if (!CONFIG(ZSTD)) {
+			printk(BIOS_ERR, "zstd support is not built in\n");
+			return 0;
+		}
+		printk(BIOS_DEBUG, "using zstd\n");
+		timestamp_add_now(TS_UZSTD_START);
+		len = uzstd(src, len, dest, memsz);
+		timestamp_add_now(TS_UZSTD_END);
+		if (!len) /* Decompression Error. */
+			return 0;
+		break;
+	}
 	case CBFS_COMPRESS_NONE: {
 		printk(BIOS_DEBUG, "it's not compressed!\n");
 		memcpy(dest, src, len);
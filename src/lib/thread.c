@@ -355,6 +355,13 @@ int thread_yield_microseconds(unsigned int microsecs)
 	return 0;
 }
 
+int thread_self_id(void)
+{
+	struct thread *current = current_thread();
+
+	return current ? current->id : 0;
+}
+
 void thread_coop_enable(void)
 {
 	struct thread *current;
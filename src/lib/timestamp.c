@@ -4,7 +4,9 @@
 #include <stdint.h>
 #include <console/console.h>
 #include <cbmem.h>
+#include <string.h>
 #include <symbols.h>
+#include <thread.h>
 #include <timer.h>
 #include <timestamp.h>
 #include <smp/node.h>
@@ -15,6 +17,15 @@
    as CBMEM comes available. */
 static struct timestamp_table *glob_ts_table;
 
+#define HAVE_SPANS (CONFIG(TIMESTAMP_SPANS) && ENV_HAS_CBMEM)
+
+#if HAVE_SPANS
+/* Span table in CBMEM, NULL until CBMEM is online. */
+static struct timestamp_span_table *glob_span_table;
+/* Innermost open span (index + 1) of each coop thread, 0 if none. */
+static uint16_t span_current[CONFIG_NUM_THREADS + 1];
+#endif
+
 static void timestamp_cache_init(struct timestamp_table *ts_cache,
 				 uint64_t base)
 {
@@ -206,6 +217,46 @@ static void timestamp_sync_cache_to_cbmem(struct timestamp_table *ts_cbmem_table
 	ts_cache_table->num_entries = 0;
 }
 
+#if HAVE_SPANS
+static void timestamp_span_reinit(void)
+{
+	struct timestamp_span_table *spans;
+
+	if (ENV_CREATES_CBMEM) {
+		spans = cbmem_add(CBMEM_ID_TIMESTAMP_SPANS, sizeof(*spans) +
+				  CONFIG_TIMESTAMP_MAX_SPANS * sizeof(spans->spans[0]));
+		if (spans) {
+			spans->max_spans = CONFIG_TIMESTAMP_MAX_SPANS;
+			spans->num_spans = 0;
+		}
+	} else {
+		spans = cbmem_find(CBMEM_ID_TIMESTAMP_SPANS);
+	}
+
+	if (!spans)
+		printk(BIOS_ERR, "No timestamp span table allocated\n");
+
+	glob_span_table = spans;
+}
+
+static void timestamp_span_rescale(uint16_t N, uint16_t M)
+{
+	uint32_t i;
+
+	if (!glob_span_table)
+		return;
+
+	for (i = 0; i < glob_span_table->num_spans; i++) {
+		struct timestamp_span *span = &glob_span_table->spans[i];
+		span->start = span->start / M * N;
+		span->end = span->end / M * N;
+	}
+}
+#else
+static void timestamp_span_reinit(void) {}
+static void timestamp_span_rescale(uint16_t N, uint16_t M) {}
+#endif
+
 static void timestamp_reinit(int is_recovery)
 {
 	struct timestamp_table *ts_cbmem_table;
@@ -236,6 +287,8 @@ static void timestamp_reinit(int is_recovery)
 		ts_cbmem_table->tick_freq_mhz = timestamp_tick_freq_mhz();
 
 	timestamp_table_set(ts_cbmem_table);
+
+	timestamp_span_reinit();
 }
 
 void timestamp_rescale_table(uint16_t N, uint16_t M)
@@ -264,7 +317,66 @@ void timestamp_rescale_table(uint16_t N, uint16_t M)
 		tse->entry_stamp /= M;
 		tse->entry_stamp *= N;
 	}
+
+	timestamp_span_rescale(N, M);
+}
+
+#if HAVE_SPANS
+int timestamp_span_begin(enum timestamp_span_kind kind, uint32_t id, const char *name)
+{
+	struct timestamp_span_table *spans = glob_span_table;
+	const int thread = thread_self_id();
+	struct timestamp_table *ts_table;
+	struct timestamp_span *span;
+
+	if (!timestamp_should_run() || !spans)
+		return 0;
+
+	ts_table = timestamp_table_get();
+	if (!ts_table)
+		return 0;
+
+	/* Handles are 16 bits wide in the parent field. */
+	if (spans->num_spans >= MIN(spans->max_spans, UINT16_MAX))
+		return 0;
+
+	assert(thread < ARRAY_SIZE(span_current));
+
+	span = &spans->spans[spans->num_spans++];
+	span->start = timestamp_get() - ts_table->base_time;
+	span->end = span->start - 1;
+	span->id = id;
+	span->parent = span_current[thread];
+	span->kind = kind;
+	span->thread = thread;
+	strncpy(span->name, name ? name : "", sizeof(span->name));
+
+	span_current[thread] = spans->num_spans;
+
+	return spans->num_spans;
+}
+
+void timestamp_span_end(int handle)
+{
+	struct timestamp_span_table *spans = glob_span_table;
+	struct timestamp_table *ts_table = timestamp_table_get();
+	struct timestamp_span *span;
+
+	if (!handle || !spans || !ts_table || handle > spans->num_spans)
+		return;
+
+	span = &spans->spans[handle - 1];
+	span->end = timestamp_get() - ts_table->base_time;
+
+	/* Spans that are closed out of order leave their children's parent in place. */
+	if (span_current[span->thread] == handle)
+		span_current[span->thread] = span->parent;
+
+	if (CONFIG(TIMESTAMPS_ON_CONSOLE))
+		printk(BIOS_INFO, "Timestamp span - %.*s: %lld\n", (int)sizeof(span->name),
+		       span->name, span->end - span->start);
 }
+#endif
 
 /*
  * Get the time in microseconds since boot (or more precise: since timestamp
@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <console/console.h>
+#include <lib.h>
+#include <stdint.h>
+
+size_t uzstd(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	static uint64_t workspace[UZSTD_WORKSPACE_SIZE / sizeof(uint64_t)];
+	size_t out_size;
+
+	out_size = uzstdn(src, srcn, dst, dstn, workspace);
+	if (!out_size)
+		printk(BIOS_WARNING, "zstd: Decoding error\n");
+
+	return out_size;
+}
@@ -21,6 +21,15 @@
 #include <cbmem.h>
 #include <acpi/acpi.h>
 #include <drivers/efi/capsules.h>
+#include <smp/parallel_for.h>
+
+/* Large enough to amortize handing out the chunks, small enough to balance the CPUs. */
+#define CLEAR_CHUNK_SIZE	(16 * MiB)
+
+static void clear_chunk(void *base, size_t start, size_t end)
+{
+	memset((uint8_t *)base + start, 0, end - start);
+}
 
 /* Helper to find free space for memset_pae. */
 static uintptr_t get_free_memory_range(struct memranges *mem,
@@ -109,9 +118,16 @@ static void clear_memory(void *unused)
 		/* Does regular memset work? */
 		if (sizeof(resource_t) == sizeof(void *) ||
 		    !(range_entry_end(r) >> (sizeof(void *) * 8))) {
-			/* fastpath */
-			memset((void *)(uintptr_t)range_entry_base(r), 0,
-			       range_entry_size(r));
+			void *base = (void *)(uintptr_t)range_entry_base(r);
+
+			/* fastpath, split across all CPUs */
+			if (parallel_for(clear_chunk, base, range_entry_size(r),
+					 CLEAR_CHUNK_SIZE) != CB_SUCCESS) {
+				/* An AP may have left its chunk unfinished */
+				printk(BIOS_WARNING, "%s: Clearing again on the BSP\n",
+				       __func__);
+				memset(base, 0, range_entry_size(r));
+			}
 		}
 		/* Use PAE if available */
 		else if (ENV_X86) {
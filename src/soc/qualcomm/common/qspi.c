@@ -151,6 +151,15 @@ static void configure_gpios(void)
 	gpio_configure(QSPI_DATA_1, GPIO_FUNC_QSPI_DATA_1,
 		GPIO_NO_PULL, GPIO_8MA, GPIO_OUTPUT);
 
+	/* IO2 and IO3 are only routed to the flash on boards using quad reads. */
+	if (CONFIG(SPI_FLASH_QUAD_IO)) {
+		gpio_configure(QSPI_DATA_2, GPIO_FUNC_QSPI_DATA_2,
+			GPIO_NO_PULL, GPIO_8MA, GPIO_OUTPUT);
+
+		gpio_configure(QSPI_DATA_3, GPIO_FUNC_QSPI_DATA_3,
+			GPIO_NO_PULL, GPIO_8MA, GPIO_OUTPUT);
+	}
+
 	gpio_configure(QSPI_CLK, GPIO_FUNC_QSPI_CLK,
 		GPIO_NO_PULL, GPIO_8MA, GPIO_OUTPUT);
 }
@@ -294,3 +303,9 @@ int qspi_xfer_dual(const struct spi_slave *slave, const void *dout,
 {
 	return xfer(SDR_2BIT, dout, out_bytes, din, in_bytes);
 }
+
+int qspi_xfer_quad(const struct spi_slave *slave, const void *dout,
+		     size_t out_bytes, void *din, size_t in_bytes)
+{
+	return xfer(SDR_4BIT, dout, out_bytes, din, in_bytes);
+}
@@ -18,10 +18,14 @@
 #define QSPI_CS				GPIO(15)
 #define QSPI_DATA_0			GPIO(12)
 #define QSPI_DATA_1			GPIO(13)
+#define QSPI_DATA_2			GPIO(16)
+#define QSPI_DATA_3			GPIO(17)
 #define QSPI_CLK			GPIO(14)
 
 #define GPIO_FUNC_QSPI_DATA_0		GPIO12_FUNC_QSPI_DATA_0
 #define GPIO_FUNC_QSPI_DATA_1		GPIO13_FUNC_QSPI_DATA_1
+#define GPIO_FUNC_QSPI_DATA_2		GPIO16_FUNC_QSPI_DATA_2
+#define GPIO_FUNC_QSPI_DATA_3		GPIO17_FUNC_QSPI_DATA_3
 #define GPIO_FUNC_QSPI_CLK		GPIO14_FUNC_QSPI_CLK
 
 /* SDHC TLMM Registers */
@@ -5,3 +5,13 @@ tests-y += acpigen-test
 acpigen-test-srcs += tests/acpi/acpigen-test.c
 acpigen-test-srcs += src/acpi/acpigen.c
 acpigen-test-srcs += tests/stubs/console.c
+
+tests-y += acpi_cache-test
+
+acpi_cache-test-srcs += tests/acpi/acpi_cache-test.c
+acpi_cache-test-srcs += src/acpi/acpi_cache.c
+acpi_cache-test-srcs += src/commonlib/region.c
+acpi_cache-test-srcs += src/lib/region_file.c
+acpi_cache-test-srcs += src/lib/xxhash.c
+acpi_cache-test-srcs += tests/stubs/console.c
+acpi_cache-test-config += CONFIG_ACPI_SOC_NVS=1
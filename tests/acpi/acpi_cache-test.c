@@ -0,0 +1,233 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <acpi/acpi.h>
+#include <cbmem.h>
+#include <commonlib/region.h>
+#include <device/device.h>
+#include <device/pci_def.h>
+#include <fmap.h>
+#include <string.h>
+#include <tests/test.h>
+#include <types.h>
+#include <version.h>
+
+#define FLASH_SIZE	(64 * KiB)
+#define TABLES_SIZE	(4 * KiB)
+#define GNVS_SIZE	256
+
+static uint64_t build_hash = 1;
+
+static uint8_t flash[FLASH_SIZE];
+static struct mem_region_device flash_mdev = MEM_REGION_DEV_RW_INIT(flash, FLASH_SIZE);
+
+static uint8_t tables[TABLES_SIZE];
+static uint8_t cbmem[64 * KiB];
+static size_t cbmem_used;
+
+/* The first byte of GNVS is filled in by SoC code, the others by generators. */
+static uint8_t gnvs[GNVS_SIZE];
+static uint8_t soc_gnvs_value;
+
+static struct resource bar = { .index = 0x10, .base = 0xfe000000, .size = 0x1000 };
+static struct device dev1 = {
+	.path = { .type = DEVICE_PATH_PCI, .pci = { .devfn = PCI_DEVFN(2, 0) } },
+	.enabled = 1,
+	.vendor = 0x8086,
+	.device = 0x1234,
+	.resource_list = &bar,
+};
+static struct device dev0 = {
+	.path = { .type = DEVICE_PATH_ROOT },
+	.enabled = 1,
+	.next = &dev1,
+};
+DEVTREE_CONST struct device *DEVTREE_CONST all_devices = &dev0;
+
+int fmap_locate_area_as_rdev_rw(const char *name, struct region_device *area)
+{
+	assert_string_equal("RW_ACPI_CACHE", name);
+	return rdev_chain_full(area, &flash_mdev.rdev);
+}
+
+void cbmem_get_region(void **baseptr, size_t *size)
+{
+	*baseptr = &cbmem[sizeof(cbmem) - cbmem_used];
+	*size = cbmem_used;
+}
+
+uint64_t coreboot_build_hash(void)
+{
+	return build_hash;
+}
+
+const struct cbmem_entry *cbmem_entry_find(u32 id)
+{
+	assert_int_equal(CBMEM_ID_ACPI_GNVS, id);
+	return (const struct cbmem_entry *)gnvs;
+}
+
+void *cbmem_entry_start(const struct cbmem_entry *entry)
+{
+	return gnvs;
+}
+
+u64 cbmem_entry_size(const struct cbmem_entry *entry)
+{
+	return GNVS_SIZE;
+}
+
+void acpi_update_gnvs(void)
+{
+	gnvs[0] = soc_gnvs_value;
+}
+
+static void generate_tables(uint8_t seed)
+{
+	for (size_t i = 0; i < TABLES_SIZE; i++)
+		tables[i] = seed + i * 7;
+
+	acpi_update_gnvs();
+	for (size_t i = 1; i < GNVS_SIZE; i++)
+		gnvs[i] = seed + i * 3;
+}
+
+static int setup_acpi_cache(void **state)
+{
+	memset(flash, 0xff, sizeof(flash));
+	cbmem_used = 4 * KiB;
+	build_hash = 1;
+	soc_gnvs_value = 0x5a;
+	dev1.enabled = 1;
+	bar.base = 0xfe000000;
+	return 0;
+}
+
+/* A boot that misses the cache generates the tables, which the cache then saves. */
+static void boot_generating(uint8_t seed)
+{
+	uintptr_t rsdp;
+
+	memset(tables, 0, sizeof(tables));
+	memset(gnvs, 0, sizeof(gnvs));
+	assert_int_equal(0, acpi_cache_restore((uintptr_t)tables, &rsdp));
+	generate_tables(seed);
+	acpi_cache_save((uintptr_t)tables, (uintptr_t)tables + TABLES_SIZE,
+			(uintptr_t)tables + 0x10);
+}
+
+static void boot_restoring(uint8_t seed)
+{
+	uintptr_t rsdp;
+	uint8_t expected[TABLES_SIZE], expected_gnvs[GNVS_SIZE];
+
+	generate_tables(seed);
+	memcpy(expected, tables, sizeof(expected));
+	memcpy(expected_gnvs, gnvs, sizeof(expected_gnvs));
+	memset(tables, 0, sizeof(tables));
+	memset(gnvs, 0, sizeof(gnvs));
+
+	assert_int_equal((uintptr_t)tables + TABLES_SIZE,
+			 acpi_cache_restore((uintptr_t)tables, &rsdp));
+	assert_int_equal((uintptr_t)tables + 0x10, rsdp);
+	assert_memory_equal(expected, tables, TABLES_SIZE);
+	assert_memory_equal(expected_gnvs, gnvs, GNVS_SIZE);
+}
+
+static void test_acpi_cache_restore(void **state)
+{
+	boot_generating(1);
+	boot_restoring(1);
+	boot_restoring(1);
+}
+
+static void test_acpi_cache_config_change(void **state)
+{
+	boot_generating(1);
+	boot_restoring(1);
+
+	/* A disabled device or a moved resource means generating the tables again. */
+	dev1.enabled = 0;
+	boot_generating(2);
+	boot_restoring(2);
+
+	bar.base = 0xfd000000;
+	boot_generating(3);
+	boot_restoring(3);
+
+	/* Going back to an old configuration is a miss too, only the last one is kept. */
+	dev1.enabled = 1;
+	bar.base = 0xfe000000;
+	boot_generating(1);
+	boot_restoring(1);
+}
+
+static void test_acpi_cache_gnvs(void **state)
+{
+	boot_generating(1);
+
+	/* Values of generators come from the cache, SoC code fills in its own again. */
+	soc_gnvs_value = 0xa5;
+	boot_restoring(1);
+	assert_int_equal(0xa5, gnvs[0]);
+}
+
+static void test_acpi_cache_firmware_update(void **state)
+{
+	boot_generating(1);
+	boot_restoring(1);
+
+	build_hash++;
+	boot_generating(1);
+	boot_restoring(1);
+}
+
+static void test_acpi_cache_corrupted(void **state)
+{
+	uintptr_t rsdp;
+
+	boot_generating(1);
+
+	/* Flip a bit in the cached copy of the tables. */
+	size_t offset;
+	for (offset = 0; offset < FLASH_SIZE - TABLES_SIZE; offset++) {
+		if (!memcmp(&flash[offset], tables, TABLES_SIZE))
+			break;
+	}
+	assert_true(offset < FLASH_SIZE - TABLES_SIZE);
+	flash[offset + TABLES_SIZE / 2] ^= 1;
+	assert_int_equal(0, acpi_cache_restore((uintptr_t)tables, &rsdp));
+}
+
+static void test_acpi_cache_cbmem_growth(void **state)
+{
+	uintptr_t rsdp;
+
+	/* Tables that allocate CBMEM while being generated are not cached. */
+	assert_int_equal(0, acpi_cache_restore((uintptr_t)tables, &rsdp));
+	generate_tables(1);
+	cbmem_used += 64;
+	acpi_cache_save((uintptr_t)tables, (uintptr_t)tables + TABLES_SIZE,
+			(uintptr_t)tables);
+
+	cbmem_used -= 64;
+	assert_int_equal(0, acpi_cache_restore((uintptr_t)tables, &rsdp));
+
+	/* Different CBMEM layouts place other tables elsewhere, so they miss as well. */
+	boot_generating(1);
+	cbmem_used += 64;
+	assert_int_equal(0, acpi_cache_restore((uintptr_t)tables, &rsdp));
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup(test_acpi_cache_restore, setup_acpi_cache),
+		cmocka_unit_test_setup(test_acpi_cache_config_change, setup_acpi_cache),
+		cmocka_unit_test_setup(test_acpi_cache_gnvs, setup_acpi_cache),
+		cmocka_unit_test_setup(test_acpi_cache_firmware_update, setup_acpi_cache),
+		cmocka_unit_test_setup(test_acpi_cache_corrupted, setup_acpi_cache),
+		cmocka_unit_test_setup(test_acpi_cache_cbmem_growth, setup_acpi_cache),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
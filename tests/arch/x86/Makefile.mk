@@ -0,0 +1,12 @@
+# SPDX-License-Identifier: GPL-2.0-only
+
+# The x86 string functions are inline assembly, so they can only be tested on an x86_64 host.
+ifneq ($(filter x86_64-%,$(shell $(HOSTCC) -dumpmachine)),)
+tests-y += string_ops-test
+endif
+
+string_ops-test-srcs += tests/arch/x86/string_ops-test.c
+string_ops-test-cflags += -D__ARCH_x86_64__
+string_ops-test-config += CONFIG_X86_STRING_OPS_DISPATCH=1 \
+			CONFIG_X86_STRING_OPS_NT_THRESHOLD=0x1000 \
+			CONFIG_ASAN_IN_RAMSTAGE=0
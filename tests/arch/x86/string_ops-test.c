@@ -0,0 +1,229 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+/* Include the x86 memcpy() and memset() and rename them to compare against libc. */
+#define memcpy cb_memcpy
+#define memset cb_memset
+#include "../arch/x86/memcpy.c"
+#include "../arch/x86/memset.c"
+#undef memcpy
+#undef memset
+
+#include <arch/string_ops.h>
+#include <commonlib/helpers.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <tests/test.h>
+#include <time.h>
+#include <types.h>
+
+/* Prototypes from string.h were renamed above, they have to be declared again. */
+void *memcpy(void *dest, const void *src, size_t n);
+void *memset(void *s, int c, size_t n);
+
+#define TEST_BUFFER_SZ		(CONFIG_X86_STRING_OPS_NT_THRESHOLD * 4)
+#define TEST_GUARD_SZ		64
+#define BENCH_LARGE_SZ		(16 * MiB)
+#define BENCH_SMALL_SZ		(4 * KiB)
+
+static const struct {
+	const char *name;
+	unsigned int features;
+} feature_sets[] = {
+	{ "generic", 0 },
+	{ "ERMS", X86_STRING_OPS_ERMS },
+	{ "ERMS+FSRM", X86_STRING_OPS_ERMS | X86_STRING_OPS_FSRM },
+	{ "NT", X86_STRING_OPS_NT },
+	{ "ERMS+FSRM+NT", X86_STRING_OPS_ERMS | X86_STRING_OPS_FSRM | X86_STRING_OPS_NT },
+};
+
+static const size_t test_sizes[] = {
+	0, 1, 3, 7, 8, 31, 33, X86_STRING_OPS_ERMS_THRESHOLD - 1, X86_STRING_OPS_ERMS_THRESHOLD,
+	1021, CONFIG_X86_STRING_OPS_NT_THRESHOLD - 1, CONFIG_X86_STRING_OPS_NT_THRESHOLD,
+	CONFIG_X86_STRING_OPS_NT_THRESHOLD + 29, TEST_BUFFER_SZ - 8,
+};
+
+static unsigned int test_features;
+
+/* Replaces the CPUID based detection so that every code path can be exercised. */
+unsigned int x86_string_ops_features(void)
+{
+	return test_features;
+}
+
+struct string_ops_test_state {
+	u8 *src;
+	u8 *dst;
+	u8 *ref;
+};
+
+static int setup_test(void **state)
+{
+	struct string_ops_test_state *s = malloc(sizeof(*s));
+	const size_t sz = TEST_BUFFER_SZ + 2 * TEST_GUARD_SZ;
+
+	if (!s)
+		return -1;
+
+	s->src = malloc(sz);
+	s->dst = malloc(sz);
+	s->ref = malloc(sz);
+	if (!s->src || !s->dst || !s->ref) {
+		free(s->src);
+		free(s->dst);
+		free(s->ref);
+		free(s);
+		return -1;
+	}
+
+	for (size_t i = 0; i < sz; i++)
+		s->src[i] = (i * 7 + i / 251) & 0xff;
+
+	*state = s;
+	return 0;
+}
+
+static int teardown_test(void **state)
+{
+	struct string_ops_test_state *s = *state;
+
+	free(s->src);
+	free(s->dst);
+	free(s->ref);
+	free(s);
+
+	return 0;
+}
+
+static void test_memcpy_all_paths(void **state)
+{
+	struct string_ops_test_state *s = *state;
+	const size_t sz = TEST_BUFFER_SZ + 2 * TEST_GUARD_SZ;
+
+	for (size_t f = 0; f < ARRAY_SIZE(feature_sets); f++) {
+		test_features = feature_sets[f].features;
+		for (size_t i = 0; i < ARRAY_SIZE(test_sizes); i++) {
+			for (size_t align = 0; align < 8; align++) {
+				const size_t n = test_sizes[i];
+				u8 *dst = s->dst + TEST_GUARD_SZ + align;
+				const u8 *src = s->src + TEST_GUARD_SZ + 7 - align;
+
+				memset(s->dst, 0xcc, sz);
+				memset(s->ref, 0xcc, sz);
+				memcpy(s->ref + TEST_GUARD_SZ + align, src, n);
+
+				assert_ptr_equal(dst, cb_memcpy(dst, src, n));
+				assert_memory_equal(s->ref, s->dst, sz);
+			}
+		}
+	}
+}
+
+static void test_memset_all_paths(void **state)
+{
+	struct string_ops_test_state *s = *state;
+	const size_t sz = TEST_BUFFER_SZ + 2 * TEST_GUARD_SZ;
+
+	for (size_t f = 0; f < ARRAY_SIZE(feature_sets); f++) {
+		test_features = feature_sets[f].features;
+		for (size_t i = 0; i < ARRAY_SIZE(test_sizes); i++) {
+			for (size_t align = 0; align < 8; align++) {
+				const size_t n = test_sizes[i];
+				u8 *dst = s->dst + TEST_GUARD_SZ + align;
+				const int c = 0x100 + 0x5a + align; /* Only the low byte counts. */
+
+				memset(s->dst, 0xcc, sz);
+				memset(s->ref, 0xcc, sz);
+				memset(s->ref + TEST_GUARD_SZ + align, c, n);
+
+				assert_ptr_equal(dst, cb_memset(dst, c, n));
+				assert_memory_equal(s->ref, s->dst, sz);
+			}
+		}
+	}
+}
+
+/* A threshold below the word size leaves less than the alignment head to copy. */
+static void test_nt_shorter_than_head(void **state)
+{
+	struct string_ops_test_state *s = *state;
+	const size_t sz = TEST_BUFFER_SZ + 2 * TEST_GUARD_SZ;
+
+	for (size_t n = 0; n < sizeof(unsigned long); n++) {
+		for (size_t align = 0; align < 8; align++) {
+			u8 *dst = s->dst + TEST_GUARD_SZ + align;
+			const u8 *src = s->src + TEST_GUARD_SZ + 7 - align;
+
+			memset(s->dst, 0xcc, sz);
+			memset(s->ref, 0xcc, sz);
+			memcpy(s->ref + TEST_GUARD_SZ + align, src, n);
+			assert_ptr_equal(dst, memcpy_nt(dst, src, n));
+			assert_memory_equal(s->ref, s->dst, sz);
+
+			memset(s->ref + TEST_GUARD_SZ + align, 0x5a, n);
+			memset_nt(dst, 0x5a, n);
+			assert_memory_equal(s->ref, s->dst, sz);
+		}
+	}
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench(const char *op, const char *name, size_t sz, int rounds, u8 *dst, u8 *src)
+{
+	uint64_t start = now_ns();
+
+	for (int i = 0; i < rounds; i++) {
+		if (src)
+			cb_memcpy(dst, src, sz);
+		else
+			cb_memset(dst, i, sz);
+	}
+
+	const uint64_t ns = MAX(now_ns() - start, 1);
+	print_message("%-6s %-13s %8zu bytes: %6llu MiB/s\n", op, name, sz,
+		      (unsigned long long)((uint64_t)sz * rounds * 1000000000ULL / MiB / ns));
+}
+
+/* Not a pass/fail criterion, just reports the throughput of every code path on the host. */
+static void test_string_ops_benchmark(void **state)
+{
+	u8 *src = malloc(BENCH_LARGE_SZ);
+	u8 *dst = malloc(BENCH_LARGE_SZ);
+
+	assert_non_null(src);
+	assert_non_null(dst);
+	memset(src, 0xa5, BENCH_LARGE_SZ);
+	memset(dst, 0, BENCH_LARGE_SZ);
+
+	for (size_t f = 0; f < ARRAY_SIZE(feature_sets); f++) {
+		test_features = feature_sets[f].features;
+		bench("memcpy", feature_sets[f].name, BENCH_SMALL_SZ, 100000, dst, src);
+		bench("memcpy", feature_sets[f].name, BENCH_LARGE_SZ, 20, dst, src);
+		bench("memset", feature_sets[f].name, BENCH_SMALL_SZ, 100000, dst, NULL);
+		bench("memset", feature_sets[f].name, BENCH_LARGE_SZ, 20, dst, NULL);
+	}
+
+	free(src);
+	free(dst);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(test_memcpy_all_paths, setup_test,
+						teardown_test),
+		cmocka_unit_test_setup_teardown(test_memset_all_paths, setup_test,
+						teardown_test),
+		cmocka_unit_test_setup_teardown(test_nt_shorter_than_head, setup_test,
+						teardown_test),
+		cmocka_unit_test(test_string_ops_benchmark),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
@@ -2,11 +2,17 @@
 
 subdirs-y += bsd
 
+tests-y += mem_pool-test
 tests-y += rational-test
 tests-y += region-test
 
+mem_pool-test-srcs += tests/commonlib/mem_pool-test.c
+mem_pool-test-srcs += src/commonlib/mem_pool.c
+
 rational-test-srcs += tests/commonlib/rational-test.c
 rational-test-srcs += src/commonlib/rational.c
 
 region-test-srcs += tests/commonlib/region-test.c
 region-test-srcs += src/commonlib/region.c
+region-test-srcs += src/commonlib/bsd/cbfs_private.c
+region-test-srcs += tests/stubs/console.c
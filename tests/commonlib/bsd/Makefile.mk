@@ -3,6 +3,10 @@
 tests-y += helpers-test
 tests-y += gcd-test
 tests-y += ipchksum-test
+tests-y += lz4_wrapper-test
+tests-y += zstd-test
+tests-y += cbfs_mcache-test
+tests-y += fnv-test
 
 helpers-test-srcs += tests/commonlib/bsd/helpers-test.c
 
@@ -11,3 +15,18 @@ gcd-test-srcs += src/commonlib/bsd/gcd.c
 
 ipchksum-test-srcs += tests/commonlib/bsd/ipchksum-test.c
 ipchksum-test-srcs += src/commonlib/bsd/ipchksum.c
+
+lz4_wrapper-test-srcs += tests/commonlib/bsd/lz4_wrapper-test.c
+lz4_wrapper-test-srcs += src/commonlib/bsd/lz4_wrapper.c
+
+zstd-test-srcs += tests/commonlib/bsd/zstd-test.c
+zstd-test-srcs += src/commonlib/bsd/zstd_decompress.c
+
+cbfs_mcache-test-srcs += tests/commonlib/bsd/cbfs_mcache-test.c
+cbfs_mcache-test-srcs += tests/stubs/console.c
+cbfs_mcache-test-srcs += src/commonlib/bsd/cbfs_mcache.c
+cbfs_mcache-test-srcs += src/commonlib/bsd/cbfs_private.c
+cbfs_mcache-test-srcs += src/commonlib/region.c
+cbfs_mcache-test-config += CONFIG_CBFS_VERIFICATION=0
+
+fnv-test-srcs += tests/commonlib/bsd/fnv-test.c
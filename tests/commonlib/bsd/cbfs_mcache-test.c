@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <commonlib/bsd/cbfs_private.h>
+#include <commonlib/region.h>
+#include <endian.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tests/test.h>
+#include <time.h>
+
+#define TEST_NUM_FILES		300
+#define TEST_NAME_SIZE		32
+#define TEST_FILE_SIZE		ALIGN_UP(sizeof(struct cbfs_file) + TEST_NAME_SIZE, CBFS_ALIGNMENT)
+#define TEST_CBFS_SIZE		(TEST_NUM_FILES * TEST_FILE_SIZE + CBFS_ALIGNMENT)
+#define TEST_MCACHE_SIZE	(64 * KiB)
+#define TEST_BENCH_ROUNDS	50
+
+static u8 cbfs_buf[TEST_CBFS_SIZE];
+static u8 mcache[TEST_MCACHE_SIZE] __aligned(CBFS_MCACHE_ALIGNMENT);
+static struct mem_region_device cbfs_mdev = MEM_REGION_DEV_RO_INIT(cbfs_buf, TEST_CBFS_SIZE);
+
+static void file_name(char *name, int i)
+{
+	snprintf(name, TEST_NAME_SIZE, "%s/file-%03d", i % 2 ? "fallback" : "normal", i);
+}
+
+/* Synthetic CBFS with TEST_NUM_FILES empty files, one per CBFS_ALIGNMENT slot. */
+static int setup_cbfs(void **state)
+{
+	memset(cbfs_buf, 0xff, sizeof(cbfs_buf));
+
+	for (int i = 0; i < TEST_NUM_FILES; i++) {
+		struct cbfs_file *file = (void *)&cbfs_buf[i * TEST_FILE_SIZE];
+
+		memcpy(file->magic, CBFS_FILE_MAGIC, sizeof(file->magic));
+		file->len = 0;
+		file->type = htobe32(CBFS_TYPE_RAW);
+		file->attributes_offset = 0;
+		file->offset = htobe32(sizeof(*file) + TEST_NAME_SIZE);
+		memset(file->filename, 0, TEST_NAME_SIZE);
+		file_name(file->filename, i);
+	}
+
+	return 0;
+}
+
+static enum cb_err lookup(const void *cache, size_t size, int i, size_t *data_offset)
+{
+	char name[TEST_NAME_SIZE];
+	union cbfs_mdata mdata;
+
+	file_name(name, i);
+	return cbfs_mcache_lookup(cache, size, name, &mdata, data_offset);
+}
+
+static void check_all_files(const void *cache, size_t size)
+{
+	size_t data_offset;
+
+	for (int i = 0; i < TEST_NUM_FILES; i++) {
+		assert_int_equal(CB_SUCCESS, lookup(cache, size, i, &data_offset));
+		assert_int_equal(i * TEST_FILE_SIZE + sizeof(struct cbfs_file) + TEST_NAME_SIZE,
+				 data_offset);
+	}
+
+	assert_int_equal(CB_CBFS_NOT_FOUND, lookup(cache, size, TEST_NUM_FILES, &data_offset));
+	assert_int_equal(CB_CBFS_NOT_FOUND,
+			 cbfs_mcache_lookup(cache, size, "normal/file",
+					    &(union cbfs_mdata){}, &data_offset));
+}
+
+static void test_mcache_indexed_lookup(void **state)
+{
+	assert_int_equal(CB_SUCCESS, cbfs_mcache_build(&cbfs_mdev.rdev, mcache,
+						       sizeof(mcache), NULL));
+	check_all_files(mcache, sizeof(mcache));
+}
+
+static void test_mcache_real_size_copy(void **state)
+{
+	void *copy;
+	size_t real_size;
+
+	assert_int_equal(CB_SUCCESS, cbfs_mcache_build(&cbfs_mdev.rdev, mcache,
+						       sizeof(mcache), NULL));
+	real_size = cbfs_mcache_real_size(mcache, sizeof(mcache));
+	assert_true(real_size < sizeof(mcache));
+
+	/* Like the CBMEM copy made after romstage, the truncated copy keeps its index. */
+	copy = test_malloc(real_size);
+	memcpy(copy, mcache, real_size);
+	check_all_files(copy, real_size);
+	assert_int_equal(real_size, cbfs_mcache_real_size(copy, real_size));
+	test_free(copy);
+}
+
+static void test_mcache_linear_fallback(void **state)
+{
+	const size_t size = sizeof(mcache);
+
+	assert_int_equal(CB_SUCCESS, cbfs_mcache_build(&cbfs_mdev.rdev, mcache, size, NULL));
+
+	/* Dropping the trailer must fall back to the linear search, as for old mcaches. */
+	memset(mcache + size - 8, 0, 8);
+	check_all_files(mcache, size);
+
+	/* Rebuilding must not pick up a stale index left behind in the buffer. */
+	memset(mcache, 0xa5, size);
+	assert_int_equal(CB_SUCCESS, cbfs_mcache_build(&cbfs_mdev.rdev, mcache, size, NULL));
+	check_all_files(mcache, size);
+}
+
+static void test_mcache_no_room_for_index(void **state)
+{
+	const size_t entries_size = TEST_NUM_FILES *
+		ALIGN_UP(sizeof(struct cbfs_file) + TEST_NAME_SIZE, CBFS_MCACHE_ALIGNMENT);
+	/* Just enough space for the entries, the terminator and the trailer, but no index. */
+	const size_t size = entries_size + sizeof(uint32_t) + 2 * sizeof(uint32_t);
+
+	memset(mcache, 0, sizeof(mcache));
+	assert_int_equal(CB_SUCCESS, cbfs_mcache_build(&cbfs_mdev.rdev, mcache, size, NULL));
+	assert_int_equal(entries_size + sizeof(uint32_t), cbfs_mcache_real_size(mcache, size));
+	check_all_files(mcache, size);
+}
+
+static void test_mcache_full(void **state)
+{
+	const size_t size = 4 * KiB;
+	size_t data_offset;
+
+	assert_int_equal(CB_CBFS_CACHE_FULL, cbfs_mcache_build(&cbfs_mdev.rdev, mcache, size,
+							       NULL));
+	assert_int_equal(CB_SUCCESS, lookup(mcache, size, 0, &data_offset));
+	assert_int_equal(CB_CBFS_CACHE_FULL,
+			 lookup(mcache, size, TEST_NUM_FILES - 1, &data_offset));
+}
+
+static uint64_t bench_lookups(const void *cache, size_t size)
+{
+	struct timespec start, end;
+	size_t data_offset;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < TEST_BENCH_ROUNDS; round++)
+		for (int i = 0; i < TEST_NUM_FILES; i++)
+			lookup(cache, size, i, &data_offset);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+}
+
+/* Not a pass/fail criterion, just reports the lookup cost with and without the index. */
+static void test_mcache_lookup_benchmark(void **state)
+{
+	const size_t size = sizeof(mcache);
+	const uint64_t lookups = TEST_BENCH_ROUNDS * TEST_NUM_FILES;
+	uint64_t indexed_ns, linear_ns;
+
+	assert_int_equal(CB_SUCCESS, cbfs_mcache_build(&cbfs_mdev.rdev, mcache, size, NULL));
+	indexed_ns = bench_lookups(mcache, size);
+
+	memset(mcache + size - 8, 0, 8);
+	linear_ns = bench_lookups(mcache, size);
+
+	print_message("%d files: %llu ns/lookup indexed, %llu ns/lookup linear\n",
+		      TEST_NUM_FILES, (unsigned long long)(indexed_ns / lookups),
+		      (unsigned long long)(linear_ns / lookups));
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_mcache_indexed_lookup),
+		cmocka_unit_test(test_mcache_real_size_copy),
+		cmocka_unit_test(test_mcache_linear_fallback),
+		cmocka_unit_test(test_mcache_no_room_for_index),
+		cmocka_unit_test(test_mcache_full),
+		cmocka_unit_test(test_mcache_lookup_benchmark),
+	};
+
+	return cb_run_group_tests(tests, setup_cbfs, NULL);
+}
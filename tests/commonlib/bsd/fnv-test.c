@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <commonlib/bsd/fnv.h>
+#include <string.h>
+#include <tests/test.h>
+
+static void test_fnv1a_32(void **state)
+{
+	/* Test vectors from the reference implementation. */
+	assert_int_equal(0x811c9dc5, fnv1a_32("", 0));
+	assert_int_equal(0xe40c292c, fnv1a_32("a", 1));
+	assert_int_equal(0xbf9cf968, fnv1a_32("foobar", 6));
+}
+
+static void test_fnv1a_32_update(void **state)
+{
+	const char data[] = "The quick brown fox jumps over the lazy dog";
+	const size_t size = strlen(data);
+	const uint32_t hash = fnv1a_32(data, size);
+
+	/* Hashing in chunks gives the same result as hashing in one go. */
+	for (size_t split = 0; split <= size; split++)
+		assert_int_equal(hash, fnv1a_32_update(fnv1a_32(data, split), data + split,
+						       size - split));
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_fnv1a_32),
+		cmocka_unit_test(test_fnv1a_32_update),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
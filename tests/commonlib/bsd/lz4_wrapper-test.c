@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <commonlib/bsd/compression.h>
+#include <commonlib/bsd/helpers.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tests/test.h>
+
+struct lz4_test_state {
+	uint8_t *raw;
+	size_t raw_sz;
+	uint8_t *comp;
+	size_t comp_sz;
+};
+
+/* Mock of a slow, non-memory-mapped boot device. */
+struct slow_media {
+	const uint8_t *data;
+	size_t size;
+	size_t next_offset;
+	size_t reads;
+	size_t fail_at;
+};
+
+static size_t slow_media_read(void *arg, size_t offset, void *buf, size_t size)
+{
+	struct slow_media *media = arg;
+
+	/* Decompressors must consume input strictly sequentially. */
+	assert_int_equal(offset, media->next_offset);
+	assert_true(offset + size <= media->size);
+
+	if (media->fail_at && offset + size > media->fail_at)
+		return 0;
+
+	memcpy(buf, media->data + offset, size);
+	media->next_offset = offset + size;
+	media->reads++;
+
+	return size;
+}
+
+static uint8_t *read_file(const char *fname, size_t *size)
+{
+	FILE *f = fopen(fname, "rb");
+	uint8_t *buf;
+	long sz;
+
+	if (!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	sz = ftell(f);
+	rewind(f);
+
+	buf = test_malloc(sz);
+	if (fread(buf, 1, sz, f) != sz) {
+		test_free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+
+	*size = sz;
+	return buf;
+}
+
+/* Set data file with prestate */
+static int setup_lz4_file(void **state)
+{
+	const char *fname_base = *state;
+	char path[256];
+	struct lz4_test_state *s = test_malloc(sizeof(*s));
+
+	/* Uncompressed data is shared with lzma-test. */
+	snprintf(path, sizeof(path), __TEST_DATA_DIR__ "/lib/lzma-test/%s.bin", fname_base);
+	s->raw = read_file(path, &s->raw_sz);
+	snprintf(path, sizeof(path), __TEST_DATA_DIR__ "/commonlib/bsd/lz4_wrapper-test/%s.lz4.bin",
+		 fname_base);
+	s->comp = read_file(path, &s->comp_sz);
+
+	if (!s->raw || !s->comp) {
+		print_error("Unable to read test data for %s\n", fname_base);
+		return 1;
+	}
+
+	*state = s;
+	return 0;
+}
+
+static int teardown_lz4_file(void **state)
+{
+	struct lz4_test_state *s = *state;
+
+	test_free(s->raw);
+	test_free(s->comp);
+	test_free(s);
+
+	return 0;
+}
+
+static void test_ulz4fn_correct_file(void **state)
+{
+	struct lz4_test_state *s = *state;
+	uint8_t *out = test_malloc(s->raw_sz);
+
+	assert_int_equal(s->raw_sz, ulz4fn(s->comp, s->comp_sz, out, s->raw_sz));
+	assert_memory_equal(s->raw, out, s->raw_sz);
+
+	test_free(out);
+}
+
+static void test_ulz4fn_stream_correct_file(void **state)
+{
+	const size_t scratch_sizes[] = { 1, 7, 64, 4 * KiB, 64 * KiB };
+	struct lz4_test_state *s = *state;
+	uint8_t *out = test_malloc(s->raw_sz);
+	uint8_t *scratch = test_malloc(64 * KiB);
+
+	for (int i = 0; i < ARRAY_SIZE(scratch_sizes); i++) {
+		struct slow_media media = { .data = s->comp, .size = s->comp_sz };
+
+		memset(out, 0, s->raw_sz);
+		assert_int_equal(s->raw_sz, ulz4fn_stream(slow_media_read, &media, s->comp_sz,
+							  out, s->raw_sz, scratch,
+							  scratch_sizes[i]));
+		assert_memory_equal(s->raw, out, s->raw_sz);
+		assert_int_equal(media.next_offset, s->comp_sz);
+
+		/* Input that doesn't fit into scratch must have been streamed. */
+		if (scratch_sizes[i] < s->comp_sz)
+			assert_true(media.reads > 1);
+	}
+
+	test_free(scratch);
+	test_free(out);
+}
+
+static void test_ulz4fn_stream_read_error(void **state)
+{
+	struct lz4_test_state *s = *state;
+	struct slow_media media = { .data = s->comp, .size = s->comp_sz,
+				    .fail_at = s->comp_sz / 2 };
+	uint8_t *out = test_malloc(s->raw_sz);
+	uint8_t scratch[256];
+
+	assert_int_equal(0, ulz4fn_stream(slow_media_read, &media, s->comp_sz, out, s->raw_sz,
+					  scratch, sizeof(scratch)));
+
+	test_free(out);
+}
+
+static void test_ulz4fn_stream_output_too_small(void **state)
+{
+	struct lz4_test_state *s = *state;
+	struct slow_media media = { .data = s->comp, .size = s->comp_sz };
+	uint8_t *out = test_malloc(s->raw_sz);
+	uint8_t scratch[256];
+
+	assert_int_equal(0, ulz4fn_stream(slow_media_read, &media, s->comp_sz, out,
+					  s->raw_sz - 1, scratch, sizeof(scratch)));
+
+	test_free(out);
+}
+
+static void test_ulz4fn_stream_bad_header(void **state)
+{
+	uint8_t in[32] = {0};
+	uint8_t out[32];
+	uint8_t scratch[16];
+	struct slow_media media = { .data = in, .size = sizeof(in) };
+
+	assert_int_equal(0, ulz4fn_stream(slow_media_read, &media, sizeof(in), out, sizeof(out),
+					  scratch, sizeof(scratch)));
+}
+
+#define LZ4_FILE_TEST(_func, _file_prefix)                                                     \
+	{                                                                                      \
+		.name = #_func "(" _file_prefix ")", .test_func = _func,                       \
+		.setup_func = setup_lz4_file, .teardown_func = teardown_lz4_file,             \
+		.initial_state = (_file_prefix)                                                \
+	}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		/* "data.N" refers to __TEST_DATA_DIR__/lib/lzma-test/data.N.bin and its
+		   LZ4-compressed form __TEST_DATA_DIR__/commonlib/bsd/lz4_wrapper-test/data.N.lz4.bin,
+		   compressed with the same parameters as cbfstool uses. data.1 uses 64KiB blocks
+		   instead of 4MiB to cover frames with multiple blocks. */
+		LZ4_FILE_TEST(test_ulz4fn_correct_file, "data.1"),
+		LZ4_FILE_TEST(test_ulz4fn_correct_file, "data.2"),
+		LZ4_FILE_TEST(test_ulz4fn_correct_file, "data.3"),
+		LZ4_FILE_TEST(test_ulz4fn_correct_file, "data.4"),
+
+		LZ4_FILE_TEST(test_ulz4fn_stream_correct_file, "data.1"),
+		LZ4_FILE_TEST(test_ulz4fn_stream_correct_file, "data.2"),
+		LZ4_FILE_TEST(test_ulz4fn_stream_correct_file, "data.3"),
+		LZ4_FILE_TEST(test_ulz4fn_stream_correct_file, "data.4"),
+
+		LZ4_FILE_TEST(test_ulz4fn_stream_read_error, "data.1"),
+		LZ4_FILE_TEST(test_ulz4fn_stream_output_too_small, "data.4"),
+		cmocka_unit_test(test_ulz4fn_stream_bad_header),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
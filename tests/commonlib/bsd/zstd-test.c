@@ -0,0 +1,206 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <commonlib/bsd/compression.h>
+#include <commonlib/bsd/helpers.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tests/test.h>
+
+struct zstd_test_state {
+	uint8_t *raw;
+	size_t raw_sz;
+	uint8_t *comp;
+	size_t comp_sz;
+};
+
+static uint64_t workspace[UZSTD_WORKSPACE_SIZE / sizeof(uint64_t)];
+
+static uint8_t *read_file(const char *fname, size_t *size)
+{
+	FILE *f = fopen(fname, "rb");
+	uint8_t *buf;
+	long sz;
+
+	if (!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	sz = ftell(f);
+	rewind(f);
+
+	buf = test_malloc(sz);
+	if (fread(buf, 1, sz, f) != sz) {
+		test_free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+
+	*size = sz;
+	return buf;
+}
+
+static int load_zstd_file(struct zstd_test_state *s, const char *fname_base)
+{
+	char path[256];
+
+	/* Uncompressed data is shared with lzma-test. */
+	snprintf(path, sizeof(path), __TEST_DATA_DIR__ "/lib/lzma-test/%s.bin", fname_base);
+	s->raw = read_file(path, &s->raw_sz);
+	snprintf(path, sizeof(path), __TEST_DATA_DIR__ "/commonlib/bsd/zstd-test/%s.zst.bin",
+		 fname_base);
+	s->comp = read_file(path, &s->comp_sz);
+
+	if (!s->raw || !s->comp) {
+		print_error("Unable to read test data for %s\n", fname_base);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void free_zstd_file(struct zstd_test_state *s)
+{
+	test_free(s->raw);
+	test_free(s->comp);
+}
+
+static int setup_zstd_file(void **state)
+{
+	const char *fname_base = *state;
+	struct zstd_test_state *s = test_malloc(sizeof(*s));
+
+	if (load_zstd_file(s, fname_base))
+		return 1;
+
+	*state = s;
+	return 0;
+}
+
+static int teardown_zstd_file(void **state)
+{
+	struct zstd_test_state *s = *state;
+
+	free_zstd_file(s);
+	test_free(s);
+
+	return 0;
+}
+
+static void test_uzstdn_correct_file(void **state)
+{
+	struct zstd_test_state *s = *state;
+	uint8_t *out = test_malloc(s->raw_sz);
+
+	assert_int_equal(s->raw_sz, uzstdn(s->comp, s->comp_sz, out, s->raw_sz, workspace));
+	assert_memory_equal(s->raw, out, s->raw_sz);
+
+	test_free(out);
+}
+
+static void test_uzstdn_output_too_small(void **state)
+{
+	struct zstd_test_state *s = *state;
+	uint8_t *out = test_malloc(s->raw_sz);
+
+	assert_int_equal(0, uzstdn(s->comp, s->comp_sz, out, s->raw_sz - 1, workspace));
+
+	test_free(out);
+}
+
+static void test_uzstdn_truncated_input(void **state)
+{
+	struct zstd_test_state *s = *state;
+	uint8_t *out = test_malloc(s->raw_sz);
+
+	assert_int_equal(0, uzstdn(s->comp, s->comp_sz / 2, out, s->raw_sz, workspace));
+	assert_int_equal(0, uzstdn(s->comp, s->comp_sz - 1, out, s->raw_sz, workspace));
+
+	test_free(out);
+}
+
+static void test_uzstdn_corrupted_input(void **state)
+{
+	struct zstd_test_state *s = *state;
+	uint8_t *comp = test_malloc(s->comp_sz);
+	uint8_t *out = test_malloc(s->raw_sz);
+
+	/* Corruption must never make the decoder write out of bounds or read past the input,
+	   whatever it does to the result. */
+	for (size_t i = 0; i < s->comp_sz; i += 7) {
+		memcpy(comp, s->comp, s->comp_sz);
+		comp[i] ^= 1 << (i % 8);
+		uzstdn(comp, s->comp_sz, out, s->raw_sz, workspace);
+	}
+
+	test_free(out);
+	test_free(comp);
+}
+
+static void test_uzstdn_multiple_frames(void **state)
+{
+	struct zstd_test_state a, b;
+	const uint8_t skippable[] = { 0x5a, 0x2a, 0x4d, 0x18, 4, 0, 0, 0, 1, 2, 3, 4 };
+
+	assert_int_equal(0, load_zstd_file(&a, "data.2"));
+	assert_int_equal(0, load_zstd_file(&b, "data.3"));
+
+	/* Frames are decoded back to back, skippable frames in between are ignored. */
+	const size_t comp_sz = a.comp_sz + sizeof(skippable) + b.comp_sz;
+	uint8_t *comp = test_malloc(comp_sz);
+	uint8_t *out = test_malloc(a.raw_sz + b.raw_sz);
+	memcpy(comp, a.comp, a.comp_sz);
+	memcpy(comp + a.comp_sz, skippable, sizeof(skippable));
+	memcpy(comp + a.comp_sz + sizeof(skippable), b.comp, b.comp_sz);
+
+	assert_int_equal(a.raw_sz + b.raw_sz, uzstdn(comp, comp_sz, out, a.raw_sz + b.raw_sz,
+						      workspace));
+	assert_memory_equal(a.raw, out, a.raw_sz);
+	assert_memory_equal(b.raw, out + a.raw_sz, b.raw_sz);
+
+	test_free(out);
+	test_free(comp);
+	free_zstd_file(&a);
+	free_zstd_file(&b);
+}
+
+static void test_uzstdn_bad_header(void **state)
+{
+	uint8_t in[32] = {0};
+	uint8_t out[32];
+
+	assert_int_equal(0, uzstdn(in, sizeof(in), out, sizeof(out), workspace));
+	assert_int_equal(0, uzstdn(in, 0, out, sizeof(out), workspace));
+}
+
+#define ZSTD_FILE_TEST(_func, _file_prefix)                                                    \
+	{                                                                                      \
+		.name = #_func "(" _file_prefix ")", .test_func = _func,                       \
+		.setup_func = setup_zstd_file, .teardown_func = teardown_zstd_file,           \
+		.initial_state = (_file_prefix)                                                \
+	}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		/* "data.N" refers to __TEST_DATA_DIR__/lib/lzma-test/data.N.bin and its
+		   zstd-compressed form __TEST_DATA_DIR__/commonlib/bsd/zstd-test/data.N.zst.bin.
+		   They were compressed with the zstd tool at levels 19 (with checksum), fast 5,
+		   3 and ultra 22 respectively to cover the different block encodings. */
+		ZSTD_FILE_TEST(test_uzstdn_correct_file, "data.1"),
+		ZSTD_FILE_TEST(test_uzstdn_correct_file, "data.2"),
+		ZSTD_FILE_TEST(test_uzstdn_correct_file, "data.3"),
+		ZSTD_FILE_TEST(test_uzstdn_correct_file, "data.4"),
+
+		ZSTD_FILE_TEST(test_uzstdn_output_too_small, "data.1"),
+		ZSTD_FILE_TEST(test_uzstdn_output_too_small, "data.4"),
+		ZSTD_FILE_TEST(test_uzstdn_truncated_input, "data.1"),
+		ZSTD_FILE_TEST(test_uzstdn_truncated_input, "data.3"),
+		ZSTD_FILE_TEST(test_uzstdn_corrupted_input, "data.2"),
+		ZSTD_FILE_TEST(test_uzstdn_corrupted_input, "data.4"),
+		cmocka_unit_test(test_uzstdn_multiple_frames),
+		cmocka_unit_test(test_uzstdn_bad_header),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
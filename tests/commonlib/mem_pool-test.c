@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <commonlib/mem_pool.h>
+#include <tests/test.h>
+
+#define POOL_ALIGN 8
+#define POOL_SIZE (32 * POOL_ALIGN)
+
+static u8 pool_buf[POOL_SIZE] __aligned(POOL_ALIGN);
+
+static int setup_pool(void **state)
+{
+	static struct mem_pool mp;
+
+	mem_pool_init(&mp, pool_buf, sizeof(pool_buf), POOL_ALIGN);
+	*state = &mp;
+
+	return 0;
+}
+
+static void test_mem_pool_lifo(void **state)
+{
+	struct mem_pool *mp = *state;
+	void *a, *b;
+
+	a = mem_pool_alloc(mp, 3);
+	assert_ptr_equal(a, pool_buf);
+	b = mem_pool_alloc(mp, POOL_ALIGN);
+	assert_ptr_equal(b, pool_buf + POOL_ALIGN);
+
+	mem_pool_free(mp, b);
+	mem_pool_free(mp, a);
+	assert_int_equal(mem_pool_largest_free(mp), POOL_SIZE);
+	assert_ptr_equal(mem_pool_alloc(mp, POOL_SIZE), pool_buf);
+	assert_null(mem_pool_alloc(mp, 1));
+}
+
+static void test_mem_pool_out_of_order_free(void **state)
+{
+	struct mem_pool *mp = *state;
+	void *a, *b, *c, *d;
+
+	a = mem_pool_alloc(mp, 4 * POOL_ALIGN);
+	b = mem_pool_alloc(mp, 4 * POOL_ALIGN);
+	c = mem_pool_alloc(mp, 4 * POOL_ALIGN);
+	assert_non_null(a);
+	assert_non_null(b);
+	assert_non_null(c);
+
+	/* Freeing the middle allocation leaves a hole that gets reused first. */
+	mem_pool_free(mp, b);
+	d = mem_pool_alloc(mp, 2 * POOL_ALIGN);
+	assert_ptr_equal(d, b);
+
+	/* Too large for the hole, so it goes to the top. */
+	d = mem_pool_alloc(mp, 3 * POOL_ALIGN);
+	assert_ptr_equal(d, (u8 *)c + 4 * POOL_ALIGN);
+
+	mem_pool_free(mp, a);
+	mem_pool_free(mp, c);
+	mem_pool_free(mp, d);
+	mem_pool_free(mp, b);
+	assert_int_equal(mem_pool_largest_free(mp), POOL_SIZE);
+}
+
+static void test_mem_pool_too_many_allocs(void **state)
+{
+	struct mem_pool *mp = *state;
+	void *first, *p = NULL;
+	int i;
+
+	first = mem_pool_alloc(mp, POOL_ALIGN);
+	for (i = 1; i <= MEM_POOL_MAX_ALLOCS; i++) {
+		p = mem_pool_alloc(mp, POOL_ALIGN);
+		assert_ptr_equal(p, pool_buf + i * POOL_ALIGN);
+	}
+
+	/* The first allocation was leaked to make room and can no longer be freed. */
+	mem_pool_free(mp, first);
+	mem_pool_free(mp, p);
+	assert_int_equal(mem_pool_largest_free(mp), POOL_SIZE - MEM_POOL_MAX_ALLOCS * POOL_ALIGN);
+
+	/* Reset brings everything back. */
+	mem_pool_reset(mp);
+	assert_int_equal(mem_pool_largest_free(mp), POOL_SIZE);
+}
+
+static void test_mem_pool_uninitialized(void **state)
+{
+	struct mem_pool mp = MEM_POOL_INIT(NULL, 0, 0);
+
+	assert_null(mem_pool_alloc(&mp, 1));
+	mem_pool_free(&mp, NULL);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup(test_mem_pool_lifo, setup_pool),
+		cmocka_unit_test_setup(test_mem_pool_out_of_order_free, setup_pool),
+		cmocka_unit_test_setup(test_mem_pool_too_many_allocs, setup_pool),
+		cmocka_unit_test(test_mem_pool_uninitialized),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
@@ -1,6 +1,10 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 
+#include <cbfs_glue.h>
+#include <commonlib/bsd/cbfs_private.h>
 #include <commonlib/region.h>
+#include <endian.h>
+#include <stdio.h>
 #include <string.h>
 #include <tests/test.h>
 
@@ -391,6 +395,188 @@ static void test_mem_rdev(void **state)
 	assert_memory_equal(backing, scratch, size);
 }
 
+#define CBFS_IMAGE_SIZE		(128 * KiB)
+#define CBFS_TEST_FILES		48
+#define CACHE_BUFFER_SIZE	(32 * KiB)
+#define CACHE_BLOCK_SIZE	256
+#define CACHE_READAHEAD		3
+
+static u8 cbfs_image[CBFS_IMAGE_SIZE];
+static size_t cache_buffer[CACHE_BUFFER_SIZE / sizeof(size_t)];
+static int backing_transactions;
+
+static void *image_mmap(const struct region_device *rdev, size_t offset, size_t size)
+{
+	return &cbfs_image[offset];
+}
+
+static int image_munmap(const struct region_device *rdev, void *mapping)
+{
+	return 0;
+}
+
+static ssize_t image_readat(const struct region_device *rdev, void *buffer, size_t offset,
+			    size_t size)
+{
+	backing_transactions++;
+	memcpy(buffer, &cbfs_image[offset], size);
+	return size;
+}
+
+static ssize_t image_writeat(const struct region_device *rdev, const void *buffer,
+			     size_t offset, size_t size)
+{
+	backing_transactions++;
+	memcpy(&cbfs_image[offset], buffer, size);
+	return size;
+}
+
+static ssize_t image_eraseat(const struct region_device *rdev, size_t offset, size_t size)
+{
+	backing_transactions++;
+	memset(&cbfs_image[offset], 0xff, size);
+	return size;
+}
+
+static const struct region_device_ops image_rdev_ops = {
+	.mmap = image_mmap,
+	.munmap = image_munmap,
+	.readat = image_readat,
+	.writeat = image_writeat,
+	.eraseat = image_eraseat,
+};
+
+static const struct region_device image_rdev =
+	REGION_DEV_INIT(&image_rdev_ops, 0, CBFS_IMAGE_SIZE);
+
+static size_t add_cbfs_file(size_t offset, uint32_t type, const char *name, size_t attr_size,
+			    size_t data_size)
+{
+	struct cbfs_file *file = (struct cbfs_file *)&cbfs_image[offset];
+	const size_t name_size = ALIGN_UP(strlen(name) + 1, 4);
+	const size_t data_offset = sizeof(*file) + name_size + attr_size;
+
+	memcpy(file->magic, CBFS_FILE_MAGIC, sizeof(file->magic));
+	file->len = htobe32(data_size);
+	file->type = htobe32(type);
+	file->attributes_offset = htobe32(attr_size ? sizeof(*file) + name_size : 0);
+	file->offset = htobe32(data_offset);
+	memset(file->filename, 0, name_size + attr_size);
+	strcpy(file->filename, name);
+	memset(&cbfs_image[offset + data_offset], type, data_size);
+
+	return ALIGN_UP(offset + data_offset + data_size, CBFS_ALIGNMENT);
+}
+
+/* A mix of small files like configs and larger ones like stages, and empty space at the end. */
+static void build_cbfs_image(void)
+{
+	static const size_t data_sizes[] = { 24, 100, 300, 1500, 60, 4000 };
+	size_t offset = 0;
+	char name[16];
+
+	memset(cbfs_image, 0xff, sizeof(cbfs_image));
+	for (int i = 0; i < CBFS_TEST_FILES; i++) {
+		snprintf(name, sizeof(name), "file-%d", i);
+		offset = add_cbfs_file(offset, CBFS_TYPE_RAW, name, i % 3 ? 0 : 40,
+				       data_sizes[i % ARRAY_SIZE(data_sizes)]);
+	}
+	add_cbfs_file(offset, CBFS_TYPE_NULL, "", 0, CBFS_IMAGE_SIZE - offset - 32);
+}
+
+static enum cb_err count_walker(cbfs_dev_t dev, size_t offset, const union cbfs_mdata *mdata,
+				size_t already_read, void *arg)
+{
+	int *files = arg;
+
+	(*files)++;
+	return CB_CBFS_NOT_FOUND;
+}
+
+static int walk_transactions(const struct region_device *rdev)
+{
+	int files = 0;
+
+	backing_transactions = 0;
+	assert_int_equal(CB_CBFS_NOT_FOUND, cbfs_walk(rdev, count_walker, &files, NULL, 0));
+	assert_int_equal(CBFS_TEST_FILES, files);
+
+	return backing_transactions;
+}
+
+static void test_cache_rdev_cbfs_walk(void **state)
+{
+	struct cache_rdev crdev;
+	const struct region_device *cached;
+	int direct, first, again;
+
+	build_cbfs_image();
+	cached = cache_rdev_init(&crdev, &image_rdev, cache_buffer, sizeof(cache_buffer),
+				 CACHE_BLOCK_SIZE, CACHE_READAHEAD);
+	assert_non_null(cached);
+	assert_int_equal(CBFS_IMAGE_SIZE, region_device_sz(cached));
+
+	direct = walk_transactions(&image_rdev);
+	first = walk_transactions(cached);
+	again = walk_transactions(cached);
+	print_message("CBFS walk over %d files: %d transactions uncached, %d cached, "
+		      "%d when walking again\n", CBFS_TEST_FILES, direct, first, again);
+
+	assert_true(first * 2 < direct);
+	assert_int_equal(0, again);
+}
+
+static void test_cache_rdev_coherency(void **state)
+{
+	struct cache_rdev crdev;
+	const struct region_device *cached;
+	u8 buf[CACHE_BUFFER_SIZE];
+	uint32_t x = 1;
+
+	build_cbfs_image();
+	for (size_t i = 0; i < CBFS_IMAGE_SIZE; i++)
+		cbfs_image[i] ^= i * 7 + i / 256;
+
+	/* Buffers that can't hold the read-ahead a few times over are rejected. */
+	assert_null(cache_rdev_init(&crdev, &image_rdev, cache_buffer,
+				    8 * (CACHE_BLOCK_SIZE + sizeof(struct cache_rdev_block)),
+				    CACHE_BLOCK_SIZE, CACHE_READAHEAD));
+	assert_null(cache_rdev_init(&crdev, &image_rdev, cache_buffer, sizeof(cache_buffer),
+				    CACHE_BLOCK_SIZE - 1, CACHE_READAHEAD));
+	cached = cache_rdev_init(&crdev, &image_rdev, cache_buffer, sizeof(cache_buffer),
+				 CACHE_BLOCK_SIZE, CACHE_READAHEAD);
+	assert_non_null(cached);
+
+	/* Reads of any size and alignment, including ones bypassing the cache. */
+	for (int i = 0; i < 2000; i++) {
+		x = x * 1103515245 + 12345;
+		const size_t size = (x >> 8) % (i % 10 ? 600 : sizeof(buf)) + 1;
+		x = x * 1103515245 + 12345;
+		const size_t offset = (x >> 4) % (CBFS_IMAGE_SIZE - size);
+
+		assert_int_equal(size, rdev_readat(cached, buf, offset, size));
+		assert_memory_equal(&cbfs_image[offset], buf, size);
+	}
+
+	/* Reads up to the end of the device, where read-ahead has to stop. */
+	assert_int_equal(10, rdev_readat(cached, buf, CBFS_IMAGE_SIZE - 10, 10));
+	assert_memory_equal(&cbfs_image[CBFS_IMAGE_SIZE - 10], buf, 10);
+	assert_int_equal(-1, rdev_readat(cached, buf, CBFS_IMAGE_SIZE - 10, 11));
+
+	/* Writes and erases drop what they touch from the cache. */
+	assert_int_equal(100, rdev_readat(cached, buf, 0x1000 - 50, 100));
+	memset(buf, 0x5a, 20);
+	assert_int_equal(20, rdev_writeat(cached, buf, 0x1000 - 10, 20));
+	assert_int_equal(16, rdev_eraseat(cached, 0x1000 - 40, 16));
+	assert_int_equal(100, rdev_readat(cached, buf, 0x1000 - 50, 100));
+	assert_memory_equal(&cbfs_image[0x1000 - 50], buf, 100);
+	assert_int_equal(0x5a, buf[50]);
+	assert_int_equal(0xff, buf[10]);
+
+	/* Mappings come from the backing device. */
+	assert_ptr_equal(&cbfs_image[0x2345], rdev_mmap(cached, 0x2345, 10));
+}
+
 int main(void)
 {
 	const struct CMUnitTest tests[] = {
@@ -402,6 +588,8 @@ int main(void)
 		cmocka_unit_test(test_rdev_chain),
 		cmocka_unit_test(test_rdev_double_chain),
 		cmocka_unit_test(test_mem_rdev),
+		cmocka_unit_test(test_cache_rdev_cbfs_walk),
+		cmocka_unit_test(test_cache_rdev_coherency),
 	};
 
 	return cb_run_group_tests(tests, NULL, NULL);
@@ -2,6 +2,9 @@
 
 tests-y += i2c-test
 tests-y += ddr4-test
+tests-y += device_const-ramstage-test
+tests-y += device_const-romstage-test
+tests-y += pci_topology_cache-test
 
 i2c-test-srcs += tests/device/i2c-test.c
 i2c-test-srcs += src/device/i2c.c
@@ -10,3 +13,23 @@ i2c-test-mocks += platform_i2c_transfer
 ddr4-test-srcs += tests/device/ddr4-test.c
 ddr4-test-srcs += tests/stubs/console.c
 ddr4-test-srcs += src/device/dram/ddr4.c
+
+device_const-ramstage-test-stage := ramstage
+device_const-ramstage-test-srcs += tests/device/device_const-test.c
+device_const-ramstage-test-srcs += tests/stubs/console.c
+device_const-ramstage-test-srcs += tests/stubs/die.c
+device_const-ramstage-test-srcs += src/device/device_const.c
+
+device_const-romstage-test-stage := romstage
+device_const-romstage-test-srcs += tests/device/device_const-test.c
+device_const-romstage-test-srcs += tests/stubs/console.c
+device_const-romstage-test-srcs += tests/stubs/die.c
+device_const-romstage-test-srcs += src/device/device_const.c
+
+pci_topology_cache-test-srcs += tests/device/pci_topology_cache-test.c
+pci_topology_cache-test-srcs += src/device/pci_topology_cache.c
+pci_topology_cache-test-srcs += src/commonlib/region.c
+pci_topology_cache-test-srcs += src/lib/region_file.c
+pci_topology_cache-test-srcs += src/lib/xxhash.c
+pci_topology_cache-test-srcs += tests/stubs/console.c
+pci_topology_cache-test-config += CONFIG_PCI=1
@@ -0,0 +1,287 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <device/device.h>
+#include <device/path.h>
+#include <device/pci_def.h>
+#include <tests/test.h>
+
+/*
+ * A device tree laid out the way sconfig generates it, numbered in the order of
+ * all_devices:
+ *
+ * 0 root
+ * 1   cpu_cluster 0
+ * 2   domain 0
+ * 3     pci 00.0
+ * 4     pci 1f.0
+ * 6       pnp 2e.1
+ * 7       i2c 50
+ * 8       pnp 2e.2
+ * 5     pci 02.0
+ *
+ * Before ramstage the device tree is constant and has no chip_ops, the same tests
+ * run against the pci_root index instead of the buses.
+ */
+
+#if DEVTREE_EARLY
+#define CHIP_OPS(ops)
+#else
+#define CHIP_OPS(ops)	.chip_ops = &(ops),
+struct chip_operations mainboard_ops, soc_ops, superio_ops, i2c_ops;
+#endif
+
+static struct device static_devices[8];
+static struct bus root_bus, domain_bus, lpc_bus;
+
+DEVTREE_CONST struct device dev_root = {
+	.path = { .type = DEVICE_PATH_ROOT },
+	.upstream = &root_bus,
+	.downstream = &root_bus,
+	CHIP_OPS(mainboard_ops)
+	.next = &static_devices[0],
+};
+
+static struct bus root_bus = { .dev = &dev_root, .children = &static_devices[0] };
+static struct bus domain_bus = { .dev = &static_devices[1], .children = &static_devices[2] };
+static struct bus lpc_bus = { .dev = &static_devices[3], .children = &static_devices[5],
+			      .secondary = 1 };
+
+static struct device static_devices[8] = {
+	[0] = {
+		.path = { .type = DEVICE_PATH_CPU_CLUSTER },
+		.upstream = &root_bus,
+		.sibling = &static_devices[1],
+		CHIP_OPS(soc_ops)
+		.next = &static_devices[1],
+	},
+	[1] = {
+		.path = { .type = DEVICE_PATH_DOMAIN },
+		.upstream = &root_bus,
+		.downstream = &domain_bus,
+		CHIP_OPS(soc_ops)
+		.next = &static_devices[2],
+	},
+	[2] = {
+		.path = { .type = DEVICE_PATH_PCI, .pci.devfn = PCI_DEVFN(0, 0) },
+		.upstream = &domain_bus,
+		.sibling = &static_devices[3],
+		CHIP_OPS(soc_ops)
+		.next = &static_devices[3],
+	},
+	[3] = {
+		.path = { .type = DEVICE_PATH_PCI, .pci.devfn = PCI_DEVFN(0x1f, 0) },
+		.upstream = &domain_bus,
+		.downstream = &lpc_bus,
+		.sibling = &static_devices[4],
+		CHIP_OPS(soc_ops)
+		.next = &static_devices[4],
+	},
+	[4] = {
+		.path = { .type = DEVICE_PATH_PCI, .pci.devfn = PCI_DEVFN(2, 0) },
+		.upstream = &domain_bus,
+		CHIP_OPS(soc_ops)
+		.next = &static_devices[5],
+	},
+	[5] = {
+		.path = { .type = DEVICE_PATH_PNP, .pnp = { .port = 0x2e, .device = 1 } },
+		.upstream = &lpc_bus,
+		.sibling = &static_devices[6],
+		CHIP_OPS(superio_ops)
+		.next = &static_devices[6],
+	},
+	[6] = {
+		.path = { .type = DEVICE_PATH_I2C, .i2c.device = 0x50 },
+		.upstream = &lpc_bus,
+		.sibling = &static_devices[7],
+		CHIP_OPS(i2c_ops)
+		.next = &static_devices[7],
+	},
+	[7] = {
+		.path = { .type = DEVICE_PATH_PNP, .pnp = { .port = 0x2e, .device = 2 } },
+		.upstream = &lpc_bus,
+		CHIP_OPS(superio_ops)
+	},
+};
+
+static const uint16_t path_devices[] = { 0, 1, 2, 3, 4, 5, 6, 8, 7 };
+static const struct devtree_index_range path_ranges[] = {
+	{ .key = DEVICE_PATH_ROOT, .first = 0, .count = 1 },
+	{ .key = DEVICE_PATH_CPU_CLUSTER, .first = 1, .count = 1 },
+	{ .key = DEVICE_PATH_DOMAIN, .first = 2, .count = 1 },
+	{ .key = DEVICE_PATH_PCI, .first = 3, .count = 3 },
+	{ .key = DEVICE_PATH_PNP, .first = 6, .count = 2 },
+	{ .key = DEVICE_PATH_I2C, .first = 8, .count = 1 },
+};
+static const uint16_t pci_root_devices[] = { 3, 5, 4 };
+#if !DEVTREE_EARLY
+static const uint16_t chip_devices[] = { 0, 1, 2, 3, 4, 5, 6, 8, 7 };
+static const struct devtree_index_range chip_ranges[] = {
+	{ .first = 0, .count = 1 },
+	{ .first = 1, .count = 5 },
+	{ .first = 6, .count = 2 },
+	{ .first = 8, .count = 1 },
+};
+#endif
+
+const struct devtree_index devtree_index = {
+	.devices = static_devices,
+	.device_count = ARRAY_SIZE(static_devices),
+	.paths = path_ranges,
+	.path_count = ARRAY_SIZE(path_ranges),
+	.by_path = path_devices,
+	.pci_root = pci_root_devices,
+	.pci_root_count = ARRAY_SIZE(pci_root_devices),
+#if !DEVTREE_EARLY
+	.chips = chip_ranges,
+	.chip_count = ARRAY_SIZE(chip_ranges),
+	.by_chip = chip_devices,
+#endif
+};
+
+#if !DEVTREE_EARLY
+
+/* Devices allocated at runtime, appended to all_devices and their bus. */
+static struct device dynamic_devices[] = {
+	{
+		.path = { .type = DEVICE_PATH_PNP, .pnp = { .port = 0x2e, .device = 3 } },
+		.upstream = &lpc_bus,
+		.next = &dynamic_devices[1],
+	},
+	{
+		.path = { .type = DEVICE_PATH_PCI, .pci.devfn = PCI_DEVFN(3, 0) },
+		.upstream = &domain_bus,
+	},
+};
+
+static int setup_dynamic_devices(void **state)
+{
+	static_devices[7].next = &dynamic_devices[0];
+	static_devices[7].sibling = &dynamic_devices[0];
+	static_devices[4].sibling = &dynamic_devices[1];
+	return 0;
+}
+
+static int teardown_dynamic_devices(void **state)
+{
+	static_devices[7].next = NULL;
+	static_devices[7].sibling = NULL;
+	static_devices[4].sibling = NULL;
+	return 0;
+}
+
+#endif
+
+static void test_dev_find_path(void **state)
+{
+	const enum device_path_type types[] = {
+		DEVICE_PATH_ROOT, DEVICE_PATH_CPU_CLUSTER, DEVICE_PATH_DOMAIN, DEVICE_PATH_PCI,
+		DEVICE_PATH_PNP, DEVICE_PATH_I2C, DEVICE_PATH_USB,
+	};
+
+	/* Every device of a type is found in the order of all_devices. */
+	for (size_t i = 0; i < ARRAY_SIZE(types); i++) {
+		DEVTREE_CONST struct device *dev = NULL, *expected = all_devices;
+
+		do {
+			while (expected && expected->path.type != types[i])
+				expected = expected->next;
+			dev = dev_find_path(dev, types[i]);
+			assert_ptr_equal(expected, dev);
+			if (expected)
+				expected = expected->next;
+		} while (dev);
+	}
+
+	assert_ptr_equal(&static_devices[1], pci_root_bus()->dev);
+}
+
+#if !DEVTREE_EARLY
+static void test_dev_find_chip_ops(void **state)
+{
+	struct chip_operations *const ops[] = { &mainboard_ops, &soc_ops, &superio_ops,
+						&i2c_ops };
+
+	for (size_t i = 0; i < ARRAY_SIZE(ops); i++) {
+		struct device *dev = NULL, *expected = all_devices;
+
+		do {
+			while (expected && expected->chip_ops != ops[i])
+				expected = expected->next;
+			dev = dev_find_chip_ops(dev, ops[i]);
+			assert_ptr_equal(expected, dev);
+			if (expected)
+				expected = expected->next;
+		} while (dev);
+	}
+}
+#endif
+
+static void test_dev_find_slot(void **state)
+{
+	assert_ptr_equal(&static_devices[5], dev_find_slot_pnp(0x2e, 1));
+	assert_ptr_equal(&static_devices[7], dev_find_slot_pnp(0x2e, 2));
+	assert_null(dev_find_slot_pnp(0x4e, 1));
+
+	assert_ptr_equal(&static_devices[6], dev_find_slot_on_smbus(1, 0x50));
+	assert_null(dev_find_slot_on_smbus(0, 0x50));
+	assert_null(dev_find_slot_on_smbus(1, 0x51));
+}
+
+static void test_pcidev_path_on_root(void **state)
+{
+	assert_ptr_equal(&static_devices[2], pcidev_on_root(0, 0));
+	assert_ptr_equal(&static_devices[4], pcidev_on_root(2, 0));
+	assert_ptr_equal(&static_devices[3], pcidev_on_root(0x1f, 0));
+	assert_null(pcidev_on_root(0x1f, 1));
+	assert_null(pcidev_on_root(3, 0));
+	assert_null(pcidev_on_root(0x1f, 7));
+	assert_null(pcidev_on_root(0x00, 1));
+}
+
+#if DEVTREE_EARLY
+static void test_pcidev_path_on_root_indexed(void **state)
+{
+	/* Before ramstage the PCI root bus isn't walked, only pci_root_devices is used. */
+	domain_bus.children = NULL;
+	assert_null(pcidev_path_behind(pci_root_bus(), PCI_DEVFN(2, 0)));
+	test_pcidev_path_on_root(state);
+	domain_bus.children = &static_devices[2];
+}
+#else
+
+static void test_dynamic_devices(void **state)
+{
+	assert_ptr_equal(&dynamic_devices[0], dev_find_slot_pnp(0x2e, 3));
+	assert_ptr_equal(&dynamic_devices[1], pcidev_on_root(3, 0));
+
+	/* Searches continue from the static devices to the dynamic ones and on from those. */
+	assert_ptr_equal(&dynamic_devices[0], dev_find_path(&static_devices[7],
+							    DEVICE_PATH_PNP));
+	assert_ptr_equal(&dynamic_devices[1], dev_find_path(&static_devices[4],
+							    DEVICE_PATH_PCI));
+	assert_ptr_equal(&dynamic_devices[1], dev_find_path(&dynamic_devices[0],
+							    DEVICE_PATH_PCI));
+	assert_null(dev_find_path(&dynamic_devices[1], DEVICE_PATH_PCI));
+
+	test_dev_find_path(state);
+	test_dev_find_chip_ops(state);
+}
+#endif
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_dev_find_path),
+		cmocka_unit_test(test_dev_find_slot),
+		cmocka_unit_test(test_pcidev_path_on_root),
+#if DEVTREE_EARLY
+		cmocka_unit_test(test_pcidev_path_on_root_indexed),
+#else
+		cmocka_unit_test(test_dev_find_chip_ops),
+		cmocka_unit_test_setup_teardown(test_dynamic_devices, setup_dynamic_devices,
+						teardown_dynamic_devices),
+#endif
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
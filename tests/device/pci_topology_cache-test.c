@@ -0,0 +1,205 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <commonlib/region.h>
+#include <device/device.h>
+#include <device/pci.h>
+#include <fmap.h>
+#include <string.h>
+#include <tests/test.h>
+#include <types.h>
+#include <version.h>
+
+#define FLASH_SIZE	(16 * KiB)
+
+uint64_t coreboot_build_hash(void)
+{
+	return 1;
+}
+
+static uint8_t flash[FLASH_SIZE];
+static struct mem_region_device flash_mdev = MEM_REGION_DEV_RW_INIT(flash, FLASH_SIZE);
+
+int fmap_locate_area_as_rdev_rw(const char *name, struct region_device *area)
+{
+	assert_string_equal("RW_PCI_CACHE", name);
+	return rdev_chain_full(area, &flash_mdev.rdev);
+}
+
+/*
+ * Bus 0 with a host bridge, a multi-function device and a root port, bus 1
+ * behind the root port with a single device.
+ */
+static struct bus bus0, bus1 = { .secondary = 1 };
+static struct device devs[] = {
+	{
+		.path = { .type = DEVICE_PATH_PCI, .pci.devfn = PCI_DEVFN(0, 0) },
+		.upstream = &bus0, .sibling = &devs[1],
+		.vendor = 0x8086, .device = 0x29c0, .class = 0x060000,
+	},
+	{
+		.path = { .type = DEVICE_PATH_PCI, .pci.devfn = PCI_DEVFN(0x1f, 0) },
+		.upstream = &bus0, .sibling = &devs[2],
+		.vendor = 0x8086, .device = 0x2918, .class = 0x060100,
+	},
+	{
+		.path = { .type = DEVICE_PATH_PCI, .pci.devfn = PCI_DEVFN(0x1f, 3) },
+		.upstream = &bus0, .sibling = &devs[3],
+		.vendor = 0x8086, .device = 0x2930, .class = 0x0c0500,
+	},
+	{
+		.path = { .type = DEVICE_PATH_PCI, .pci.devfn = PCI_DEVFN(0x1c, 0) },
+		.upstream = &bus0, .downstream = &bus1,
+		.vendor = 0x1b36, .device = 0x000c, .class = 0x060400,
+	},
+	{
+		.path = { .type = DEVICE_PATH_PCI, .pci.devfn = PCI_DEVFN(0, 0) },
+		.upstream = &bus1,
+		.vendor = 0x1af4, .device = 0x1041, .class = 0x020000,
+	},
+};
+
+static int setup_pci_topology_cache(void **state)
+{
+	memset(flash, 0xff, sizeof(flash));
+	bus0.children = &devs[0];
+	bus1.children = &devs[4];
+	devs[4].vendor = 0x1af4;
+	devs[2].hidden = 0;
+	return 0;
+}
+
+static void enumerate(void)
+{
+	pci_topology_cache_record(&bus0);
+	pci_topology_cache_record(&bus1);
+	pci_topology_cache_save();
+}
+
+static void assert_cached(const struct bus *bus, const struct device *first, size_t count)
+{
+	const struct pci_topology_entry *entries;
+	size_t n;
+
+	assert_true(pci_topology_cache_lookup(bus, &entries, &n));
+	assert_int_equal(count, n);
+	for (size_t i = 0; i < count; i++, first = first->sibling) {
+		assert_int_equal(bus->secondary, entries[i].bus);
+		assert_int_equal(first->path.pci.devfn, entries[i].devfn);
+		assert_int_equal(first->device << 16 | first->vendor, entries[i].id);
+		assert_int_equal(first->class, entries[i].class);
+	}
+}
+
+static void test_pci_topology_cache_hit(void **state)
+{
+	const struct pci_topology_entry *entries;
+	struct bus bus2 = { .secondary = 2 };
+	uint8_t before[FLASH_SIZE];
+	size_t count;
+
+	pci_topology_cache_load();
+	assert_false(pci_topology_cache_lookup(&bus0, &entries, &count));
+	enumerate();
+
+	pci_topology_cache_load();
+	assert_cached(&bus0, &devs[0], 4);
+	assert_cached(&bus1, &devs[4], 1);
+	assert_false(pci_topology_cache_lookup(&bus2, &entries, &count));
+
+	/* An unchanged topology doesn't touch the flash. */
+	memcpy(before, flash, sizeof(flash));
+	enumerate();
+	assert_memory_equal(before, flash, sizeof(flash));
+}
+
+static void test_pci_topology_cache_changed(void **state)
+{
+	const struct pci_topology_entry *entries;
+	size_t count;
+
+	pci_topology_cache_load();
+	enumerate();
+
+	/* A card was removed, so pci_scan_bus() found it missing and rescanned. */
+	pci_topology_cache_load();
+	assert_cached(&bus1, &devs[4], 1);
+	pci_topology_cache_invalidate();
+	assert_false(pci_topology_cache_lookup(&bus0, &entries, &count));
+	bus1.children = NULL;
+	enumerate();
+
+	/*
+	 * Buses scanned before the invalidation were filtered by the stale cache,
+	 * so the cache is only dropped. The next boot scans everything again.
+	 */
+	pci_topology_cache_load();
+	assert_false(pci_topology_cache_lookup(&bus0, &entries, &count));
+	enumerate();
+
+	pci_topology_cache_load();
+	assert_cached(&bus0, &devs[0], 4);
+	assert_cached(&bus1, NULL, 0);
+
+	/* Hidden functions and ones that weren't found aren't cached. */
+	bus1.children = &devs[4];
+	devs[4].vendor = 0;
+	devs[2].hidden = 1;
+	devs[1].sibling = &devs[3];
+	enumerate();
+	devs[1].sibling = &devs[2];
+
+	pci_topology_cache_load();
+	assert_true(pci_topology_cache_lookup(&bus0, &entries, &count));
+	assert_int_equal(3, count);
+	assert_int_equal(PCI_DEVFN(0x1c, 0), entries[2].devfn);
+	assert_cached(&bus1, NULL, 0);
+}
+
+static void test_pci_topology_cache_corrupted(void **state)
+{
+	const struct pci_topology_entry *entries;
+	size_t count, offset;
+	const uint8_t pattern[] = { 0x86, 0x80, 0xc0, 0x29 };
+
+	pci_topology_cache_load();
+	enumerate();
+
+	for (offset = 0; offset < FLASH_SIZE - sizeof(pattern); offset++) {
+		if (!memcmp(&flash[offset], pattern, sizeof(pattern)))
+			break;
+	}
+	assert_true(offset < FLASH_SIZE - sizeof(pattern));
+	flash[offset] ^= 1;
+
+	pci_topology_cache_load();
+	assert_false(pci_topology_cache_lookup(&bus0, &entries, &count));
+}
+
+static void test_pci_topology_cache_overflow(void **state)
+{
+	const struct pci_topology_entry *entries;
+	size_t count;
+
+	pci_topology_cache_load();
+	for (size_t i = 0; i < 256; i++)
+		pci_topology_cache_record(&bus0);
+	pci_topology_cache_save();
+
+	pci_topology_cache_load();
+	assert_false(pci_topology_cache_lookup(&bus0, &entries, &count));
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup(test_pci_topology_cache_hit, setup_pci_topology_cache),
+		cmocka_unit_test_setup(test_pci_topology_cache_changed,
+				       setup_pci_topology_cache),
+		cmocka_unit_test_setup(test_pci_topology_cache_corrupted,
+				       setup_pci_topology_cache),
+		cmocka_unit_test_setup(test_pci_topology_cache_overflow,
+				       setup_pci_topology_cache),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
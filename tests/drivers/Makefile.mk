@@ -11,3 +11,46 @@ efivars-test-cflags += -I src/vendorcode/intel/edk2/UDK2017/MdePkg/Include/
 efivars-test-cflags += -I src/vendorcode/intel/edk2/UDK2017/MdePkg/Include/Ia32/
 efivars-test-cflags += -I src/vendorcode/intel/edk2/UDK2017/MdePkg/Include/Pi/
 efivars-test-cflags += -I src/vendorcode/intel/edk2/UDK2017/MdeModulePkg/Include/
+
+tests-y += smmstore-test
+
+smmstore-test-srcs += tests/drivers/smmstore-test.c
+smmstore-test-srcs += tests/stubs/console.c
+smmstore-test-srcs += src/commonlib/region.c
+smmstore-test-config += CONFIG_SMMSTORE=1
+smmstore-test-cflags += -I tests/include/tests/lib/fmap
+
+tests-y += elog-test
+
+elog-test-srcs += tests/drivers/elog-test.c
+elog-test-srcs += tests/stubs/console.c
+elog-test-srcs += src/commonlib/bsd/elog.c
+elog-test-srcs += src/commonlib/region.c
+elog-test-config += CONFIG_ELOG=1
+elog-test-config += CONFIG_ELOG_DEFER_NV_WRITES=1
+elog-test-config += CONFIG_COLLECT_TIMESTAMPS=0
+
+tests-y += spi_flash-test
+
+spi_flash-test-srcs += tests/drivers/spi_flash-test.c
+spi_flash-test-srcs += tests/stubs/console.c
+spi_flash-test-srcs += src/drivers/spi/spi_flash.c
+spi_flash-test-srcs += src/drivers/spi/spi-generic.c
+spi_flash-test-srcs += src/drivers/spi/winbond.c
+spi_flash-test-srcs += src/drivers/spi/macronix.c
+spi_flash-test-srcs += src/commonlib/region.c
+spi_flash-test-config += CONFIG_SPI_FLASH=1
+spi_flash-test-config += CONFIG_SPI_FLASH_WINBOND=1
+spi_flash-test-config += CONFIG_SPI_FLASH_MACRONIX=1
+spi_flash-test-config += CONFIG_SPI_FLASH_QUAD_IO=1
+
+tests-y += mrc_cache-test
+
+mrc_cache-test-srcs += tests/drivers/mrc_cache-test.c
+mrc_cache-test-srcs += tests/stubs/console.c
+mrc_cache-test-srcs += src/commonlib/region.c
+mrc_cache-test-srcs += src/commonlib/mem_pool.c
+mrc_cache-test-srcs += src/lib/region_file.c
+mrc_cache-test-srcs += src/lib/xxhash.c
+mrc_cache-test-config += CONFIG_CACHE_MRC_SETTINGS=1
+mrc_cache-test-config += CONFIG_MRC_CACHE_DELTA_UPDATES=1
@@ -0,0 +1,259 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+/* bootstate.h declares the stage's main(), which would clash with the one of the test. */
+#define _MAIN_DECL_H_
+#include "../drivers/elog/elog.c"
+
+#include <boot_device.h>
+#include <cbmem.h>
+#include <commonlib/region.h>
+#include <fmap.h>
+#include <smbios.h>
+#include <string.h>
+#include <tests/test.h>
+#include <types.h>
+
+#define FLASH_SIZE	(8 * KiB)
+#define TEST_EVENTS	10
+
+static uint8_t flash[FLASH_SIZE];
+static int flash_writes;
+static int flash_erases;
+
+static void *flash_mmap(const struct region_device *rd, size_t offset, size_t size)
+{
+	return &flash[offset];
+}
+
+static int flash_munmap(const struct region_device *rd, void *mapping)
+{
+	return 0;
+}
+
+static ssize_t flash_readat(const struct region_device *rd, void *b, size_t offset,
+			    size_t size)
+{
+	memcpy(b, &flash[offset], size);
+	return size;
+}
+
+/* Like SPI flash, writes can only clear bits. */
+static ssize_t flash_writeat(const struct region_device *rd, const void *b, size_t offset,
+			     size_t size)
+{
+	const uint8_t *p = b;
+
+	for (size_t i = 0; i < size; i++)
+		flash[offset + i] &= p[i];
+
+	flash_writes++;
+	return size;
+}
+
+static ssize_t flash_eraseat(const struct region_device *rd, size_t offset, size_t size)
+{
+	memset(&flash[offset], 0xff, size);
+	flash_erases++;
+	return size;
+}
+
+static const struct region_device_ops flash_ops = {
+	.mmap = flash_mmap,
+	.munmap = flash_munmap,
+	.readat = flash_readat,
+	.writeat = flash_writeat,
+	.eraseat = flash_eraseat,
+};
+
+static const struct region_device flash_rdev = REGION_DEV_INIT(&flash_ops, 0, FLASH_SIZE);
+
+int fmap_locate_area_as_rdev_rw(const char *name, struct region_device *area)
+{
+	return rdev_chain_full(area, &flash_rdev);
+}
+
+const struct region_device *boot_device_ro(void)
+{
+	return &flash_rdev;
+}
+
+/* A single CBMEM entry is enough to hold the tail hint. */
+int cbmem_initialized;
+static struct elog_tail_hint hint_entry;
+static bool hint_added;
+
+void *cbmem_add(u32 id, u64 size)
+{
+	if (id != CBMEM_ID_ELOG_HINT || size != sizeof(hint_entry))
+		return NULL;
+
+	hint_added = true;
+	return &hint_entry;
+}
+
+void *cbmem_find(u32 id)
+{
+	if (id != CBMEM_ID_ELOG_HINT || !hint_added)
+		return NULL;
+
+	return &hint_entry;
+}
+
+int rtc_get(struct rtc_time *time)
+{
+	return -1;
+}
+
+void *smbios_carve_table(unsigned long start, u8 type, u8 length, u16 handle)
+{
+	return NULL;
+}
+
+int smbios_full_table_len(struct smbios_header *header, u8 *str_table_start)
+{
+	return 0;
+}
+
+/* Start over as a new stage would, with what is in flash and CBMEM. */
+static void reset_stage(bool defer)
+{
+	memset(&elog_state, 0, sizeof(elog_state));
+	elog_state.defer_nv_writes = defer;
+	flash_writes = 0;
+	flash_erases = 0;
+}
+
+static int setup_elog(void **state)
+{
+	memset(flash, 0xff, sizeof(flash));
+	memset(&hint_entry, 0, sizeof(hint_entry));
+	hint_added = false;
+	cbmem_initialized = 1;
+	reset_stage(true);
+	return 0;
+}
+
+static size_t count_events(void)
+{
+	size_t offset = elog_events_start();
+	size_t count = 0;
+
+	while (flash[offset] != ELOG_TYPE_EOL) {
+		offset += flash[offset + offsetof(struct event_header, length)];
+		count++;
+	}
+
+	return count;
+}
+
+static void test_elog_deferred_writes(void **state)
+{
+	assert_int_equal(0, elog_init());
+
+	/* The new header, the log clear and the boot events all stay in the mirror. */
+	for (int i = 0; i < TEST_EVENTS; i++)
+		assert_int_equal(0, elog_add_event_byte(ELOG_TYPE_OS_EVENT, i));
+	assert_int_equal(0, flash_writes);
+
+	/* And go out with a single write. */
+	assert_int_equal(0, elog_flush());
+	assert_int_equal(1, flash_writes);
+	assert_int_equal(0, flash_erases);
+	assert_int_equal(TEST_EVENTS + 2, count_events());
+
+	/* Flushing again has nothing left to write. */
+	assert_int_equal(0, elog_flush());
+	assert_int_equal(1, flash_writes);
+
+	/* Stages that don't defer write every event right away. */
+	reset_stage(false);
+	assert_int_equal(0, elog_init());
+	for (int i = 0; i < TEST_EVENTS; i++)
+		assert_int_equal(0, elog_add_event_byte(ELOG_TYPE_OS_EVENT, i));
+	assert_int_equal(TEST_EVENTS + 1, flash_writes);
+	assert_int_equal(2 * TEST_EVENTS + 3, count_events());
+}
+
+static void test_elog_deferred_shrink(void **state)
+{
+	size_t events;
+
+	assert_int_equal(0, elog_init());
+	assert_int_equal(0, elog_flush());
+
+	/* Overflowing the log shrinks it, which only needs an erase and a write at the end. */
+	reset_stage(true);
+	assert_int_equal(0, elog_init());
+	for (size_t i = 0; i < ELOG_SIZE / sizeof(struct event_header); i++)
+		assert_int_equal(0, elog_add_event_dword(ELOG_TYPE_OS_EVENT, i));
+	assert_int_equal(0, flash_writes);
+	assert_int_equal(0, elog_flush());
+	assert_int_equal(1, flash_erases);
+	assert_int_equal(1, flash_writes);
+
+	/* The result is a valid log, which doesn't need to be prepared again. */
+	events = count_events();
+	reset_stage(true);
+	hint_added = false;
+	assert_int_equal(0, elog_init());
+	assert_int_equal(0, elog_flush());
+	assert_int_equal(0, flash_erases);
+	assert_int_equal(events + 1, count_events());
+}
+
+static void test_elog_tail_hint(void **state)
+{
+	assert_int_equal(0, elog_init());
+	for (int i = 0; i < TEST_EVENTS; i++)
+		assert_int_equal(0, elog_add_event_byte(ELOG_TYPE_OS_EVENT, i));
+	assert_int_equal(0, elog_flush());
+
+	const size_t tail = elog_state.mirror_last_write;
+	assert_true(hint_added);
+	assert_int_equal(tail, hint_entry.tail);
+	/* The newest event is the last one logged, with one byte of data. */
+	assert_int_equal(tail - sizeof(struct event_header) - 2, hint_entry.last_event);
+
+	/* Events appended behind the back of the hint are validated and picked up. */
+	cbmem_initialized = 0;
+	reset_stage(false);
+	assert_int_equal(0, elog_init());
+	assert_int_equal(0, elog_add_event_byte(ELOG_TYPE_OS_EVENT, 0xaa));
+	const size_t new_tail = elog_state.mirror_last_write;
+	assert_int_equal(tail, hint_entry.tail);
+
+	cbmem_initialized = 1;
+	reset_stage(true);
+	assert_int_equal(0, elog_init());
+	assert_int_equal(new_tail, elog_state.nv_last_write);
+	assert_int_equal(new_tail, hint_entry.tail);
+	assert_int_equal(new_tail - sizeof(struct event_header) - 2, hint_entry.last_event);
+
+	/* Events before the hint aren't validated again, a broken checksum goes unnoticed. */
+	const size_t event = elog_events_start();
+	const size_t checksum = event + flash[event + offsetof(struct event_header, length)] - 1;
+	flash[checksum] ^= 1;
+	reset_stage(true);
+	assert_int_equal(0, elog_init());
+	assert_int_equal(new_tail, elog_state.nv_last_write);
+	assert_int_equal(0, flash_erases);
+
+	/* Without a matching hint the whole log is validated and the corruption is found. */
+	hint_entry.last_event++;
+	reset_stage(true);
+	assert_int_equal(0, elog_init());
+	assert_int_equal(0, elog_flush());
+	assert_int_equal(1, flash_erases);
+	assert_int_equal(2, count_events());
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup(test_elog_deferred_writes, setup_elog),
+		cmocka_unit_test_setup(test_elog_deferred_shrink, setup_elog),
+		cmocka_unit_test_setup(test_elog_tail_hint, setup_elog),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,333 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+/* bootstate.h declares the stage's main(), which would clash with the one of the test. */
+#define _MAIN_DECL_H_
+#include "../drivers/mrc_cache/mrc_cache.c"
+
+#include <boot_device.h>
+#include <cbfs.h>
+#include <commonlib/region.h>
+#include <fmap.h>
+#include <string.h>
+#include <tests/test.h>
+#include <types.h>
+
+#define CACHE_SIZE	0x10000
+#define DATA_SIZE	1024
+#define DATA_VERSION	3
+
+static uint8_t flash[CACHE_SIZE];
+static uint8_t flash_copy[CACHE_SIZE];
+
+static uint8_t pool_buf[2 * DATA_SIZE];
+struct mem_pool cbfs_cache = MEM_POOL_INIT(pool_buf, sizeof(pool_buf), 8);
+
+static void *flash_mmap(const struct region_device *rd, size_t offset, size_t size)
+{
+	return &flash[offset];
+}
+
+static int flash_munmap(const struct region_device *rd, void *mapping)
+{
+	return 0;
+}
+
+static ssize_t flash_readat(const struct region_device *rd, void *b, size_t offset,
+			    size_t size)
+{
+	memcpy(b, &flash[offset], size);
+	return size;
+}
+
+/* Like SPI flash, writes can only clear bits. */
+static ssize_t flash_writeat(const struct region_device *rd, const void *b, size_t offset,
+			     size_t size)
+{
+	const uint8_t *p = b;
+
+	for (size_t i = 0; i < size; i++)
+		flash[offset + i] &= p[i];
+
+	return size;
+}
+
+static ssize_t flash_eraseat(const struct region_device *rd, size_t offset, size_t size)
+{
+	memset(&flash[offset], 0xff, size);
+	return size;
+}
+
+static const struct region_device_ops flash_ops = {
+	.mmap = flash_mmap,
+	.munmap = flash_munmap,
+	.readat = flash_readat,
+	.writeat = flash_writeat,
+	.eraseat = flash_eraseat,
+};
+
+static const struct region_device flash_rdev = REGION_DEV_INIT(&flash_ops, 0, CACHE_SIZE);
+
+int fmap_locate_area(const char *name, struct region *r)
+{
+	if (strcmp(name, DEFAULT_MRC_CACHE))
+		return -1;
+
+	r->offset = 0;
+	r->size = CACHE_SIZE;
+	return 0;
+}
+
+int fmap_locate_area_as_rdev_rw(const char *name, struct region_device *area)
+{
+	return rdev_chain_full(area, &flash_rdev);
+}
+
+int boot_device_ro_subregion(const struct region *sub, struct region_device *subrd)
+{
+	return rdev_chain(subrd, &flash_rdev, sub->offset, sub->size);
+}
+
+int boot_device_rw_subregion(const struct region *sub, struct region_device *subrd)
+{
+	return rdev_chain(subrd, &flash_rdev, sub->offset, sub->size);
+}
+
+static uint8_t data[DATA_SIZE];
+
+static int setup_cache(void **state)
+{
+	memset(flash, 0xff, sizeof(flash));
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = i * 7;
+	delta_unusable = false;
+	return 0;
+}
+
+static void stash(void)
+{
+	assert_int_equal(0, mrc_cache_stash_data(MRC_TRAINING_DATA, DATA_VERSION, data,
+						 sizeof(data)));
+}
+
+/* Returns the metadata of the latest slot, which has to be valid. */
+static struct mrc_metadata latest_slot(void)
+{
+	struct region_device read_rdev;
+	struct region_device rdev;
+	struct mrc_metadata md;
+
+	assert_int_equal(0, mrc_cache_find_current(MRC_TRAINING_DATA, DATA_VERSION,
+						   &read_rdev, &rdev, &md));
+	return md;
+}
+
+static void check_load(void)
+{
+	uint8_t buf[DATA_SIZE];
+	size_t size = 0;
+	void *mapping;
+
+	assert_int_equal(sizeof(data), mrc_cache_load_current(MRC_TRAINING_DATA,
+							      DATA_VERSION, buf, sizeof(buf)));
+	assert_memory_equal(data, buf, sizeof(data));
+
+	mapping = mrc_cache_current_mmap_leak(MRC_TRAINING_DATA, DATA_VERSION, &size);
+	assert_non_null(mapping);
+	assert_int_equal(sizeof(data), size);
+	assert_memory_equal(data, mapping, sizeof(data));
+	if (latest_slot().flags & MRC_FLAG_DELTA)
+		mem_pool_free(&cbfs_cache, mapping);
+}
+
+static void test_mrc_cache_full_write(void **state)
+{
+	uint8_t buf[DATA_SIZE];
+	struct mrc_metadata md;
+
+	/* Nothing to load from an empty cache. */
+	assert_int_equal(-1, mrc_cache_load_current(MRC_TRAINING_DATA, DATA_VERSION, buf,
+						    sizeof(buf)));
+
+	stash();
+	md = latest_slot();
+	assert_int_equal(0, md.flags & MRC_FLAG_DELTA);
+	assert_int_equal(sizeof(data), md.data_size);
+	check_load();
+
+	/* Unchanged data is not written again. */
+	memcpy(flash_copy, flash, sizeof(flash));
+	stash();
+	assert_memory_equal(flash_copy, flash, sizeof(flash));
+
+	/* Other versions are not loaded. */
+	assert_int_equal(-1, mrc_cache_load_current(MRC_TRAINING_DATA, DATA_VERSION + 1, buf,
+						    sizeof(buf)));
+}
+
+static void test_mrc_cache_delta_write(void **state)
+{
+	struct region_device read_rdev, rdev;
+	struct mrc_metadata base, md;
+
+	stash();
+	base = latest_slot();
+	assert_int_equal(0, mrc_cache_find_current(MRC_TRAINING_DATA, DATA_VERSION,
+						   &read_rdev, &rdev, &md));
+	const size_t base_offset = rdev_relative_offset(&read_rdev, &rdev) - sizeof(md);
+
+	data[10] ^= 0xff;
+	data[500] ^= 0xff;
+	data[501] ^= 0xff;
+	stash();
+	md = latest_slot();
+	assert_int_equal(MRC_FLAG_DELTA, md.flags & MRC_FLAG_DELTA);
+	assert_int_equal(base_offset, md.base_offset);
+	assert_true(md.base_hash == base.data_hash);
+	/* Two runs, the adjacent bytes are merged. */
+	assert_int_equal(2 * sizeof(struct mrc_delta_run) + 3, md.delta_size);
+	check_load();
+}
+
+static void test_mrc_cache_delta_reconstruction(void **state)
+{
+	struct region_device read_rdev, rdev;
+	uint8_t buf[DATA_SIZE];
+	struct mrc_metadata md;
+	uint32_t base_offset;
+
+	stash();
+
+	/* A delta on top of a delta is still taken against the full copy. */
+	data[20] ^= 0x55;
+	stash();
+	base_offset = latest_slot().base_offset;
+	data[20] ^= 0x55;
+	data[900] ^= 0x55;
+	stash();
+	md = latest_slot();
+	assert_int_equal(MRC_FLAG_DELTA, md.flags & MRC_FLAG_DELTA);
+	assert_int_equal(base_offset, md.base_offset);
+	assert_int_equal(sizeof(struct mrc_delta_run) + 1, md.delta_size);
+	check_load();
+
+	/* Going back to the data of the full copy takes an empty delta. */
+	data[900] ^= 0x55;
+	stash();
+	md = latest_slot();
+	assert_int_equal(MRC_FLAG_DELTA, md.flags & MRC_FLAG_DELTA);
+	assert_int_equal(0, md.delta_size);
+	check_load();
+
+	/* Runs pointing outside of the data are rejected. */
+	setup_cache(state);
+	stash();
+	data[30] ^= 0xff;
+	stash();
+	assert_int_equal(0, mrc_cache_find_current(MRC_TRAINING_DATA, DATA_VERSION,
+						   &read_rdev, &rdev, &md));
+	flash[rdev_relative_offset(&flash_rdev, &rdev) + 3] = 0x10;
+	assert_int_equal(-1, mrc_cache_load_current(MRC_TRAINING_DATA, DATA_VERSION, buf,
+						    sizeof(buf)));
+}
+
+static void test_mrc_cache_delta_unusable(void **state)
+{
+	uint8_t buf[DATA_SIZE];
+	struct mrc_metadata md;
+
+	stash();
+	data[42] ^= 0xff;
+	stash();
+	assert_int_equal(MRC_FLAG_DELTA, latest_slot().flags & MRC_FLAG_DELTA);
+
+	/* The full copy the delta was taken against is gone. */
+	memset(&flash[latest_slot().base_offset], 0, sizeof(md));
+	assert_int_equal(-1, mrc_cache_load_current(MRC_TRAINING_DATA, DATA_VERSION, buf,
+						    sizeof(buf)));
+	assert_true(delta_unusable);
+
+	/* The retrained data is the same, but it is written in full. */
+	stash();
+	md = latest_slot();
+	assert_int_equal(0, md.flags & MRC_FLAG_DELTA);
+	assert_int_equal(MRC_FLAG_NO_DELTA, md.flags & MRC_FLAG_NO_DELTA);
+	check_load();
+
+	/* A full copy is up to date even when marked like that. */
+	memcpy(flash_copy, flash, sizeof(flash));
+	stash();
+	assert_memory_equal(flash_copy, flash, sizeof(flash));
+}
+
+static void test_mrc_cache_delta_threshold(void **state)
+{
+	const size_t max_run = DATA_SIZE / 4 - sizeof(struct mrc_delta_run);
+
+	stash();
+
+	/* A delta of a quarter of the data is still written. */
+	memset(&data[100], 0xa5, max_run);
+	stash();
+	assert_int_equal(MRC_FLAG_DELTA, latest_slot().flags & MRC_FLAG_DELTA);
+	assert_int_equal(DATA_SIZE / 4, latest_slot().delta_size);
+	check_load();
+
+	/* One more byte and the data is written in full. */
+	data[100 + max_run] = 0xa5;
+	stash();
+	assert_int_equal(0, latest_slot().flags & MRC_FLAG_DELTA);
+	check_load();
+
+	/* So is a change that needs too many runs. */
+	for (int i = 0; i <= MRC_DELTA_MAX_RUNS; i++)
+		data[i * 32] ^= 0xff;
+	stash();
+	assert_int_equal(0, latest_slot().flags & MRC_FLAG_DELTA);
+	check_load();
+}
+
+static void test_mrc_cache_needs_update(void **state)
+{
+	const struct mrc_metadata md = {
+		.signature = MRC_DATA_SIGNATURE,
+		.data_size = DATA_SIZE,
+		.data_hash = 0x1234,
+		.version = DATA_VERSION,
+	};
+	struct mrc_metadata new_md = md;
+	struct mrc_metadata delta_md = md;
+
+	assert_false(mrc_cache_needs_update(&md, &new_md));
+
+	new_md.data_hash++;
+	assert_true(mrc_cache_needs_update(&md, &new_md));
+	new_md = md;
+	new_md.version++;
+	assert_true(mrc_cache_needs_update(&md, &new_md));
+	new_md = md;
+	new_md.data_size--;
+	assert_true(mrc_cache_needs_update(&md, &new_md));
+
+	/* A delta reconstructing the same data is up to date, unless it can't be applied. */
+	delta_md.flags = MRC_FLAG_DELTA;
+	delta_md.delta_size = 8;
+	new_md = md;
+	assert_false(mrc_cache_needs_update(&delta_md, &new_md));
+	new_md.flags = MRC_FLAG_NO_DELTA;
+	assert_true(mrc_cache_needs_update(&delta_md, &new_md));
+	assert_false(mrc_cache_needs_update(&md, &new_md));
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup(test_mrc_cache_full_write, setup_cache),
+		cmocka_unit_test_setup(test_mrc_cache_delta_write, setup_cache),
+		cmocka_unit_test_setup(test_mrc_cache_delta_reconstruction, setup_cache),
+		cmocka_unit_test_setup(test_mrc_cache_delta_unusable, setup_cache),
+		cmocka_unit_test_setup(test_mrc_cache_delta_threshold, setup_cache),
+		cmocka_unit_test_setup(test_mrc_cache_needs_update, setup_cache),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
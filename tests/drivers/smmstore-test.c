@@ -0,0 +1,340 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include "../drivers/smmstore/store.c"
+
+#include <boot_device.h>
+#include <commonlib/region.h>
+#include <fmap.h>
+#include <smmstore.h>
+#include <stdio.h>
+#include <string.h>
+#include <tests/test.h>
+#include <types.h>
+
+#define STORE_SIZE	FMAP_SECTION_SMMSTORE_SIZE
+#define STORE_HALF	(STORE_SIZE / 2)
+#define TEST_KEYS	8
+#define TEST_VALUE_SIZE	1000
+
+static uint8_t flash[STORE_SIZE];
+
+static void *flash_mmap(const struct region_device *rd, size_t offset, size_t size)
+{
+	return &flash[offset];
+}
+
+static int flash_munmap(const struct region_device *rd, void *mapping)
+{
+	return 0;
+}
+
+static ssize_t flash_readat(const struct region_device *rd, void *b, size_t offset,
+			    size_t size)
+{
+	memcpy(b, &flash[offset], size);
+	return size;
+}
+
+/* Like SPI flash, writes can only clear bits. */
+static ssize_t flash_writeat(const struct region_device *rd, const void *b, size_t offset,
+			     size_t size)
+{
+	const uint8_t *p = b;
+
+	for (size_t i = 0; i < size; i++)
+		flash[offset + i] &= p[i];
+
+	return size;
+}
+
+static ssize_t flash_eraseat(const struct region_device *rd, size_t offset, size_t size)
+{
+	memset(&flash[offset], 0xff, size);
+	return size;
+}
+
+static const struct region_device_ops flash_ops = {
+	.mmap = flash_mmap,
+	.munmap = flash_munmap,
+	.readat = flash_readat,
+	.writeat = flash_writeat,
+	.eraseat = flash_eraseat,
+};
+
+static const struct region_device flash_rdev = REGION_DEV_INIT(&flash_ops, 0, STORE_SIZE);
+
+int fmap_locate_area(const char *name, struct region *r)
+{
+	r->offset = 0;
+	r->size = STORE_SIZE;
+	return 0;
+}
+
+int fmap_locate_area_as_rdev_rw(const char *name, struct region_device *area)
+{
+	return rdev_chain_full(area, &flash_rdev);
+}
+
+const struct region_device *boot_device_rw(void)
+{
+	return &flash_rdev;
+}
+
+int boot_device_ro_subregion(const struct region *sub, struct region_device *subrd)
+{
+	return rdev_chain(subrd, &flash_rdev, sub->offset, sub->size);
+}
+
+int boot_device_rw_subregion(const struct region *sub, struct region_device *subrd)
+{
+	return rdev_chain(subrd, &flash_rdev, sub->offset, sub->size);
+}
+
+static int setup_store(void **state)
+{
+	memset(flash, 0xff, sizeof(flash));
+	memset(&store_index, 0, sizeof(store_index));
+	return 0;
+}
+
+static void key_name(char *key, int i)
+{
+	snprintf(key, 16, "key-%d", i);
+}
+
+static void append(int key, uint8_t value, size_t value_sz)
+{
+	uint8_t buf[TEST_VALUE_SIZE];
+	char name[16];
+
+	key_name(name, key);
+	memset(buf, value, value_sz);
+	assert_int_equal(0, smmstore_append_data(name, strlen(name), buf, value_sz));
+}
+
+static void check_value(int key, uint8_t value, size_t value_sz)
+{
+	uint8_t buf[TEST_VALUE_SIZE];
+	uint32_t size = sizeof(buf);
+	char name[16];
+
+	key_name(name, key);
+	assert_int_equal(0, smmstore_lookup_data(name, strlen(name), buf, &size));
+	assert_int_equal(value_sz, size);
+	for (size_t i = 0; i < value_sz; i++)
+		assert_int_equal(value, buf[i]);
+}
+
+/* Find the latest value of a key the way a payload does it, by walking the whole log. */
+static int walk_log(const uint8_t *log, size_t size, int key, uint8_t *value)
+{
+	char name[16];
+	size_t offset = 0;
+	int found = 0;
+
+	key_name(name, key);
+	while (offset + 8 <= size) {
+		uint32_t k_sz, v_sz;
+
+		memcpy(&k_sz, &log[offset], sizeof(k_sz));
+		memcpy(&v_sz, &log[offset + 4], sizeof(v_sz));
+		if (k_sz == SMMSTORE_END_MARKER)
+			break;
+		if (log[offset + 8 + k_sz + v_sz] == 0 && k_sz == strlen(name) &&
+		    !memcmp(&log[offset + 8], name, k_sz)) {
+			*value = log[offset + 8 + k_sz];
+			found = 1;
+		}
+		offset = ALIGN_UP(offset + 8 + k_sz + v_sz + 1, 4);
+	}
+
+	return found;
+}
+
+static void test_smmstore_append_lookup(void **state)
+{
+	uint8_t buf[TEST_VALUE_SIZE];
+	uint32_t size;
+
+	for (int i = 0; i < TEST_KEYS; i++)
+		append(i, i, 10 + i);
+	append(3, 0xa5, 100);
+	append(5, 0x5a, 1);
+
+	for (int i = 0; i < TEST_KEYS; i++) {
+		if (i == 3)
+			check_value(i, 0xa5, 100);
+		else if (i == 5)
+			check_value(i, 0x5a, 1);
+		else
+			check_value(i, i, 10 + i);
+	}
+	assert_int_equal(TEST_KEYS, store_index.count);
+
+	/* A too small buffer only reports the size of the value. */
+	size = 10;
+	assert_int_equal(-1, smmstore_lookup_data("key-3", 5, buf, &size));
+	assert_int_equal(100, size);
+
+	/* Keys differing only in length or content don't match. */
+	size = sizeof(buf);
+	assert_int_equal(-1, smmstore_lookup_data("key-", 4, buf, &size));
+	assert_int_equal(-1, smmstore_lookup_data("key-9", 5, buf, &size));
+	assert_int_equal(-1, smmstore_lookup_data("key-10", 6, buf, &size));
+}
+
+static void test_smmstore_index_rebuild(void **state)
+{
+	for (int i = 0; i < TEST_KEYS; i++)
+		append(i, i, 20);
+
+	/* The index is rebuilt from flash, skipping entries that were never completed. */
+	memset(&store_index, 0, sizeof(store_index));
+	check_value(2, 2, 20);
+	assert_int_equal(TEST_KEYS, store_index.count);
+
+	const size_t end = store_index.end;
+	append(2, 0x22, 20);
+	flash[end + 8 + 5 + 20] = 0xff;
+	memset(&store_index, 0, sizeof(store_index));
+	check_value(2, 2, 20);
+
+	/* An entry appended behind the back of the index is picked up as well. */
+	const size_t next = store_index.end;
+	const uint32_t k_sz = 5, v_sz = 1;
+	memcpy(&flash[next], &k_sz, sizeof(k_sz));
+	memcpy(&flash[next + 4], &v_sz, sizeof(v_sz));
+	memcpy(&flash[next + 8], "key-7", 5);
+	flash[next + 13] = 0x77;
+	flash[next + 14] = 0;
+	check_value(7, 0x77, 1);
+}
+
+static void test_smmstore_compaction(void **state)
+{
+	uint8_t buf[STORE_HALF];
+	uint8_t last[TEST_KEYS];
+	ssize_t size;
+	uint8_t value;
+
+	/* Fill the first half several times over, which requires multiple compactions. */
+	for (int round = 0; round < 3 * STORE_HALF / TEST_VALUE_SIZE; round++) {
+		last[round % TEST_KEYS] = round;
+		append(round % TEST_KEYS, round, TEST_VALUE_SIZE);
+	}
+	assert_int_equal(STORE_HALF, store_index.limit);
+
+	size = sizeof(buf);
+	assert_int_equal(0, smmstore_read_region(buf, &size));
+	assert_int_equal(STORE_HALF, size);
+
+	for (int i = 0; i < TEST_KEYS; i++) {
+		check_value(i, last[i], TEST_VALUE_SIZE);
+
+		/* Reading the store returns the active log only. */
+		assert_true(walk_log(buf, size, i, &value));
+		assert_int_equal(last[i], value);
+	}
+
+	/* After a reboot the index finds the log in the same place. */
+	const size_t base = store_index.base;
+	memset(&store_index, 0, sizeof(store_index));
+	check_value(0, last[0], TEST_VALUE_SIZE);
+	assert_int_equal(base, store_index.base);
+}
+
+static void test_smmstore_interrupted_compaction(void **state)
+{
+	for (int i = 0; i < TEST_KEYS; i++)
+		append(i, i, 30);
+
+	/* A completed copy in the second half is used once the old log is invalidated. */
+	memcpy(&flash[STORE_HALF], &flash[0], 0x200);
+	memset(&store_index, 0, sizeof(store_index));
+	check_value(4, 4, 30);
+	assert_int_equal(0, store_index.base);
+
+	memset(&flash[0], 0xff, SMM_BLOCK_SIZE);
+	memset(&store_index, 0, sizeof(store_index));
+	check_value(4, 4, 30);
+	assert_int_equal(STORE_HALF, store_index.base);
+
+	/* A copy back into the first half that didn't get its first word written is ignored. */
+	memcpy(&flash[0], &flash[STORE_HALF], 0x200);
+	memset(&flash[0], 0xff, sizeof(uint32_t));
+	memset(&flash[0x100], 0xff, 0x100);
+	memset(&store_index, 0, sizeof(store_index));
+	check_value(7, 7, 30);
+	assert_int_equal(STORE_HALF, store_index.base);
+}
+
+static void test_smmstore_full_half_compaction(void **state)
+{
+	static uint8_t old_log[STORE_HALF];
+	const size_t value_sz = 512 - entry_size(5, 0);
+	struct region_device store;
+	int i;
+
+	/* A log filling the first half exactly has no end marker. */
+	for (i = 0; i < STORE_HALF / 512; i++)
+		append(i % TEST_KEYS, i, value_sz);
+	assert_int_equal(STORE_HALF, store_index.end);
+
+	/* Compaction wrote the copy, but a crash kept it from erasing the old log. */
+	memcpy(old_log, flash, STORE_HALF);
+	assert_int_equal(0, lookup_store(&store));
+	assert_int_equal(CB_SUCCESS, compact_store(&store));
+	memcpy(flash, old_log, STORE_HALF);
+
+	/* The copy isn't scanned as part of the old log, which can be compacted again. */
+	memset(&store_index, 0, sizeof(store_index));
+	check_value(3, i - TEST_KEYS + 3, value_sz);
+	assert_int_equal(0, store_index.base);
+	assert_int_equal(STORE_HALF, store_index.end);
+	assert_int_equal(STORE_HALF, store_index.limit);
+
+	append(3, 0x33, 10);
+	check_value(3, 0x33, 10);
+	check_value(4, i - TEST_KEYS + 4, value_sz);
+	assert_int_equal(STORE_HALF, store_index.base);
+}
+
+static void test_smmstore_legacy_log(void **state)
+{
+	uint8_t buf[TEST_VALUE_SIZE];
+	int i;
+
+	/* A log reaching into the second half keeps using the whole store. */
+	for (i = 0; i < STORE_HALF / TEST_VALUE_SIZE + 8; i++) {
+		store_index.limit = STORE_SIZE;
+		append(i % TEST_KEYS, i, TEST_VALUE_SIZE);
+	}
+	memset(&store_index, 0, sizeof(store_index));
+	check_value(0, (i - 1) / TEST_KEYS * TEST_KEYS & 0xff, TEST_VALUE_SIZE);
+	assert_int_equal(STORE_SIZE, store_index.limit);
+
+	/* It can't be compacted and needs a clear once full. */
+	memset(buf, 0, sizeof(buf));
+	while (smmstore_append_data("key-0", 5, buf, sizeof(buf)) == 0)
+		i++;
+	assert_true(i < STORE_SIZE / TEST_VALUE_SIZE);
+
+	assert_int_equal(0, smmstore_clear_region());
+	append(1, 0x11, 10);
+	check_value(1, 0x11, 10);
+	assert_int_equal(STORE_HALF, store_index.limit);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup(test_smmstore_append_lookup, setup_store),
+		cmocka_unit_test_setup(test_smmstore_index_rebuild, setup_store),
+		cmocka_unit_test_setup(test_smmstore_compaction, setup_store),
+		cmocka_unit_test_setup(test_smmstore_interrupted_compaction, setup_store),
+		cmocka_unit_test_setup(test_smmstore_full_half_compaction, setup_store),
+		cmocka_unit_test_setup(test_smmstore_legacy_log, setup_store),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,570 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <delay.h>
+#include <spi-generic.h>
+#include <spi_flash.h>
+#include <string.h>
+#include <tests/test.h>
+#include <timer.h>
+#include <types.h>
+
+#include "../drivers/spi/spi_flash_internal.h"
+
+#define SIM_SIZE		(16 * MiB)
+#define SIM_XFER_SIZE		4096
+#define TEST_READ_SIZE		(64 * KiB)
+#define CLOCKS_READ_SIZE	(256 * KiB)
+
+#define WINBOND_SR2_QE		(1 << 1)
+#define MACRONIX_SR_QE		(1 << 6)
+
+enum sim_vendor {
+	SIM_WINBOND,
+	SIM_MACRONIX,
+};
+
+enum sim_phase {
+	PHASE_OPCODE,
+	PHASE_ADDR,
+	PHASE_MODE,
+	PHASE_DUMMY,
+	PHASE_DATA_IN,
+	PHASE_DATA_OUT,
+	PHASE_NONE,
+};
+
+/*
+ * A SPI NOR flash that is clocked one SCLK cycle at a time. Every cycle the host either drives
+ * or samples 1, 2 or 4 of the IO lines, and the flash checks that this matches the phase of
+ * the current command, the same way a real part would only see garbage otherwise.
+ */
+static struct {
+	enum sim_vendor vendor;
+	uint8_t id[3];
+	uint8_t mem[SIM_SIZE];
+	/* Status registers, and their non-volatile values that are restored on power up. */
+	uint8_t sr1, sr2;
+	uint8_t sr1_nv, sr2_nv;
+	bool sr_locked;
+	bool wel, vwel;
+
+	bool selected;
+	enum sim_phase phase;
+	uint8_t opcode;
+	unsigned int width;
+	unsigned int data_width;
+	unsigned int addr_left;
+	unsigned int dummy_left;
+	bool has_mode;
+	uint32_t addr;
+	uint8_t shift;
+	unsigned int nbits;
+	uint8_t in[2];
+	size_t in_len;
+	size_t out_idx;
+
+	uint64_t clocks;
+	unsigned int errors;
+	uint8_t last_read;
+} sim;
+
+static void sim_error(const char *msg)
+{
+	print_message("flash sim: %s (opcode %#x, phase %d)\n", msg, sim.opcode, sim.phase);
+	sim.errors++;
+}
+
+static bool sim_qe(void)
+{
+	if (sim.vendor == SIM_MACRONIX)
+		return sim.sr1 & MACRONIX_SR_QE;
+	return sim.sr2 & WINBOND_SR2_QE;
+}
+
+static void sim_power_up(void)
+{
+	sim.sr1 = sim.sr1_nv;
+	sim.sr2 = sim.sr2_nv;
+	sim.wel = false;
+	sim.vwel = false;
+}
+
+static void sim_reset(enum sim_vendor vendor, uint8_t id0, uint8_t id1, uint8_t id2)
+{
+	uint32_t x = 0x12345678;
+
+	memset(&sim, 0, sizeof(sim));
+	sim.vendor = vendor;
+	sim.id[0] = id0;
+	sim.id[1] = id1;
+	sim.id[2] = id2;
+
+	for (size_t i = 0; i < SIM_SIZE; i++) {
+		x = x * 1103515245 + 12345;
+		sim.mem[i] = x >> 16;
+	}
+
+	sim_power_up();
+}
+
+static void sim_start_read(unsigned int addr_width, bool mode, unsigned int dummy_clocks,
+			   unsigned int data_width, bool quad)
+{
+	if (quad && !sim_qe())
+		sim_error("quad read while QE is clear, IO2/IO3 are WP#/HOLD#");
+
+	sim.phase = PHASE_ADDR;
+	sim.width = addr_width;
+	sim.addr_left = 3;
+	sim.addr = 0;
+	sim.has_mode = mode;
+	sim.dummy_left = dummy_clocks;
+	sim.data_width = data_width;
+	sim.last_read = sim.opcode;
+}
+
+static void sim_decode(uint8_t opcode)
+{
+	sim.opcode = opcode;
+	sim.phase = PHASE_NONE;
+
+	switch (opcode) {
+	case CMD_READ_ARRAY_SLOW:
+		sim_start_read(1, false, 0, 1, false);
+		break;
+	case CMD_READ_ARRAY_FAST:
+		sim_start_read(1, false, 8, 1, false);
+		break;
+	case CMD_READ_FAST_DUAL_OUTPUT:
+		sim_start_read(1, false, 8, 2, false);
+		break;
+	case CMD_READ_FAST_DUAL_IO:
+		sim_start_read(2, true, 0, 2, false);
+		break;
+	case CMD_READ_FAST_QUAD_OUTPUT:
+		sim_start_read(1, false, 8, 4, true);
+		break;
+	case CMD_READ_FAST_QUAD_IO:
+		sim_start_read(4, true, 4, 4, true);
+		break;
+	case CMD_READ_ID:
+	case CMD_READ_STATUS:
+		sim.phase = PHASE_DATA_OUT;
+		sim.width = 1;
+		break;
+	case 0x35: /* Read Status Register 2 */
+		if (sim.vendor != SIM_WINBOND)
+			sim_error("no status register 2");
+		sim.phase = PHASE_DATA_OUT;
+		sim.width = 1;
+		break;
+	case CMD_WRITE_ENABLE:
+		sim.wel = true;
+		break;
+	case 0x50: /* Write Enable for Volatile Status Register */
+		if (sim.vendor == SIM_WINBOND)
+			sim.vwel = true;
+		break;
+	case 0x01: /* Write Status Register */
+		sim.phase = PHASE_DATA_IN;
+		sim.width = 1;
+		break;
+	default:
+		sim_error("unknown opcode");
+	}
+}
+
+static void sim_after_addr(void)
+{
+	if (sim.has_mode) {
+		sim.phase = PHASE_MODE;
+	} else if (sim.dummy_left) {
+		sim.phase = PHASE_DUMMY;
+	} else {
+		sim.phase = PHASE_DATA_OUT;
+		sim.width = sim.data_width;
+	}
+}
+
+static void sim_byte_in(uint8_t b)
+{
+	switch (sim.phase) {
+	case PHASE_OPCODE:
+		sim_decode(b);
+		break;
+	case PHASE_ADDR:
+		sim.addr = sim.addr << 8 | b;
+		if (--sim.addr_left == 0)
+			sim_after_addr();
+		break;
+	case PHASE_MODE:
+		/* M5-4 = 10b keeps the part in continuous read mode, expecting no opcode. */
+		if ((b & 0x30) == 0x20)
+			sim_error("continuous read mode entered");
+		sim.has_mode = false;
+		sim_after_addr();
+		break;
+	case PHASE_DATA_IN:
+		if (sim.in_len < ARRAY_SIZE(sim.in))
+			sim.in[sim.in_len++] = b;
+		else
+			sim_error("too many status bytes");
+		break;
+	default:
+		sim_error("unexpected input");
+	}
+}
+
+static uint8_t sim_byte_out(void)
+{
+	switch (sim.opcode) {
+	case CMD_READ_ID:
+		return sim.out_idx < ARRAY_SIZE(sim.id) ? sim.id[sim.out_idx++] : 0;
+	case CMD_READ_STATUS:
+		return sim.sr1;
+	case 0x35:
+		return sim.sr2;
+	default:
+		return sim.mem[sim.addr++ % SIM_SIZE];
+	}
+}
+
+/* One SCLK cycle. Returns the bits the flash drives, if any. */
+static unsigned int sim_clock(unsigned int width, bool host_drives, unsigned int bits)
+{
+	const unsigned int mask = (1 << width) - 1;
+
+	if (!sim.selected) {
+		sim_error("clock without chip select");
+		return 0;
+	}
+
+	sim.clocks++;
+
+	switch (sim.phase) {
+	case PHASE_DUMMY:
+		if (--sim.dummy_left == 0) {
+			sim.phase = PHASE_DATA_OUT;
+			sim.width = sim.data_width;
+		}
+		return 0;
+	case PHASE_DATA_OUT:
+		if (host_drives || width != sim.width) {
+			sim_error("wrong bus mode while the flash drives");
+			return 0;
+		}
+		if (sim.nbits == 0) {
+			sim.shift = sim_byte_out();
+			sim.nbits = 8;
+		}
+		sim.nbits -= width;
+		return (sim.shift >> sim.nbits) & mask;
+	case PHASE_NONE:
+		sim_error("unexpected clock");
+		return 0;
+	default:
+		if (!host_drives || width != sim.width) {
+			sim_error("wrong bus mode while the flash samples");
+			return 0;
+		}
+		sim.shift = sim.shift << width | (bits & mask);
+		sim.nbits += width;
+		if (sim.nbits == 8) {
+			sim.nbits = 0;
+			sim_byte_in(sim.shift);
+		}
+		return 0;
+	}
+}
+
+static void sim_write_status(void)
+{
+	const bool nv = sim.wel;
+
+	if (!sim.wel && !sim.vwel)
+		return;
+
+	sim.wel = false;
+	sim.vwel = false;
+
+	if (sim.sr_locked || sim.in_len == 0)
+		return;
+
+	/* BUSY and WEL are read-only. */
+	sim.sr1 = (sim.sr1 & 0x03) | (sim.in[0] & ~0x03);
+	if (sim.in_len == 2)
+		sim.sr2 = sim.in[1];
+
+	/* Macronix parts have no volatile status register writes. */
+	if (nv || sim.vendor == SIM_MACRONIX) {
+		sim.sr1_nv = sim.sr1;
+		sim.sr2_nv = sim.sr2;
+	}
+}
+
+static void sim_select(void)
+{
+	if (sim.selected)
+		sim_error("chip select asserted twice");
+
+	sim.selected = true;
+	sim.phase = PHASE_OPCODE;
+	sim.width = 1;
+	sim.nbits = 0;
+	sim.in_len = 0;
+	sim.out_idx = 0;
+}
+
+static void sim_deselect(void)
+{
+	if (sim.nbits && sim.phase != PHASE_DATA_OUT)
+		sim_error("chip select released within a byte");
+
+	if (sim.phase == PHASE_ADDR || sim.phase == PHASE_MODE || sim.phase == PHASE_DUMMY)
+		sim_error("command incomplete");
+
+	if (sim.opcode == 0x01 && sim.phase == PHASE_DATA_IN)
+		sim_write_status();
+
+	sim.selected = false;
+}
+
+static void bus_out(unsigned int width, const uint8_t *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		for (int shift = 8 - width; shift >= 0; shift -= width)
+			sim_clock(width, true, buf[i] >> shift);
+}
+
+static void bus_in(unsigned int width, uint8_t *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		uint8_t b = 0;
+
+		for (unsigned int bits = 0; bits < 8; bits += width)
+			b = b << width | sim_clock(width, false, 0);
+		buf[i] = b;
+	}
+}
+
+static int bus_xfer(unsigned int width, const void *dout, size_t bytesout, void *din,
+		    size_t bytesin)
+{
+	/* Flash commands are half duplex. */
+	if (bytesout && bytesin)
+		return -1;
+
+	bus_out(width, dout, bytesout);
+	bus_in(width, din, bytesin);
+	return 0;
+}
+
+static int sim_claim_bus(const struct spi_slave *slave)
+{
+	sim_select();
+	return 0;
+}
+
+static void sim_release_bus(const struct spi_slave *slave)
+{
+	sim_deselect();
+}
+
+static int sim_xfer(const struct spi_slave *slave, const void *dout, size_t bytesout,
+		    void *din, size_t bytesin)
+{
+	return bus_xfer(1, dout, bytesout, din, bytesin);
+}
+
+static int sim_xfer_dual(const struct spi_slave *slave, const void *dout, size_t bytesout,
+			 void *din, size_t bytesin)
+{
+	return bus_xfer(2, dout, bytesout, din, bytesin);
+}
+
+static int sim_xfer_quad(const struct spi_slave *slave, const void *dout, size_t bytesout,
+			 void *din, size_t bytesin)
+{
+	return bus_xfer(4, dout, bytesout, din, bytesin);
+}
+
+static const struct spi_ctrlr quad_ctrlr = {
+	.claim_bus = sim_claim_bus,
+	.release_bus = sim_release_bus,
+	.xfer = sim_xfer,
+	.xfer_dual = sim_xfer_dual,
+	.xfer_quad = sim_xfer_quad,
+	.max_xfer_size = SIM_XFER_SIZE,
+};
+
+static const struct spi_ctrlr dual_ctrlr = {
+	.claim_bus = sim_claim_bus,
+	.release_bus = sim_release_bus,
+	.xfer = sim_xfer,
+	.xfer_dual = sim_xfer_dual,
+	.max_xfer_size = SIM_XFER_SIZE,
+};
+
+static const struct spi_ctrlr single_ctrlr = {
+	.claim_bus = sim_claim_bus,
+	.release_bus = sim_release_bus,
+	.xfer = sim_xfer,
+	.max_xfer_size = SIM_XFER_SIZE,
+};
+
+enum {
+	BUS_QUAD,
+	BUS_DUAL,
+	BUS_SINGLE,
+};
+
+const struct spi_ctrlr_buses spi_ctrlr_bus_map[] = {
+	{ .ctrlr = &quad_ctrlr, .bus_start = BUS_QUAD, .bus_end = BUS_QUAD },
+	{ .ctrlr = &dual_ctrlr, .bus_start = BUS_DUAL, .bus_end = BUS_DUAL },
+	{ .ctrlr = &single_ctrlr, .bus_start = BUS_SINGLE, .bus_end = BUS_SINGLE },
+};
+
+const size_t spi_ctrlr_bus_map_count = ARRAY_SIZE(spi_ctrlr_bus_map);
+
+void timer_monotonic_get(struct mono_time *mt)
+{
+	mt->microseconds = 0;
+}
+
+void udelay(unsigned int usecs)
+{
+}
+
+static void read_and_check(const struct spi_flash *flash, uint32_t offset, size_t size)
+{
+	uint8_t *buf = test_malloc(size);
+
+	assert_int_equal(0, spi_flash_read(flash, offset, size, buf));
+	assert_memory_equal(&sim.mem[offset], buf, size);
+	assert_int_equal(0, sim.errors);
+
+	test_free(buf);
+}
+
+static void test_winbond_quad_io(void **state)
+{
+	struct spi_flash flash;
+
+	/* W25Q128_V */
+	sim_reset(SIM_WINBOND, 0xef, 0x40, 0x18);
+	assert_int_equal(0, spi_flash_probe(BUS_QUAD, 0, &flash));
+	assert_true(flash.flags.quad_io);
+	assert_true(flash.flags.quad_output);
+
+	/* QE is only set in the volatile status register. */
+	assert_true(sim.sr2 & WINBOND_SR2_QE);
+	assert_false(sim.sr2_nv & WINBOND_SR2_QE);
+
+	read_and_check(&flash, 0x123457, TEST_READ_SIZE);
+	assert_int_equal(CMD_READ_FAST_QUAD_IO, sim.last_read);
+
+	/* It is set again after a power cycle. */
+	sim_power_up();
+	assert_false(sim_qe());
+	assert_int_equal(0, spi_flash_probe(BUS_QUAD, 0, &flash));
+	read_and_check(&flash, 0, TEST_READ_SIZE);
+	assert_int_equal(CMD_READ_FAST_QUAD_IO, sim.last_read);
+
+	/* Quad Output is used on parts without Quad I/O. */
+	flash.flags.quad_io = 0;
+	read_and_check(&flash, SIM_SIZE - TEST_READ_SIZE, TEST_READ_SIZE);
+	assert_int_equal(CMD_READ_FAST_QUAD_OUTPUT, sim.last_read);
+}
+
+static void test_macronix_quad_io(void **state)
+{
+	struct spi_flash flash;
+
+	/* MX25U12835F */
+	sim_reset(SIM_MACRONIX, 0xc2, 0x25, 0x38);
+	sim.sr1_nv = 0x3c;
+	sim_power_up();
+	assert_int_equal(0, spi_flash_probe(BUS_QUAD, 0, &flash));
+	assert_true(flash.flags.quad_io);
+	assert_false(flash.flags.quad_output);
+
+	/* Macronix only has a non-volatile QE bit, the other bits are left alone. */
+	assert_int_equal(0x3c | MACRONIX_SR_QE, sim.sr1_nv);
+
+	read_and_check(&flash, 0x800001, TEST_READ_SIZE);
+	assert_int_equal(CMD_READ_FAST_QUAD_IO, sim.last_read);
+}
+
+static void test_quad_fallback(void **state)
+{
+	struct spi_flash flash;
+
+	/* Without quad support in the controller, QE and with it WP# are left alone. */
+	sim_reset(SIM_WINBOND, 0xef, 0x40, 0x18);
+	assert_int_equal(0, spi_flash_probe(BUS_DUAL, 0, &flash));
+	assert_false(flash.flags.quad_io);
+	assert_false(flash.flags.quad_output);
+	assert_false(sim_qe());
+	read_and_check(&flash, 0x1000, TEST_READ_SIZE);
+	assert_int_equal(CMD_READ_FAST_DUAL_IO, sim.last_read);
+
+	assert_int_equal(0, spi_flash_probe(BUS_SINGLE, 0, &flash));
+	read_and_check(&flash, 0x1000, TEST_READ_SIZE);
+	assert_int_equal(CMD_READ_ARRAY_FAST, sim.last_read);
+
+	/* A locked status register means QE can't be set, so the dual reads are used. */
+	sim.sr_locked = true;
+	assert_int_equal(0, spi_flash_probe(BUS_QUAD, 0, &flash));
+	assert_false(flash.flags.quad_io);
+	assert_false(sim_qe());
+	read_and_check(&flash, 0x1000, TEST_READ_SIZE);
+	assert_int_equal(CMD_READ_FAST_DUAL_IO, sim.last_read);
+}
+
+/* Returns the SCLK cycles a read takes with the command selected for flash. */
+static uint64_t read_clocks(const struct spi_flash *flash, uint8_t cmd)
+{
+	const uint64_t start = sim.clocks;
+
+	read_and_check(flash, 0, CLOCKS_READ_SIZE);
+	assert_int_equal(cmd, sim.last_read);
+
+	return sim.clocks - start;
+}
+
+/* Bus cycles are what a read costs on hardware, so every wider read has to take fewer. */
+static void test_read_clocks(void **state)
+{
+	struct spi_flash flash;
+	uint64_t quad_io, quad_output, dual_io, dual_output, fast;
+
+	sim_reset(SIM_WINBOND, 0xef, 0x40, 0x18);
+	assert_int_equal(0, spi_flash_probe(BUS_QUAD, 0, &flash));
+	quad_io = read_clocks(&flash, CMD_READ_FAST_QUAD_IO);
+	flash.flags.quad_io = 0;
+	quad_output = read_clocks(&flash, CMD_READ_FAST_QUAD_OUTPUT);
+	flash.flags.quad_output = 0;
+	dual_io = read_clocks(&flash, CMD_READ_FAST_DUAL_IO);
+	flash.flags.dual_io = 0;
+	dual_output = read_clocks(&flash, CMD_READ_FAST_DUAL_OUTPUT);
+	flash.flags.dual_output = 0;
+	fast = read_clocks(&flash, CMD_READ_ARRAY_FAST);
+
+	assert_true(quad_io < quad_output);
+	assert_true(quad_output < dual_io);
+	assert_true(dual_io < dual_output);
+	assert_true(dual_output < fast);
+	assert_true(quad_io * 3 < fast);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_winbond_quad_io),
+		cmocka_unit_test(test_macronix_quad_io),
+		cmocka_unit_test(test_quad_fallback),
+		cmocka_unit_test(test_read_clocks),
+	};
+
+	return cb_run_group_tests(tests, NULL, NULL);
+}
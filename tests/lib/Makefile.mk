@@ -61,6 +61,7 @@ timestamp-test-srcs += tests/lib/timestamp-test.c
 timestamp-test-srcs += tests/stubs/timestamp.c
 timestamp-test-srcs += tests/stubs/console.c
 timestamp-test-stage := romstage
+timestamp-test-config += CONFIG_TIMESTAMP_SPANS=1 CONFIG_TIMESTAMP_MAX_SPANS=4
 
 edid-test-srcs += tests/lib/edid-test.c
 edid-test-srcs += src/lib/edid.c
@@ -128,6 +128,51 @@ static void test_ulzman_correct_file(void **state)
 	test_free(comp_buf);
 }
 
+struct lzma_test_media {
+	const uint8_t *data;
+	size_t next_offset;
+	size_t reads;
+};
+
+static size_t lzma_test_media_read(void *arg, size_t offset, void *buf, size_t size)
+{
+	struct lzma_test_media *media = arg;
+
+	assert_int_equal(offset, media->next_offset);
+	memcpy(buf, media->data + offset, size);
+	media->next_offset += size;
+	media->reads++;
+
+	return size;
+}
+
+static void test_ulzman_stream_correct_file(void **state)
+{
+	struct lzma_test_state *s = *state;
+	uint8_t *raw_buf = test_malloc(s->raw_file_sz);
+	uint8_t *decomp_buf = test_malloc(s->raw_file_sz);
+	uint8_t *comp_buf = test_malloc(s->comp_file_sz);
+	uint8_t scratch[1 * KiB];
+	struct lzma_test_media media = { .data = comp_buf };
+
+	assert_non_null(raw_buf);
+	assert_non_null(decomp_buf);
+	assert_non_null(comp_buf);
+	assert_int_equal(s->raw_file_sz, read_file(s->raw_filename, raw_buf, s->raw_file_sz));
+	assert_int_equal(s->comp_file_sz,
+			 read_file(s->comp_filename, comp_buf, s->comp_file_sz));
+
+	assert_int_equal(s->raw_file_sz,
+			 ulzman_stream(lzma_test_media_read, &media, s->comp_file_sz,
+				       decomp_buf, s->raw_file_sz, scratch, sizeof(scratch)));
+	assert_memory_equal(raw_buf, decomp_buf, s->raw_file_sz);
+	assert_true(media.reads > s->comp_file_sz / sizeof(scratch));
+
+	test_free(raw_buf);
+	test_free(decomp_buf);
+	test_free(comp_buf);
+}
+
 static void test_ulzman_input_too_small(void **state)
 {
 	uint8_t in_buf[32] = {0};
@@ -154,6 +199,14 @@ static void test_ulzman_zero_buffer(void **state)
 		.teardown_func = teardown_ulzman_file, .initial_state = (_file_prefix)         \
 	}
 
+#define ULZMAN_STREAM_CORRECT_FILE_TEST(_file_prefix)                                          \
+	{                                                                                      \
+		.name = "test_ulzman_stream_correct_file(" _file_prefix ")",                   \
+		.test_func = test_ulzman_stream_correct_file,                                  \
+		.setup_func = setup_ulzman_file, .teardown_func = teardown_ulzman_file,        \
+		.initial_state = (_file_prefix)                                                \
+	}
+
 int main(void)
 {
 	const struct CMUnitTest tests[] = {
@@ -179,6 +232,12 @@ int main(void)
 		   Another binary file, shared object. */
 		ULZMAN_CORRECT_FILE_TEST("data.4"),
 
+		/* Same files, decompressed from a mock boot device through a small buffer. */
+		ULZMAN_STREAM_CORRECT_FILE_TEST("data.1"),
+		ULZMAN_STREAM_CORRECT_FILE_TEST("data.2"),
+		ULZMAN_STREAM_CORRECT_FILE_TEST("data.3"),
+		ULZMAN_STREAM_CORRECT_FILE_TEST("data.4"),
+
 		cmocka_unit_test(test_ulzman_input_too_small),
 
 		cmocka_unit_test(test_ulzman_zero_buffer),
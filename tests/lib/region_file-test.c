@@ -289,6 +289,36 @@ static void test_region_file_update_data_arr(void **state)
 	assert_memory_equal(&dummy_data[data3_offset], &output_buffer[data2_size], data3_size);
 }
 
+static void test_region_file_update_fits(void **state)
+{
+	struct region_device *rdev = *state;
+	struct region_file regf;
+	const size_t data_size = REGION_FILE_BUFFER_SIZE / 4;
+	uint8_t *data = test_malloc(data_size);
+	int i;
+
+	memset(data, 0xa5, data_size);
+	assert_int_equal(0, region_file_init(&regf, rdev));
+
+	/* An empty region file is erased before the first update. */
+	assert_int_equal(0, region_file_update_fits(&regf, 16));
+
+	assert_int_equal(0, region_file_update_data(&regf, data, data_size));
+
+	/* Append updates until the region is full, without emptying it in between. */
+	for (i = 0; region_file_update_fits(&regf, data_size); i++)
+		assert_int_equal(0, region_file_update_data(&regf, data, data_size));
+	assert_true(i > 0);
+	assert_int_equal(1, region_file_update_fits(&regf, 16));
+	assert_int_equal(0, region_file_update_fits(&regf, REGION_FILE_BUFFER_SIZE));
+
+	/* The next update of this size empties the region and starts over. */
+	assert_int_equal(0, region_file_update_data(&regf, data, data_size));
+	assert_int_equal(1, regf.slot);
+
+	test_free(data);
+}
+
 int main(void)
 {
 	const struct CMUnitTest tests[] = {
@@ -322,6 +352,9 @@ int main(void)
 		cmocka_unit_test_setup_teardown(test_region_file_update_data_arr,
 						setup_teardown_region_file_test,
 						setup_teardown_region_file_test),
+		cmocka_unit_test_setup_teardown(test_region_file_update_fits,
+						setup_teardown_region_file_test,
+						setup_teardown_region_file_test),
 	};
 
 	return cb_run_group_tests(tests, setup_region_file_test_group,
@@ -96,6 +96,61 @@ void test_timestamp_rescale_table(void **state)
 				 glob_ts_table->entries[i].entry_stamp);
 }
 
+void test_timestamp_spans(void **state)
+{
+	const int timestamp_base = 1000;
+	const char long_name[] = "a name that is way longer than a span name can be";
+	static u8 span_buf[sizeof(struct timestamp_span_table) + 4 * sizeof(struct timestamp_span)];
+	struct timestamp_span_table *spans = (void *)span_buf;
+	int outer, inner, other;
+
+	timestamp_init(timestamp_base);
+	spans->max_spans = 4;
+	spans->num_spans = 0;
+	/* There is a need to set this manually, because cbmem hooks are not used. */
+	glob_span_table = spans;
+
+	dummy_timestamp_set(2000);
+	outer = timestamp_span_begin(TS_SPAN_BOOT_STATE, 0, "BS_DEV_INIT");
+	dummy_timestamp_set(3000);
+	inner = timestamp_span_begin(TS_SPAN_DEVICE_INIT, 0, long_name);
+	dummy_timestamp_set(4000);
+	timestamp_span_end(inner);
+	dummy_timestamp_set(5000);
+	timestamp_span_end(outer);
+	other = timestamp_span_begin(TS_SPAN_GENERIC, TS_ROMSTAGE_START, NULL);
+
+	assert_int_equal(1, outer);
+	assert_int_equal(2, inner);
+	assert_int_equal(3, other);
+	assert_int_equal(3, spans->num_spans);
+
+	assert_int_equal(0, spans->spans[0].parent);
+	assert_int_equal(TS_SPAN_BOOT_STATE, spans->spans[0].kind);
+	assert_int_equal(2000 - timestamp_base, spans->spans[0].start);
+	assert_int_equal(5000 - timestamp_base, spans->spans[0].end);
+	assert_string_equal("BS_DEV_INIT", spans->spans[0].name);
+
+	assert_int_equal(outer, spans->spans[1].parent);
+	assert_int_equal(3000 - timestamp_base, spans->spans[1].start);
+	assert_int_equal(4000 - timestamp_base, spans->spans[1].end);
+	assert_memory_equal(long_name, spans->spans[1].name, TIMESTAMP_SPAN_NAME_LEN);
+
+	/* The third span is still open and must not be nested in the closed ones. */
+	assert_int_equal(0, spans->spans[2].parent);
+	assert_int_equal(TS_ROMSTAGE_START, spans->spans[2].id);
+	assert_true(spans->spans[2].end < spans->spans[2].start);
+
+	/* Once the table is full, spans are dropped and their handles are ignored. */
+	assert_int_equal(4, timestamp_span_begin(TS_SPAN_GENERIC, 0, "last"));
+	assert_int_equal(0, timestamp_span_begin(TS_SPAN_GENERIC, 0, "dropped"));
+	timestamp_span_end(0);
+	assert_int_equal(4, spans->num_spans);
+
+	glob_span_table = NULL;
+	span_current[0] = 0;
+}
+
 void test_get_us_since_boot(void **state)
 {
 	const int base_multipler = 10000;
@@ -127,6 +182,9 @@ int main(void)
 		cmocka_unit_test_setup(test_timestamp_add_now, setup_timestamp_and_freq),
 		cmocka_unit_test_setup(test_timestamp_rescale_table, setup_timestamp_and_freq),
 		cmocka_unit_test_setup(test_get_us_since_boot, setup_timestamp_and_freq),
+#if CONFIG(TIMESTAMP_SPANS)
+		cmocka_unit_test_setup(test_timestamp_spans, setup_timestamp_and_freq),
+#endif
 	};
 
 #if CONFIG(COLLECT_TIMESTAMPS)
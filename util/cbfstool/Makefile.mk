@@ -12,6 +12,8 @@ compressionobj += lzma.o
 compressionobj += LzFind.o
 compressionobj += LzmaDec.o
 compressionobj += LzmaEnc.o
+# ZSTD (compression needs the host libzstd)
+compressionobj += zstd_decompress.o
 
 cbfsobj :=
 cbfsobj += cbfstool.o
@@ -24,6 +26,7 @@ cbfsobj += rmodule.o
 cbfsobj += xdr.o
 cbfsobj += partitioned_file.o
 cbfsobj += platform_fixups.o
+cbfsobj += parallel.o
 # COMMONLIB
 cbfsobj += cbfs_private.o
 cbfsobj += fsp_relocate.o
@@ -72,6 +75,7 @@ ifitobj += partitioned_file.o
 ifitobj += cbfs-mkstage.o
 ifitobj += cbfs-mkpayload.o
 ifitobj += rmodule.o
+ifitobj += parallel.o
 # FMAP
 ifitobj += fmap.o
 ifitobj += kv_pair.o
@@ -135,6 +139,20 @@ TOOLCPPFLAGS += -I$(top)/src/vendorcode/intel/edk2/uefi_2.4/MdePkg/Include
 
 TOOLLDFLAGS ?=
 
+# zstd compression uses the host libzstd. Its output can change between libzstd
+# versions, so images are only reproducible when built against the same one.
+ZSTD_MIN_VERSION := 1.4.0
+HOSTPKGCONFIG ?= pkg-config
+ifeq ($(shell $(HOSTPKGCONFIG) --atleast-version=$(ZSTD_MIN_VERSION) libzstd 2>/dev/null && echo y),y)
+TOOLCPPFLAGS += -DHAVE_LIBZSTD $(shell $(HOSTPKGCONFIG) --cflags libzstd)
+ZSTD_LIBS := $(shell $(HOSTPKGCONFIG) --libs libzstd)
+else ifeq ($(CONFIG_ZSTD),y)
+$(error zstd compression requires libzstd $(ZSTD_MIN_VERSION) or newer, found through $(HOSTPKGCONFIG))
+endif
+
+# parallel.c runs compression and hashing on POSIX threads
+THREAD_LIBS ?= -pthread
+
 ifeq ($(shell uname -s | cut -c-7 2>/dev/null), MINGW32)
 HOSTCFLAGS += -fms-extensions
 TOOLCFLAGS += -mno-ms-bitfields
@@ -203,7 +221,7 @@ $(objutil)/cbfstool/%.o: $(top)/util/cbfstool/bpdt_formats/%.c
 
 $(objutil)/cbfstool/cbfstool: $(addprefix $(objutil)/cbfstool/,$(cbfsobj)) $(VBOOT_HOSTLIB)
 	printf "    HOSTCC     $(subst $(objutil)/,,$(@)) (link)\n"
-	$(HOSTCC) -v $(TOOLLDFLAGS) -o $@ $(addprefix $(objutil)/cbfstool/,$(cbfsobj)) $(VBOOT_HOSTLIB)
+	$(HOSTCC) -v $(TOOLLDFLAGS) -o $@ $(addprefix $(objutil)/cbfstool/,$(cbfsobj)) $(VBOOT_HOSTLIB) $(ZSTD_LIBS) $(THREAD_LIBS)
 
 $(objutil)/cbfstool/fmaptool: $(addprefix $(objutil)/cbfstool/,$(fmapobj))
 	printf "    HOSTCC     $(subst $(objutil)/,,$(@)) (link)\n"
@@ -219,11 +237,11 @@ $(objutil)/cbfstool/ifwitool: $(addprefix $(objutil)/cbfstool/,$(ifwiobj))
 
 $(objutil)/cbfstool/ifittool: $(addprefix $(objutil)/cbfstool/,$(ifitobj)) $(VBOOT_HOSTLIB)
 	printf "    HOSTCC     $(subst $(objutil)/,,$(@)) (link)\n"
-	$(HOSTCC) $(TOOLLDFLAGS) -o $@ $(addprefix $(objutil)/cbfstool/,$(ifitobj)) $(VBOOT_HOSTLIB)
+	$(HOSTCC) $(TOOLLDFLAGS) -o $@ $(addprefix $(objutil)/cbfstool/,$(ifitobj)) $(VBOOT_HOSTLIB) $(ZSTD_LIBS) $(THREAD_LIBS)
 
 $(objutil)/cbfstool/cbfs-compression-tool: $(addprefix $(objutil)/cbfstool/,$(cbfscompobj))
 	printf "    HOSTCC     $(subst $(objutil)/,,$(@)) (link)\n"
-	$(HOSTCC) $(TOOLLDFLAGS) -o $@ $(addprefix $(objutil)/cbfstool/,$(cbfscompobj))
+	$(HOSTCC) $(TOOLLDFLAGS) -o $@ $(addprefix $(objutil)/cbfstool/,$(cbfscompobj)) $(ZSTD_LIBS)
 
 $(objutil)/cbfstool/amdcompress: $(addprefix $(objutil)/cbfstool/,$(amdcompobj))
 	printf "    HOSTCC     $(subst $(objutil)/,,$(@)) (link)\n"
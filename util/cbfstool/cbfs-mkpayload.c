@@ -50,6 +50,28 @@ void xdr_get_seg(struct cbfs_payload_segment *out,
 	out->mem_len = xdr_be.get32(&inheader);
 }
 
+/* One loadable segment to be compressed on its own, possibly on another thread. */
+struct segment_compression {
+	comp_func_ptr compress;
+	char *in;
+	int in_len;
+	char *out;
+	int out_len;
+	int ret;
+};
+
+static void compress_segment(void *arg, size_t i)
+{
+	struct segment_compression *c = &((struct segment_compression *)arg)[i];
+
+	c->out = malloc(c->in_len);
+	if (!c->out) {
+		c->ret = -1;
+		return;
+	}
+	c->ret = c->compress(c->in, c->in_len, c->out, &c->out_len);
+}
+
 int parse_elf_to_payload(const struct buffer *input, struct buffer *output,
 			 enum cbfs_compression algo)
 {
@@ -63,6 +85,8 @@ int parse_elf_to_payload(const struct buffer *input, struct buffer *output,
 	int isize = 0, osize = 0;
 	int doffset = 0;
 	struct cbfs_payload_segment *segs = NULL;
+	struct segment_compression *comp = NULL;
+	int ncomp = 0, next_comp = 0;
 	int i;
 	int ret = 0;
 
@@ -115,6 +139,25 @@ int parse_elf_to_payload(const struct buffer *input, struct buffer *output,
 
 		segments++;
 	}
+
+	/* Segments don't depend on each other, so compress them all at once
+	   before putting them in order below. */
+	comp = calloc(headers, sizeof(*comp));
+	if (comp == NULL) {
+		ret = -1;
+		goto out;
+	}
+	for (i = 0; i < headers; i++) {
+		if (phdr[i].p_type != PT_LOAD || phdr[i].p_memsz == 0 ||
+		    phdr[i].p_filesz == 0)
+			continue;
+		comp[ncomp].compress = compress;
+		comp[ncomp].in = &header[phdr[i].p_offset];
+		comp[ncomp].in_len = phdr[i].p_filesz;
+		ncomp++;
+	}
+	parallel_run(ncomp, compress_segment, comp);
+
 	/* Allocate and initialize the segment header array */
 	segs = calloc(segments, sizeof(*segs));
 	if (segs == NULL) {
@@ -194,10 +237,8 @@ int parse_elf_to_payload(const struct buffer *input, struct buffer *output,
 		/* If the compression failed or made the section is larger,
 		   use the original stuff */
 
-		int len;
-		if (compress((char *)&header[phdr[i].p_offset],
-			     phdr[i].p_filesz, output->data + doffset, &len) ||
-		    (unsigned int)len > phdr[i].p_filesz) {
+		struct segment_compression *c = &comp[next_comp++];
+		if (c->ret || (unsigned int)c->out_len > phdr[i].p_filesz) {
 			WARN("Compression failed or would make the data bigger "
 			     "- disabled.\n");
 			segs[segments].compression = 0;
@@ -206,7 +247,8 @@ int parse_elf_to_payload(const struct buffer *input, struct buffer *output,
 			       &header[phdr[i].p_offset], phdr[i].p_filesz);
 		} else {
 			segs[segments].compression = algo;
-			segs[segments].len = len;
+			segs[segments].len = c->out_len;
+			memcpy(output->data + doffset, c->out, c->out_len);
 		}
 
 		doffset += segs[segments].len;
@@ -222,6 +264,11 @@ int parse_elf_to_payload(const struct buffer *input, struct buffer *output,
 	xdr_segs(output, segs, segments);
 
 out:
+	if (comp) {
+		for (i = 0; i < ncomp; i++)
+			free(comp[i].out);
+		free(comp);
+	}
 	if (segs) free(segs);
 	if (shdr) free(shdr);
 	if (phdr) free(phdr);
@@ -1416,6 +1416,98 @@ static int cbfs_print_decoded_payload_segment_info(
 	return 0;
 }
 
+/* Results of cbfs_check_file_hashes(), in the order of the image. */
+struct file_hash_check {
+	const void *data;
+	size_t len;
+	const struct vb2_hash *hash;
+	bool valid;
+};
+
+static struct file_hash_check *file_hash_checks;
+static size_t file_hash_checks_count;
+static size_t file_hash_checks_next;
+
+static int count_file_hashes(unused struct cbfs_image *image,
+			     struct cbfs_file *entry, void *arg)
+{
+	struct cbfs_file_attr_hash *attr = NULL;
+	size_t *count = arg;
+
+	while ((attr = cbfs_file_get_next_hash(entry, attr)) != NULL)
+		(*count)++;
+	return 0;
+}
+
+static int collect_file_hashes(unused struct cbfs_image *image,
+			       struct cbfs_file *entry, unused void *arg)
+{
+	struct cbfs_file_attr_hash *attr = NULL;
+
+	while ((attr = cbfs_file_get_next_hash(entry, attr)) != NULL) {
+		struct file_hash_check *check =
+			&file_hash_checks[file_hash_checks_count++];
+		check->data = CBFS_SUBHEADER(entry);
+		check->len = be32toh(entry->len);
+		check->hash = &attr->hash;
+	}
+	return 0;
+}
+
+static void check_file_hash(unused void *arg, size_t i)
+{
+	struct file_hash_check *check = &file_hash_checks[i];
+
+	check->valid = vb2_digest_size(check->hash->algo) &&
+		vb2_hash_verify(false, check->data, check->len,
+				check->hash) == VB2_SUCCESS;
+}
+
+void cbfs_check_file_hashes(struct cbfs_image *image)
+{
+	size_t count = 0;
+
+	cbfs_drop_file_hash_checks();
+	cbfs_legacy_walk(image, count_file_hashes, &count);
+	if (!count)
+		return;
+
+	file_hash_checks = calloc(count, sizeof(*file_hash_checks));
+	if (!file_hash_checks)
+		return;
+	cbfs_legacy_walk(image, collect_file_hashes, NULL);
+	parallel_run(file_hash_checks_count, check_file_hash, NULL);
+}
+
+void cbfs_drop_file_hash_checks(void)
+{
+	free(file_hash_checks);
+	file_hash_checks = NULL;
+	file_hash_checks_count = 0;
+	file_hash_checks_next = 0;
+}
+
+bool cbfs_file_hash_valid(const void *data, size_t len,
+			  const struct vb2_hash *hash)
+{
+	/* Lookups come in image order, so start after the last match. */
+	for (size_t n = 0; n < file_hash_checks_count; n++) {
+		size_t i = (file_hash_checks_next + n) % file_hash_checks_count;
+		const struct file_hash_check *check = &file_hash_checks[i];
+
+		if (check->data != data || check->len != len ||
+		    check->hash->algo != hash->algo ||
+		    memcmp(check->hash->raw, hash->raw,
+			   vb2_digest_size(hash->algo)))
+			continue;
+
+		file_hash_checks_next = i + 1;
+		return check->valid;
+	}
+
+	return vb2_hash_verify(false, data, len, hash) == VB2_SUCCESS;
+}
+
 int cbfs_print_entry_info(struct cbfs_image *image, struct cbfs_file *entry,
 			  void *arg)
 {
@@ -1467,8 +1559,8 @@ int cbfs_print_entry_info(struct cbfs_image *image, struct cbfs_file *entry,
 			break;
 		}
 		char *hash_str = bintohex(attr->hash.raw, hash_len);
-		int valid = vb2_hash_verify(false, CBFS_SUBHEADER(entry),
-			be32toh(entry->len), &attr->hash) == VB2_SUCCESS;
+		int valid = cbfs_file_hash_valid(CBFS_SUBHEADER(entry),
+			be32toh(entry->len), &attr->hash);
 		const char *valid_str = valid ? "valid" : "invalid";
 
 		fprintf(fp, "    hash %s:%s %s\n",
@@ -1581,8 +1673,8 @@ static int cbfs_print_parseable_entry_info(struct cbfs_image *image,
 			if (!hash_len)
 				continue;
 			char *hash_str = bintohex(attr->hash.raw, hash_len);
-			int valid = vb2_hash_verify(false, CBFS_SUBHEADER(entry),
-				be32toh(entry->len), &attr->hash) == VB2_SUCCESS;
+			int valid = cbfs_file_hash_valid(CBFS_SUBHEADER(entry),
+				be32toh(entry->len), &attr->hash);
 			fprintf(fp, "%shash:%s:%s:%s", sep,
 				vb2_get_hash_algorithm_name(attr->hash.algo),
 				hash_str, valid ? "valid" : "invalid");
@@ -164,6 +164,16 @@ int cbfs_is_legacy_cbfs(struct cbfs_image *image);
 /* Returns 1 if entry has valid data (by checking magic number), otherwise 0. */
 int cbfs_is_valid_entry(struct cbfs_image *image, struct cbfs_file *entry);
 
+/* Verifies the hashes of all files in the image up front, spreading the work
+ * over several threads. Until cbfs_drop_file_hash_checks() is called, the
+ * results are used by cbfs_file_hash_valid() instead of hashing again. */
+void cbfs_check_file_hashes(struct cbfs_image *image);
+void cbfs_drop_file_hash_checks(void);
+
+/* Returns true if len bytes at data match hash. */
+bool cbfs_file_hash_valid(const void *data, size_t len,
+			  const struct vb2_hash *hash);
+
 /* Print CBFS component information. */
 void cbfs_print_directory(struct cbfs_image *image);
 void cbfs_print_parseable_directory(struct cbfs_image *image);
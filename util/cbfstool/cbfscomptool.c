@@ -50,10 +50,8 @@ static int benchmark(void)
 		printf("measuring '%s'\n", algo->name);
 		comp_func_ptr comp = compression_function(algo->type);
 		if (comp == NULL) {
-			printf("no handler associated with algorithm\n");
-			free(data);
-			free(compressed_data);
-			return 1;
+			printf("no handler associated with algorithm, skipping\n");
+			continue;
 		}
 
 		struct timespec t_s, t_e;
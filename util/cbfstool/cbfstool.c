@@ -135,14 +135,34 @@ struct mh_cache {
 	bool initialized;
 };
 
+static struct mh_cache mh_cache;
+
+/* File data of an "add" command in a batch, compressed before the command runs. */
+struct batch_compressed {
+	struct buffer input;
+	uint32_t compression;
+	char *data;
+	int size;
+};
+
+/*
+ * State of a "batch" run, which executes many commands against one in-memory
+ * image. The CBFS metadata hash is only updated once at the end instead of after
+ * every command.
+ */
+static struct {
+	bool active;
+	bool metadata_hash_dirty;
+	/* Compressed data prepared for the running command, if any. */
+	struct batch_compressed *compressed;
+} batch;
+
 static struct mh_cache *get_mh_cache(void)
 {
-	static struct mh_cache mhc;
-
-	if (mhc.initialized)
-		return &mhc;
+	if (mh_cache.initialized)
+		return &mh_cache;
 
-	mhc.initialized = true;
+	mh_cache.initialized = true;
 
 	const struct fmap *fmap = partitioned_file_get_fmap(param.image_file);
 	if (!fmap)
@@ -156,7 +176,7 @@ static struct mh_cache *get_mh_cache(void)
 		if (!partitioned_file_read_region(&buffer, param.image_file,
 						  SECTION_NAME_BOOTBLOCK))
 			goto no_metadata_hash;
-		mhc.region = SECTION_NAME_BOOTBLOCK;
+		mh_cache.region = SECTION_NAME_BOOTBLOCK;
 		offset = 0;
 		size = buffer.size;
 	} else {
@@ -165,7 +185,7 @@ static struct mh_cache *get_mh_cache(void)
 		if (!partitioned_file_read_region(&buffer, param.image_file,
 						  SECTION_NAME_PRIMARY_CBFS))
 			goto no_metadata_hash;
-		mhc.region = SECTION_NAME_PRIMARY_CBFS;
+		mh_cache.region = SECTION_NAME_PRIMARY_CBFS;
 		if (cbfs_image_from_buffer(&cbfs, &buffer, param.headeroffset))
 			goto no_metadata_hash;
 		mh_container = cbfs_get_entry(&cbfs, "bootblock");
@@ -191,16 +211,16 @@ static struct mh_cache *get_mh_cache(void)
 			      anchor->cbfs_hash.algo);
 			goto no_metadata_hash;
 		}
-		mhc.cbfs_hash = anchor->cbfs_hash;
-		mhc.offset = (void *)anchor - buffer_get(&buffer);
-		mhc.fixup = platform_fixups_probe(&buffer, mhc.offset,
-						  mhc.region);
-		return &mhc;
+		mh_cache.cbfs_hash = anchor->cbfs_hash;
+		mh_cache.offset = (void *)anchor - buffer_get(&buffer);
+		mh_cache.fixup = platform_fixups_probe(&buffer, mh_cache.offset,
+						  mh_cache.region);
+		return &mh_cache;
 	}
 
 no_metadata_hash:
-	mhc.cbfs_hash.algo = VB2_HASH_INVALID;
-	return &mhc;
+	mh_cache.cbfs_hash.algo = VB2_HASH_INVALID;
+	return &mh_cache;
 }
 
 static void update_and_info(const char *name, void *dst, void *src, size_t size)
@@ -241,13 +261,8 @@ static int update_anchor(struct mh_cache *mhc, uint8_t *fmap_hash)
 
 }
 
-/* This should be called after every time CBFS metadata might have changed. It
-   will recalculate and update the metadata hash in the bootblock if needed. */
-static int maybe_update_metadata_hash(struct cbfs_image *cbfs)
+static int update_metadata_hash(struct cbfs_image *cbfs)
 {
-	if (strcmp(param.region_name, SECTION_NAME_PRIMARY_CBFS))
-		return 0;  /* Metadata hash only embedded in primary CBFS. */
-
 	struct mh_cache *mhc = get_mh_cache();
 	if (mhc->cbfs_hash.algo == VB2_HASH_INVALID)
 		return 0;
@@ -262,6 +277,21 @@ static int maybe_update_metadata_hash(struct cbfs_image *cbfs)
 	return update_anchor(mhc, NULL);
 }
 
+/* This should be called after every time CBFS metadata might have changed. It
+   will recalculate and update the metadata hash in the bootblock if needed. */
+static int maybe_update_metadata_hash(struct cbfs_image *cbfs)
+{
+	if (strcmp(param.region_name, SECTION_NAME_PRIMARY_CBFS))
+		return 0;  /* Metadata hash only embedded in primary CBFS. */
+
+	if (batch.active) {
+		batch.metadata_hash_dirty = true;
+		return 0;
+	}
+
+	return update_metadata_hash(cbfs);
+}
+
 /* This should be called after every time the FMAP or the bootblock itself might
    have changed, and will write the new FMAP hash into the metadata hash anchor
    in the bootblock if required (usually when the bootblock is first added). */
@@ -384,12 +414,12 @@ static int decode_mmap_arg(char *arg)
 #define DEFAULT_DECODE_WINDOW_TOP	(4ULL * GiB)
 #define DEFAULT_DECODE_WINDOW_MAX_SIZE	(16 * MiB)
 
+static bool mmap_windows_created;
+
 static bool create_mmap_windows(void)
 {
-	static bool done;
-
-	if (done)
-		return done;
+	if (mmap_windows_created)
+		return true;
 
 	// No memory map provided, use a default one
 	if (mmap_window_table_size == 0) {
@@ -433,8 +463,8 @@ static bool create_mmap_windows(void)
 		}
 	}
 
-	done = true;
-	return done;
+	mmap_windows_created = true;
+	return true;
 }
 
 static unsigned int convert_address(const struct region *to, const struct region *from,
@@ -1033,6 +1063,26 @@ error:
 	return 1;
 }
 
+/*
+ * Take the data the batch compressed ahead of time for the running command. The
+ * input is compared, as an earlier command may have rewritten the file.
+ */
+static bool batch_take_compressed(const struct buffer *input, char **compressed,
+				  int *compressed_size)
+{
+	struct batch_compressed *prepared = batch.compressed;
+
+	if (!prepared || !prepared->data || prepared->compression != param.compression ||
+	    buffer_size(&prepared->input) != buffer_size(input) ||
+	    memcmp(buffer_get(&prepared->input), buffer_get(input), buffer_size(input)))
+		return false;
+
+	*compressed = prepared->data;
+	*compressed_size = prepared->size;
+	prepared->data = NULL;
+	return true;
+}
+
 static int cbfstool_convert_raw(struct buffer *buffer,
 	unused uint32_t *offset, struct cbfs_file *header)
 {
@@ -1049,10 +1099,9 @@ static int cbfstool_convert_raw(struct buffer *buffer,
 		if (!compressed)
 			return -1;
 		memcpy(compressed, buffer->data + 8, compressed_size);
-	} else {
-		if (param.compression == CBFS_COMPRESS_NONE)
-			goto out;
-
+	} else if (param.compression == CBFS_COMPRESS_NONE) {
+		goto out;
+	} else if (!batch_take_compressed(buffer, &compressed, &compressed_size)) {
 		compress = compression_function(param.compression);
 		if (!compress)
 			return -1;
@@ -1552,7 +1601,7 @@ static enum cb_err verify_walker(__always_unused cbfs_dev_t dev, size_t offset,
 	if (!hash)
 		return CB_ERR;
 	void *file_data = arg + offset + data_offset;
-	if (vb2_hash_verify(false, file_data, be32toh(mdata->h.len), hash) != VB2_SUCCESS)
+	if (!cbfs_file_hash_valid(file_data, be32toh(mdata->h.len), hash))
 		return CB_CBFS_HASH_MISMATCH;
 	return CB_CBFS_NOT_FOUND;
 }
@@ -1563,6 +1612,9 @@ static int cbfs_print(void)
 	if (cbfs_image_from_buffer(&image, param.image_region,
 							param.headeroffset))
 		return 1;
+	/* Both the listing and the verification below need every file hash. */
+	if (verbose)
+		cbfs_check_file_hashes(&image);
 	if (param.machine_parseable) {
 		if (verbose)
 			printf("[FMAP REGION]\t%s\n", param.region_name);
@@ -1575,8 +1627,10 @@ static int cbfs_print(void)
 	if (verbose) {
 		const char *verification_state = "fully valid";
 		struct mh_cache *mhc = get_mh_cache();
-		if (mhc->cbfs_hash.algo == VB2_HASH_INVALID)
+		if (mhc->cbfs_hash.algo == VB2_HASH_INVALID) {
+			cbfs_drop_file_hash_checks();
 			return 0;
+		}
 
 		struct vb2_hash real_hash = { .algo = mhc->cbfs_hash.algo };
 		enum cb_err err = cbfs_walk(&image, verify_walker, buffer_get(&image.buffer),
@@ -1603,6 +1657,7 @@ static int cbfs_print(void)
 		free(hash_str);
 	}
 
+	cbfs_drop_file_hash_checks();
 	return 0;
 }
 
@@ -2014,6 +2069,10 @@ static void usage(char *name)
 			"Truncate CBFS and print new size on stdout\n"
 	     " expand [-r fmap-region]                                     "
 			"Expand CBFS to span entire region\n"
+	     " batch -f MANIFEST                                           "
+			"Run the commands listed in MANIFEST (- for stdin)\n"
+	     "                                                             "
+			"on one in-memory image, writing it only once\n"
 	     "OFFSETs:\n"
 	     "  Numbers accompanying -b, -H, and -o switches* may be provided\n"
 	     "  in two possible formats: if their value is greater than\n"
@@ -2062,251 +2121,639 @@ static bool valid_opt(size_t i, int c)
 	return false;
 }
 
-int main(int argc, char **argv)
+static int parse_options(size_t i, int argc, char **argv, char *name)
 {
-	size_t i;
 	int c;
 
-	if (argc < 3) {
-		usage(argv[0]);
-		return 1;
-	}
+	while (1) {
+		char *suffix = NULL;
+		int option_index = 0;
 
-	char *image_name = argv[1];
-	char *cmd = argv[2];
-	optind += 2;
-
-	for (i = 0; i < ARRAY_SIZE(commands); i++) {
-		if (strcmp(cmd, commands[i].name) != 0)
-			continue;
+		c = getopt_long(argc, argv, commands[i].optstring,
+					long_options, &option_index);
+		if (c == -1) {
+			if (optind < argc) {
+				ERROR("%s: excessive argument -- '%s'"
+					"\n", name, argv[optind]);
+				return 1;
+			}
+			break;
+		}
 
-		while (1) {
-			char *suffix = NULL;
-			int option_index = 0;
+		/* Filter out illegal long options */
+		if (!valid_opt(i, c)) {
+			ERROR("%s: invalid option -- '%d'\n",
+			      name, c);
+			c = '?';
+		}
 
-			c = getopt_long(argc, argv, commands[i].optstring,
-						long_options, &option_index);
-			if (c == -1) {
-				if (optind < argc) {
-					ERROR("%s: excessive argument -- '%s'"
-						"\n", argv[0], argv[optind]);
-					return 1;
-				}
+		switch(c) {
+		case 'n':
+			param.name = optarg;
+			break;
+		case 't':
+			if (intfiletype(optarg) != ((uint64_t) - 1))
+				param.type = intfiletype(optarg);
+			else
+				param.type = strtoul(optarg, NULL, 0);
+			if (param.type == 0)
+				WARN("Unknown type '%s' ignored\n",
+						optarg);
+			break;
+		case 'c': {
+			if (strcmp(optarg, "precompression") == 0) {
+				param.precompression = 1;
 				break;
 			}
-
-			/* Filter out illegal long options */
-			if (!valid_opt(i, c)) {
-				ERROR("%s: invalid option -- '%d'\n",
-				      argv[0], c);
-				c = '?';
+			int algo = cbfs_parse_comp_algo(optarg);
+			if (algo >= 0)
+				param.compression = algo;
+			else
+				WARN("Unknown compression '%s' ignored.\n",
+								optarg);
+			break;
+		}
+		case 'A': {
+			if (!vb2_lookup_hash_alg(optarg, &param.hash)) {
+				ERROR("Unknown hash algorithm '%s'.\n",
+					optarg);
+				return 1;
 			}
-
-			switch(c) {
-			case 'n':
-				param.name = optarg;
-				break;
-			case 't':
-				if (intfiletype(optarg) != ((uint64_t) - 1))
-					param.type = intfiletype(optarg);
-				else
-					param.type = strtoul(optarg, NULL, 0);
-				if (param.type == 0)
-					WARN("Unknown type '%s' ignored\n",
-							optarg);
-				break;
-			case 'c': {
-				if (strcmp(optarg, "precompression") == 0) {
-					param.precompression = 1;
-					break;
-				}
-				int algo = cbfs_parse_comp_algo(optarg);
-				if (algo >= 0)
-					param.compression = algo;
-				else
-					WARN("Unknown compression '%s' ignored.\n",
-									optarg);
-				break;
+			break;
+		}
+		case 'M':
+			param.fmap = optarg;
+			break;
+		case 'r':
+			param.region_name = optarg;
+			break;
+		case 'R':
+			param.source_region = optarg;
+			break;
+		case 'b':
+			param.baseaddress_input = strtoll(optarg, &suffix, 0);
+			if (!*optarg || (suffix && *suffix)) {
+				ERROR("Invalid base address '%s'.\n",
+					optarg);
+				return 1;
 			}
-			case 'A': {
-				if (!vb2_lookup_hash_alg(optarg, &param.hash)) {
-					ERROR("Unknown hash algorithm '%s'.\n",
-						optarg);
-					return 1;
-				}
-				break;
+			// baseaddress may be zero on non-x86, so we
+			// need an explicit "baseaddress_assigned".
+			param.baseaddress_assigned = 1;
+			break;
+		case 'l':
+			param.loadaddress = strtoull(optarg, &suffix, 0);
+			if (!*optarg || (suffix && *suffix)) {
+				ERROR("Invalid load address '%s'.\n",
+					optarg);
+				return 1;
 			}
-			case 'M':
-				param.fmap = optarg;
-				break;
-			case 'r':
-				param.region_name = optarg;
-				break;
-			case 'R':
-				param.source_region = optarg;
-				break;
-			case 'b':
-				param.baseaddress_input = strtoll(optarg, &suffix, 0);
-				if (!*optarg || (suffix && *suffix)) {
-					ERROR("Invalid base address '%s'.\n",
-						optarg);
-					return 1;
-				}
-				// baseaddress may be zero on non-x86, so we
-				// need an explicit "baseaddress_assigned".
-				param.baseaddress_assigned = 1;
-				break;
-			case 'l':
-				param.loadaddress = strtoull(optarg, &suffix, 0);
-				if (!*optarg || (suffix && *suffix)) {
-					ERROR("Invalid load address '%s'.\n",
-						optarg);
-					return 1;
-				}
-				break;
-			case 'e':
-				param.entrypoint = strtoull(optarg, &suffix, 0);
-				if (!*optarg || (suffix && *suffix)) {
-					ERROR("Invalid entry point '%s'.\n",
-						optarg);
-					return 1;
-				}
-				break;
-			case 's':
-				param.size = strtoul(optarg, &suffix, 0);
-				if (!*optarg) {
-					ERROR("Empty size specified.\n");
-					return 1;
-				}
-				switch (tolower((int)suffix[0])) {
-				case 'k':
-					param.size *= 1024;
-					break;
-				case 'm':
-					param.size *= 1024 * 1024;
-					break;
-				case '\0':
-					break;
-				default:
-					ERROR("Invalid suffix for size '%s'.\n",
-						optarg);
-					return 1;
-				}
-				break;
-			case 'B':
-				param.bootblock = optarg;
-				break;
-			case 'H':
-				param.headeroffset_input = strtoll(optarg, &suffix, 0);
-				if (!*optarg || (suffix && *suffix)) {
-					ERROR("Invalid header offset '%s'.\n",
-						optarg);
-					return 1;
-				}
-				param.headeroffset_assigned = 1;
-				break;
-			case 'a':
-				param.alignment = strtoul(optarg, &suffix, 0);
-				if (!*optarg || (suffix && *suffix)) {
-					ERROR("Invalid alignment '%s'.\n",
-						optarg);
-					return 1;
-				}
-				break;
-			case 'p':
-				param.padding = strtoul(optarg, &suffix, 0);
-				if (!*optarg || (suffix && *suffix)) {
-					ERROR("Invalid pad size '%s'.\n",
-						optarg);
-					return 1;
-				}
-				break;
-			case 'Q':
-				param.force_pow2_pagesize = 1;
-				break;
-			case 'o':
-				param.cbfsoffset_input = strtoll(optarg, &suffix, 0);
-				if (!*optarg || (suffix && *suffix)) {
-					ERROR("Invalid cbfs offset '%s'.\n",
-						optarg);
-					return 1;
-				}
-				param.cbfsoffset_assigned = 1;
-				break;
-			case 'f':
-				param.filename = optarg;
-				break;
-			case 'F':
-				param.force = 1;
-				break;
-			case 'i':
-				param.u64val = strtoull(optarg, &suffix, 0);
-				param.u64val_assigned = 1;
-				if (!*optarg || (suffix && *suffix)) {
-					ERROR("Invalid int parameter '%s'.\n",
-						optarg);
-					return 1;
-				}
-				break;
-			case 'u':
-				param.fill_partial_upward = true;
-				break;
-			case 'd':
-				param.fill_partial_downward = true;
-				break;
-			case 'w':
-				param.show_immutable = true;
-				break;
-			case 'j':
-				param.topswap_size = strtol(optarg, NULL, 0);
-				if (!is_valid_topswap())
-					return 1;
-				break;
-			case 'q':
-				param.ucode_region = optarg;
-				break;
-			case 'v':
-				verbose++;
-				break;
-			case 'm':
-				param.arch = string_to_arch(optarg);
-				break;
-			case 'I':
-				param.initrd = optarg;
-				break;
-			case 'C':
-				param.cmdline = optarg;
-				break;
-			case 'S':
-				param.ignore_sections = optarg;
-				break;
-			case 'y':
-				param.stage_xip = true;
-				break;
-			case 'g':
-				param.autogen_attr = true;
-				break;
+			break;
+		case 'e':
+			param.entrypoint = strtoull(optarg, &suffix, 0);
+			if (!*optarg || (suffix && *suffix)) {
+				ERROR("Invalid entry point '%s'.\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 's':
+			param.size = strtoul(optarg, &suffix, 0);
+			if (!*optarg) {
+				ERROR("Empty size specified.\n");
+				return 1;
+			}
+			switch (tolower((int)suffix[0])) {
 			case 'k':
-				param.machine_parseable = true;
-				break;
-			case 'U':
-				param.unprocessed = true;
+				param.size *= 1024;
 				break;
-			case LONGOPT_IBB:
-				param.ibb = true;
+			case 'm':
+				param.size *= 1024 * 1024;
 				break;
-			case LONGOPT_MMAP:
-				if (decode_mmap_arg(optarg))
-					return 1;
+			case '\0':
 				break;
-			case 'h':
-			case '?':
-				usage(argv[0]);
-				return 1;
 			default:
+				ERROR("Invalid suffix for size '%s'.\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 'B':
+			param.bootblock = optarg;
+			break;
+		case 'H':
+			param.headeroffset_input = strtoll(optarg, &suffix, 0);
+			if (!*optarg || (suffix && *suffix)) {
+				ERROR("Invalid header offset '%s'.\n",
+					optarg);
+				return 1;
+			}
+			param.headeroffset_assigned = 1;
+			break;
+		case 'a':
+			param.alignment = strtoul(optarg, &suffix, 0);
+			if (!*optarg || (suffix && *suffix)) {
+				ERROR("Invalid alignment '%s'.\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 'p':
+			param.padding = strtoul(optarg, &suffix, 0);
+			if (!*optarg || (suffix && *suffix)) {
+				ERROR("Invalid pad size '%s'.\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 'Q':
+			param.force_pow2_pagesize = 1;
+			break;
+		case 'o':
+			param.cbfsoffset_input = strtoll(optarg, &suffix, 0);
+			if (!*optarg || (suffix && *suffix)) {
+				ERROR("Invalid cbfs offset '%s'.\n",
+					optarg);
+				return 1;
+			}
+			param.cbfsoffset_assigned = 1;
+			break;
+		case 'f':
+			param.filename = optarg;
+			break;
+		case 'F':
+			param.force = 1;
+			break;
+		case 'i':
+			param.u64val = strtoull(optarg, &suffix, 0);
+			param.u64val_assigned = 1;
+			if (!*optarg || (suffix && *suffix)) {
+				ERROR("Invalid int parameter '%s'.\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 'u':
+			param.fill_partial_upward = true;
+			break;
+		case 'd':
+			param.fill_partial_downward = true;
+			break;
+		case 'w':
+			param.show_immutable = true;
+			break;
+		case 'j':
+			param.topswap_size = strtol(optarg, NULL, 0);
+			if (!is_valid_topswap())
+				return 1;
+			break;
+		case 'q':
+			param.ucode_region = optarg;
+			break;
+		case 'v':
+			verbose++;
+			break;
+		case 'm':
+			param.arch = string_to_arch(optarg);
+			break;
+		case 'I':
+			param.initrd = optarg;
+			break;
+		case 'C':
+			param.cmdline = optarg;
+			break;
+		case 'S':
+			param.ignore_sections = optarg;
+			break;
+		case 'y':
+			param.stage_xip = true;
+			break;
+		case 'g':
+			param.autogen_attr = true;
+			break;
+		case 'k':
+			param.machine_parseable = true;
+			break;
+		case 'U':
+			param.unprocessed = true;
+			break;
+		case LONGOPT_IBB:
+			param.ibb = true;
+			break;
+		case LONGOPT_MMAP:
+			if (decode_mmap_arg(optarg))
+				return 1;
+			break;
+		case 'h':
+		case '?':
+			usage(name);
+			return 1;
+		default:
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int run_command(size_t i)
+{
+	unsigned num_regions = 1;
+	for (const char *list = strchr(param.region_name, ','); list;
+					list = strchr(list + 1, ','))
+		++num_regions;
+
+	// If the action needs to read an image region, as indicated by
+	// having accesses_region set in its command struct, that
+	// region's buffer struct will be stored here and the client
+	// will receive a pointer to it via param.image_region. It
+	// need not write the buffer back to the image file itself,
+	// since this behavior can be requested via its modifies_region
+	// field. Additionally, it should never free the region buffer,
+	// as that is performed automatically once it completes.
+	struct buffer image_regions[num_regions];
+	memset(image_regions, 0, sizeof(image_regions));
+
+	bool seen_primary_cbfs = false;
+	char region_name_scratch[strlen(param.region_name) + 1];
+	strcpy(region_name_scratch, param.region_name);
+	param.region_name = strtok(region_name_scratch, ",");
+	for (unsigned region = 0; region < num_regions; ++region) {
+		if (!param.region_name) {
+			ERROR("Encountered illegal degenerate region name in -r list\n");
+			ERROR("The image will be left unmodified.\n");
+			return 1;
+		}
+
+		if (strcmp(param.region_name, SECTION_NAME_PRIMARY_CBFS)
+								== 0)
+			seen_primary_cbfs = true;
+
+		param.image_region = image_regions + region;
+		if (dispatch_command(commands[i]))
+			return 1;
+
+		param.region_name = strtok(NULL, ",");
+	}
+
+	if (commands[i].function == cbfs_create && !seen_primary_cbfs) {
+		ERROR("The creation -r list must include the mandatory '%s' section.\n",
+					SECTION_NAME_PRIMARY_CBFS);
+		ERROR("The image will be left unmodified.\n");
+		return 1;
+	}
+
+	if (commands[i].modifies_region) {
+		assert(param.image_file);
+		for (unsigned region = 0; region < num_regions;
+							++region) {
+
+			if (!partitioned_file_write_region(
+						param.image_file,
+					image_regions + region))
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+#define BATCH_MAX_ARGS 64
+
+/*
+ * Split a manifest line into arguments in place. Arguments are separated by
+ * whitespace, can be quoted with '' or "" and a backslash escapes the next
+ * character outside of ''. A # at the start of an argument starts a comment.
+ * Returns the number of arguments or -1 if the line is malformed.
+ */
+static int batch_split_line(char *line, char **args, int max_args)
+{
+	char *src = line;
+	char *dst = line;
+	int count = 0;
+
+	while (1) {
+		while (isspace((unsigned char)*src))
+			src++;
+		if (*src == '\0' || *src == '#')
+			break;
+		if (count == max_args) {
+			ERROR("More than %d arguments.\n", max_args);
+			return -1;
+		}
+
+		char quote = '\0';
+		args[count++] = dst;
+		while (*src && (quote || !isspace((unsigned char)*src))) {
+			if (quote && *src == quote) {
+				quote = '\0';
+				src++;
+			} else if (!quote && (*src == '\'' || *src == '"')) {
+				quote = *src++;
+			} else if (*src == '\\' && quote != '\'' && src[1]) {
+				src++;
+				*dst++ = *src++;
+			} else {
+				*dst++ = *src++;
+			}
+		}
+		if (quote) {
+			ERROR("Unterminated %c quote.\n", quote);
+			return -1;
+		}
+		if (*src)
+			src++;
+		*dst++ = '\0';
+	}
+
+	args[count] = NULL;
+	return count;
+}
+
+/* A manifest line, parsed into the state it runs with. */
+struct batch_command {
+	char *line;
+	unsigned int line_number;
+	size_t index;
+	struct param param;
+	int verbose;
+	struct mmap_window mmap_windows[MMAP_MAX_WINDOWS];
+	int mmap_window_count;
+	struct batch_compressed compressed;
+};
+
+/*
+ * Parse a manifest line. The arguments stay in the line, which the command
+ * keeps. Returns 1 for a command, 0 for an empty line and -1 on errors.
+ */
+static int batch_parse_line(struct batch_command *cmd, const struct param *defaults,
+			    int default_verbose, char *name)
+{
+	char *args[BATCH_MAX_ARGS + 1];
+	int count = batch_split_line(cmd->line, args, BATCH_MAX_ARGS);
+	size_t i;
+
+	if (count <= 0)
+		return count;
+
+	for (i = 0; i < ARRAY_SIZE(commands); i++) {
+		if (strcmp(args[0], commands[i].name) == 0)
+			break;
+	}
+	if (i == ARRAY_SIZE(commands) || commands[i].function == cbfs_create) {
+		ERROR("Command '%s' can't be used in a batch.\n", args[0]);
+		return -1;
+	}
+
+	/* Each command starts out in the state of a separate cbfstool run. */
+	param = *defaults;
+	verbose = default_verbose;
+	mmap_window_table_size = 0;
+
+	/* Makes getopt_long() start over on the new argument vector. */
+	optind = 0;
+	if (parse_options(i, count, args, name))
+		return -1;
+
+	cmd->index = i;
+	cmd->param = param;
+	cmd->verbose = verbose;
+	memcpy(cmd->mmap_windows, mmap_window_table, sizeof(mmap_window_table));
+	cmd->mmap_window_count = mmap_window_table_size;
+	return 1;
+}
+
+static void batch_compress(void *arg, size_t i)
+{
+	struct batch_compressed *prepared = ((struct batch_compressed **)arg)[i];
+	comp_func_ptr compress = compression_function(prepared->compression);
+	struct buffer *input = &prepared->input;
+
+	prepared->data = calloc(buffer_size(input), 1);
+	if (!prepared->data)
+		return;
+
+	if (compress(buffer_get(input), buffer_size(input), prepared->data,
+		     &prepared->size)) {
+		free(prepared->data);
+		prepared->data = NULL;
+	}
+}
+
+/*
+ * Compress the files of all "add" commands at once, the way add-payload compresses
+ * segments. Whatever can't be prepared here is compressed when the command runs.
+ */
+static int batch_prepare(struct batch_command *cmds, size_t count)
+{
+	struct batch_compressed **prepared = calloc(count, sizeof(*prepared));
+	size_t num_prepared = 0;
+
+	if (!prepared)
+		return 1;
+
+	for (size_t i = 0; i < count; i++) {
+		const struct param *p = &cmds[i].param;
+
+		if (commands[cmds[i].index].function != cbfs_add ||
+		    p->type == CBFS_TYPE_FSP || p->precompression || !p->filename ||
+		    p->compression == CBFS_COMPRESS_NONE ||
+		    !compression_function(p->compression))
+			continue;
+
+		if (buffer_from_file(&cmds[i].compressed.input, p->filename))
+			continue;
+		cmds[i].compressed.compression = p->compression;
+		prepared[num_prepared++] = &cmds[i].compressed;
+	}
+
+	parallel_run(num_prepared, batch_compress, prepared);
+	free(prepared);
+	return 0;
+}
+
+static int batch_run_command(struct batch_command *cmd, partitioned_file_t *image_file)
+{
+	int ret;
+
+	param = cmd->param;
+	param.image_file = image_file;
+	verbose = cmd->verbose;
+	memcpy(mmap_window_table, cmd->mmap_windows, sizeof(mmap_window_table));
+	mmap_window_table_size = cmd->mmap_window_count;
+	mmap_windows_created = false;
+	memset(&mh_cache, 0, sizeof(mh_cache));
+
+	batch.compressed = &cmd->compressed;
+	ret = run_command(cmd->index);
+	batch.compressed = NULL;
+
+	buffer_delete(&cmd->compressed.input);
+	free(cmd->compressed.data);
+	cmd->compressed.data = NULL;
+	return ret;
+}
+
+static int batch_finish(partitioned_file_t *image_file, const struct param *defaults)
+{
+	if (batch.metadata_hash_dirty) {
+		struct buffer buffer;
+		struct cbfs_image image;
+
+		param = *defaults;
+		param.image_file = image_file;
+		memset(&mh_cache, 0, sizeof(mh_cache));
+		if (get_mh_cache()->cbfs_hash.algo != VB2_HASH_INVALID &&
+		    (!partitioned_file_read_region(&buffer, image_file,
+						   SECTION_NAME_PRIMARY_CBFS) ||
+		     cbfs_image_from_buffer(&image, &buffer, param.headeroffset) ||
+		     update_metadata_hash(&image)))
+			return 1;
+	}
+
+	return !partitioned_file_flush(image_file);
+}
+
+/*
+ * Run the commands from a manifest, one per line, against a single in-memory copy of
+ * the image. The image is only written back once all of them have succeeded. All lines
+ * are parsed before the first command runs, so that the files to add can be compressed
+ * in parallel.
+ */
+static int cbfs_batch(char *image_name, int argc, char **argv)
+{
+	const struct param defaults = param;
+	const char *manifest_name = NULL;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "f:vh?", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'f':
+			manifest_name = optarg;
+			break;
+		case 'v':
+			verbose++;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc) {
+		ERROR("%s: excessive argument -- '%s'\n", argv[0], argv[optind]);
+		return 1;
+	}
+	if (!manifest_name) {
+		ERROR("You need to specify -f/--file.\n");
+		return 1;
+	}
+
+	FILE *manifest = strcmp(manifest_name, "-") ? fopen(manifest_name, "r") : stdin;
+	if (!manifest) {
+		perror(manifest_name);
+		return 1;
+	}
+
+	partitioned_file_t *image_file = partitioned_file_reopen(image_name, true);
+	if (!image_file) {
+		if (manifest != stdin)
+			fclose(manifest);
+		return 1;
+	}
+	partitioned_file_defer_writes(image_file);
+
+	const int default_verbose = verbose;
+	struct batch_command *cmds = NULL;
+	unsigned int line_number = 0;
+	size_t count = 0, allocated = 0;
+	size_t line_size = 0;
+	char *line = NULL;
+	size_t i;
+	int ret = 0;
+
+	while (getline(&line, &line_size, manifest) != -1) {
+		line_number++;
+		if (count == allocated) {
+			allocated = allocated ? 2 * allocated : 64;
+			struct batch_command *grown = realloc(cmds, allocated * sizeof(*cmds));
+			if (!grown) {
+				ERROR("Out of memory.\n");
+				ret = 1;
 				break;
 			}
+			cmds = grown;
+		}
+
+		struct batch_command *cmd = &cmds[count];
+		memset(cmd, 0, sizeof(*cmd));
+		cmd->line = line;
+		cmd->line_number = line_number;
+		int parsed = batch_parse_line(cmd, &defaults, default_verbose, argv[0]);
+		if (parsed < 0) {
+			ERROR("%s:%u: Invalid command.\n", manifest_name, line_number);
+			ERROR("The image will be left unmodified.\n");
+			ret = 1;
+			break;
 		}
+		if (parsed == 0)
+			continue;
+
+		/* The command keeps the line, its arguments point into it. */
+		count++;
+		line = NULL;
+		line_size = 0;
+	}
+
+	if (!ret && batch_prepare(cmds, count))
+		ret = 1;
+
+	batch.active = true;
+	for (i = 0; !ret && i < count; i++) {
+		if (batch_run_command(&cmds[i], image_file)) {
+			ERROR("%s:%u: Command failed.\n", manifest_name, cmds[i].line_number);
+			ERROR("The image will be left unmodified.\n");
+			ret = 1;
+		}
+	}
+	if (!ret && batch_finish(image_file, &defaults))
+		ret = 1;
+	batch.active = false;
+
+	for (i = 0; i < count; i++) {
+		buffer_delete(&cmds[i].compressed.input);
+		free(cmds[i].compressed.data);
+		free(cmds[i].line);
+	}
+	free(cmds);
+	free(line);
+	if (manifest != stdin)
+		fclose(manifest);
+	partitioned_file_close(image_file);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	size_t i;
+
+	if (argc < 3) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	char *image_name = argv[1];
+	char *cmd = argv[2];
+	optind += 2;
+
+	if (strcmp(cmd, "batch") == 0)
+		return cbfs_batch(image_name, argc, argv);
+
+	for (i = 0; i < ARRAY_SIZE(commands); i++) {
+		if (strcmp(cmd, commands[i].name) != 0)
+			continue;
+
+		if (parse_options(i, argc, argv, argv[0]))
+			return 1;
 
 		if (commands[i].function == cbfs_create) {
 			if (param.fmap) {
@@ -2333,72 +2780,11 @@ int main(int argc, char **argv)
 		if (!param.image_file)
 			return 1;
 
-		unsigned num_regions = 1;
-		for (const char *list = strchr(param.region_name, ','); list;
-						list = strchr(list + 1, ','))
-			++num_regions;
-
-		// If the action needs to read an image region, as indicated by
-		// having accesses_region set in its command struct, that
-		// region's buffer struct will be stored here and the client
-		// will receive a pointer to it via param.image_region. It
-		// need not write the buffer back to the image file itself,
-		// since this behavior can be requested via its modifies_region
-		// field. Additionally, it should never free the region buffer,
-		// as that is performed automatically once it completes.
-		struct buffer image_regions[num_regions];
-		memset(image_regions, 0, sizeof(image_regions));
-
-		bool seen_primary_cbfs = false;
-		char region_name_scratch[strlen(param.region_name) + 1];
-		strcpy(region_name_scratch, param.region_name);
-		param.region_name = strtok(region_name_scratch, ",");
-		for (unsigned region = 0; region < num_regions; ++region) {
-			if (!param.region_name) {
-				ERROR("Encountered illegal degenerate region name in -r list\n");
-				ERROR("The image will be left unmodified.\n");
-				partitioned_file_close(param.image_file);
-				return 1;
-			}
-
-			if (strcmp(param.region_name, SECTION_NAME_PRIMARY_CBFS)
-									== 0)
-				seen_primary_cbfs = true;
-
-			param.image_region = image_regions + region;
-			if (dispatch_command(commands[i])) {
-				partitioned_file_close(param.image_file);
-				return 1;
-			}
-
-			param.region_name = strtok(NULL, ",");
-		}
-
-		if (commands[i].function == cbfs_create && !seen_primary_cbfs) {
-			ERROR("The creation -r list must include the mandatory '%s' section.\n",
-						SECTION_NAME_PRIMARY_CBFS);
-			ERROR("The image will be left unmodified.\n");
-			partitioned_file_close(param.image_file);
-			return 1;
-		}
-
-		if (commands[i].modifies_region) {
-			assert(param.image_file);
-			for (unsigned region = 0; region < num_regions;
-								++region) {
 
-				if (!partitioned_file_write_region(
-							param.image_file,
-						image_regions + region)) {
-					partitioned_file_close(
-							param.image_file);
-					return 1;
-				}
-			}
-		}
 
+		int ret = run_command(i);
 		partitioned_file_close(param.image_file);
-		return 0;
+		return ret;
 	}
 
 	ERROR("Unknown command '%s'.\n", cmd);
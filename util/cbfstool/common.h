@@ -198,6 +198,13 @@ int do_lzma_compress(char *in, int in_len, char *out, int *out_len);
 int do_lzma_uncompress(char *dst, int dst_len, char *src, int src_len,
 			size_t *actual_size);
 
+/* parallel.c */
+/* Calls func(arg, i) for every i from 0 to count - 1, spread over worker
+ * threads, and returns when all calls are done. The calls must not depend on
+ * each other. The number of threads follows the number of online CPUs unless
+ * CBFSTOOL_JOBS is set in the environment. */
+void parallel_run(size_t count, void (*func)(void *arg, size_t i), void *arg);
+
 /* xdr.c */
 struct xdr {
 	uint8_t (*get8)(struct buffer *input);
@@ -7,6 +7,9 @@
 #include "common.h"
 #include "lz4/lib/lz4frame.h"
 #include <commonlib/bsd/compression.h>
+#if HAVE_LIBZSTD
+#include <zstd.h>
+#endif
 
 static int lz4_compress(char *in, int in_len, char *out, int *out_len)
 {
@@ -43,6 +46,61 @@ static int lz4_decompress(char *in, int in_len, char *out, int out_len,
 	return 0;
 }
 
+#if HAVE_LIBZSTD
+#if ZSTD_VERSION_NUMBER < 10400
+#error "zstd compression requires libzstd 1.4.0 or newer"
+#endif
+
+/*
+ * Set every parameter that ends up in the frame explicitly, so that it doesn't depend on
+ * the defaults of the libzstd version. The compressed data itself still may.
+ */
+static int zstd_compress(char *in, int in_len, char *out, int *out_len)
+{
+	size_t worst_size = ZSTD_compressBound(in_len);
+	ZSTD_CCtx *cctx = ZSTD_createCCtx();
+	void *bounce = malloc(worst_size);
+	size_t result;
+	int ret = -1;
+
+	if (!cctx || !bounce)
+		goto out;
+
+	if (ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 19)) ||
+	    ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, 1)) ||
+	    ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 0)) ||
+	    ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_dictIDFlag, 0)))
+		goto out;
+
+	result = ZSTD_compress2(cctx, bounce, worst_size, in, in_len);
+	if (ZSTD_isError(result) || result >= (size_t)in_len)
+		goto out;
+
+	*out_len = result;
+	memcpy(out, bounce, *out_len);
+	ret = 0;
+out:
+	free(bounce);
+	ZSTD_freeCCtx(cctx);
+	return ret;
+}
+#endif
+
+static int zstd_decompress(char *in, int in_len, char *out, int out_len,
+			   size_t *actual_size)
+{
+	void *workspace = malloc(UZSTD_WORKSPACE_SIZE);
+	if (!workspace)
+		return -1;
+	size_t result = uzstdn(in, in_len, out, out_len, workspace);
+	free(workspace);
+	if (result == 0)
+		return -1;
+	if (actual_size != NULL)
+		*actual_size = result;
+	return 0;
+}
+
 static int lzma_compress(char *in, int in_len, char *out, int *out_len)
 {
 	return do_lzma_compress(in, in_len, out, out_len);
@@ -82,6 +140,14 @@ comp_func_ptr compression_function(enum cbfs_compression algo)
 	case CBFS_COMPRESS_LZ4:
 		compress = lz4_compress;
 		break;
+	case CBFS_COMPRESS_ZSTD:
+#if HAVE_LIBZSTD
+		compress = zstd_compress;
+		break;
+#else
+		ERROR("zstd compression needs cbfstool built with libzstd!\n");
+		return NULL;
+#endif
 	default:
 		ERROR("Unknown compression algorithm %d!\n", algo);
 		return NULL;
@@ -102,6 +168,9 @@ decomp_func_ptr decompression_function(enum cbfs_compression algo)
 	case CBFS_COMPRESS_LZ4:
 		decompress = lz4_decompress;
 		break;
+	case CBFS_COMPRESS_ZSTD:
+		decompress = zstd_decompress;
+		break;
 	default:
 		ERROR("Unknown compression algorithm %d!\n", algo);
 		return NULL;
@@ -45,35 +45,40 @@ static struct ISzAlloc LZMAalloc = { SzAlloc, SzFree };
 
 /* Streaming API */
 
+/* The stream interfaces come first so that Read() and Write() can get to the
+   vector from the pointer they are called with. */
 struct vector_t {
+	union {
+		struct ISeqInStream is;
+		struct ISeqOutStream os;
+	};
 	char *p;
 	size_t pos;
 	size_t size;
 };
 
-static struct vector_t instream, outstream;
-
-static SRes Read(unused void *u, void *buf, size_t *size)
+static SRes Read(void *u, void *buf, size_t *size)
 {
-	if ((instream.size - instream.pos) < *size)
-		*size = instream.size - instream.pos;
-	memcpy(buf, instream.p + instream.pos, *size);
-	instream.pos += *size;
+	struct vector_t *instream = u;
+
+	if ((instream->size - instream->pos) < *size)
+		*size = instream->size - instream->pos;
+	memcpy(buf, instream->p + instream->pos, *size);
+	instream->pos += *size;
 	return SZ_OK;
 }
 
-static size_t Write(unused void *u, const void *buf, size_t size)
+static size_t Write(void *u, const void *buf, size_t size)
 {
-	if(outstream.size - outstream.pos < size)
-		size = outstream.size - outstream.pos;
-	memcpy(outstream.p + outstream.pos, buf, size);
-	outstream.pos += size;
+	struct vector_t *outstream = u;
+
+	if(outstream->size - outstream->pos < size)
+		size = outstream->size - outstream->pos;
+	memcpy(outstream->p + outstream->pos, buf, size);
+	outstream->pos += size;
 	return size;
 }
 
-static struct ISeqInStream is = { Read };
-static struct ISeqOutStream os = { Write };
-
 /**
  * Compress a buffer with lzma
  * Don't copy the result back if it is too large.
@@ -130,18 +135,21 @@ int do_lzma_compress(char *in, int in_len, char *out, int *out_len)
 		return -1;
 	}
 
-	instream.p = in;
-	instream.pos = 0;
-	instream.size = in_len;
-
-	outstream.p = out;
-	outstream.pos = 0;
-	outstream.size = in_len;
+	struct vector_t instream = {
+		.is = { Read },
+		.p = in,
+		.size = in_len,
+	};
+	struct vector_t outstream = {
+		.os = { Write },
+		.p = out,
+		.size = in_len,
+	};
 
 	put_64(propsEncoded + LZMA_PROPS_SIZE, in_len);
-	Write(&os, propsEncoded, LZMA_PROPS_SIZE+8);
+	Write(&outstream, propsEncoded, LZMA_PROPS_SIZE+8);
 
-	res = LzmaEnc_Encode(p, &os, &is, 0, &LZMAalloc, &LZMAalloc);
+	res = LzmaEnc_Encode(p, &outstream.os, &instream.is, 0, &LZMAalloc, &LZMAalloc);
 	LzmaEnc_Destroy(p, &LZMAalloc, &LZMAalloc);
 	if (res != SZ_OK) {
 		ERROR("LZMA: LzmaEnc_Encode failed %d.\n", res);
@@ -0,0 +1,83 @@
+/* run independent work items on several threads */
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "common.h"
+
+/* Upper bound for the number of worker threads, whatever the host has. */
+#define MAX_JOBS	64
+
+struct parallel_work {
+	void (*func)(void *arg, size_t i);
+	void *arg;
+	size_t count;
+	size_t next;
+	pthread_mutex_t lock;
+};
+
+static size_t parallel_jobs(void)
+{
+	const char *env = getenv("CBFSTOOL_JOBS");
+	long jobs;
+
+	if (env && *env)
+		jobs = strtol(env, NULL, 0);
+	else
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (jobs < 1)
+		return 1;
+	return MIN(jobs, MAX_JOBS);
+}
+
+static void *parallel_worker(void *arg)
+{
+	struct parallel_work *work = arg;
+	size_t i;
+
+	while (1) {
+		pthread_mutex_lock(&work->lock);
+		i = work->next;
+		if (i < work->count)
+			work->next++;
+		pthread_mutex_unlock(&work->lock);
+
+		if (i >= work->count)
+			return NULL;
+		work->func(work->arg, i);
+	}
+}
+
+void parallel_run(size_t count, void (*func)(void *arg, size_t i), void *arg)
+{
+	struct parallel_work work = {
+		.func = func,
+		.arg = arg,
+		.count = count,
+	};
+	pthread_t threads[MAX_JOBS];
+	size_t jobs = MIN(parallel_jobs(), count);
+	size_t started;
+
+	if (jobs <= 1) {
+		for (size_t i = 0; i < count; i++)
+			func(arg, i);
+		return;
+	}
+
+	pthread_mutex_init(&work.lock, NULL);
+
+	/* The calling thread is a worker too, so start one thread less. */
+	for (started = 0; started < jobs - 1; started++) {
+		if (pthread_create(&threads[started], NULL, parallel_worker, &work))
+			break;
+	}
+	parallel_worker(&work);
+
+	for (size_t i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&work.lock);
+}
@@ -16,6 +16,10 @@ struct partitioned_file {
 	struct fmap *fmap;
 	struct buffer buffer;
 	FILE *stream;
+	bool defer_writes;
+	/* Range of file->buffer written since writes were deferred. */
+	size_t dirty_start;
+	size_t dirty_end;
 };
 
 static bool fill_ones_through(struct partitioned_file *file)
@@ -220,6 +224,17 @@ bool partitioned_file_write_region(partitioned_file_t *file,
 		return false;
 	}
 
+	if (file->defer_writes) {
+		if (file->dirty_start >= file->dirty_end) {
+			file->dirty_start = buffer->offset;
+			file->dirty_end = buffer->offset + buffer->size;
+		} else {
+			file->dirty_start = MIN(file->dirty_start, buffer->offset);
+			file->dirty_end = MAX(file->dirty_end, buffer->offset + buffer->size);
+		}
+		return true;
+	}
+
 	if (fseek(file->stream, buffer->offset, SEEK_SET)) {
 		ERROR("Failed to seek within image file\n");
 		return false;
@@ -231,6 +246,33 @@ bool partitioned_file_write_region(partitioned_file_t *file,
 	return true;
 }
 
+void partitioned_file_defer_writes(partitioned_file_t *file)
+{
+	assert(file);
+
+	file->defer_writes = true;
+	file->dirty_start = 0;
+	file->dirty_end = 0;
+}
+
+bool partitioned_file_flush(partitioned_file_t *file)
+{
+	assert(file);
+	assert(file->defer_writes);
+
+	if (file->dirty_start >= file->dirty_end)
+		return true;
+
+	struct buffer dirty;
+	buffer_splice(&dirty, &file->buffer, file->dirty_start,
+		      file->dirty_end - file->dirty_start);
+
+	file->defer_writes = false;
+	bool ret = partitioned_file_write_region(file, &dirty);
+	partitioned_file_defer_writes(file);
+	return ret;
+}
+
 bool partitioned_file_read_region(struct buffer *dest,
 			const partitioned_file_t *file, const char *region)
 {
@@ -79,6 +79,25 @@ partitioned_file_t *partitioned_file_reopen(const char *filename,
 bool partitioned_file_write_region(partitioned_file_t *file,
 						const struct buffer *buffer);
 
+/**
+ * Stop updating the backing file on every partitioned_file_write_region().
+ * Written regions are only recorded from then on; their contents already live in
+ * the file's in-memory buffer. A single partitioned_file_flush() writes them all
+ * out, and closing the file without flushing leaves the backing file untouched.
+ *
+ * @param file Partitioned file whose writes should be deferred
+ */
+void partitioned_file_defer_writes(partitioned_file_t *file);
+
+/**
+ * Write everything recorded since partitioned_file_defer_writes() to the backing
+ * file in one go.
+ *
+ * @param file Partitioned file to write out
+ * @return     Whether the operation was successful
+ */
+bool partitioned_file_flush(partitioned_file_t *file);
+
 /**
  * Obtain one particular region of a segmented file.
  * The result is owned by the partitioned_file_t and shared among every caller
@@ -0,0 +1,162 @@
+#!/usr/bin/python3
+# SPDX-License-Identifier: GPL-2.0-only
+
+"""Measure how cbfstool scales with CBFSTOOL_JOBS.
+
+Assembles an image around a large payload, the way an edk2 (UefiPayloadPkg)
+build ends up, once per job count. Times adding the payload, adding compressed
+files in one batch and printing the image with all file hashes verified. The
+images must come out identical whatever the number of jobs.
+
+Without --payload, a synthetic ELF with several loadable segments of roughly
+firmware-like compressibility is used instead of a real UEFIPAYLOAD.elf. The
+payload speedup is bounded by its number of loadable segments, which is printed
+with the results. Pass a real UEFIPAYLOAD.elf for representative numbers.
+"""
+
+import argparse
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+PT_LOAD = 1
+PF_X = 1
+PF_R = 4
+
+
+def make_segment(rng: random.Random, size: int) -> bytes:
+    # Mostly repeated snippets with some noise, to compress like code and data.
+    words = [rng.randbytes(rng.randint(4, 32)) for _ in range(512)]
+    out = bytearray()
+    while len(out) < size:
+        if rng.random() < 0.1:
+            out += rng.randbytes(16)
+        else:
+            out += rng.choice(words)
+    return bytes(out[:size])
+
+
+def make_elf(path: str, segments: int, segment_size: int) -> None:
+    rng = random.Random(0x5eed)
+    ehdr_size, phdr_size, shdr_size = 64, 56, 64
+    shstrtab = b"\0.shstrtab\0"
+    data_offset = ehdr_size + segments * phdr_size
+    load_addr = 0x800000
+
+    phdrs = b""
+    blobs = b""
+    for i in range(segments):
+        blob = make_segment(rng, segment_size)
+        offset = data_offset + len(blobs)
+        phdrs += struct.pack("<IIQQQQQQ", PT_LOAD, PF_R | (PF_X if i == 0 else 0), offset,
+                             load_addr, load_addr, len(blob), len(blob), 0x1000)
+        load_addr += (len(blob) + 0xfff) & ~0xfff
+        blobs += blob
+
+    shstrtab_offset = data_offset + len(blobs)
+    shdr_offset = shstrtab_offset + len(shstrtab)
+    shdrs = b"\0" * shdr_size
+    shdrs += struct.pack("<IIQQQQIIQQ", 1, 3, 0, 0, shstrtab_offset, len(shstrtab),
+                         0, 0, 1, 0)
+
+    ehdr = b"\x7fELF" + bytes([2, 1, 1]) + b"\0" * 9
+    ehdr += struct.pack("<HHIQQQIHHHHHH", 2, 62, 1, 0x800000, ehdr_size, shdr_offset, 0,
+                        ehdr_size, phdr_size, segments, shdr_size, 2, 1)
+
+    with open(path, "wb") as f:
+        f.write(ehdr + phdrs + blobs + shstrtab + shdrs)
+
+
+def count_load_segments(path: str) -> int:
+    with open(path, "rb") as f:
+        ehdr = f.read(64)
+        if ehdr[:4] != b"\x7fELF":
+            raise ValueError(f"{path} is not an ELF file")
+        is64 = ehdr[4] == 2
+        endian = "<" if ehdr[5] == 1 else ">"
+        if is64:
+            phoff, = struct.unpack_from(endian + "Q", ehdr, 32)
+            phentsize, phnum = struct.unpack_from(endian + "HH", ehdr, 54)
+        else:
+            phoff, = struct.unpack_from(endian + "I", ehdr, 28)
+            phentsize, phnum = struct.unpack_from(endian + "HH", ehdr, 42)
+        count = 0
+        for i in range(phnum):
+            f.seek(phoff + i * phentsize)
+            p_type, = struct.unpack(endian + "I", f.read(4))
+            if p_type == PT_LOAD:
+                count += 1
+    return count
+
+
+def run(cbfstool: str, jobs: int, args: list) -> float:
+    env = dict(os.environ, CBFSTOOL_JOBS=str(jobs))
+    start = time.monotonic()
+    subprocess.run([cbfstool] + args, env=env, check=True, stdout=subprocess.DEVNULL)
+    return time.monotonic() - start
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser.add_argument("--cbfstool", default=os.path.join(here, "..", "cbfstool"))
+    parser.add_argument("--payload", help="ELF payload to add, e.g. UEFIPAYLOAD.elf")
+    parser.add_argument("--segments", type=int, default=8)
+    parser.add_argument("--segment-size", type=int, default=2 * 1024 * 1024)
+    parser.add_argument("--compression", default="lzma")
+    parser.add_argument("--files", type=int, default=64,
+                        help="number of compressed raw files added in one batch")
+    parser.add_argument("--jobs", type=int, nargs="+", default=[1, os.cpu_count()])
+    opts = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        payload = opts.payload
+        if not payload:
+            payload = os.path.join(tmp, "payload.elf")
+            make_elf(payload, opts.segments, opts.segment_size)
+        manifest = os.path.join(tmp, "manifest")
+        rng = random.Random(1)
+        with open(manifest, "w") as m:
+            for i in range(opts.files):
+                raw = os.path.join(tmp, f"raw{i}.bin")
+                with open(raw, "wb") as f:
+                    f.write(make_segment(rng, 256 * 1024))
+                m.write(f"add -f {raw} -n raw{i} -t raw -c {opts.compression} -A sha256\n")
+
+        image_size = 2 * os.path.getsize(payload) + (opts.files + 1) * 512 * 1024
+        image_size = (image_size + 0xfffff) & ~0xfffff
+        images = []
+        times = []
+        print(f"payload: {os.path.basename(payload)}, "
+              f"{count_load_segments(payload)} loadable segments")
+        print(f"{'jobs':>4}  {'add-payload':>11}  {'batch add':>9}  {'print -v':>8}  "
+              f"{'speedup':>7}")
+        for jobs in opts.jobs:
+            image = os.path.join(tmp, f"image.{jobs}")
+            run(opts.cbfstool, jobs, [image, "create", "-m", "x86", "-s", str(image_size)])
+            add = run(opts.cbfstool, jobs, [image, "add-payload", "-f", payload,
+                                            "-n", "fallback/payload",
+                                            "-c", opts.compression, "-A", "sha256"])
+            batch = run(opts.cbfstool, jobs, [image, "batch", "-f", manifest])
+            verify = run(opts.cbfstool, jobs, [image, "print", "-v"])
+            times.append(add + batch + verify)
+            print(f"{jobs:>4}  {add:>10.2f}s  {batch:>8.2f}s  {verify:>7.2f}s  "
+                  f"{times[0] / times[-1]:>6.2f}x")
+            images.append(image)
+
+        for image in images[1:]:
+            with open(images[0], "rb") as a, open(image, "rb") as b:
+                if a.read() != b.read():
+                    print(f"{image} differs from {images[0]}", file=sys.stderr)
+                    return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
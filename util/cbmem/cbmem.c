@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <dirent.h>
@@ -247,6 +248,7 @@ static int find_cbmem_entry(uint32_t id, uint64_t *addr, size_t *size)
  */
 
 static struct lb_cbmem_ref timestamps;
+static struct lb_cbmem_ref timestamp_spans;
 static struct lb_cbmem_ref console;
 static struct lb_cbmem_ref tpm_cb_log;
 static struct lb_memory_range cbmem;
@@ -312,6 +314,12 @@ static int parse_cbtable_entries(const struct mapping *table_mapping)
 			    parse_cbmem_ref((struct lb_cbmem_ref *)lbr_p);
 			continue;
 		}
+		case LB_TAG_TIMESTAMP_SPANS: {
+			debug("    Found timestamp span table.\n");
+			timestamp_spans =
+			    parse_cbmem_ref((struct lb_cbmem_ref *)lbr_p);
+			continue;
+		}
 		case LB_TAG_CBMEM_CONSOLE: {
 			debug("    Found cbmem console.\n");
 			console = parse_cbmem_ref((struct lb_cbmem_ref *)lbr_p);
@@ -584,6 +592,29 @@ static uint64_t timestamp_print_parseable_entry(uint32_t id, uint64_t stamp,
 	return step_time;
 }
 
+static void print_json_string(const char *str)
+{
+	putchar('"');
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			printf("\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			printf("\\u%04x", *str);
+		else
+			putchar(*str);
+	}
+	putchar('"');
+}
+
+static void timestamp_print_json_entry(uint32_t id, uint64_t stamp, uint64_t prev_stamp)
+{
+	printf("{\"type\":\"timestamp\",\"id\":%u,\"name\":", id);
+	print_json_string(timestamp_name(id));
+	printf(",\"time_us\":%llu,\"delta_us\":%llu}\n",
+	       (long long)arch_convert_raw_ts_entry(stamp),
+	       (long long)arch_convert_raw_ts_entry(stamp - prev_stamp));
+}
+
 static uint64_t timestamp_print_entry(uint32_t id, uint64_t stamp, uint64_t prev_stamp)
 {
 	const char *name;
@@ -673,7 +704,10 @@ enum timestamps_print_type {
 	TIMESTAMPS_PRINT_NONE,
 	TIMESTAMPS_PRINT_NORMAL,
 	TIMESTAMPS_PRINT_MACHINE_READABLE,
+	TIMESTAMPS_PRINT_JSON_LINES,
 	TIMESTAMPS_PRINT_STACKED,
+	TIMESTAMPS_PRINT_SPANS_FOLDED,
+	TIMESTAMPS_PRINT_SPANS_JSON,
 };
 
 /* dump the timestamp table */
@@ -747,6 +781,8 @@ static void dump_timestamps(enum timestamps_print_type output_type)
 		stamp = tse->entry_stamp + sorted_tst_p->base_time;
 		if (output_type == TIMESTAMPS_PRINT_MACHINE_READABLE) {
 			timestamp_print_parseable_entry(tse->entry_id, stamp, prev_stamp);
+		} else if (output_type == TIMESTAMPS_PRINT_JSON_LINES) {
+			timestamp_print_json_entry(tse->entry_id, stamp, prev_stamp);
 		} else if (output_type == TIMESTAMPS_PRINT_NORMAL) {
 			total_time += timestamp_print_entry(tse->entry_id, stamp, prev_stamp);
 		} else if (output_type == TIMESTAMPS_PRINT_STACKED) {
@@ -792,6 +828,150 @@ static void dump_timestamps(enum timestamps_print_type output_type)
 	free(sorted_tst_p);
 }
 
+static const char *timestamp_span_kind_name(uint8_t kind)
+{
+	switch (kind) {
+	case TS_SPAN_BOOT_STATE:
+		return "boot_state";
+	case TS_SPAN_DEVICE_INIT:
+		return "device_init";
+	case TS_SPAN_CBFS_LOAD:
+		return "cbfs_load";
+	case TS_SPAN_DEVICE_READ_RESOURCES:
+		return "device_read_resources";
+	case TS_SPAN_DEVICE_ENABLE:
+		return "device_enable";
+	case TS_SPAN_DEVICE_FINAL:
+		return "device_final";
+	default:
+		return "generic";
+	}
+}
+
+/* Copy the span name, which isn't necessarily terminated, falling back to the ID name. */
+static void timestamp_span_name(const struct timestamp_span *span, char *name)
+{
+	memcpy(name, span->name, TIMESTAMP_SPAN_NAME_LEN);
+	name[TIMESTAMP_SPAN_NAME_LEN] = '\0';
+	if (!name[0])
+		snprintf(name, TIMESTAMP_SPAN_NAME_LEN + 1, "%s", get_timestamp_name(span->id));
+}
+
+/* Print the parents of a span, outermost first, separated by ';'. */
+static void print_span_path(const struct timestamp_span_table *spt, uint32_t i)
+{
+	const struct timestamp_span *span = &spt->spans[i];
+	char name[TIMESTAMP_SPAN_NAME_LEN + 1];
+
+	/* Parents always start before their children, anything else is corrupted. */
+	if (span->parent && span->parent - 1U < i) {
+		print_span_path(spt, span->parent - 1);
+		putchar(';');
+	}
+	timestamp_span_name(span, name);
+	printf("%s", name);
+}
+
+/*
+ * Dump the timestamp spans either as folded stacks with the self time of every span in
+ * microseconds (for flamegraph.pl and similar tools), or in the Chrome trace event format
+ * (for chrome://tracing, Perfetto or speedscope).
+ */
+static void dump_timestamp_spans(enum timestamps_print_type output_type)
+{
+	const struct timestamp_table *tst_p;
+	const struct timestamp_span_table *spt_p;
+	struct timestamp_span_table *spt;
+	struct mapping timestamp_mapping;
+	struct mapping span_mapping;
+	uint64_t base_time;
+	int64_t *child_time;
+	int64_t last = 0;
+	size_t size;
+
+	if (timestamps.tag != LB_TAG_TIMESTAMPS) {
+		fprintf(stderr, "No timestamps found in coreboot table.\n");
+		return;
+	}
+	if (timestamp_spans.tag != LB_TAG_TIMESTAMP_SPANS) {
+		fprintf(stderr, "No timestamp spans found in coreboot table.\n");
+		return;
+	}
+
+	tst_p = map_memory(&timestamp_mapping, timestamps.cbmem_addr, sizeof(*tst_p));
+	if (!tst_p)
+		die("Unable to map timestamp header\n");
+	timestamp_set_tick_freq(tst_p->tick_freq_mhz);
+	base_time = tst_p->base_time;
+	unmap_memory(&timestamp_mapping);
+
+	size = sizeof(*spt_p);
+	spt_p = map_memory(&span_mapping, timestamp_spans.cbmem_addr, size);
+	if (!spt_p)
+		die("Unable to map timestamp span header\n");
+	size += MIN(spt_p->num_spans, spt_p->max_spans) * sizeof(spt_p->spans[0]);
+	unmap_memory(&span_mapping);
+
+	spt_p = map_memory(&span_mapping, timestamp_spans.cbmem_addr, size);
+	if (!spt_p)
+		die("Unable to map full timestamp span table\n");
+
+	spt = malloc(size);
+	if (!spt)
+		die("Failed to allocate memory");
+	aligned_memcpy(spt, spt_p, size);
+	unmap_memory(&span_mapping);
+	spt->num_spans = MIN(spt->num_spans, spt->max_spans);
+
+	child_time = calloc(spt->num_spans + 1, sizeof(*child_time));
+	if (!child_time)
+		die("Failed to allocate memory");
+
+	/* Spans that were never closed are cut off at the last recorded time. */
+	for (uint32_t i = 0; i < spt->num_spans; i++)
+		last = MAX(last, MAX(spt->spans[i].start, spt->spans[i].end));
+	for (uint32_t i = 0; i < spt->num_spans; i++) {
+		struct timestamp_span *span = &spt->spans[i];
+
+		if (span->end < span->start)
+			span->end = last;
+		if (span->parent && span->parent - 1U < i)
+			child_time[span->parent - 1] += span->end - span->start;
+	}
+
+	if (output_type == TIMESTAMPS_PRINT_SPANS_JSON)
+		printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	for (uint32_t i = 0; i < spt->num_spans; i++) {
+		const struct timestamp_span *span = &spt->spans[i];
+		char name[TIMESTAMP_SPAN_NAME_LEN + 1];
+
+		if (output_type == TIMESTAMPS_PRINT_SPANS_FOLDED) {
+			/* Time spent in nested spans is accounted to them. */
+			print_span_path(spt, i);
+			printf(" %llu\n", (long long)arch_convert_raw_ts_entry(
+				MAX(span->end - span->start - child_time[i], 0)));
+			continue;
+		}
+
+		timestamp_span_name(span, name);
+		printf("%s\n{\"name\":", i ? "," : "");
+		print_json_string(name);
+		printf(",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,"
+		       "\"pid\":0,\"tid\":%u,\"args\":{\"id\":%u,\"parent\":%u}}",
+		       timestamp_span_kind_name(span->kind),
+		       (long long)arch_convert_raw_ts_entry(span->start + base_time),
+		       (long long)arch_convert_raw_ts_entry(span->end - span->start),
+		       span->thread, span->id, span->parent);
+	}
+
+	if (output_type == TIMESTAMPS_PRINT_SPANS_JSON)
+		printf("\n]}\n");
+
+	free(child_time);
+	free(spt);
+}
+
 /* add a timestamp entry */
 static void timestamp_add_now(uint32_t timestamp_id)
 {
@@ -1144,17 +1324,123 @@ static int parse_loglevel(char *arg, int *print_unknown_logs)
 	return BIOS_NEVER;
 }
 
-/* dump the cbmem console */
-static void dump_console(enum console_print_type type, int max_loglevel, int print_unknown_logs)
+/* Console output state, which carries over between chunks of a followed console. */
+struct console_output {
+	int max_loglevel;
+	int print_unknown_logs;
+	bool json;
+	bool tty;
+	bool suppressed;
+	/* Level of the current line, -1 if it didn't start with a marker. */
+	int level;
+	size_t line_len;
+	char line[1024];
+};
+
+static void console_output_init(struct console_output *out, int max_loglevel,
+				int print_unknown_logs, bool json)
+{
+	memset(out, 0, sizeof(*out));
+	out->max_loglevel = max_loglevel;
+	out->print_unknown_logs = print_unknown_logs;
+	out->json = json;
+	out->tty = !json && isatty(fileno(stdout));
+	out->level = -1;
+}
+
+/*
+ * Slight memory corruption may occur between reboots and give us a few
+ * unprintable characters like '\0'. Replace them with '?' on output.
+ */
+static void console_sanitize(char *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		if (!isprint(buf[i]) && !isspace(buf[i]) && !BIOS_LOG_IS_MARKER(buf[i]))
+			buf[i] = '?';
+}
+
+/* Print the collected line as a JSON object on a line of its own. */
+static void console_output_json_line(struct console_output *out)
+{
+	out->line[out->line_len] = '\0';
+	printf("{\"type\":\"console\",\"level\":");
+	if (out->level >= 0) {
+		/* The prefixes are padded with spaces and not terminated. */
+		const char *prefix = bios_log_prefix[out->level];
+		int len = sizeof(bios_log_prefix[0]);
+		while (len > 0 && prefix[len - 1] == ' ')
+			len--;
+		printf("\"%.*s\"", len, prefix);
+	} else
+		printf("null");
+	printf(",\"message\":");
+	print_json_string(out->line);
+	printf("}\n");
+	out->line_len = 0;
+}
+
+static void console_output_char(struct console_output *out, char c)
+{
+	if (BIOS_LOG_IS_MARKER(c)) {
+		int lvl = BIOS_LOG_MARKER_TO_LEVEL(c);
+		if (lvl > out->max_loglevel) {
+			/* Drop what was collected of a line the marker interrupted. */
+			out->suppressed = true;
+			out->line_len = 0;
+			return;
+		}
+		out->suppressed = false;
+		out->level = lvl;
+		if (out->json)
+			return;
+		if (out->tty)
+			printf(BIOS_LOG_ESCAPE_PATTERN, bios_log_escape[lvl]);
+		printf(BIOS_LOG_PREFIX_PATTERN, bios_log_prefix[lvl]);
+		return;
+	}
+
+	if (out->json) {
+		if (c != '\n' && !out->suppressed) {
+			/* Overly long lines are split into several messages. */
+			if (out->line_len == sizeof(out->line) - 1)
+				console_output_json_line(out);
+			out->line[out->line_len++] = c;
+		}
+	} else if (!out->suppressed) {
+		putchar(c);
+	}
+
+	if (c == '\n') {
+		if (out->json && !out->suppressed)
+			console_output_json_line(out);
+		if (out->tty && !out->suppressed)
+			printf(BIOS_LOG_ESCAPE_RESET);
+		out->suppressed = !out->print_unknown_logs;
+		out->level = -1;
+	}
+}
+
+/* Flush an unterminated last line. */
+static void console_output_finish(struct console_output *out)
+{
+	if (out->json && out->line_len)
+		console_output_json_line(out);
+	if (out->tty)
+		printf(BIOS_LOG_ESCAPE_RESET);
+}
+
+/* dump the cbmem console, returning the cursor it was dumped up to */
+static uint32_t dump_console(enum console_print_type type, struct console_output *out)
 {
 	const struct cbmem_console *console_p;
 	char *console_c;
 	size_t size, cursor, previous;
+	uint32_t raw_cursor;
 	struct mapping console_mapping;
 
 	if (console.tag != LB_TAG_CBMEM_CONSOLE) {
 		fprintf(stderr, "No console found in coreboot table.\n");
-		return;
+		return 0;
 	}
 
 	size = sizeof(*console_p);
@@ -1162,8 +1448,9 @@ static void dump_console(enum console_print_type type, int max_loglevel, int pri
 	if (!console_p)
 		die("Unable to map console object.\n");
 
-	cursor = console_p->cursor & CBMC_CURSOR_MASK;
-	if (!(console_p->cursor & CBMC_OVERFLOW) && cursor < console_p->size)
+	raw_cursor = console_p->cursor;
+	cursor = raw_cursor & CBMC_CURSOR_MASK;
+	if (!(raw_cursor & CBMC_OVERFLOW) && cursor < console_p->size)
 		size = cursor;
 	else
 		size = console_p->size;
@@ -1182,10 +1469,12 @@ static void dump_console(enum console_print_type type, int max_loglevel, int pri
 	if (!console_p)
 		die("Unable to map full console object.\n");
 
-	if (console_p->cursor & CBMC_OVERFLOW) {
+	if (raw_cursor & CBMC_OVERFLOW) {
 		if (cursor >= size) {
-			printf("cbmem: ERROR: CBMEM console struct is illegal, "
-			       "output may be corrupt or out of order!\n\n");
+			/* Keep JSON output parseable. */
+			fprintf(out->json ? stderr : stdout,
+				"cbmem: ERROR: CBMEM console struct is illegal, "
+				"output may be corrupt or out of order!\n\n");
 			cursor = 0;
 		}
 		aligned_memcpy(console_c, console_p->body + cursor,
@@ -1196,12 +1485,7 @@ static void dump_console(enum console_print_type type, int max_loglevel, int pri
 		aligned_memcpy(console_c, console_p->body, size);
 	}
 
-	/* Slight memory corruption may occur between reboots and give us a few
-	   unprintable characters like '\0'. Replace them with '?' on output. */
-	for (cursor = 0; cursor < size; cursor++)
-		if (!isprint(console_c[cursor]) && !isspace(console_c[cursor])
-		    && !BIOS_LOG_IS_MARKER(console_c[cursor]))
-			console_c[cursor] = '?';
+	console_sanitize(console_c, size);
 
 	/* We detect the reboot cutoff by looking for a bootblock, romstage or
 	   ramstage banner, in that order (to account for platforms without
@@ -1241,34 +1525,88 @@ static void dump_console(enum console_print_type type, int max_loglevel, int pri
 	}
 
 	char c;
-	int suppressed = 0;
-	int tty = isatty(fileno(stdout));
-	while ((c = console_c[cursor++])) {
-		if (BIOS_LOG_IS_MARKER(c)) {
-			int lvl = BIOS_LOG_MARKER_TO_LEVEL(c);
-			if (lvl > max_loglevel) {
-				suppressed = 1;
-				continue;
+	while ((c = console_c[cursor++]))
+		console_output_char(out, c);
+
+	free(console_c);
+	unmap_memory(&console_mapping);
+
+	return raw_cursor;
+}
+
+#define CONSOLE_FOLLOW_INTERVAL_MS	100
+
+static void follow_console_range(struct console_output *out, const struct cbmem_console *console_p,
+				 size_t start, size_t end)
+{
+	char buf[4096];
+
+	while (start < end) {
+		size_t len = MIN(end - start, sizeof(buf));
+
+		aligned_memcpy(buf, console_p->body + start, len);
+		console_sanitize(buf, len);
+		for (size_t i = 0; i < len; i++)
+			console_output_char(out, buf[i]);
+		start += len;
+	}
+}
+
+/*
+ * Keep the console mapped and print whatever is added to it after the cursor
+ * returned by dump_console(), e.g. by SMI handlers, until interrupted. Only
+ * the new part of the ring buffer is copied on every poll. If the ring buffer
+ * wraps more than once between two polls, the lost part can't be detected.
+ */
+static void follow_console(uint32_t last, struct console_output *out)
+{
+	const struct cbmem_console *console_p;
+	struct mapping console_mapping;
+	const struct timespec interval = {
+		.tv_nsec = CONSOLE_FOLLOW_INTERVAL_MS * 1000000L,
+	};
+	size_t size;
+
+	if (console.tag != LB_TAG_CBMEM_CONSOLE)
+		return;
+
+	console_p = map_memory(&console_mapping, console.cbmem_addr, sizeof(*console_p));
+	if (!console_p)
+		die("Unable to map console object.\n");
+	size = console_p->size;
+	unmap_memory(&console_mapping);
+
+	console_p = map_memory(&console_mapping, console.cbmem_addr, size + sizeof(*console_p));
+	if (!console_p)
+		die("Unable to map full console object.\n");
+
+	while (1) {
+		uint32_t now = *(const volatile uint32_t *)&console_p->cursor;
+		size_t from = MIN(last & CBMC_CURSOR_MASK, size);
+		size_t to = MIN(now & CBMC_CURSOR_MASK, size);
+
+		if (now == last) {
+			nanosleep(&interval, NULL);
+			continue;
+		}
+
+		if (!(now & CBMC_OVERFLOW) && to < from) {
+			/* The console was started over. */
+			follow_console_range(out, console_p, 0, to);
+		} else if ((now & CBMC_OVERFLOW) && (to < from || !(last & CBMC_OVERFLOW))) {
+			/* The ring buffer wrapped around since the last poll. */
+			if (to >= from) {
+				fprintf(stderr, "cbmem: console overflowed, output was lost\n");
+				from = to;
 			}
-			suppressed = 0;
-			if (tty)
-				printf(BIOS_LOG_ESCAPE_PATTERN, bios_log_escape[lvl]);
-			printf(BIOS_LOG_PREFIX_PATTERN, bios_log_prefix[lvl]);
+			follow_console_range(out, console_p, from, size);
+			follow_console_range(out, console_p, 0, to);
 		} else {
-			if (!suppressed)
-				putchar(c);
-			if (c == '\n') {
-				if (tty && !suppressed)
-					printf(BIOS_LOG_ESCAPE_RESET);
-				suppressed = !print_unknown_logs;
-			}
+			follow_console_range(out, console_p, from, to);
 		}
+		fflush(stdout);
+		last = now;
 	}
-	if (tty)
-		printf(BIOS_LOG_ESCAPE_RESET);
-
-	free(console_c);
-	unmap_memory(&console_mapping);
 }
 
 static void hexdump(unsigned long memory, int length)
@@ -1547,11 +1885,12 @@ static void print_version(void)
 
 static void print_usage(const char *name, int exit_code)
 {
-	printf("usage: %s [-cCltTLxVvh?]\n", name);
+	printf("usage: %s [-cfCltTSFjJLxVvh?]\n", name);
 	printf("\n"
 	     "   -c | --console:                   print cbmem console\n"
 	     "   -1 | --oneboot:                   print cbmem console for last boot only\n"
 	     "   -2 | --2ndtolast:                 print cbmem console for the boot that came before the last one only\n"
+	     "   -f | --follow:                    keep printing what is added to the cbmem console\n"
 	     "   -B | --loglevel:                  maximum loglevel to print; prefix `+` (e.g. -B +INFO) to also print lines that have no level\n"
 	     "   -C | --coverage:                  dump coverage information\n"
 	     "   -l | --list:                      print cbmem table of contents\n"
@@ -1560,6 +1899,9 @@ static void print_usage(const char *name, int exit_code)
 	     "   -t | --timestamps:                print timestamp information\n"
 	     "   -T | --parseable-timestamps:      print parseable timestamps\n"
 	     "   -S | --stacked-timestamps:        print stacked timestamps (e.g. for flame graph tools)\n"
+	     "   -F | --folded-spans:              print timestamp spans as folded stacks for flame graph tools\n"
+	     "   -j | --trace-json:                print timestamp spans as Chrome trace event JSON\n"
+	     "   -J | --json:                      print console and timestamps as JSON lines\n"
 	     "   -a | --add-timestamp ID:          append timestamp with ID\n"
 	     "   -L | --tcpa-log                   print TPM log\n"
 	     "   -V | --verbose:                   verbose (debugging) output\n"
@@ -1688,6 +2030,8 @@ int main(int argc, char** argv)
 {
 	int print_defaults = 1;
 	int print_console = 0;
+	int follow = 0;
+	int json = 0;
 	int print_coverage = 0;
 	int print_list = 0;
 	int print_hexdump = 0;
@@ -1699,12 +2043,15 @@ int main(int argc, char** argv)
 	int max_loglevel = BIOS_NEVER;
 	int print_unknown_logs = 1;
 	uint32_t timestamp_id = 0;
+	uint32_t console_cursor = 0;
+	struct console_output console_out;
 
 	int opt, option_index = 0;
 	static struct option long_options[] = {
 		{"console", 0, 0, 'c'},
 		{"oneboot", 0, 0, '1'},
 		{"2ndtolast", 0, 0, '2'},
+		{"follow", 0, 0, 'f'},
 		{"loglevel", required_argument, 0, 'B'},
 		{"coverage", 0, 0, 'C'},
 		{"list", 0, 0, 'l'},
@@ -1712,6 +2059,9 @@ int main(int argc, char** argv)
 		{"timestamps", 0, 0, 't'},
 		{"parseable-timestamps", 0, 0, 'T'},
 		{"stacked-timestamps", 0, 0, 'S'},
+		{"folded-spans", 0, 0, 'F'},
+		{"trace-json", 0, 0, 'j'},
+		{"json", 0, 0, 'J'},
 		{"add-timestamp", required_argument, 0, 'a'},
 		{"hexdump", 0, 0, 'x'},
 		{"rawdump", required_argument, 0, 'r'},
@@ -1720,7 +2070,7 @@ int main(int argc, char** argv)
 		{"help", 0, 0, 'h'},
 		{0, 0, 0, 0}
 	};
-	while ((opt = getopt_long(argc, argv, "c12B:CltTSa:LxVvh?r:",
+	while ((opt = getopt_long(argc, argv, "c12fB:CltTSFjJa:LxVvh?r:",
 				  long_options, &option_index)) != EOF) {
 		switch (opt) {
 		case 'c':
@@ -1737,6 +2087,11 @@ int main(int argc, char** argv)
 			console_type = CONSOLE_PRINT_PREVIOUS;
 			print_defaults = 0;
 			break;
+		case 'f':
+			print_console = 1;
+			follow = 1;
+			print_defaults = 0;
+			break;
 		case 'B':
 			max_loglevel = parse_loglevel(optarg, &print_unknown_logs);
 			break;
@@ -1773,6 +2128,17 @@ int main(int argc, char** argv)
 			timestamp_type = TIMESTAMPS_PRINT_STACKED;
 			print_defaults = 0;
 			break;
+		case 'F':
+			timestamp_type = TIMESTAMPS_PRINT_SPANS_FOLDED;
+			print_defaults = 0;
+			break;
+		case 'j':
+			timestamp_type = TIMESTAMPS_PRINT_SPANS_JSON;
+			print_defaults = 0;
+			break;
+		case 'J':
+			json = 1;
+			break;
 		case 'a':
 			print_defaults = 0;
 			timestamp_id = timestamp_enum_name_to_id(optarg);
@@ -1874,8 +2240,12 @@ int main(int argc, char** argv)
 	if (mapping_virt(&lbtable_mapping) == NULL)
 		die("Table not found.\n");
 
-	if (print_console)
-		dump_console(console_type, max_loglevel, print_unknown_logs);
+	console_output_init(&console_out, max_loglevel, print_unknown_logs, json);
+	if (print_console) {
+		console_cursor = dump_console(console_type, &console_out);
+		if (!follow)
+			console_output_finish(&console_out);
+	}
 
 	if (print_coverage)
 		dump_coverage();
@@ -1895,12 +2265,24 @@ int main(int argc, char** argv)
 	if (print_defaults)
 		timestamp_type = TIMESTAMPS_PRINT_NORMAL;
 
-	if (timestamp_type != TIMESTAMPS_PRINT_NONE)
+	if (json && (timestamp_type == TIMESTAMPS_PRINT_NORMAL ||
+		     timestamp_type == TIMESTAMPS_PRINT_MACHINE_READABLE))
+		timestamp_type = TIMESTAMPS_PRINT_JSON_LINES;
+
+	if (timestamp_type == TIMESTAMPS_PRINT_SPANS_FOLDED ||
+	    timestamp_type == TIMESTAMPS_PRINT_SPANS_JSON)
+		dump_timestamp_spans(timestamp_type);
+	else if (timestamp_type != TIMESTAMPS_PRINT_NONE)
 		dump_timestamps(timestamp_type);
 
 	if (print_tcpa_log)
 		dump_tpm_log();
 
+	if (follow) {
+		fflush(stdout);
+		follow_console(console_cursor, &console_out);
+	}
+
 	unmap_memory(&lbtable_mapping);
 
 	close(mem_fd);
@@ -1338,6 +1338,8 @@ static void create_fmap_template(char *image, int size, const char *layout_fname
 		     "\t\t##CONSOLE_ENTRY##\n"
 		     "\t\t##MRC_CACHE_ENTRY##\n"
 		     "\t\t##SMMSTORE_ENTRY##\n"
+		     "\t\t##ACPI_CACHE_ENTRY##\n"
+		     "\t\t##PCI_CACHE_ENTRY##\n"
 		     "\t\t##SPD_CACHE_ENTRY##\n"
 		     "\t\t##VPD_ENTRY##\n"
 		     "\t\tFMAP@##FMAP_BASE## ##FMAP_SIZE##\n"
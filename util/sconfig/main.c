@@ -720,6 +720,17 @@ void add_device_ops(struct bus *bus, char *ops_id)
 	bus->dev->ops_id = ops_id;
 }
 
+void add_device_flag(struct bus *bus, char *flag)
+{
+	if (!strcmp(flag, "async_init")) {
+		bus->dev->init_async = 1;
+		return;
+	}
+
+	printf("ERROR: Unknown device flag '%s' in line %d.\n", flag, linenum + 1);
+	exit(1);
+}
+
 /* Allocate a new bus for the provided device. */
 static void alloc_bus(struct device *dev)
 {
@@ -997,8 +1008,8 @@ static void set_reference(struct chip_instance *const chip_instance,
 		exit(1);
 	}
 
-	char *const ref_name = S_ALLOC(strlen(dev->name) + 2);
-	sprintf(ref_name, "&%s", dev->name);
+	char *const ref_name = S_ALLOC(strlen(dev->ref) + 2);
+	sprintf(ref_name, "&%s", dev->ref);
 	add_register(chip_instance, name, ref_name);
 }
 
@@ -1071,11 +1082,34 @@ static int dev_has_children(struct device *dev)
 	return 0;
 }
 
+/* All devices in the order of all_devices, which is the order of the static_devices array. */
+static struct device **static_devs;
+static int static_dev_count;
+
+static void add_static_device(struct device *dev)
+{
+	static int allocated;
+
+	if (static_dev_count == allocated) {
+		allocated = allocated ? 2 * allocated : 64;
+		static_devs = realloc(static_devs, allocated * sizeof(*static_devs));
+		if (!static_devs) {
+			fprintf(stderr, "%s: Failed to alloc mem!\n", __func__);
+			exit(1);
+		}
+	}
+	dev->index = static_dev_count;
+	static_devs[static_dev_count++] = dev;
+}
+
 static void pass0(FILE *fil, FILE *head, struct device *ptr, struct device *next)
 {
 	static int dev_id;
 
+	add_static_device(ptr);
+
 	if (ptr == &base_root_dev) {
+		ptr->ref = ptr->name;
 		fprintf(fil, "STORAGE struct bus %s_bus;\n",
 			ptr->name);
 		return;
@@ -1093,20 +1127,16 @@ static void pass0(FILE *fil, FILE *head, struct device *ptr, struct device *next
 
 	ptr->name = name;
 
-	fprintf(fil, "STORAGE struct device %s;\n", ptr->name);
+	/* The root device is kept out of the array, it is dev_root. */
+	ptr->ref = S_ALLOC(32);
+	sprintf(ptr->ref, "static_devices[%d]", ptr->index - 1);
+
 	if (ptr->res)
 		fprintf(fil, "STORAGE struct resource %s_res[];\n",
 			ptr->name);
 	if (dev_has_children(ptr))
 		fprintf(fil, "STORAGE struct bus %s_bus;\n",
 			ptr->name);
-
-	if (next)
-		return;
-
-	fprintf(fil,
-		"DEVTREE_CONST struct device * DEVTREE_CONST last_dev = &%s;\n",
-		ptr->name);
 }
 
 static void emit_smbios_data(FILE *fil, struct device *ptr)
@@ -1178,8 +1208,8 @@ static void emit_dev_bus(FILE *fil, struct device *ptr)
 	assert(ptr->bus && ptr->bus->children);
 	struct bus *bus = ptr->bus;
 
-	fprintf(fil, "\t.dev = &%s,\n", bus->dev->name);
-	fprintf(fil, "\t.children = &%s,\n", bus->children->name);
+	fprintf(fil, "\t.dev = &%s,\n", bus->dev->ref);
+	fprintf(fil, "\t.children = &%s,\n", bus->children->ref);
 
 	fprintf(fil, "};\n");
 }
@@ -1197,11 +1227,9 @@ static struct chip_instance *get_chip_instance(const struct device *dev)
 	return chip_ins;
 }
 
+/* Emit the objects a device points to. */
 static void pass1(FILE *fil, FILE *head, struct device *ptr, struct device *next)
 {
-	struct chip_instance *chip_ins = get_chip_instance(ptr);
-	int has_children = dev_has_children(ptr);
-
 	/* Emit probe structures. */
 	if (ptr->probe && (emit_fw_config_probe(fil, ptr) < 0)) {
 		if (head)
@@ -1210,10 +1238,25 @@ static void pass1(FILE *fil, FILE *head, struct device *ptr, struct device *next
 		exit(1);
 	}
 
+	emit_resources(fil, ptr);
+
+	if (dev_has_children(ptr))
+		emit_dev_bus(fil, ptr);
+}
+
+/*
+ * Emit the device itself. All devices but the root device are emitted as one array, in the
+ * breadth-first order of all_devices, so walking the list or the tree stays within it.
+ */
+static void pass2(FILE *fil, FILE *head, struct device *ptr, struct device *next)
+{
+	struct chip_instance *chip_ins = get_chip_instance(ptr);
+	int has_children = dev_has_children(ptr);
+
 	if (ptr == &base_root_dev)
 		fprintf(fil, "DEVTREE_CONST struct device %s = {\n", ptr->name);
 	else
-		fprintf(fil, "STORAGE struct device %s = {\n", ptr->name);
+		fprintf(fil, "[%d] = { /* %s */\n", ptr->index - 1, ptr->name);
 
 	fprintf(fil, "#if !DEVTREE_EARLY\n");
 
@@ -1236,6 +1279,8 @@ static void pass1(FILE *fil, FILE *head, struct device *ptr, struct device *next
 	fprintf(fil, "\t.enabled = %d,\n", ptr->enabled);
 	fprintf(fil, "\t.hidden = %d,\n", ptr->hidden);
 	fprintf(fil, "\t.mandatory = %d,\n", ptr->mandatory);
+	if (ptr->init_async)
+		fprintf(fil, "\t.init_async = 1,\n");
 	fprintf(fil, "\t.on_mainboard = 1,\n");
 	if (ptr->subsystem_vendor > 0)
 		fprintf(fil, "\t.subsystem_vendor = 0x%04x,\n",
@@ -1255,7 +1300,7 @@ static void pass1(FILE *fil, FILE *head, struct device *ptr, struct device *next
 	else
 		fprintf(fil, "\t.downstream = NULL,\n");
 	if (ptr->sibling)
-		fprintf(fil, "\t.sibling = &%s,\n", ptr->sibling->name);
+		fprintf(fil, "\t.sibling = &%s,\n", ptr->sibling->ref);
 	else
 		fprintf(fil, "\t.sibling = NULL,\n");
 	if (ptr->probe)
@@ -1270,16 +1315,171 @@ static void pass1(FILE *fil, FILE *head, struct device *ptr, struct device *next
 		fprintf(fil, "\t.chip_info = &%s_info_%d,\n",
 			chip_ins->chip->name_underscore, chip_ins->id);
 	if (next)
-		fprintf(fil, "\t.next=&%s,\n", next->name);
+		fprintf(fil, "\t.next=&%s,\n", next->ref);
 
 	emit_smbios_data(fil, ptr);
 
+	if (ptr != &base_root_dev)
+		fprintf(fil, "},\n");
+	else
+		fprintf(fil, "};\n");
+
+	if (ptr == &base_root_dev && next)
+		fprintf(fil, "\nSTORAGE struct device static_devices[%d] = {\n",
+			static_dev_count - 1);
+	else if (ptr != &base_root_dev && !next)
+		fprintf(fil, "};\n");
+}
+
+/* Path type of a device, e.g. DEVICE_PATH_PCI, as set by its path initializer. */
+static char *path_type(const struct device *dev)
+{
+	char type[32];
+
+	if (sscanf(dev->path, " .type = %31[A-Z0-9_]", type) != 1) {
+		fprintf(stderr, "ERROR: Unknown path type of %s\n", dev->name);
+		exit(1);
+	}
+	return strdup(type);
+}
+
+static int pci_devfn(const struct device *dev)
+{
+	return dev->path_a << 3 | dev->path_b;
+}
+
+static int compare_devfn(const void *a, const void *b)
+{
+	return pci_devfn(static_devs[*(const int *)a]) - pci_devfn(static_devs[*(const int *)b]);
+}
+
+static void emit_index_list(FILE *fil, const char *name, const int *list, int count)
+{
+	fprintf(fil, "static const uint16_t %s[] = {", name);
+	for (int i = 0; i < count; i++)
+		fprintf(fil, "%s%d,", i % 16 ? " " : "\n\t", list[i]);
+	fprintf(fil, "\n};\n");
+}
+
+/*
+ * Emit the device numbers grouped into one range for every distinct key, keeping the order
+ * of all_devices within a range. The ranges are named after key_names, if given.
+ */
+static void emit_index(FILE *fil, const char *name, const void *const *keys,
+		       const char *const *key_names)
+{
+	int *list = S_ALLOC(static_dev_count * sizeof(*list));
+	int *first = S_ALLOC(static_dev_count * sizeof(*first));
+	int *key_dev = S_ALLOC(static_dev_count * sizeof(*key_dev));
+	int ranges = 0, count = 0;
+	char list_name[64];
+
+	for (int i = 0; i < static_dev_count; i++) {
+		int seen = 0;
+
+		for (int r = 0; r < ranges && !seen; r++)
+			seen = keys[key_dev[r]] == keys[i];
+		if (seen)
+			continue;
+
+		key_dev[ranges] = i;
+		first[ranges++] = count;
+		for (int j = i; j < static_dev_count; j++)
+			if (keys[j] == keys[i])
+				list[count++] = j;
+	}
+
+	snprintf(list_name, sizeof(list_name), "%s_devices", name);
+	emit_index_list(fil, list_name, list, count);
+
+	fprintf(fil, "static const struct devtree_index_range %s_ranges[] = {\n", name);
+	for (int r = 0; r < ranges; r++) {
+		int end = r + 1 < ranges ? first[r + 1] : count;
+
+		if (key_names)
+			fprintf(fil, "\t{ .key = %s, .first = %d, .count = %d },\n",
+				key_names[key_dev[r]], first[r], end - first[r]);
+		else
+			fprintf(fil, "\t{ .first = %d, .count = %d },\n",
+				first[r], end - first[r]);
+	}
 	fprintf(fil, "};\n");
 
-	emit_resources(fil, ptr);
+	free(list);
+	free(first);
+	free(key_dev);
+}
 
-	if (has_children)
-		emit_dev_bus(fil, ptr);
+/*
+ * Emit the index of the static devices, which lets device_const.c find devices by path
+ * type, chip driver and PCI devfn on the root bus without walking all of them.
+ */
+static void emit_devtree_index(FILE *fil)
+{
+	const void **keys = S_ALLOC(static_dev_count * sizeof(*keys));
+	char **types = S_ALLOC(static_dev_count * sizeof(*types));
+	int *pci_root = S_ALLOC(static_dev_count * sizeof(*pci_root));
+	int pci_root_count = 0;
+	struct device *domain = NULL;
+
+	if (static_dev_count > UINT16_MAX) {
+		fprintf(stderr, "ERROR: Too many devices in the devicetree\n");
+		exit(1);
+	}
+
+	/* Same path types share the string pointer, which is used as the key. */
+	for (int i = 0; i < static_dev_count; i++) {
+		types[i] = path_type(static_devs[i]);
+		for (int j = 0; j < i; j++) {
+			if (!strcmp(types[i], types[j])) {
+				types[i] = types[j];
+				break;
+			}
+		}
+		keys[i] = types[i];
+	}
+	emit_index(fil, "path", keys, (const char *const *)types);
+
+	/* Chip operations only exist in ramstage. */
+	for (int i = 0; i < static_dev_count; i++)
+		keys[i] = get_chip_instance(static_devs[i])->chip;
+	fprintf(fil, "#if !DEVTREE_EARLY\n");
+	emit_index(fil, "chip", keys, NULL);
+	fprintf(fil, "#endif\n");
+
+	/* pci_root_bus() is the bus of the first domain. */
+	for (int i = 0; i < static_dev_count && !domain; i++)
+		if (!strcmp(types[i], "DEVICE_PATH_DOMAIN"))
+			domain = static_devs[i];
+	if (domain && dev_has_children(domain)) {
+		for (struct device *d = domain->bus->children; d; d = d->sibling)
+			if (!strcmp(types[d->index], "DEVICE_PATH_PCI"))
+				pci_root[pci_root_count++] = d->index;
+		qsort(pci_root, pci_root_count, sizeof(*pci_root), compare_devfn);
+	}
+	if (pci_root_count)
+		emit_index_list(fil, "pci_root_devices", pci_root, pci_root_count);
+
+	fprintf(fil, "\nconst struct devtree_index devtree_index = {\n");
+	fprintf(fil, "\t.devices = static_devices,\n");
+	fprintf(fil, "\t.device_count = %d,\n", static_dev_count - 1);
+	fprintf(fil, "\t.paths = path_ranges,\n");
+	fprintf(fil, "\t.path_count = ARRAY_SIZE(path_ranges),\n");
+	fprintf(fil, "\t.by_path = path_devices,\n");
+	if (pci_root_count) {
+		fprintf(fil, "\t.pci_root = pci_root_devices,\n");
+		fprintf(fil, "\t.pci_root_count = ARRAY_SIZE(pci_root_devices),\n");
+	}
+	fprintf(fil, "#if !DEVTREE_EARLY\n");
+	fprintf(fil, "\t.chips = chip_ranges,\n");
+	fprintf(fil, "\t.chip_count = ARRAY_SIZE(chip_ranges),\n");
+	fprintf(fil, "\t.by_chip = chip_devices,\n");
+	fprintf(fil, "#endif\n");
+	fprintf(fil, "};\n");
+
+	free(types);
+	free(keys);
+	free(pci_root);
 }
 
 static void expose_device_names(FILE *fil, FILE *head, struct device *ptr, struct device *next)
@@ -1291,7 +1491,7 @@ static void expose_device_names(FILE *fil, FILE *head, struct device *ptr, struc
 		fprintf(head, "extern DEVTREE_CONST struct device *const __pci_%d_%02x_%d;\n",
 			ptr->parent->dev->path_a, ptr->path_a, ptr->path_b);
 		fprintf(fil, "DEVTREE_CONST struct device *const __pci_%d_%02x_%d = &%s;\n",
-			ptr->parent->dev->path_a, ptr->path_a, ptr->path_b, ptr->name);
+			ptr->parent->dev->path_a, ptr->path_a, ptr->path_b, ptr->ref);
 
 		if (chip_ins->chip->chiph_exists) {
 			fprintf(head, "extern DEVTREE_CONST void *const __pci_%d_%02x_%d_config;\n",
@@ -1306,13 +1506,13 @@ static void expose_device_names(FILE *fil, FILE *head, struct device *ptr, struc
 		fprintf(head, "extern DEVTREE_CONST struct device *const __pnp_%04x_%02x;\n",
 			ptr->path_a, ptr->path_b);
 		fprintf(fil, "DEVTREE_CONST struct device *const __pnp_%04x_%02x = &%s;\n",
-			ptr->path_a, ptr->path_b, ptr->name);
+			ptr->path_a, ptr->path_b, ptr->ref);
 	}
 
 	if (ptr->alias) {
 		fprintf(head, "extern DEVTREE_CONST struct device *const %s_ptr;\n", ptr->name);
 		fprintf(fil, "DEVTREE_CONST struct device *const %s_ptr = &%s;\n",
-			ptr->name, ptr->name);
+			ptr->name, ptr->ref);
 	}
 }
 
@@ -1701,6 +1901,9 @@ static void update_device(struct device *base_dev, struct device *override_dev)
 	 */
 	base_dev->hidden = override_dev->hidden;
 
+	/* An override tree can flag devices for parallel init(), but not unflag them. */
+	base_dev->init_async |= override_dev->init_async;
+
 	/*
 	 * Copy subsystem vendor and device ids from override device to base
 	 * device only if the ids are non-zero in override device. Else, honor
@@ -1906,11 +2109,18 @@ static void generate_outputc(FILE *f, const char *static_header)
 	walk_device_tree(NULL, NULL, &base_root_dev, inherit_subsystem_ids);
 	fprintf(f, "\n/* pass 0 */\n");
 	walk_device_tree(f, NULL, &base_root_dev, pass0);
+	fprintf(f, "STORAGE struct device static_devices[%d];\n", static_dev_count - 1);
+	fprintf(f, "DEVTREE_CONST struct device * DEVTREE_CONST last_dev = &%s;\n",
+		static_devs[static_dev_count - 1]->ref);
 	walk_device_tree(NULL, NULL, &base_root_dev, update_references);
 	fprintf(f, "\n/* chip configs */\n");
 	emit_chip_configs(f);
 	fprintf(f, "\n/* pass 1 */\n");
 	walk_device_tree(f, NULL, &base_root_dev, pass1);
+	fprintf(f, "\n/* pass 2 */\n");
+	walk_device_tree(f, NULL, &base_root_dev, pass2);
+	fprintf(f, "\n/* device index */\n");
+	emit_devtree_index(f);
 }
 
 static void generate_outputd(FILE *gen, FILE *dev)
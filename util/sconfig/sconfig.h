@@ -119,6 +119,8 @@ struct device {
 	int hidden;
 	/* non-zero if the device should be included in all cases */
 	int mandatory;
+	/* non-zero if init() may run in parallel with other devices */
+	int init_async;
 
 	/* Subsystem IDs for the device. */
 	int subsystem_vendor;
@@ -128,6 +130,12 @@ struct device {
 	/* Name of this device. */
 	char *name;
 
+	/* Expression referring to this device in the generated code. */
+	char *ref;
+
+	/* Position of this device in all_devices, 0 for the root device. */
+	int index;
+
 	/* Alias of this device (for internal references) */
 	char *alias;
 
@@ -227,3 +235,4 @@ void append_fw_config_bits(struct fw_config_field_bits **bits,
 			   unsigned int start_bit, unsigned int end_bit);
 
 void add_device_ops(struct bus *, char *ops_id);
+void add_device_flag(struct bus *bus, char *flag);
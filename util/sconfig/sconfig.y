@@ -46,7 +46,7 @@ device: DEVICE BUS NUMBER /* == devnum */ alias status {
 	$<dev>$ = new_device_raw(cur_parent, cur_chip_instance, $<number>2, $<string>3, $<string>4, $<number>5);
 	cur_parent = $<dev>$->bus;
 }
-	devicechildren END {
+	device_flags devicechildren END {
 	cur_parent = $<dev>6->parent;
 };
 
@@ -54,7 +54,7 @@ device: DEVICE REFERENCE STRING status {
 	$<dev>$ = new_device_reference(cur_parent, cur_chip_instance, $<string>3, $<number>4);
 	cur_parent = $<dev>$->bus;
 }
-	devicechildren END {
+	device_flags devicechildren END {
 	cur_parent = $<dev>5->parent;
 };
 
@@ -66,6 +66,10 @@ alias: /* empty */ {
 
 status: BOOL | STATUS ;
 
+/* Flags follow the status, anything else starts with a keyword. */
+device_flags: device_flags STRING /* == flag name */
+	{ add_device_flag(cur_parent, $<string>2); } | /* empty */ ;
+
 resource: RESOURCE NUMBER /* == resnum */ EQUALS NUMBER /* == resval */
 	{ add_resource(cur_parent, $<number>1, strtol($<string>2, NULL, 0), strtol($<string>4, NULL, 0)); } ;
 
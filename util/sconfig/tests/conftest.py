@@ -0,0 +1,12 @@
+# SPDX-License-Identifier: GPL-2.0-only
+
+import pathlib
+
+
+def pytest_addoption(parser):
+    top = pathlib.Path(__file__).parent / ".." / ".." / ".."
+    parser.addoption(
+        "--sconfig-path",
+        type=pathlib.Path,
+        default=(top / "build" / "util" / "sconfig" / "sconfig").resolve(),
+    )
@@ -0,0 +1,121 @@
+#!/usr/bin/python3
+# SPDX-License-Identifier: GPL-2.0-only
+
+import os
+import pathlib
+import pytest
+import re
+import subprocess
+
+TOP = (pathlib.Path(__file__).parent / ".." / ".." / "..").resolve()
+
+# Devices are numbered in the order of all_devices: the root, then the devices on each
+# bus before the devices behind them. The PCI device behind the bridge comes last.
+DEVICETREE = """
+chip mainboard/emulation/qemu-q35
+	device cpu_cluster 0 on end
+	device domain 0 on
+		device pci 1f.0 on
+			chip superio/ite/it8772f
+				device pnp 2e.1 on end
+			end
+		end
+		device pci 00.0 on end
+		device pci 1c.0 on
+			device pci 00.0 on end
+		end
+		device pci 02.0 on end
+	end
+end
+"""
+
+NO_DOMAIN_DEVICETREE = """
+chip mainboard/emulation/qemu-q35
+	device cpu_cluster 0 on end
+end
+"""
+
+
+@pytest.fixture(scope="session")
+def sconfig_path(request):
+    exe = request.config.option.sconfig_path
+    assert os.path.exists(exe)
+    return exe
+
+
+def run_sconfig(sconfig_path, tmp_path, devicetree: str) -> str:
+    tree = tmp_path / "devicetree.cb"
+    tree.write_text(devicetree)
+    # sconfig looks up the chip drivers relative to the top of the tree.
+    subprocess.run([sconfig_path, "-m", tree, "-c", tmp_path / "static.c",
+                    "-r", tmp_path / "static.h", "-d", tmp_path / "static_devices.h",
+                    "-f", tmp_path / "static_fw_config.h"], cwd=TOP, check=True)
+    return (tmp_path / "static.c").read_text()
+
+
+def index_list(static_c: str, name: str) -> list:
+    m = re.search(r"static const uint16_t %s\[\] = \{([^}]*)\};" % name, static_c)
+    assert m, f"{name} not emitted"
+    return [int(n) for n in m.group(1).replace(",", " ").split()]
+
+
+def path_ranges(static_c: str) -> dict:
+    m = re.search(r"path_ranges\[\] = \{(.*?)\n\};", static_c, re.S)
+    assert m
+    return {key: (int(first), int(count)) for key, first, count in
+            re.findall(r"\.key = (\w+), \.first = (\d+), \.count = (\d+)", m.group(1))}
+
+
+def dev_number(static_c: str, symbol: str) -> int:
+    m = re.search(r"%s = &static_devices\[(\d+)\];" % symbol, static_c)
+    assert m, f"{symbol} not emitted"
+    return int(m.group(1)) + 1
+
+
+def test_path_ranges(sconfig_path, tmp_path):
+    static_c = run_sconfig(sconfig_path, tmp_path, DEVICETREE)
+    ranges = path_ranges(static_c)
+    by_path = index_list(static_c, "path_devices")
+
+    assert ranges == {
+        "DEVICE_PATH_ROOT": (0, 1),
+        "DEVICE_PATH_CPU_CLUSTER": (1, 1),
+        "DEVICE_PATH_DOMAIN": (2, 1),
+        "DEVICE_PATH_PCI": (3, 5),
+        "DEVICE_PATH_PNP": (8, 1),
+    }
+    assert sorted(by_path) == list(range(9))
+
+    def devices(key):
+        first, count = ranges[key]
+        return by_path[first:first + count]
+
+    assert devices("DEVICE_PATH_ROOT") == [0]
+    assert devices("DEVICE_PATH_PNP") == [dev_number(static_c, "__pnp_002e_01")]
+
+    # Ranges keep the order of all_devices.
+    pci = devices("DEVICE_PATH_PCI")
+    assert pci == sorted(pci)
+    on_root = [dev_number(static_c, f"__pci_0_{devfn}") for devfn in
+               ("1f_0", "00_0", "1c_0", "02_0")]
+    assert pci[:4] == on_root
+
+
+def test_pci_root_devices(sconfig_path, tmp_path):
+    static_c = run_sconfig(sconfig_path, tmp_path, DEVICETREE)
+
+    # Sorted by devfn, without the device behind the bridge.
+    assert index_list(static_c, "pci_root_devices") == [
+        dev_number(static_c, f"__pci_0_{devfn}") for devfn in
+        ("00_0", "02_0", "1c_0", "1f_0")]
+    assert ".pci_root = pci_root_devices," in static_c
+
+
+def test_no_pci_root_devices(sconfig_path, tmp_path):
+    static_c = run_sconfig(sconfig_path, tmp_path, NO_DOMAIN_DEVICETREE)
+
+    assert "pci_root_devices" not in static_c
+    assert path_ranges(static_c) == {
+        "DEVICE_PATH_ROOT": (0, 1),
+        "DEVICE_PATH_CPU_CLUSTER": (1, 1),
+    }